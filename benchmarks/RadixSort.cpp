@@ -0,0 +1,397 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Radix sort microbenchmark.
+ *
+ * Standalone program to measure the throughput of the sorting engines of
+ * Aqua::CalcServer::RadixSort, i.e. the classic one (histogram, scan, paste
+ * and sort kernels per pass) and the onesweep one (a single kernel per pass),
+ * from 10^4 to 10^8 random keys.
+ *
+ * The number of keys is padded to the next power of 2 with the maximum key,
+ * as the arrays of AQUAgpusph are, but the throughput is computed with the
+ * actual number of keys. All the onesweep candidates considered by the tool
+ * tuning are timed, reporting the best one. The results are checked against
+ * std::stable_sort.
+ *
+ * The work sizes, the memory objects and the kernels enqueueing are carried
+ * out by Aqua::CalcServer::RadixSortPasses, i.e. the same host code than the
+ * tool.
+ */
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <climits>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <CL/cl.h>
+
+#include <CalcServer/RadixSortPasses.h>
+#include "CalcServer/RadixSort.hcl"
+#include "CalcServer/RadixSort.cl"
+
+#ifndef _ITEMS
+    #define _ITEMS  128
+#endif
+#ifndef _GROUPS
+    #define _GROUPS 32
+#endif
+#ifndef _HISTOSPLIT
+    #define _HISTOSPLIT 512
+#endif
+
+using namespace Aqua::CalcServer;
+
+/// Bits sorted in each pass by the classic engine
+#define CLASSIC_BITS 4
+/// Number of timed repetitions of each sorting
+#define REPETITIONS 5
+
+/** @struct program
+ * @brief Radix sort kernels, compiled for a number of bits per pass
+ */
+struct program{
+    /// OpenCL program
+    cl_program prog;
+    /// Kernels
+    RadixSortPasses::kernels kernels;
+};
+
+/// OpenCL context
+static cl_context context = NULL;
+/// OpenCL device
+static cl_device_id device = NULL;
+/// OpenCL command queue
+static cl_command_queue queue = NULL;
+
+/** @brief Throw an exception if an OpenCL call failed.
+ * @param err_code OpenCL error code.
+ * @param what Failing operation.
+ */
+static void check(cl_int err_code, const std::string what)
+{
+    if(err_code == CL_SUCCESS)
+        return;
+    std::ostringstream msg;
+    msg << what << " failed with the OpenCL error " << err_code;
+    throw std::runtime_error(msg.str());
+}
+
+/** @brief Build the radix sort kernels.
+ * @param bits Bits sorted in each pass.
+ * @return Compiled kernels.
+ */
+static program build(unsigned int bits)
+{
+    cl_int err_code;
+    program p;
+
+    const std::string source =
+        std::string((const char*)RadixSort_hcl_in, RadixSort_hcl_in_len) +
+        std::string((const char*)RadixSort_cl_in, RadixSort_cl_in_len);
+    const char *source_cstr = source.c_str();
+    const size_t source_length = source.size();
+    p.prog = clCreateProgramWithSource(context,
+                                       1,
+                                       &source_cstr,
+                                       &source_length,
+                                       &err_code);
+    check(err_code, "clCreateProgramWithSource");
+
+    // Same flags than Aqua::CalcServer::RadixSort
+    std::ostringstream flags;
+    flags << "-D_BITS=" << bits << " -D_RADIX=" << (1u << bits)
+          << " -DPERMUT -DNDEBUG -cl-mad-enable -cl-fast-relaxed-math"
+          << " -DHAVE_3D";
+    err_code = clBuildProgram(p.prog, 0, NULL, flags.str().c_str(), NULL, NULL);
+    if(err_code != CL_SUCCESS){
+        size_t log_size = 0;
+        clGetProgramBuildInfo(p.prog, device, CL_PROGRAM_BUILD_LOG, 0, NULL,
+                              &log_size);
+        std::string log(log_size, '\0');
+        clGetProgramBuildInfo(p.prog, device, CL_PROGRAM_BUILD_LOG, log_size,
+                              &log[0], NULL);
+        std::cerr << log << std::endl;
+        check(err_code, "clBuildProgram");
+    }
+
+    const std::pair<cl_kernel*, const char*> kernels[] = {
+        {&p.kernels.init, "init"},
+        {&p.kernels.histogram, "histogram"},
+        {&p.kernels.scan, "scan"},
+        {&p.kernels.paste, "paste"},
+        {&p.kernels.sort, "sort"},
+        {&p.kernels.counts, "digitCounts"},
+        {&p.kernels.onesweep, "onesweep"}};
+    for(auto kernel : kernels){
+        *kernel.first = clCreateKernel(p.prog, kernel.second, &err_code);
+        check(err_code, std::string("clCreateKernel(") + kernel.second + ")");
+    }
+    return p;
+}
+
+/** @brief Release the radix sort kernels.
+ * @param p Compiled kernels.
+ */
+static void release(program &p)
+{
+    const RadixSortPasses::kernels &k = p.kernels;
+    for(auto kernel : {k.init, k.histogram, k.scan, k.paste, k.sort,
+                       k.counts, k.onesweep}){
+        clReleaseKernel(kernel);
+    }
+    clReleaseProgram(p.prog);
+}
+
+/** @brief Time an engine, checking the result.
+ * @param p Compiled kernels.
+ * @param e Engine parameters.
+ * @param keys Keys to sort.
+ * @param sorted Reference sorted permutations.
+ * @param key_bits Bits of the maximum key.
+ * @return Best elapsed time among the repetitions (seconds).
+ */
+static double run(const program &p,
+                  RadixSortPasses::params e,
+                  const std::vector<cl_uint> &keys,
+                  const std::vector<cl_uint> &sorted,
+                  unsigned int key_bits)
+{
+    const cl_uint n = keys.size();
+    const cl_uint n_pass = std::max(1u, (key_bits + e.bits - 1) / e.bits);
+    if(e.onesweep)
+        e.groups = std::min(RadixSortPasses::tiles(e, n), 256u);
+    else
+        RadixSortPasses::classicDims(device, p.kernels, e);
+    RadixSortPasses::mems m = {NULL, NULL, NULL, NULL, NULL,
+                               NULL, NULL, NULL, NULL};
+    RadixSortPasses::allocate(context, e, n, m);
+
+    // The first execution is discarded, since it may include some
+    // initialization overhead
+    double best_time = std::numeric_limits<double>::max();
+    for(unsigned int i = 0; i <= REPETITIONS; i++){
+        check(clEnqueueWriteBuffer(queue, m.in_keys, CL_TRUE, 0,
+                                   n * sizeof(cl_uint), keys.data(),
+                                   0, NULL, NULL),
+              "clEnqueueWriteBuffer");
+        auto start = std::chrono::high_resolution_clock::now();
+        cl_event event = RadixSortPasses::passes(queue, p.kernels, m, e,
+                                                 n, n_pass, NULL);
+        check(clWaitForEvents(1, &event), "clWaitForEvents");
+        std::chrono::duration<double> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+        clReleaseEvent(event);
+        if(i && (elapsed.count() < best_time))
+            best_time = elapsed.count();
+    }
+
+    // Check the permutations, which are stable and unique
+    std::vector<cl_uint> permut(n);
+    check(clEnqueueReadBuffer(queue, m.in_permut, CL_TRUE, 0,
+                              n * sizeof(cl_uint), permut.data(),
+                              0, NULL, NULL),
+          "clEnqueueReadBuffer");
+    RadixSortPasses::release(m);
+    if(permut != sorted)
+        throw std::runtime_error("Wrong sorting result");
+
+    return best_time;
+}
+
+/** @brief Show the program usage.
+ */
+static void displayUsage()
+{
+    std::cout << "Usage:\tAQUAgpusph-bench-radixsort [Option]..." << std::endl;
+    std::cout << "Measure the throughput of the radix sort engines"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -p, --platform=INDEX         OpenCL platform (0 by default)"
+              << std::endl;
+    std::cout << "  -d, --device=INDEX           OpenCL device (0 by default)"
+              << std::endl;
+    std::cout << "  -b, --bits=BITS              Bits of the random keys (32 "
+              << "by default)" << std::endl;
+    std::cout << "  -n, --max=N                  Maximum number of keys "
+              << "(10^8 by default)" << std::endl;
+    std::cout << "  -h, --help                   Show this help page"
+              << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    cl_int err_code;
+    unsigned int platform_id = 0, device_id = 0, key_bits = 32;
+    unsigned long long max_n = 100000000ull;
+
+    const char *opts = "p:d:b:n:h";
+    const struct option longOpts[] = {
+        {"platform", required_argument, NULL, 'p'},
+        {"device", required_argument, NULL, 'd'},
+        {"bits", required_argument, NULL, 'b'},
+        {"max", required_argument, NULL, 'n'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, no_argument, NULL, 0}
+    };
+    int index, opt;
+    while((opt = getopt_long(argc, argv, opts, longOpts, &index)) != -1){
+        switch(opt){
+            case 'p':
+                platform_id = std::stoi(optarg);
+                break;
+            case 'd':
+                device_id = std::stoi(optarg);
+                break;
+            case 'b':
+                key_bits = std::stoi(optarg);
+                break;
+            case 'n':
+                max_n = std::stoull(optarg);
+                break;
+            case 'h':
+                displayUsage();
+                return EXIT_SUCCESS;
+            default:
+                displayUsage();
+                return EXIT_FAILURE;
+        }
+    }
+    if(!key_bits || (key_bits > 32) || (max_n >= (1ull << 30))){
+        std::cerr << "Invalid number of key bits or keys" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        cl_uint n_platforms, n_devices;
+        check(clGetPlatformIDs(0, NULL, &n_platforms), "clGetPlatformIDs");
+        if(platform_id >= n_platforms)
+            throw std::runtime_error("Invalid platform");
+        std::vector<cl_platform_id> platforms(n_platforms);
+        check(clGetPlatformIDs(n_platforms, platforms.data(), NULL),
+              "clGetPlatformIDs");
+        check(clGetDeviceIDs(platforms.at(platform_id), CL_DEVICE_TYPE_ALL,
+                             0, NULL, &n_devices),
+              "clGetDeviceIDs");
+        if(device_id >= n_devices)
+            throw std::runtime_error("Invalid device");
+        std::vector<cl_device_id> devices(n_devices);
+        check(clGetDeviceIDs(platforms.at(platform_id), CL_DEVICE_TYPE_ALL,
+                             n_devices, devices.data(), NULL),
+              "clGetDeviceIDs");
+        device = devices.at(device_id);
+        context = clCreateContext(NULL, 1, &device, NULL, NULL, &err_code);
+        check(err_code, "clCreateContext");
+        queue = clCreateCommandQueue(context, device, 0, &err_code);
+        check(err_code, "clCreateCommandQueue");
+
+        char device_name[1024];
+        clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name),
+                        device_name, NULL);
+        std::cout << "Device: " << device_name << std::endl;
+        std::cout << "Keys bits: " << key_bits << std::endl << std::endl;
+
+        // Kernels for each number of bits per pass
+        std::vector<std::pair<unsigned int, program>> programs;
+        for(auto bits : {CLASSIC_BITS, 6, 8})
+            programs.push_back({bits, build(bits)});
+
+        std::cout << std::setw(12) << "N"
+                  << std::setw(20) << "classic [Mkeys/s]"
+                  << std::setw(20) << "onesweep [Mkeys/s]"
+                  << std::setw(10) << "speedup"
+                  << "   onesweep (bits, items, keys per thread)"
+                  << std::endl;
+
+        std::mt19937 generator(0);
+        const cl_uint max_key = (key_bits < 32) ? (1u << key_bits) - 1u :
+                                                  UINT_MAX;
+        for(unsigned long long n_keys = 10000ull; n_keys <= max_n;
+            n_keys *= 10){
+            // Pad the keys up to the next power of 2 with the maximum key
+            cl_uint n = 1;
+            while(n < n_keys)
+                n <<= 1;
+            std::vector<cl_uint> keys(n, max_key);
+            for(cl_uint i = 0; i < n_keys; i++)
+                keys.at(i) = generator() & max_key;
+            std::vector<cl_uint> sorted(n);
+            std::iota(sorted.begin(), sorted.end(), 0u);
+            std::stable_sort(sorted.begin(), sorted.end(),
+                [&keys](cl_uint a, cl_uint b){return keys[a] < keys[b];});
+
+            const RadixSortPasses::params classic_engine =
+                {false, CLASSIC_BITS, _ITEMS, _GROUPS, _HISTOSPLIT, 0};
+            const double classic_time = run(programs.front().second,
+                                            classic_engine,
+                                            keys,
+                                            sorted,
+                                            key_bits);
+
+            RadixSortPasses::params best;
+            double best_time = std::numeric_limits<double>::max();
+            for(auto &p : programs){
+                auto engines = RadixSortPasses::candidates(device,
+                                                           p.second.kernels,
+                                                           p.first);
+                for(auto e : engines){
+                    const double t = run(p.second, e, keys, sorted, key_bits);
+                    if(t < best_time){
+                        best = e;
+                        best_time = t;
+                    }
+                }
+            }
+
+            std::ostringstream params;
+            params << "(" << best.bits << ", " << best.items << ", "
+                   << best.kpt << ")";
+            std::cout << std::setw(12) << n_keys
+                      << std::setw(20) << std::fixed << std::setprecision(1)
+                      << n_keys / classic_time * 1.e-6
+                      << std::setw(20) << n_keys / best_time * 1.e-6
+                      << std::setw(10) << std::setprecision(2)
+                      << classic_time / best_time
+                      << "   " << params.str() << std::endl;
+        }
+
+        for(auto &p : programs)
+            release(p.second);
+        clReleaseCommandQueue(queue);
+        clReleaseContext(context);
+    } catch(RadixSortPasses::opencl_error &e) {
+        std::cerr << "Error: " << e.what() << " (OpenCL error " << e.code()
+                  << ")" << std::endl;
+        return EXIT_FAILURE;
+    } catch(std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
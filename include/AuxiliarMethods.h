@@ -24,7 +24,9 @@
 #define AUXILIARMETHODS_H_INCLUDED
 
 #include <sphPrerequisites.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace Aqua{
 
@@ -200,6 +202,46 @@ bool isFile(const std::string file_name);
  */
 bool isRelativePath(const std::string path);
 
+/** @brief Create the folder @paramname{path}, and all its parents, if it does
+ * not exist yet.
+ *
+ * @param path The folder path.
+ * @return true if the folder exists or it has been created, false otherwise.
+ */
+bool makeFolder(const std::string path);
+
+/** @brief Compute the 64 bits FNV-1a hash of @paramname{data}.
+ *
+ * Several chunks of data can be hashed passing the previous result as
+ * @paramname{hash}.
+ * @param data Data to be hashed.
+ * @param hash Initial hash value.
+ * @return Hash value.
+ */
+uint64_t hashString(const std::string data,
+                    uint64_t hash=14695981039346656037ULL);
+
+/** @brief Hash the files included by a source code, recursively.
+ *
+ * The path and the content of each included file is hashed. The included
+ * files are looked for in the folder of the including file, in the
+ * @paramname{dirs} folders, and in the current folder. Computed includes,
+ * i.e. the ones built with macros, cannot be resolved without preprocessing,
+ * so all the files in the folder they are pointing to are hashed instead.
+ *
+ * The content of the files is read just once per run.
+ * @param source Source code.
+ * @param folder Folder of the source code file. An empty string if the
+ * source code is not coming from a file.
+ * @param dirs Include folders, e.g. the ones passed with the "-I" flags.
+ * @param hash Initial hash value.
+ * @return Hash value.
+ */
+uint64_t hashIncludes(const std::string source,
+                      const std::string folder,
+                      const std::vector<std::string> &dirs,
+                      uint64_t hash=14695981039346656037ULL);
+
 /// Compute the maximum local work size allowed by a device.
 /**
  * @param n Amount of data to operate in kernel (aiming threads to launch).
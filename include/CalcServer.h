@@ -37,6 +37,11 @@
 #include <Variable.h>
 #include <Singleton.h>
 #include <CalcServer/Tool.h>
+#include <CalcServer/ProgramCache.h>
+#include <CalcServer/StagingPool.h>
+#include <CalcServer/SignatureIndex.h>
+#include <CalcServer/Replay.h>
+#include <CalcServer/Quantize.h>
 
 #ifndef _ITEMS
     /** @def _ITEMS
@@ -63,6 +68,7 @@ namespace Aqua{
 namespace CalcServer{
 
 class UnSort;
+class Filter;
 
 /** @class CalcServer CalcServer.h CalcServer.h
  * @brief Exception raised when the user manually interrupts the simulation.
@@ -104,11 +110,15 @@ public:
     /** @brief Internal time loop.
      * 
      * Calculation server will be iterating while no output files should be
-     * updated (or even the simulation is finished).
+     * updated (or even the simulation is finished). The loop is also
+     * interrupted, between time steps, when a checkpoint must be taken (see
+     * Aqua::InputOutput::TimeManager::mustCheckpoint()).
      * @param t_manager Time manager to let the calculation server when shall
      * stop the internal loop.
+     * @return true if the output files should be updated, false if a
+     * checkpoint must be taken instead.
      */
-    void update(InputOutput::TimeManager& t_manager);
+    bool update(InputOutput::TimeManager& t_manager);
 
     /// Setup some additional simulation data.
     /** Even thought this work is associated with the constructor CalcServer(),
@@ -152,26 +162,113 @@ public:
      */
     cl_command_queue command_queue() const{return _command_queue;}
 
-    /** Download a unsorted variable from the device.
-     * @param var_name Variable to unsort and download.
-     * @param offset The offset in bytes in the memory object to read from.
-     * @param cb The size in bytes of data being downloaded.
-     * @param ptr The host memory where the data should be copied
+    /** Download a set of unsorted variables from the device.
+     *
+     * The variables are unsorted by a single kernel, packing them in a device
+     * buffer, which is downloaded in a single transfer into a staging buffer
+     * (see staging()).
+     * @param var_names Variables to unsort and download.
+     * @param first First particle to download (in the unsorted space).
+     * @param n Number of particles to download.
+     * @param ptrs Returned host memory where the data of each variable is
+     * copied. Each pointer shall be released back to the staging pool.
+     * @param tolerances Quantization tolerance of each variable, 0 to
+     * download it without quantization (see Aqua::CalcServer::Quantize).
+     * @param quants Returned quantization of each variable. Mandatory if
+     * tolerances are provided.
+     * @return The data download event, NULL if errors are detected.
+     * @note The caller must wait for the events (clWaitForEvents) before
+     * accessing the downloaded data.
+     * @remarks The caller must call clReleaseEvent to destroy the event.
+     * Otherwise a memory leak can be expected.
+     */
+    cl_event getUnsortedMem(const std::vector<std::string> var_names,
+                            unsigned int first,
+                            unsigned int n,
+                            std::vector<void*> &ptrs,
+                            const std::vector<float> tolerances=std::vector<float>(),
+                            std::vector<quantization> *quants=NULL);
+
+    /** Download a set of unsorted variables from the device, just for the
+     * particles meeting a condition.
+     *
+     * The variables are unsorted like in getUnsortedMem(), and then the
+     * particles are filtered in the device (see Aqua::CalcServer::Filter),
+     * such that just the kept particles are downloaded.
+     * @param var_names Variables to unsort and download.
+     * @param first First particle to consider (in the unsorted space).
+     * @param n Number of particles to consider.
+     * @param condition OpenCL condition to be met by the particles.
+     * @param condition_names Variables used by the condition.
+     * @param ptrs Returned host memory where the data of each variable is
+     * copied. Each pointer shall be released back to the staging pool.
+     * @param m Returned number of particles meeting the condition.
+     * @param tolerances Quantization tolerance of each variable, 0 to
+     * download it without quantization (see Aqua::CalcServer::Quantize).
+     * @param quants Returned quantization of each variable. Mandatory if
+     * tolerances are provided.
+     * @return The data download event, NULL if errors are detected.
+     * @note The caller must wait for the events (clWaitForEvents) before
+     * accessing the downloaded data.
+     * @remarks The caller must call clReleaseEvent to destroy the event.
+     * Otherwise a memory leak can be expected.
+     */
+    cl_event getFilteredMem(const std::vector<std::string> var_names,
+                            unsigned int first,
+                            unsigned int n,
+                            const std::string condition,
+                            const std::vector<std::string> condition_names,
+                            std::vector<void*> &ptrs,
+                            unsigned int &m,
+                            const std::vector<float> tolerances=std::vector<float>(),
+                            std::vector<quantization> *quants=NULL);
+
+    /** Download a set of unsorted variables from the device, just for a
+     * selection of particles.
+     *
+     * The selected particles are gathered by the same kernel unsorting the
+     * variables (see Aqua::CalcServer::UnSort), such that just them are
+     * downloaded.
+     * @param var_names Variables to unsort and download.
+     * @param first First particle of the range (in the unsorted space).
+     * @param n Number of particles of the range.
+     * @param map Position in the downloaded data of each particle of the
+     * range, 0xFFFFFFFF for the discarded ones. It shall have n components.
+     * @param m Number of selected particles.
+     * @param ptrs Returned host memory where the data of each variable is
+     * copied. Each pointer shall be released back to the staging pool.
      * @return The data download event, NULL if errors are detected.
      * @note The caller must wait for the events (clWaitForEvents) before
      * accessing the downloaded data.
      * @remarks The caller must call clReleaseEvent to destroy the event.
      * Otherwise a memory leak can be expected.
      */
-    cl_event getUnsortedMem(const std::string var_name,
-                            size_t offset,
-                            size_t cb,
-                            void *ptr);
+    cl_event getGatheredMem(const std::vector<std::string> var_names,
+                            unsigned int first,
+                            unsigned int n,
+                            cl_mem map,
+                            unsigned int m,
+                            std::vector<void*> &ptrs);
 
     /** @brief Get the AQUAgpusph root path.
      * @return AQUAgpusph root path
      */
     const std::string base_path() const{return _base_path.c_str();}
+
+    /** @brief Get the compiled OpenCL programs cache.
+     * @return Programs cache
+     */
+    ProgramCache* program_cache() const{return _program_cache;}
+
+    /** @brief Get the kernels arguments index.
+     * @return Kernels signatures index
+     */
+    SignatureIndex* signatures() const{return _signatures;}
+
+    /** @brief Get the pinned host buffers pool, to download data.
+     * @return Staging buffers pool
+     */
+    StagingPool* staging() const{return _staging;}
 private:
     /** Setup the OpenCL stuff.
      */
@@ -186,6 +283,72 @@ private:
      */
     void setupDevices();
 
+    /** @brief Select the command queue where a tool should be enqueued.
+     *
+     * In the concurrent mode (see
+     * Aqua::InputOutput::ProblemSetup::sphSettings::queues) the tool is sent
+     * to the queue where the last writer of any of its variables was sent,
+     * such that the chained tools are not bouncing between queues. Otherwise
+     * the queues are selected in a round-robin fashion, so independent tools
+     * can be overlapped.
+     *
+     * The synchronization between queues is anyway granted by the variables
+     * events (see Aqua::CalcServer::Tool::getEvents()).
+     * @param tool Tool to be enqueued.
+     * @return The command queue.
+     */
+    cl_command_queue schedule(Tool *tool);
+
+    /** @brief Get the captured sequence of tools starting at a tool.
+     *
+     * The sequence is captured the first time the tool is reached (see
+     * Aqua::CalcServer::Replay).
+     * @param tool First tool of the sequence.
+     * @return The captured sequence, NULL if the tool is not starting a
+     * sequence of several replayable tools.
+     */
+    Replay* replay(Tool *tool);
+
+    /** @brief Unsort a set of variables, packing them in the device.
+     * @param var_names Variables to unsort.
+     * @param first First particle to unsort (in the unsorted space).
+     * @param n Number of particles to unsort.
+     * @param map Position in the packed data of each particle of the range,
+     * NULL to pack the whole range (see UnSort::range()).
+     * @param m Number of particles gathered by the map.
+     * @return The unsorter, NULL if errors are detected. The packed data is
+     * stored in _unsort_mem, at the offsets provided by UnSort::offsets().
+     */
+    UnSort* unsort(const std::vector<std::string> var_names,
+                   unsigned int first,
+                   unsigned int n,
+                   cl_mem map=NULL,
+                   unsigned int m=0);
+
+    /** @brief Download the columns of a packed buffer into a staging buffer.
+     *
+     * The columns with a positive tolerance are quantized before downloading
+     * them.
+     * @param mem Packed buffer.
+     * @param offsets Offsets of the columns in the packed buffer.
+     * @param vars Variables of the columns to download.
+     * @param n Number of particles to download.
+     * @param event_wait Event to be waited before reading the packed buffer.
+     * @param tolerances Quantization tolerance of each variable.
+     * @param ptrs Returned host memory where the data of each variable is
+     * copied.
+     * @param quants Returned quantization of each variable.
+     * @return The data download event, NULL if errors are detected.
+     */
+    cl_event download(cl_mem mem,
+                      const std::vector<size_t> offsets,
+                      const std::vector<InputOutput::ArrayVariable*> vars,
+                      unsigned int n,
+                      cl_event event_wait,
+                      const std::vector<float> tolerances,
+                      std::vector<void*> &ptrs,
+                      std::vector<quantization> *quants);
+
     /// Number of available OpenCL platforms
     cl_uint _num_platforms;
     /// List of OpenCL platforms
@@ -204,6 +367,17 @@ private:
     cl_device_id _device;
     /// Selected command queue
     cl_command_queue _command_queue;
+    /// In-order command queues for the concurrent scheduler
+    std::vector<cl_command_queue> _queues;
+    /// Last tool enqueued on each concurrent scheduler queue
+    std::vector<Tool*> _queues_tail;
+    /// Last tool writing each variable
+    std::map<InputOutput::Variable*, Tool*> _writers;
+    /// Next queue to be used for the independent tools
+    unsigned int _next_queue;
+
+    /// Captured sequences of tools, indexed by their first tool
+    std::map<Tool*, Replay*> _replays;
 
     /// User registered variables
     InputOutput::Variables _vars;
@@ -220,6 +394,15 @@ private:
      */
     std::string _base_path;
 
+    /// Compiled OpenCL programs cache
+    ProgramCache *_program_cache;
+
+    /// Kernels arguments index
+    SignatureIndex *_signatures;
+
+    /// Pinned host buffers pool
+    StagingPool *_staging;
+
     /** @brief Currently executed tool/report.
      * 
      * Useful to can report runtime OpenCL implementation errors (see
@@ -230,10 +413,35 @@ private:
      */
     char* _current_tool_name;
 
-    /** Map with the unsorter for each variable. Storing the unsorters should
-     * dramatically reduce the saving files overhead in some platforms
+    /** Map with the unsorter for each set of variables. Storing the
+     * unsorters should dramatically reduce the saving files overhead in some
+     * platforms
      */
     std::map<std::string, UnSort*> unsorters;
+
+    /// Packed unsorted data, shared by all the unsorters
+    cl_mem _unsort_mem;
+
+    /// Size of the packed unsorted data buffer
+    size_t _unsort_mem_size;
+
+    /// Map with the output filter for each set of variables and condition
+    std::map<std::string, Filter*> filters;
+
+    /// Packed filtered data, shared by all the filters
+    cl_mem _filter_mem;
+
+    /// Size of the packed filtered data buffer
+    size_t _filter_mem_size;
+
+    /// Output fields quantization
+    Quantize *_quantize;
+
+    /// Quantized columns, downloaded instead of the packed data
+    cl_mem _quant_mem;
+
+    /// Size of the quantized columns buffer
+    size_t _quant_mem_size;
 private:
     /// Simulation data read from XML files
     Aqua::InputOutput::ProblemSetup _sim_data;
@@ -67,6 +67,8 @@ protected:
 private:
     /// Condition expression to evaluate
     std::string _condition;
+    /// Compiled condition expression
+    InputOutput::Expression *_expr;
 };
 
 }}  // namespace
@@ -0,0 +1,169 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Compacted lists of the array elements meeting a condition.
+ * (See Aqua::CalcServer::Compact for details)
+ * @note Hardcoded versions of the files CalcServer/Compact.cl.in and
+ * CalcServer/Compact.hcl.in are internally included as a text array.
+ */
+
+#ifndef COMPACT_H_INCLUDED
+#define COMPACT_H_INCLUDED
+
+#include <sphPrerequisites.h>
+#include <vector>
+#include <CalcServer/Tool.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class Compact Compact.h CalcServer/Compact.h
+ * @brief Compacted lists of the array elements meeting a condition.
+ *
+ * The indexes of the elements of an integer array (e.g. "imove") meeting a
+ * condition are packed, keeping their order, into an output list, by means of
+ * a parallel prefix sum. The number of packed indexes is stored in a scalar
+ * variable, which is asynchronously downloaded, such that the host is not
+ * blocked until its value is actually required.
+ *
+ * Afterwards, the kernels can be launched just over the listed particles,
+ * setting the number of threads of the tool, "n", to the scalar variable,
+ * and getting the particle index with LIST_PARTICLE. For instance, to launch
+ * just over the fluid particles, after "Sort":
+ *
+ * @code{.xml}
+    <Tool name="fluid list" action="insert" after="Sort" type="compact"
+          in="imove" out="ifluid" n="n_fluid" condition="imove == 1"/>
+    <Tool name="rates" action="add" type="kernel" n="n_fluid"
+          entry_point="fluid" path="Rates.cl"/>
+   @endcode
+ *
+ * The lists are not following the particles sorting, so they shall be
+ * computed again every time the particles are sorted.
+ * @note Hardcoded versions of the files CalcServer/Compact.cl.in and
+ * CalcServer/Compact.hcl.in are internally included as a text array.
+ */
+class Compact : public Aqua::CalcServer::Tool
+{
+public:
+    /** Constructor.
+     * @param name Tool name.
+     * @param input_name Integer array to be checked.
+     * @param output_name Array where the indexes of the elements meeting the
+     * condition shall be stored.
+     * @param n_name Scalar variable where the number of elements meeting the
+     * condition shall be stored.
+     * @param condition OpenCL condition to be met, which may use the value of
+     * the element by the name of the input array, e.g. "imove > 0".
+     * @param once Run this tool just once. Useful to make initializations.
+     */
+    Compact(const std::string name,
+            const std::string input_name,
+            const std::string output_name,
+            const std::string n_name,
+            const std::string condition,
+            bool once=false);
+
+    /** Destructor
+     */
+    ~Compact();
+
+    /** Initialize the tool.
+     */
+    void setup();
+
+protected:
+    /** Execute the tool
+     * @param events List of events that shall be waited before safe execution
+     * @return OpenCL event to be waited before accesing the dependencies
+     */
+    cl_event _execute(const std::vector<cl_event> events);
+
+private:
+    /** Get the input and output variables
+     */
+    void variables();
+
+    /** Compile the source code and generate the kernels
+     * @param source Source code to be compiled.
+     */
+    void compile(const std::string source);
+
+    /** Set a kernel argument
+     * @param kernel Kernel
+     * @param index Argument index
+     * @param size Argument size
+     * @param value Argument value
+     */
+    void setArg(cl_kernel kernel,
+                cl_uint index,
+                size_t size,
+                const void* value);
+
+    /** Enqueue a kernel
+     * @param kernel Kernel to be enqueued
+     * @param global_work_size Global work size
+     * @param local_work_size Local work size
+     * @param events Events to be waited
+     * @return Kernel event
+     */
+    cl_event enqueue(cl_kernel kernel,
+                     size_t global_work_size,
+                     size_t local_work_size,
+                     const std::vector<cl_event> events);
+
+    /// Input variable name
+    std::string _input_name;
+    /// Output variable name
+    std::string _output_name;
+    /// Number of elements variable name
+    std::string _n_name;
+    /// Condition to be met
+    std::string _condition;
+
+    /// Input variable
+    InputOutput::ArrayVariable *_input_var;
+    /// Output variable
+    InputOutput::ArrayVariable *_output_var;
+    /// Number of elements variable
+    InputOutput::Variable *_n_var;
+
+    /// Number of elements in the input array
+    unsigned int _n;
+    /// Number of work groups
+    unsigned int _n_groups;
+
+    /// Number of elements meeting the condition in each group
+    cl_mem _counts_mem;
+
+    /// Per group counting kernel
+    cl_kernel _count;
+    /// Groups scan kernel
+    cl_kernel _scan;
+    /// Stream compaction kernel
+    cl_kernel _compact;
+
+    /// Local work size
+    size_t _local_work_size;
+    /// Global work size
+    size_t _global_work_size;
+};
+
+}}  // namespace
+
+#endif // COMPACT_H_INCLUDED
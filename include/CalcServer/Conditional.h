@@ -80,6 +80,8 @@ protected:
 private:
     /// Condition expression to evaluate
     std::string _condition;
+    /// Compiled condition expression
+    InputOutput::Expression *_expr;
     /// The next tool in the pipeline when the condition is not fulfilled
     Tool* _ending_tool;
 
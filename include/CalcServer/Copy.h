@@ -53,6 +53,12 @@ public:
      */
     void setup();
 
+    /** @brief The copy is just enqueued on the device, so it can be part of
+     * a captured sequence.
+     * @return true
+     */
+    bool replayable() {return true;}
+
 protected:
     /** Execute the tool
      * @param events List of events that shall be waited before safe execution
@@ -0,0 +1,180 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Output particles filtering, carried out in the computational device.
+ * (See Aqua::CalcServer::Filter for details)
+ * @note Hardcoded versions of the files CalcServer/Filter.cl.in and
+ * CalcServer/Filter.hcl.in are internally included as a text array.
+ */
+
+#ifndef FILTER_H_INCLUDED
+#define FILTER_H_INCLUDED
+
+#include <CL/cl.h>
+#include <vector>
+#include <string>
+#include <Variable.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class Filter Filter.h CalcServer/Filter.h
+ * @brief Output particles filtering, carried out in the computational device.
+ * This tool is not designed for the common usage but as an auxiliar tool for
+ * the savers, therefore it will not be selectable for the users.
+ *
+ * The filter is applied on the packed buffer generated by
+ * Aqua::CalcServer::UnSort, such that the particles are already in the
+ * unsorted space. The condition is evaluated for each particle, and the ones
+ * meeting it are packed (stream compaction) into an output buffer, keeping
+ * their order. Hence, just the kept particles shall be downloaded.
+ *
+ * The fields to be written are the first ones of the input packed buffer,
+ * while the rest are just used to evaluate the condition.
+ *
+ * @see Aqua::InputOutput::ProblemSetup::sphParticlesSet::addOutputFilter()
+ */
+class Filter
+{
+public:
+    /** Constructor.
+     * @param name Filter name.
+     * @param condition OpenCL condition to be met by the particles.
+     * @param vars Variables in the input packed buffer.
+     * @param condition_vars Variables used by the condition.
+     * @param n_out Number of variables to be packed in the output, i.e. the
+     * first n_out variables in vars.
+     */
+    Filter(const std::string name,
+           const std::string condition,
+           const std::vector<InputOutput::ArrayVariable*> vars,
+           const std::vector<std::string> condition_vars,
+           unsigned int n_out);
+
+    /** Destructor.
+     */
+    ~Filter();
+
+    /** Initialize the tool.
+     */
+    void setup();
+
+    /** Get the offsets of the fields in the output buffer.
+     * @param n Number of particles.
+     * @return The offset in bytes of each field, and the total size of the
+     * packed data as last element.
+     */
+    std::vector<size_t> offsets(unsigned int n) const;
+
+    /** Filter the particles.
+     * @param input Input packed buffer, generated by
+     * Aqua::CalcServer::UnSort.
+     * @param in_offsets Offsets of the fields in the input buffer.
+     * @param output Output packed buffer, with offsets(n).back() bytes at
+     * least.
+     * @param n Number of particles in the input buffer.
+     * @param event_wait Event to be waited before reading the input.
+     * @param m Returned number of particles meeting the condition.
+     * @return Event to be waited before accessing the output.
+     * @remarks The caller must call clReleaseEvent to destroy the event.
+     */
+    cl_event execute(cl_mem input,
+                     const std::vector<size_t> in_offsets,
+                     cl_mem output,
+                     unsigned int n,
+                     cl_event event_wait,
+                     unsigned int &m);
+
+private:
+    /** Setup the OpenCL stuff
+     */
+    void setupOpenCL();
+
+    /** Compile the source code and generate the kernels
+     * @param source Source code to be compiled.
+     */
+    void compile(const std::string source);
+
+    /** Allocate the flags and counts buffers, if required
+     * @param n Number of particles in the input buffer.
+     */
+    void allocate(unsigned int n);
+
+    /** Set a kernel argument
+     * @param kernel Kernel
+     * @param index Argument index
+     * @param size Argument size
+     * @param value Argument value
+     */
+    void setArg(cl_kernel kernel,
+                cl_uint index,
+                size_t size,
+                const void* value);
+
+    /** Enqueue a kernel
+     * @param kernel Kernel to be enqueued
+     * @param global_work_size Global work size
+     * @param local_work_size Local work size
+     * @param event_wait Event to be waited
+     * @return Kernel event
+     */
+    cl_event enqueue(cl_kernel kernel,
+                     size_t global_work_size,
+                     size_t local_work_size,
+                     cl_event event_wait);
+
+    /// Filter name
+    std::string _name;
+
+    /// Condition to be met
+    std::string _condition;
+
+    /// Variables in the input packed buffer
+    std::vector<InputOutput::ArrayVariable*> _vars;
+
+    /// Variables used by the condition
+    std::vector<std::string> _condition_vars;
+
+    /// Number of variables to be packed in the output
+    unsigned int _n_out;
+
+    /// Flags of the particles meeting the condition
+    cl_mem _flags_mem;
+
+    /// Number of particles meeting the condition in each group
+    cl_mem _counts_mem;
+
+    /// Number of particles allocated in the flags buffer
+    unsigned int _n_alloc;
+
+    /// Condition evaluation kernel
+    cl_kernel _mark;
+    /// Per group counting kernel
+    cl_kernel _count;
+    /// Groups scan kernel
+    cl_kernel _scan;
+    /// Stream compaction kernel
+    cl_kernel _compact;
+
+    /// Local work size
+    size_t _local_work_size;
+};
+
+}}  // namespace
+
+#endif // FILTER_H_INCLUDED
@@ -42,7 +42,9 @@ public:
     /** Constructor.
      * @param tool_name Tool name.
      * @param kernel_path Kernel path.
-     * @param n Number of threads to launch.
+     * @param n Number of threads to launch. It can be the number of elements
+     * of a list generated by Aqua::CalcServer::Compact, to launch the kernel
+     * just over the listed particles.
      * @param once Run this tool just once. Useful to make initializations.
      */
     Kernel(const std::string tool_name,
@@ -75,6 +77,21 @@ public:
      */
     size_t globalWorkSize() const {return _global_work_size;}
 
+    /** @brief Kernels can be part of a captured sequence.
+     * @return true
+     */
+    bool replayable() {return true;}
+
+    /** @brief Set the kernel arguments and compute the global work size.
+     */
+    void capture();
+
+    /** @brief Get the variables the kernel arguments and the number of threads
+     * depend on.
+     * @return Variables bound to the captured state.
+     */
+    const std::vector<InputOutput::Variable*> bindings();
+
 protected:
     /** Execute the tool
      * @param events List of events that shall be waited before safe execution
@@ -82,6 +99,12 @@ protected:
      */
     cl_event _execute(const std::vector<cl_event> events);
 
+    /** Enqueue the kernel with the already set arguments and work sizes
+     * @param events List of events that shall be waited before safe execution
+     * @return OpenCL event to be waited before accessing the dependencies
+     */
+    cl_event _replay(const std::vector<cl_event> events);
+
 protected:
     /** Compile the OpenCL program
      * @param entry_point Program entry point method.
@@ -119,6 +142,9 @@ private:
     /// Number of threads expression
     std::string _n;
 
+    /// Compiled number of threads expression
+    InputOutput::Expression *_n_expr;
+
     /// OpenCL kernel
     cl_kernel _kernel;
 
@@ -130,6 +156,8 @@ private:
 
     /// List of required variables
     std::vector<std::string> _var_names;
+    /// List of required variables, already resolved
+    std::vector<InputOutput::Variable*> _var_pointers;
     /// List of variable values
     std::vector<void*> _var_values;
 };
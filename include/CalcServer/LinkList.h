@@ -32,6 +32,13 @@
 #include <CalcServer/Reduction.h>
 #include <CalcServer/RadixSort.h>
 
+/** @def _LINKLIST_SORT_PASSES Maximum number of blocks sorting passes in the
+ * incremental mode, before falling back to the radix sort.
+ */
+#ifndef _LINKLIST_SORT_PASSES
+    #define _LINKLIST_SORT_PASSES 4
+#endif
+
 namespace Aqua{ namespace CalcServer{
 
 /** @class LinkList LinkList.h CalcServer/LinkList.h
@@ -42,6 +49,32 @@ namespace Aqua{ namespace CalcServer{
  *   -# "ihoc" array allocation
  *   -# "ihoc" and "icell" calculations
  *   -# Radix sort of "icell", computing permutation array "id_sorted" and "id_unsorted" as well.
+ *
+ * Since the particles are usually sorted every time step, just a few of them
+ * are changing the cell between consecutive executions, i.e. "icell" is
+ * almost sorted. In the incremental mode, the number of disordered keys is
+ * counted, and if it is small enough the order is repaired sorting blocks of
+ * keys in local memory, instead of running the full radix sort. The radix sort
+ * is anyway executed if the number of cells changed, if the number of
+ * disordered keys exceeds the threshold, or if the blocks sorting cannot fix
+ * the order.
+ *
+ * By default the cells are linearly indexed in x-major order, so the
+ * particles in the neighbour cells along y and z are far away in memory after
+ * sorting. Optionally the particles can be sorted following a Morton (Z-order)
+ * or a Hilbert space-filling curve instead, improving the memory locality of
+ * the neighbours loops. The cells are anyway linearly indexed in "icell" and
+ * "ihoc", so the loops over the neighbour cells are not affected.
+ *
+ * By default "ihoc" has a component per cell of the bounding box of the
+ * particles, so a few particles far away from the rest (e.g. splashes) can
+ * make it huge, both in memory and in the time required to clear it.
+ * Optionally the cells can be sparsely stored instead, such that "ihoc" is a
+ * hash table with just the occupied cells. The table has the smallest power
+ * of 2 number of entries not smaller than 2N, with the linear index of the
+ * cell and its head of chain in each pair of components. The kernels shall be
+ * compiled with SPARSE_CELLS defined, such that the HOC macro looks up the
+ * table.
  * @note Hardcoded versions of the files CalcServer/LinkList.cl.in and
  * CalcServer/LinkList.hcl.in are internally included as a text array.
  */
@@ -51,10 +84,21 @@ public:
     /** Constructor.
      * @param tool_name Tool name.
      * @param input Input array to be used as the particles positions.
+     * @param incremental true to try to repair the previous order instead of
+     * running the full radix sort, false otherwise.
+     * @param threshold Maximum ratio of disordered keys (with respect to the
+     * number of particles) to try the incremental sorting.
+     * @param ordering Cells ordering: "linear", "morton" or "hilbert".
+     * @param sparse true to store just the occupied cells in a hash table,
+     * false to store all the cells of the bounding box.
      * @param once Run this tool just once. Useful to make initializations.
      */
     LinkList(const std::string tool_name,
              const std::string input="pos",
+             bool incremental=false,
+             float threshold=0.05f,
+             const std::string ordering="linear",
+             bool sparse=false,
              bool once=false);
 
     /** Destructor
@@ -86,7 +130,8 @@ private:
      */
     void nCells();
 
-    /** Allocate the "ihoc" array
+    /** Allocate the "ihoc" array, either with a component per cell, or as a
+     * sparse cells table
      */
     void allocate();
 
@@ -94,6 +139,47 @@ private:
      */
     void setVariables();
 
+    /** Setup the OpenCL stuff of the incremental mode
+     */
+    void setupIncremental();
+
+    /** Setup the OpenCL stuff of the space-filling curves ordering
+     */
+    void setupOrdering();
+
+    /** Replace the sorted space-filling curve keys by the linear cells index
+     */
+    void linearCells();
+
+    /** Count the number of disordered keys in "icell".
+     * @return Number of keys greater than the next one.
+     * @note This is a blocking operation
+     */
+    unsigned int disorder();
+
+    /** Try to sort "icell" repairing the previous order.
+     * @return true if "icell" has been sorted, and the permutations computed,
+     * false if the full radix sort is required.
+     */
+    bool sortIncremental();
+
+    /** Enqueue one of the incremental mode kernels
+     * @param kernel Kernel to be enqueued
+     * @param args Arguments to be set, as pairs of size and value pointer. A
+     * NULL value pointer can be used to allocate local memory.
+     * @param gws Global work size
+     * @param lws Local work size
+     * @param events Events to be waited
+     * @param kernel_name Name of the kernel, to report errors
+     * @return Kernel event
+     */
+    cl_event enqueue(cl_kernel kernel,
+                     const std::vector<std::pair<size_t, const void*>> args,
+                     size_t gws,
+                     size_t lws,
+                     const std::vector<cl_event> events,
+                     const std::string kernel_name);
+
     /// Input variable name
     std::string _input_name;
 
@@ -103,6 +189,24 @@ private:
     /// Number of cells
     uivec4 _n_cells;
 
+    /// Number of cells in the previous execution
+    uivec4 _prev_n_cells;
+
+    /// Incremental sorting mode
+    bool _incremental;
+
+    /// Maximum ratio of disordered keys to try the incremental sorting
+    float _threshold;
+
+    /// Cells ordering
+    std::string _ordering;
+
+    /// Sparse cells storage
+    bool _sparse;
+
+    /// Number of entries of the sparse cells table
+    unsigned int _n_hash;
+
     /// Minimum position computation tool
     Reduction *_min_pos;
 
@@ -138,6 +242,30 @@ private:
     size_t _ll_gws;
     /// "ihoc" array computation sent arguments
     std::vector<void*> _ll_args;
+
+    /// Disordered keys counting
+    cl_kernel _disorder;
+    /// Disordered keys counting local work size
+    size_t _disorder_lws;
+    /// Disordered keys counter
+    cl_mem _disorder_mem;
+    /// Permutations initialization
+    cl_kernel _init_perms;
+    /// Permutations initialization local work size
+    size_t _init_perms_lws;
+    /// Blocks sorting
+    cl_kernel _sort_blocks;
+    /// Blocks sorting local work size, i.e. the blocks size
+    size_t _sort_blocks_lws;
+    /// Inverse permutations computation
+    cl_kernel _inv_perms;
+    /// Inverse permutations computation local work size
+    size_t _inv_perms_lws;
+
+    /// Space-filling curve keys replacement by the linear cells index
+    cl_kernel _linear_cell;
+    /// Space-filling curve keys replacement local work size
+    size_t _linear_cell_lws;
 };
 
 }}  // namespace
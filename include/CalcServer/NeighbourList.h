@@ -0,0 +1,175 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Verlet neighbours lists, built on top of the link-list.
+ * (See Aqua::CalcServer::NeighbourList for details)
+ * @note Hardcoded versions of the files CalcServer/NeighbourList.cl.in and
+ * CalcServer/NeighbourList.hcl.in are internally included as a text array.
+ */
+
+#ifndef NEIGHBOURLIST_H_INCLUDED
+#define NEIGHBOURLIST_H_INCLUDED
+
+#include <sphPrerequisites.h>
+#include <vector>
+#include <CalcServer/Tool.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class NeighbourList NeighbourList.h CalcServer/NeighbourList.h
+ * @brief Verlet neighbours lists, built on top of the link-list.
+ *
+ * The list of each particle contains all the particles closer than the kernel
+ * support plus a skin distance, such that it remains valid while no particle
+ * moves more than half of the skin. Hence, the lists are just built again
+ * when some particle exceeds such displacement. Between builds the
+ * interactions kernels can traverse the lists (see
+ * BEGIN_LOOP_OVER_NEIGHS_LIST), instead of walking the neighbour cells.
+ *
+ * The lists are stored in the "neighs" array, with a fixed capacity per
+ * particle, in column-major order, i.e. the k-th neighbour of the particle i
+ * is placed at neighs[k * N + i], while "n_neighs" has the number of
+ * neighbours of each particle. That way the lists can be permuted every time
+ * step, following the particles sorting (see "id_sorted").
+ *
+ * Hence, this tool should be executed just after the particles sorting,
+ * requiring an updated link-list ("icell" and "ihoc"). The cells length
+ * should not be smaller than the kernel support, so the skin cannot be bigger
+ * than such kernel support.
+ *
+ * If the number of neighbours of a particle exceeds the capacity, an error is
+ * raised (with a delay of one time step).
+ * @note Hardcoded versions of the files CalcServer/NeighbourList.cl.in and
+ * CalcServer/NeighbourList.hcl.in are internally included as a text array.
+ */
+class NeighbourList : public Aqua::CalcServer::Tool
+{
+public:
+    /** Constructor.
+     * @param tool_name Tool name.
+     * @param input Input array to be used as the particles positions.
+     * @param skin Skin distance, relative to the kernel support.
+     * @param max_neighs Maximum number of neighbours per particle.
+     * @param once Run this tool just once. Useful to make initializations.
+     */
+    NeighbourList(const std::string tool_name,
+                  const std::string input="r",
+                  float skin=0.1f,
+                  unsigned int max_neighs=64,
+                  bool once=false);
+
+    /** Destructor
+     */
+    ~NeighbourList();
+
+    /** Initialize the tool.
+     */
+    void setup();
+
+protected:
+    /** Execute the tool
+     * @param events List of events that shall be waited before safe execution
+     * @return OpenCL event to be waited before accesing the dependencies
+     */
+    cl_event _execute(const std::vector<cl_event> events);
+
+private:
+    /** Compile the source code and generate the kernels
+     * @param source Source code to be compiled.
+     */
+    void compile(const std::string source);
+
+    /** Allocate the internal buffers
+     */
+    void allocate();
+
+    /** Check that the lists have not overflowed in the previous execution.
+     */
+    void checkOverflow();
+
+    /** Enqueue one of the kernels
+     * @param kernel Kernel to be enqueued
+     * @param args Arguments to be set, as pairs of size and value pointer.
+     * @param events Events to be waited
+     * @param kernel_name Name of the kernel, to report errors
+     * @return Kernel event
+     */
+    cl_event enqueue(cl_kernel kernel,
+                     const std::vector<std::pair<size_t, const void*>> args,
+                     const std::vector<cl_event> events,
+                     const std::string kernel_name);
+
+    /** Fill a single unsigned integer buffer
+     * @param mem Buffer to be filled
+     * @param value Value to be set
+     * @param events Events to be waited
+     * @return Filling event
+     */
+    cl_event fill(cl_mem mem,
+                  cl_uint value,
+                  const std::vector<cl_event> events);
+
+    /// Input variable name
+    std::string _input_name;
+
+    /// Skin distance, relative to the kernel support
+    float _skin;
+
+    /// Lists capacity
+    unsigned int _max_neighs;
+
+    /// Kernel support, i.e. support * h
+    float _support;
+
+    /// Whether the lists have been built or not
+    bool _built;
+
+    /// Scratch buffer to permute "neighs"
+    cl_mem _neighs_mem;
+    /// Scratch buffer to permute "n_neighs"
+    cl_mem _n_neighs_mem;
+    /// Positions when the lists were built
+    cl_mem _r_ref_mem;
+    /// Scratch buffer to permute the positions when the lists were built
+    cl_mem _r_ref_in_mem;
+    /// Rebuild flag
+    cl_mem _rebuild_mem;
+    /// Overflow counter
+    cl_mem _overflow_mem;
+
+    /// Overflow counter read back from the device
+    cl_uint _overflow;
+    /// Overflow counter reading event
+    cl_event _overflow_event;
+
+    /// Lists permutation
+    cl_kernel _permute;
+    /// Displacements checking
+    cl_kernel _displacement;
+    /// Lists building
+    cl_kernel _build;
+    /// Local work size
+    size_t _lws;
+    /// Global work size
+    size_t _gws;
+};
+
+}}  // namespace
+
+#endif // NEIGHBOURLIST_H_INCLUDED
@@ -0,0 +1,174 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief On-disk cache of compiled OpenCL programs.
+ * (See Aqua::CalcServer::ProgramCache for details)
+ */
+
+#ifndef PROGRAMCACHE_H_INCLUDED
+#define PROGRAMCACHE_H_INCLUDED
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class ProgramCache ProgramCache.h CalcServer/ProgramCache.h
+ * @brief On-disk cache of compiled OpenCL programs.
+ *
+ * Building the OpenCL programs from sources may take a significant amount of
+ * time, specially on the complex pipelines. To avoid that, the binaries of
+ * the successfully built programs are stored in a folder, and reused in the
+ * subsequent runs.
+ *
+ * The binaries are content addressed, i.e. each binary is identified by a hash
+ * of the source code, the files it includes, the compilation flags, the user
+ * definitions and the device/driver identity. Hence, any modification in the
+ * source code or its headers, or an update of the OpenCL driver, will result
+ * in a new compilation from sources.
+ *
+ * The cache folder can be set with the tag `ProgramCache`, in the `Settings`
+ * section:
+ * `<ProgramCache path="/path/to/the/cache" />`
+ * An empty path disables the cache.
+ *
+ * Along with the binaries, the cache can store small text records, like the
+ * parameters tuned for the device by some tools (see
+ * Aqua::CalcServer::RadixSort). The records are keyed on their name and the
+ * device/driver identity.
+ */
+class ProgramCache
+{
+public:
+    /** @brief Constructor.
+     * @param path Folder where the binaries should be stored. An empty string
+     * disables the cache.
+     * @param context OpenCL context.
+     * @param platform OpenCL platform.
+     * @param device OpenCL device.
+     */
+    ProgramCache(const std::string path,
+                 cl_context context,
+                 cl_platform_id platform,
+                 cl_device_id device);
+
+    /// Destructor.
+    ~ProgramCache();
+
+    /** @brief Create and build an OpenCL program.
+     *
+     * If a binary compiled from the same source code and flags is available,
+     * it is used. Otherwise the program is built from sources, and its binary
+     * stored for the upcoming runs.
+     *
+     * Stale binaries (i.e. the ones that cannot be loaded or built anymore)
+     * are removed, falling back to the sources.
+     * @param source Source code.
+     * @param flags Compilation flags.
+     * @param err_code Returned error code. CL_SUCCESS if the program has been
+     * successfully built, the clBuildProgram() error code otherwise.
+     * @return The OpenCL program. NULL if the program cannot be created at
+     * all. If a non-NULL program is returned with a building error, it can be
+     * used to get the building log.
+     * @remarks The caller must call clReleaseProgram() to destroy the program.
+     */
+    cl_program build(const std::string source,
+                     const std::string flags,
+                     cl_int *err_code);
+
+    /** @brief Get a previously stored record.
+     *
+     * The records stored during this run are available even if the cache is
+     * disabled.
+     * @param name Record name.
+     * @param record Output record.
+     * @return true if the record has been found, false otherwise.
+     */
+    bool loadRecord(const std::string name, std::string &record);
+
+    /** @brief Store a record, to be reused by the upcoming runs.
+     * @param name Record name.
+     * @param record Record. It should be a single line of text.
+     */
+    void storeRecord(const std::string name, const std::string record);
+
+    /** @brief Check whether the cache is enabled.
+     * @return true if the binaries are stored and reused, false otherwise.
+     */
+    bool enabled() const{return !_path.empty();}
+
+    /** @brief Number of programs retrieved from the cache.
+     * @return Number of cache hits.
+     */
+    unsigned int hits() const{return _hits;}
+
+    /** @brief Number of programs built from sources.
+     * @return Number of cache misses.
+     */
+    unsigned int misses() const{return _misses;}
+
+private:
+    /** @brief Compute the key of a program.
+     * @param source Source code.
+     * @param flags Compilation flags.
+     * @return Hexadecimal key.
+     */
+    std::string key(const std::string source, const std::string flags);
+
+    /** @brief Get the file path of a record.
+     * @param name Record name.
+     * @return Record file path.
+     */
+    std::string recordPath(const std::string name);
+
+    /** @brief Load a program from its binary.
+     * @param file_path Binary file path.
+     * @param flags Compilation flags.
+     * @return The built OpenCL program. NULL if the binary is not available
+     * or it is not valid anymore.
+     */
+    cl_program load(const std::string file_path, const std::string flags);
+
+    /** @brief Store the binary of a program.
+     * @param file_path Binary file path.
+     * @param program Built program.
+     */
+    void store(const std::string file_path, cl_program program);
+
+    /// Cache folder
+    std::string _path;
+    /// OpenCL context
+    cl_context _context;
+    /// OpenCL device
+    cl_device_id _device;
+    /// Platform and device identity, to be added to the key
+    std::string _identity;
+    /// Number of cache hits
+    unsigned int _hits;
+    /// Number of cache misses
+    unsigned int _misses;
+    /// Records stored or loaded during this run
+    std::map<std::string, std::string> _records;
+};
+
+}}  // namespace
+
+#endif // PROGRAMCACHE_H_INCLUDED
@@ -0,0 +1,184 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Output fields quantization, carried out in the computational device.
+ * (See Aqua::CalcServer::Quantize for details)
+ * @note Hardcoded versions of the files CalcServer/Quantize.cl.in and
+ * CalcServer/Quantize.hcl.in are internally included as a text array.
+ */
+
+#ifndef QUANTIZE_H_INCLUDED
+#define QUANTIZE_H_INCLUDED
+
+#include <CL/cl.h>
+#include <string>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @struct quantization
+ * @brief Fixed rate quantization of a downloaded field.
+ *
+ * Each quantized value q stands for the value vmin + q * step.
+ */
+struct quantization{
+    /// Bits of each quantized value, 0 if the field is not quantized
+    unsigned int bits;
+    /// Value represented by the quantized 0
+    float vmin;
+    /// Quantization step
+    float step;
+};
+
+/** @class Quantize Quantize.h CalcServer/Quantize.h
+ * @brief Output fields quantization, carried out in the computational device.
+ * This tool is not designed for the common usage but as an auxiliar tool for
+ * the savers, therefore it will not be selectable for the users.
+ *
+ * The columns of the packed buffers generated by Aqua::CalcServer::UnSort
+ * (or Aqua::CalcServer::Filter) are quantized before downloading them, such
+ * that the transferred data is reduced by a factor 2 or 4.
+ *
+ * The quantization step is twice the tolerance asked by the user, such that
+ * the quantization error is never bigger than such tolerance. Then the range
+ * of the column is computed, and the smallest integer type able to represent
+ * it (8 or 16 bits) is selected (see bits()). If neither is enough, the column
+ * shall be downloaded without quantization.
+ *
+ * Just the float based types can be quantized, considering all their
+ * components as a flat array.
+ *
+ * @see Aqua::InputOutput::ProblemSetup::sphParticlesSet::addOutputQuantization()
+ */
+class Quantize
+{
+public:
+    /** Constructor.
+     */
+    Quantize();
+
+    /** Destructor.
+     */
+    ~Quantize();
+
+    /** Initialize the tool.
+     */
+    void setup();
+
+    /** Compute the range of a column.
+     * @param input Packed buffer.
+     * @param offset Offset of the column in the packed buffer.
+     * @param n Number of float values in the column.
+     * @param event_wait Event to be waited before reading the input.
+     * @param vmin Returned minimum value.
+     * @param vmax Returned maximum value.
+     * @note This method is blocking.
+     * @note If the column has some NaN value, both vmin and vmax are NaN.
+     */
+    void range(cl_mem input,
+               size_t offset,
+               unsigned int n,
+               cl_event event_wait,
+               float &vmin,
+               float &vmax);
+
+    /** Select the quantization of a column.
+     * @param vmin Minimum value of the column.
+     * @param vmax Maximum value of the column.
+     * @param tolerance Maximum quantization error.
+     * @return The quantization, with 0 bits if the column cannot be
+     * quantized.
+     */
+    static quantization bits(float vmin, float vmax, float tolerance);
+
+    /** Quantize a column.
+     * @param input Packed buffer.
+     * @param offset Offset of the column in the packed buffer.
+     * @param n Number of float values in the column.
+     * @param q Quantization, as returned by bits().
+     * @param output Quantized columns buffer.
+     * @param out_offset Offset of the quantized column in the output buffer.
+     * @param event_wait Event to be waited before reading the input.
+     * @return Event to be waited before accessing the output.
+     * @remarks The caller must call clReleaseEvent to destroy the event.
+     */
+    cl_event encode(cl_mem input,
+                    size_t offset,
+                    unsigned int n,
+                    const quantization q,
+                    cl_mem output,
+                    size_t out_offset,
+                    cl_event event_wait);
+
+private:
+    /** Compile the source code and generate the kernels
+     * @param source Source code to be compiled.
+     */
+    void compile(const std::string source);
+
+    /** Allocate the groups range buffers, if required
+     * @param n_groups Number of work groups.
+     */
+    void allocate(unsigned int n_groups);
+
+    /** Set a kernel argument
+     * @param kernel Kernel
+     * @param index Argument index
+     * @param size Argument size
+     * @param value Argument value
+     */
+    void setArg(cl_kernel kernel,
+                cl_uint index,
+                size_t size,
+                const void* value);
+
+    /** Enqueue a kernel
+     * @param kernel Kernel to be enqueued
+     * @param global_work_size Global work size
+     * @param local_work_size Local work size
+     * @param event_wait Event to be waited
+     * @return Kernel event
+     */
+    cl_event enqueue(cl_kernel kernel,
+                     size_t global_work_size,
+                     size_t local_work_size,
+                     cl_event event_wait);
+
+    /// Minimum value of each work group
+    cl_mem _mins_mem;
+
+    /// Maximum value of each work group
+    cl_mem _maxs_mem;
+
+    /// Number of work groups allocated in the range buffers
+    unsigned int _n_groups;
+
+    /// Range computation kernel
+    cl_kernel _range;
+    /// 8 bits quantization kernel
+    cl_kernel _encode8;
+    /// 16 bits quantization kernel
+    cl_kernel _encode16;
+
+    /// Local work size
+    size_t _local_work_size;
+};
+
+}}  // namespace
+
+#endif // QUANTIZE_H_INCLUDED
@@ -28,8 +28,10 @@
 #define RADIXSORT_H_INCLUDED
 
 #include <sphPrerequisites.h>
+#include <vector>
 #include <CalcServer.h>
 #include <CalcServer/Tool.h>
+#include <CalcServer/RadixSortPasses.h>
 
 /** @def _ITEMS Number of items in a group
  * @note Must be power of 2, and in some devices greather than 32.
@@ -83,12 +85,32 @@ namespace Aqua{ namespace CalcServer{
 /** @class RadixSort RadixSort.h CalcServer/RadixSort.h
  * @brief Methods to perform a radix sort using the GPU (or any device
  * supported by OpenCL).
- * The code has 3 steps:
+ *
+ * Two engines are available. The classic one has 3 steps per pass:
  *   -# Create the histogram.
  *   -# Scan the histogram to create the accumulated one.
  *   -# Permut the variables.
  * To learn more about this code, please see also
  * http://code.google.com/p/ocl-radix-sort/updates/list.
+ *
+ * The onesweep engine counts the radices of all the passes at once, and then
+ * performs each pass in a single kernel, where the tiles of keys are getting
+ * their offsets with a decoupled look-back. Hence, just one kernel is
+ * launched per pass, instead of five.
+ *
+ * The engine, the number of bits per pass, and the work sizes are selected
+ * per device the first time, timing a set of candidates on random keys. The
+ * selected parameters are stored in the programs cache (see
+ * Aqua::CalcServer::ProgramCache), so the upcoming runs are not tuning them
+ * again.
+ *
+ * The number of passes is trimmed to the bits of the maximum key (see
+ * maxKey()). Moreover, the onesweep passes where all the keys have the same
+ * radix are reduced to a plain copy.
+ *
+ * The work sizes and the kernels enqueueing of both engines are carried out
+ * by Aqua::CalcServer::RadixSortPasses, which is shared with the radix sort
+ * microbenchmark.
  * @note Hardcoded versions of the files CalcServer/RadixSort.cl.in and
  * CalcServer/RadixSort.hcl.in are internally included as a text array.
  */
@@ -117,6 +139,14 @@ public:
      */
     void setup();
 
+    /** Set the maximum value of the keys to be sorted.
+     *
+     * By default, the "n_cells" total number of cells is considered when
+     * "icell" is sorted, and the whole unsigned int range otherwise.
+     * @param max_key Maximum value of the keys, 0 to use the default bound.
+     */
+    void maxKey(unsigned int max_key){_max_key = max_key;}
+
 protected:
     /** Execute the tool
      * @param events List of events that shall be waited before safe execution
@@ -125,31 +155,19 @@ protected:
     cl_event _execute(const std::vector<cl_event> events);
 
 private:
-    /** Initialize permutations array
-     * @return Permutations initialization event
+    /** Get the number of bits of the maximum key
+     * @return Number of bits
      */
-    cl_event init();
+    unsigned int keyBits();
 
-    /** Perform histograms
-     * @param keys_event Event of the last keys manipulation 
-     * @param histograms_event Event of the last histogram manipulation. NULL if
-     * it has not been manipulated yet
-     * @return Histograms event
-     */
-    cl_event histograms(cl_event keys_event, cl_event histograms_event);
-
-    /** Scan histograms.
-     * @param event Event of the last histogram manipulation
-     * @return Histograms event
-     */
-    cl_event scan(cl_event event);
-
-    /** Scan histograms.
-     * @param perms_event Event of the permutations initialization
-     * @param histograms_event Event of the last histogram manipulation
-     * @return Histograms event
+    /** Perform all the sorting passes on the internal keys buffer
+     * @param keys_event Event of the last keys manipulation. NULL if there is
+     * nothing to wait for
+     * @return Permutation arrays event
+     * @note After this method, the sorted keys and the permutations are
+     * stored in the input keys and permutations memory objects
      */
-    cl_event reorder(cl_event perms_event, cl_event histograms_event);
+    cl_event passes(cl_event keys_event);
 
     /** Build the reversed permutations vector.
      * @return Permutation arrays event
@@ -164,16 +182,34 @@ private:
      */
     void setupOpenCL();
 
+    /** Select the engine and its parameters, either from the records of the
+     * programs cache or timing the candidates.
+     */
+    void tune();
+
+    /** Get the onesweep candidates compatible with the device.
+     * @param bits Bits sorted in each pass.
+     * @return List of candidates
+     */
+    std::vector<RadixSortPasses::params> candidates(unsigned int bits);
+
+    /** Setup the engine with the given parameters, compiling the kernels and
+     * allocating the memory objects.
+     * @param p Engine parameters.
+     */
+    void configure(const RadixSortPasses::params p);
+
+    /** Time a full sorting with the current engine and parameters.
+     * @param keys Random keys to be sorted.
+     * @return Best elapsed time among several repetitions (seconds).
+     */
+    double benchmark(const std::vector<unsigned int> &keys);
+
     /** Compile the source code and generate the corresponding kernels
      * @param source Source code to compile.
      */
     void compile(const std::string source);
 
-    /** Setup the main computing dimensions _items, _groups and _histo_split
-     * from the valid local work sizes per each kernel.
-     */
-    void setupDims();
-
     /** Setup the memory objects.
      */
     void setupMems();
@@ -182,6 +218,12 @@ private:
      */
     void setupArgs();
 
+    /** Log an error of Aqua::CalcServer::RadixSortPasses, and throw an
+     * exception.
+     * @param e Exception raised by Aqua::CalcServer::RadixSortPasses.
+     */
+    void error(const RadixSortPasses::opencl_error &e);
+
     /// Variable to sort name
     std::string _var_name;
 
@@ -203,51 +245,23 @@ private:
     /// Number of keys to sort
     unsigned int _n;
 
-    /// OpenCL initialization kernel
-    cl_kernel _init_kernel;
-    /// OpenCL histogram kernel
-    cl_kernel _histograms_kernel;
-    /// OpenCL scan histogram kernel
-    cl_kernel _scan_kernel;
-    /// OpenCL paste histogram kernel
-    cl_kernel _paste_kernel;
-    /// OpenCL permutations kernel
-    cl_kernel _sort_kernel;
+    /// OpenCL sorting kernels
+    RadixSortPasses::kernels _kernels;
     /// OpenCL reverse permutations kernel
     cl_kernel _inv_perms_kernel;
 
-    /// Input keys
-    cl_mem _in_keys;
-    /// Output keys
-    cl_mem _out_keys;
-    /// Input permutations
-    cl_mem _in_permut;
-    /// Output permutations
-    cl_mem _out_permut;
-    /// Histograms
-    cl_mem _histograms;
-    /// Sums for each histogram split
-    cl_mem _global_sums;
-    /// Temporal memory
-    cl_mem _temp_mem;
-
-    /// Number of items in a group
-    unsigned int _items;
-    /// Number of groups in a radix
-    unsigned int _groups;
-    /// Bits of the Radix
-    unsigned int _bits;
-    /// Number of Radices
-    unsigned int _radix;
-    /// Splits of the histogram
-    unsigned int _histo_split;
+    /// Sorting memory objects
+    RadixSortPasses::mems _mems;
+
+    /// Sorting engine parameters
+    RadixSortPasses::params _params;
 
+    /// Maximum value of the keys, 0 to use the default bound
+    unsigned int _max_key;
     /// Key bits (maximum)
     unsigned int _key_bits;
-    /// Needed radix pass (_key_bits / _STEPBITS)
+    /// Needed radix pass (_key_bits / bits, rounded up)
     unsigned int _n_pass;
-    /// Pass of the radix decomposition
-    unsigned int _pass;
 
     /// Maximum local work size allowed by the device
     size_t _local_work_size;
@@ -0,0 +1,223 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Host side orchestration of the radix sort engines.
+ * (See Aqua::CalcServer::RadixSortPasses for details)
+ */
+
+#ifndef RADIXSORTPASSES_H_INCLUDED
+#define RADIXSORTPASSES_H_INCLUDED
+
+#include <CL/cl.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @namespace Aqua::CalcServer::RadixSortPasses
+ * @brief Host side orchestration of the radix sort engines.
+ *
+ * The work sizes selection, the memory objects allocation, and the kernels
+ * enqueueing of the classic and the onesweep engines of
+ * Aqua::CalcServer::RadixSort. These methods are just depending on OpenCL,
+ * so the radix sort microbenchmark is driving the same code than the tool.
+ *
+ * The errors are reported by throwing a
+ * Aqua::CalcServer::RadixSortPasses::opencl_error exception, such that the
+ * caller can log them.
+ */
+namespace RadixSortPasses{
+
+/** @class opencl_error RadixSortPasses.h CalcServer/RadixSortPasses.h
+ * @brief Exception raised when an OpenCL call failed.
+ */
+class opencl_error : public std::runtime_error
+{
+public:
+    /** Constructor
+     * @param msg Failing operation.
+     * @param code OpenCL error code.
+     */
+    opencl_error(const std::string msg, cl_int code)
+        : std::runtime_error(msg), _code(code) {};
+
+    /** Get the OpenCL error code
+     * @return OpenCL error code
+     */
+    cl_int code() const {return _code;}
+private:
+    /// OpenCL error code
+    cl_int _code;
+};
+
+/** @struct params
+ * @brief Sorting engine parameters
+ */
+struct params{
+    /// Onesweep engine (true) or classic one (false)
+    bool onesweep;
+    /// Bits sorted in each pass
+    unsigned int bits;
+    /// Number of items in a group
+    unsigned int items;
+    /// Number of groups of the histograms
+    unsigned int groups;
+    /// Splits of the histogram (classic engine)
+    unsigned int histo_split;
+    /// Keys per thread (onesweep engine)
+    unsigned int kpt;
+};
+
+/** @struct kernels
+ * @brief Radix sort kernels, compiled for a number of bits per pass
+ */
+struct kernels{
+    /// Permutations initialization (classic engine)
+    cl_kernel init;
+    /// Histograms (classic engine)
+    cl_kernel histogram;
+    /// Histograms scan (classic engine)
+    cl_kernel scan;
+    /// Histograms paste (classic engine)
+    cl_kernel paste;
+    /// Reordering (classic engine)
+    cl_kernel sort;
+    /// Radices counting (onesweep engine)
+    cl_kernel counts;
+    /// Single pass (onesweep engine)
+    cl_kernel onesweep;
+};
+
+/** @struct mems
+ * @brief Radix sort memory objects
+ *
+ * The input and output keys and permutations are swapped on each pass, so
+ * after the sorting the results are stored in the input ones.
+ */
+struct mems{
+    /// Input keys
+    cl_mem in_keys;
+    /// Output keys
+    cl_mem out_keys;
+    /// Input permutations
+    cl_mem in_permut;
+    /// Output permutations
+    cl_mem out_permut;
+    /// Histograms (classic engine)
+    cl_mem histograms;
+    /// Sums for each histogram split (classic engine)
+    cl_mem global_sums;
+    /// Temporal memory (classic engine)
+    cl_mem temp;
+    /// Radices counts and tiles counters (onesweep engine)
+    cl_mem counts;
+    /// Look-back status (onesweep engine)
+    cl_mem status;
+};
+
+/** @brief Number of tiles of keys processed by the onesweep engine.
+ * @param p Engine parameters.
+ * @param n Number of keys.
+ * @return Number of tiles.
+ */
+unsigned int tiles(const params &p, cl_uint n);
+
+/** @brief Fit the classic engine work sizes, i.e. the number of items,
+ * groups and histogram splits, to the valid local work sizes of the kernels.
+ * @param device Device where the kernels are compiled.
+ * @param k Kernels.
+ * @param p Engine parameters, corrected on return.
+ */
+void classicDims(cl_device_id device, const kernels &k, params &p);
+
+/** @brief Get the onesweep engine candidates compatible with the device.
+ * @param device Device where the kernels are compiled.
+ * @param k Kernels, compiled for @p bits bits per pass.
+ * @param bits Bits sorted in each pass.
+ * @return List of candidates
+ */
+std::vector<params> candidates(cl_device_id device,
+                               const kernels &k,
+                               unsigned int bits);
+
+/** @brief Allocate the memory objects of an engine.
+ * @param context Context where the memory objects are allocated.
+ * @param p Engine parameters.
+ * @param n Number of keys.
+ * @param m Memory objects. The previous ones are released.
+ * @return Allocated memory (bytes).
+ */
+size_t allocate(cl_context context, const params &p, cl_uint n, mems &m);
+
+/** @brief Release the memory objects of an engine.
+ * @param m Memory objects.
+ */
+void release(mems &m);
+
+/** @brief Enqueue all the sorting passes of an engine.
+ *
+ * The keys to sort shall be already stored in the input keys, while the
+ * permutations are initialized by the engine.
+ * @param queue Command queue.
+ * @param k Kernels.
+ * @param m Memory objects. After the sorting, the sorted keys and the
+ * permutations are stored in the input ones.
+ * @param p Engine parameters.
+ * @param n Number of keys.
+ * @param n_pass Number of passes.
+ * @param keys_event Event of the last keys manipulation. NULL if there is
+ * nothing to wait for
+ * @return Permutation arrays event
+ */
+cl_event passes(cl_command_queue queue,
+                const kernels &k,
+                mems &m,
+                const params &p,
+                cl_uint n,
+                cl_uint n_pass,
+                cl_event keys_event);
+
+/** @brief Enqueue the classic engine passes, i.e. the histogram, scan, paste
+ * and sort kernels on each pass.
+ * @see passes()
+ */
+cl_event classic(cl_command_queue queue,
+                 const kernels &k,
+                 mems &m,
+                 const params &p,
+                 cl_uint n,
+                 cl_uint n_pass,
+                 cl_event keys_event);
+
+/** @brief Enqueue the onesweep engine passes, i.e. the radices counting
+ * kernel, and then a single kernel on each pass.
+ * @see passes()
+ */
+cl_event onesweep(cl_command_queue queue,
+                  const kernels &k,
+                  mems &m,
+                  const params &p,
+                  cl_uint n,
+                  cl_uint n_pass,
+                  cl_event keys_event);
+
+}}}  // namespace
+
+#endif // RADIXSORTPASSES_H_INCLUDED
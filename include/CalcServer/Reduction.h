@@ -45,6 +45,10 @@ public:
      * @param name Tool name.
      * @param input_name Variable to be reduced name.
      * @param output_name Variable where the reduced value will be stored.
+     * If it is an array, the reduced value is copied in its first component,
+     * and it is never downloaded to the host. Otherwise the value is
+     * asynchronously downloaded, and the variable is synced just when its
+     * value is required.
      * @param operation The reduction operation.
      * For instance:
      *   - "c += b;"
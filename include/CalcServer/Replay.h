@@ -0,0 +1,155 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Captured sequence of tools, which can be replayed with minimal host
+ * work.
+ * (See Aqua::CalcServer::Replay for details)
+ */
+
+#ifndef REPLAY_H_INCLUDED
+#define REPLAY_H_INCLUDED
+
+#include <CL/cl.h>
+#include <vector>
+#include <CalcServer/Tool.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class Replay Replay.h CalcServer/Replay.h
+ * @brief Captured sequence of tools, which can be replayed with minimal host
+ * work.
+ *
+ * Between the conditional tools, or any other tool executing work on the
+ * host, the pipeline usually consists in a straight sequence of tools just
+ * enqueueing work on the device (see Aqua::CalcServer::Tool::replayable()),
+ * like Aqua::CalcServer::Kernel, which are enqueued in the same way every
+ * single time step.
+ *
+ * Such sequence is captured the first time it is reached, resolving the state
+ * of each tool (e.g. the kernel arguments and work sizes, see
+ * Aqua::CalcServer::Tool::capture()) and the whole events graph, i.e. which
+ * tools (or which variables events, for the first tools) shall be waited by
+ * each tool. Afterwards the sequence is replayed just enqueueing the captured
+ * state, without the per tool events management, and updating the variables
+ * events just at the end.
+ *
+ * The captured state of a tool is invalidated, and captured again, when some
+ * of the variables it is bound to (see Aqua::CalcServer::Tool::bindings()),
+ * either scalar values or buffer handles, is changing. Since the captured
+ * sequences never cross a conditional tool, the branches outcome is just
+ * selecting which sequence is replayed next.
+ *
+ * The replay can be enabled with the tag `Replay`, in the `Settings` section:
+ * `<Replay value="true" />`
+ */
+class Replay
+{
+public:
+    /** @brief Constructor.
+     * @param tools Sequence of tools to be captured.
+     */
+    Replay(const std::vector<Tool*> tools);
+
+    /// Destructor.
+    ~Replay();
+
+    /** @brief Replay the captured sequence.
+     */
+    void execute();
+
+    /** @brief Get the first tool of the sequence.
+     * @return First tool.
+     */
+    Tool* first_tool() {return _tools.front();}
+
+    /** @brief Get the next tool to be executed after the sequence.
+     * @return Next tool to be executed. NULL if the sequence is the last part
+     * of the pipeline
+     */
+    Tool* next_tool() {return _tools.back()->next_tool();}
+
+    /** @brief Number of tools in the sequence
+     * @return Number of tools
+     */
+    unsigned int n() const {return _tools.size();}
+
+private:
+    /** @brief Capture again the tools whose bindings have changed since the
+     * last execution.
+     */
+    void validate();
+
+    /** @struct binding
+     * @brief Variable value the captured state of some tools depends on.
+     */
+    struct binding{
+        /// Variable
+        InputOutput::Variable *var;
+        /// Value when the tools were captured
+        std::vector<char> value;
+        /// Tools indexes in the sequence
+        std::vector<unsigned int> tools;
+    };
+
+    /** @struct dependency
+     * @brief Event to be waited by a tool.
+     *
+     * It is either the event of a previous tool in the sequence, or the
+     * event(s) that a variable had at the start of the sequence.
+     */
+    struct dependency{
+        /// Previous tool index in the sequence, -1 for a variable event
+        int tool;
+        /// Variable, if tool is -1
+        InputOutput::Variable *var;
+        /// true to wait for the variable readers, false for its writer
+        bool readers;
+
+        bool operator==(const dependency &other) const {
+            return (tool == other.tool) &&
+                   (var == other.var) &&
+                   (readers == other.readers);
+        }
+    };
+
+    /** @struct outcome
+     * @brief Variable events at the end of the sequence.
+     */
+    struct outcome{
+        /// Variable
+        InputOutput::Variable *var;
+        /// Last tool writing the variable, -1 if it is not written
+        int writer;
+        /// Tools reading the variable after the last writer
+        std::vector<int> readers;
+    };
+
+    /// Captured tools
+    std::vector<Tool*> _tools;
+    /// Variables the captured tools depend on
+    std::vector<binding> _bindings;
+    /// Events to be waited by each tool
+    std::vector<std::vector<dependency>> _dependencies;
+    /// Variables events to be set at the end of the sequence
+    std::vector<outcome> _outcomes;
+};
+
+}}  // namespace
+
+#endif // REPLAY_H_INCLUDED
@@ -37,6 +37,8 @@ namespace Aqua{ namespace CalcServer{ namespace Reports{
  *    -# Allocated memory in the computational device
  *    -# The average CPU time consumend of each tool (GPU time can be taken
  *    with the profiling tools of each vendor)
+ *    -# The output files writing threads status, i.e. the number of queued
+ *    frames and the throughput (see Aqua::InputOutput::WriterPool)
  *
  * @see Aqua::InputOutput::Logger
  */
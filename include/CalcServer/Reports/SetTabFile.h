@@ -56,6 +56,29 @@ namespace Aqua{ namespace CalcServer{ namespace Reports{
  * And therefore \f$ n_{prop} \cdot n_{parts} \f$ fields should be doownloaded
  * and printed in plain text, so be careful about what particles sets and fields
  * are requested.
+ *
+ * To track just some probe particles of a large set, a list of particle
+ * indexes (relative to the set) can be provided, like `"0, 12, 100-199"`.
+ * In that case the selected particles are gathered in the computational
+ * device (see Aqua::CalcServer::CalcServer::getGatheredMem()), such that
+ * just them are downloaded and printed, in the listed order.
+ *
+ * The report can be written in a binary format as well, which is not
+ * requiring to format the values, composed by:
+ *   -# A head with the magic string `"AQUAtab"` (8 bytes, including the null
+ *      termination), the format version (unsigned int), the number of
+ *      particles (unsigned int), the number of fields (unsigned int) and the
+ *      length of each row in bytes (unsigned int).
+ *   -# A record per field, with its name (64 bytes, null terminated), its type
+ *      name (32 bytes, null terminated), the type size in bytes (unsigned
+ *      int) and the offset of the field in the rows (unsigned int).
+ *   -# The index of each particle (unsigned int), in the unsorted space.
+ *   -# A row per report event, with the time instant (float), followed by
+ *      the values of each field for all the particles.
+ *
+ * The values are stored in the host byte order. The rows are buffered, and
+ * the file is just flushed every "flush" rows, both in text and binary
+ * formats.
  */
 class SetTabFile : public Aqua::CalcServer::Reports::Report
 {
@@ -71,6 +94,12 @@ public:
      * @param output_file File to be written.
      * @param ipf Iterations per frame, 0 to just ignore this printing criteria.
      * @param fps Frames per second, 0 to just ignore this printing criteria.
+     * @param ids Particles to be printed (relative to the set), separated by
+     * commas, and where the ranges are denoted by a dash, like `"0, 10-20"`.
+     * An empty string to print all the particles of the set.
+     * @param binary true to write the binary format, false to write plain
+     * text.
+     * @param flush Number of rows between file flushes.
      * @remarks The output file will be cleared.
      */
     SetTabFile(const std::string tool_name,
@@ -79,7 +108,10 @@ public:
                unsigned int n,
                const std::string output_file,
                unsigned int ipf=1,
-               float fps=0.f);
+               float fps=0.f,
+               const std::string ids="",
+               bool binary=false,
+               unsigned int flush=1);
 
     /** @brief Destructor
      */
@@ -102,10 +134,20 @@ protected:
      */
     uivec2 bounds(){return _bounds;}
 
+    /** @brief Get the number of particles printed.
+     * @return The number of selected particles, or the number of particles of
+     * the set if no selection has been provided.
+     */
+    unsigned int nParticles(){
+        return _ids.size() ? _ids.size() : _bounds.y - _bounds.x;
+    }
+
     /** Download the data from the device, and store it.
      * @param vars Fields to download.
      * @return host allocated memory. A clear list if errors happened.
-     * @note The returned data must be manually cleared.
+     * @note The returned buffers are taken from the staging pool (see
+     * Aqua::CalcServer::StagingPool), and must be released back to it with
+     * clearList().
      */
     std::vector<void*> download(std::vector<InputOutput::Variable*> vars);
 
@@ -115,6 +157,20 @@ private:
      */
     void clearList(std::vector<void*> *data);
 
+    /** Parse the list of selected particles, and upload the gathering map.
+     * @param ids Particles to be printed, as provided to the constructor.
+     */
+    void selection(const std::string ids);
+
+    /** Write the header of the binary format.
+     */
+    void binaryHeader();
+
+    /** Write a row of the binary format.
+     * @param data Downloaded data of each field.
+     */
+    void binaryRow(const std::vector<void*> data);
+
     /// Particles managed bounds
     uivec2 _bounds;
 
@@ -122,6 +178,20 @@ private:
     std::string _output_file;
     /// Output file handler
     std::ofstream _f;
+
+    /// Selected particles list, as provided to the constructor
+    std::string _ids_str;
+    /// Selected particles, relative to the set
+    std::vector<unsigned int> _ids;
+    /// Position of each particle of the set in the downloaded data
+    cl_mem _map;
+
+    /// Binary format
+    bool _binary;
+    /// Rows between flushes
+    unsigned int _flush;
+    /// Rows written since the last flush
+    unsigned int _rows;
 };
 
 }}} // namespace
@@ -64,6 +64,12 @@ public:
      */
     void setup();
 
+    /** @brief The array is set on the device, so the tool can be part of a
+     * captured sequence.
+     * @return true
+     */
+    bool replayable() {return true;}
+
 protected:
     /** Execute the tool
      * @param events List of events that shall be waited before safe execution
@@ -72,6 +72,12 @@ private:
 
     /// Input variable
     InputOutput::Variable *_var;
+
+    /// Compiled value expression
+    InputOutput::Expression *_expr;
+
+    /// Evaluated value
+    void *_data;
 };
 
 }}  // namespace
@@ -0,0 +1,125 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Index of the OpenCL kernels arguments.
+ * (See Aqua::CalcServer::SignatureIndex for details)
+ */
+
+#ifndef SIGNATUREINDEX_H_INCLUDED
+#define SIGNATUREINDEX_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class SignatureIndex SignatureIndex.h CalcServer/SignatureIndex.h
+ * @brief Index of the OpenCL kernels arguments.
+ *
+ * The Aqua::CalcServer::Kernel tools are getting the variables to be sent as
+ * arguments from the names of the entry point arguments. To extract them the
+ * OpenCL source file should be parsed with libclang, which is an expensive
+ * operation.
+ *
+ * This index parses each file just once per run, collecting the arguments of
+ * all the functions declared inside. Moreover, the collected signatures are
+ * stored on disk, keyed on the hash of the file contents and the files it
+ * includes, such that libclang is not required at all while neither the file
+ * nor its headers change.
+ *
+ * The signatures are stored in the same folder of the OpenCL programs cache
+ * (see Aqua::CalcServer::ProgramCache).
+ */
+class SignatureIndex
+{
+public:
+    /** @brief Constructor.
+     * @param path Folder where the signatures should be stored. An empty
+     * string disables the on-disk storage, keeping just the per run index.
+     */
+    SignatureIndex(const std::string path);
+
+    /// Destructor.
+    ~SignatureIndex();
+
+    /** @brief Get the arguments of a function.
+     * @param file_path OpenCL source file path.
+     * @param entry_point Function name.
+     * @param args Output arguments names.
+     * @param read_only Output flags to know whether each argument is read-only
+     * or not. The arguments passed by value, and the pointers to either
+     * `const` or `__constant` data, are considered read-only.
+     * @return Number of times the function has been found in the file.
+     */
+    unsigned int get(const std::string file_path,
+                     const std::string entry_point,
+                     std::vector<std::string> &args,
+                     std::vector<bool> &read_only);
+
+    /** @struct signature
+     * @brief Function signature, i.e. the function name and its arguments
+     */
+    struct signature{
+        /// Function name
+        std::string name;
+        /// Arguments names
+        std::vector<std::string> args;
+        /// Read-only flag of each argument
+        std::vector<bool> read_only;
+    };
+
+private:
+    /** @brief Get all the function signatures of a file.
+     *
+     * The signatures are looked for in the in-memory index, then in the
+     * on-disk storage, and finally the file is parsed with libclang.
+     * @param file_path OpenCL source file path.
+     * @return The list of signatures.
+     */
+    const std::vector<signature>& signatures(const std::string file_path);
+
+    /** @brief Parse a file with libclang to extract the function signatures.
+     * @param file_path OpenCL source file path.
+     * @return The list of signatures.
+     */
+    std::vector<signature> parse(const std::string file_path);
+
+    /** @brief Load the signatures from the on-disk storage.
+     * @param sig_path Signatures file path.
+     * @param sigs Output list of signatures.
+     * @return true if the signatures have been loaded, false otherwise.
+     */
+    bool load(const std::string sig_path, std::vector<signature> &sigs);
+
+    /** @brief Save the signatures in the on-disk storage.
+     * @param sig_path Signatures file path.
+     * @param sigs List of signatures.
+     */
+    void save(const std::string sig_path, const std::vector<signature> &sigs);
+
+    /// Storage folder
+    std::string _path;
+    /// Per run index, mapping the files to their signatures
+    std::map<std::string, std::vector<signature>> _index;
+};
+
+}}  // namespace
+
+#endif // SIGNATUREINDEX_H_INCLUDED
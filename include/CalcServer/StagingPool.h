@@ -0,0 +1,117 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pool of pinned host buffers, to download data from the device.
+ * (See Aqua::CalcServer::StagingPool for details)
+ */
+
+#ifndef STAGINGPOOL_H_INCLUDED
+#define STAGINGPOOL_H_INCLUDED
+
+#include <CL/cl.h>
+#include <pthread.h>
+#include <vector>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @class StagingPool StagingPool.h CalcServer/StagingPool.h
+ * @brief Pool of pinned host buffers, to download data from the device.
+ *
+ * The savers and the reports are downloading the same fields frame after
+ * frame. Allocating a pageable host buffer for each field, and each frame,
+ * results in allocator traffic, and in slower transfers, since the OpenCL
+ * implementation should internally copy the data through a pinned buffer.
+ *
+ * This pool is instead allocating the buffers with `CL_MEM_ALLOC_HOST_PTR`,
+ * mapping them just once. The buffers are acquired to download the data, and
+ * released back to the pool (instead of freed) when the data is not required
+ * anymore, e.g. by the parallel writing threads. Hence, after the first
+ * frames, no more buffers are allocated.
+ *
+ * A buffer can be shared by several users, e.g. the fields packed in a
+ * single download, each one releasing its own part of the buffer. The buffer
+ * becomes idle when all the users have released it.
+ * @note acquire() shall be called from the main thread, while release() can
+ * be called from any thread.
+ */
+class StagingPool
+{
+public:
+    /** @brief Constructor.
+     * @param context OpenCL context.
+     * @param queue OpenCL command queue, used to map the buffers.
+     */
+    StagingPool(cl_context context, cl_command_queue queue);
+
+    /// Destructor.
+    ~StagingPool();
+
+    /** @brief Get a host buffer.
+     *
+     * The smallest idle buffer large enough is returned, allocating a new one
+     * if there are not.
+     * @param size Required size in bytes.
+     * @param users Number of release() calls required to give back the
+     * buffer to the pool.
+     * @return Host pointer of the buffer.
+     */
+    void* acquire(size_t size, unsigned int users=1);
+
+    /** @brief Give back a buffer to the pool.
+     * @param ptr Host pointer returned by acquire(), or any other pointer
+     * inside the same buffer.
+     */
+    void release(void *ptr);
+
+    /** @brief Total size of the allocated buffers.
+     * @return Size in bytes.
+     */
+    size_t allocated() const{return _allocated;}
+
+private:
+    /** @struct buffer
+     * @brief Mapped buffer.
+     */
+    struct buffer{
+        /// OpenCL memory object
+        cl_mem mem;
+        /// Mapped host pointer
+        void *ptr;
+        /// Size in bytes
+        size_t size;
+        /// Number of users which have not released the buffer yet, 0 if it
+        /// is idle
+        unsigned int users;
+    };
+
+    /// OpenCL context
+    cl_context _context;
+    /// OpenCL command queue
+    cl_command_queue _queue;
+    /// Allocated buffers
+    std::vector<buffer> _buffers;
+    /// Total size of the allocated buffers
+    size_t _allocated;
+    /// Buffers list access lock
+    pthread_mutex_t _mutex;
+};
+
+}}  // namespace
+
+#endif // STAGINGPOOL_H_INCLUDED
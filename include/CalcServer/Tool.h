@@ -89,6 +89,47 @@ public:
      * pipeline
      */
     virtual Tool* next_tool() {return _next_tool;}
+
+    /** Check whether the tool is ran just once or not.
+     * @return true if the tool is executed just the first time, false
+     * otherwise.
+     */
+    bool once() const {return _once;}
+
+    /** @brief Check whether the tool can be part of a captured sequence (see
+     * Aqua::CalcServer::Replay).
+     *
+     * Such tools are just enqueueing work on the device, without taking
+     * decisions or synchronizing on the host.
+     * @return true if the tool can be replayed, false otherwise.
+     */
+    virtual bool replayable() {return false;}
+
+    /** @brief Resolve the state to be replayed, e.g. the kernel arguments and
+     * the work sizes.
+     *
+     * It is called when the sequence is captured, and every time one of the
+     * bindings() is changing afterwards.
+     */
+    virtual void capture() {}
+
+    /** @brief Get the variables the captured state depends on.
+     * @return Variables bound to the captured state.
+     */
+    virtual const std::vector<InputOutput::Variable*> bindings() {
+        return std::vector<InputOutput::Variable*>();
+    }
+
+    /** @brief Execute the tool as part of a captured sequence, measuring the
+     * elapsed time.
+     *
+     * Unlike execute(), the events are not managed by the tool, but by the
+     * Aqua::CalcServer::Replay which is replaying the sequence.
+     * @param events List of events that shall be waited before safe execution
+     * @return OpenCL event to be waited before accessing the dependencies
+     * @remarks The caller must call clReleaseEvent to destroy the event.
+     */
+    cl_event replay(const std::vector<cl_event> events);
     
     /** Get the allocated memory for this tool.
      * @return allocated memory by this tool.
@@ -134,6 +175,18 @@ public:
      * @note scopes shall be always balanced
      */
     virtual const int scope_modifier(){return 0;}
+
+    /** @brief Get the depedencies of the tool
+     *
+     * @return Dependencies
+     */
+    const std::vector<InputOutput::Variable*> getDependencies();
+
+    /** @brief Get the read-only depedencies of the tool
+     *
+     * @return Read-only dependencies
+     */
+    const std::vector<InputOutput::Variable*> getInputs();
 protected:
     /** Get the tool index in the pipeline
      * @return Index of the tool in the pipeline. -1 if the tool cannot be find
@@ -157,6 +210,14 @@ protected:
      */
     virtual cl_event _execute(const std::vector<cl_event> events){return NULL;}
 
+    /** Execute the tool with the state resolved by capture()
+     * @param events List of events that shall be waited before safe execution
+     * @return OpenCL event to be waited before accessing the dependencies
+     */
+    virtual cl_event _replay(const std::vector<cl_event> events){
+        return _execute(events);
+    }
+
     /** @brief Add new data to the average and squared elapsed times
      * @param elapsed_time Elapsed time
      */
@@ -180,11 +241,16 @@ protected:
      */
     void setDependencies(std::vector<InputOutput::Variable*> vars);
 
-    /** @brief Get the depedencies of the tool
+    /** @brief Set the read-only depedencies of the tool
      *
-     * @return Dependencies
+     * The inputs are variables that this tool is just reading. Hence, the
+     * tool will wait for the last tool writing them, but several tools can
+     * read them simultaneously.
+     *
+     * @param vars Read-only dependencies
+     * @note The inputs shall not be included in the dependencies
      */
-    const std::vector<InputOutput::Variable*> getDependencies();
+    void setInputs(std::vector<InputOutput::Variable*> vars);
 
 private:
     /** @brief Get the list of events that this tool shall wait for
@@ -222,6 +288,9 @@ private:
     /// List of dependencies
     std::vector<InputOutput::Variable*> _vars;
 
+    /// List of read-only dependencies
+    std::vector<InputOutput::Variable*> _inputs;
+
     /// Internal storage to can safely return memory with getEvents()
     std::vector<cl_event> _events;
 };
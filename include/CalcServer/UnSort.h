@@ -26,6 +26,7 @@
 #ifndef UNSORT_H_INCLUDED
 #define UNSORT_H_INCLUDED
 
+#include <vector>
 #include <CalcServer.h>
 #include <CalcServer/Kernel.h>
 
@@ -35,16 +36,26 @@ namespace Aqua{ namespace CalcServer{
  * @brief UnSort Recover the original id of each particle. This tool is not
  * designed for the common usage but as an auxiliar tool for the savers,
  * therefore it will not be selectable for the users.
+ *
+ * All the fields are unsorted at once, by a single kernel, which is packing
+ * the data of a range of particles into an output buffer, such that it can
+ * be downloaded in a single transfer. The field f is stored at the offset
+ * offsets()[f], with the same alignment used by the host staging buffers.
+ *
+ * Just a selection of the particles in the range can be gathered as well,
+ * providing a map with the position of each particle in the packed output.
  */
 class UnSort : public Aqua::CalcServer::Tool
 {
 public:
     /** Constructor.
      * @param name Tool name.
-     * @param var_name Variable to unsort.
+     * @param var_names Variables to unsort.
      * @param once Run this tool just once. Useful to make initializations.
      */
-    UnSort(const std::string name, const std::string var_name, bool once=false);
+    UnSort(const std::string name,
+           const std::vector<std::string> var_names,
+           bool once=false);
 
     /** Destructor.
      */
@@ -54,15 +65,33 @@ public:
      */
     void setup();
 
-    /** Get the input variable.
-     * @return The variable to become sorted.
+    /** Get the input variables.
+     * @return The variables to become unsorted.
      */
-    InputOutput::ArrayVariable* input(){return _var;}
+    std::vector<InputOutput::ArrayVariable*> input(){return _vars;}
 
-    /** Get the memory object where the unsorted data is stored.
-     * @return The memory object where the unsorted data is stored.
+    /** Get the offsets of the fields in the output buffer.
+     * @param n Number of particles to unsort.
+     * @return The offset in bytes of each field, and the total size of the
+     * packed data as last element.
+     */
+    std::vector<size_t> offsets(unsigned int n) const;
+
+    /** Set the range of particles to unsort, and the output buffer.
+     * @param first First particle to unsort (in the unsorted space).
+     * @param n Number of particles to unsort.
+     * @param output Output memory object, with offsets(m).back() bytes at
+     * least.
+     * @param map Position in the output of each particle of the range,
+     * 0xFFFFFFFF to discard it. NULL to pack the whole range.
+     * @param m Number of particles gathered by the map. Ignored if map is
+     * NULL.
      */
-    cl_mem output(){return _output;}
+    void range(unsigned int first,
+               unsigned int n,
+               cl_mem output,
+               cl_mem map=NULL,
+               unsigned int m=0);
 
 protected:
     /** Execute the tool
@@ -72,14 +101,10 @@ protected:
     cl_event _execute(const std::vector<cl_event> events);
 
 private:
-    /** Get the input variable
+    /** Get the input variables
      */
     void variables();
 
-    /** Create the output memory object
-     */
-    void setupMem();
-
     /** Setup the OpenCL stuff
      */
     void setupOpenCL();
@@ -94,23 +119,20 @@ private:
      */
     void setVariables();
 
-    /// Input variable name
-    std::string _var_name;
+    /// Input variables names
+    std::vector<std::string> _var_names;
 
     /// ID variable
     InputOutput::ArrayVariable *_id_var;
 
-    /// Input variable
-    InputOutput::ArrayVariable *_var;
+    /// Input variables
+    std::vector<InputOutput::ArrayVariable*> _vars;
 
     /// ID Memory object sent
     cl_mem _id_input;
 
-    /// Memory object sent
-    cl_mem _input;
-
-    /// Output memory object
-    cl_mem _output;
+    /// Memory objects sent
+    std::vector<cl_mem> _inputs_mem;
 
     /// OpenCL kernel
     cl_kernel _kernel;
@@ -32,6 +32,9 @@
 #include <CalcServer.h>
 #include <InputOutput/State.h>
 #include <InputOutput/Particles.h>
+#include <InputOutput/WriterPool.h>
+#include <InputOutput/Checkpoint.h>
+#include <TimeManager.h>
 
 namespace Aqua{
 /// @namespace Aqua::InputOutput Input/Output data interfaces.
@@ -75,6 +78,19 @@ public:
      */
     std::string inputFile(){return _in_file;}
 
+    /** @brief Set the checkpoint to resume the simulation from.
+     * @param path Checkpoint file path, empty to start the simulation from
+     * the XML definition files.
+     * @see Aqua::InputOutput::Checkpoint
+     */
+    void restartFile(std::string path){_restart_file = path;}
+
+    /** @brief Get the checkpoint to resume the simulation from.
+     * @return Checkpoint file path, empty if the simulation is not resumed.
+     * @see Aqua::InputOutput::Checkpoint
+     */
+    std::string restartFile(){return _restart_file;}
+
     /** @brief Get the simulation setup, extracted from the XML definition files
      *
      * AQUAgpusph simulations are built on top of a XML definition file. Such
@@ -115,13 +131,27 @@ public:
      */
     void save(float t);
 
+    /** @brief Resume the simulation from the checkpoint, if it has been set.
+     *
+     * This method shall be called after load(), when the time manager has
+     * been already built.
+     * @param t_manager Time manager.
+     * @see restartFile()
+     */
+    void restart(TimeManager &t_manager);
+
+    /** @brief Take a checkpoint.
+     * @param t_manager Time manager.
+     * @see Aqua::InputOutput::ProblemSetup::sphSettings::checkpoint_path
+     */
+    void checkpoint(TimeManager &t_manager);
+
     /** @brief Wait for the parallel saving threads.
      *
-     * Some savers may optionally launch parallel threads to save the data, in
-     * an asynchronous way, in order to improve the performance. In such a case,
-     * AQUAgpusph shall wait them to finish before proceeding to destroy the
-     * data
-     * @see Aqua::InputOutput::VTK::waitForSavers()
+     * The savers are submitting the data to a pool of parallel threads, in
+     * order to write it in an asynchronous way. AQUAgpusph shall wait them to
+     * finish before proceeding to destroy the data
+     * @see Aqua::InputOutput::WriterPool
      */
     void waitForSavers();
 private:
@@ -139,6 +169,15 @@ private:
 
     /// The fluid savers
     std::vector<Particles*> _savers;
+
+    /// The pool of threads writing the output files
+    WriterPool *_writers;
+
+    /// Checkpoint to resume the simulation from
+    std::string _restart_file;
+
+    /// The checkpoints loader/saver
+    Checkpoint _checkpoint;
 };  // class FileManager
 
 }}  // namespaces
@@ -0,0 +1,133 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Particles binary columnar data files loader/saver.
+ * (See Aqua::InputOutput::Binary for details)
+ */
+
+#ifndef BINARY_H_INCLUDED
+#define BINARY_H_INCLUDED
+
+#include <sphPrerequisites.h>
+#include <InputOutput/Particles.h>
+
+namespace Aqua{
+namespace InputOutput{
+
+/** @class Binary Binary.h InputOutput/Binary.h
+ * @brief Binary columnar particles data files loader/saver.
+ *
+ * The data of each field is stored as a contiguous column, in the same
+ * layout used by the computational device, such that it can be loaded/saved
+ * without parsing every single value. The file is composed by:
+ *   -# A head with the magic string `"AQUAbin"` (8 bytes, including the null
+ *      termination), the format version (unsigned int), the number of
+ *      particles (unsigned int), the number of fields (unsigned int) and the
+ *      simulation time (float).
+ *   -# A record per field, with its name (64 bytes, null terminated), its type
+ *      name as returned by Aqua::InputOutput::Variable::type() (32 bytes, null
+ *      terminated), the type size in bytes (unsigned int), the encoding
+ *      (unsigned int), and the offset and length in bytes of the column (64
+ *      bits unsigned integers).
+ *   -# The columns, each one starting at a file page boundary.
+ *
+ * The encoding is 0 for the plain columns, or the number of bits (8 or 16) of
+ * the quantized columns (see
+ * Aqua::InputOutput::ProblemSetup::sphParticlesSet::addOutputQuantization()).
+ * A quantized column starts with the value represented by the quantized 0 and
+ * the quantization step (2 floats), followed by the quantized value of each
+ * float component. The loader is decoding such columns back. The encoding was
+ * an unused padding in the version 1 files, which can be still loaded.
+ *
+ * All the values are stored in little-endian order.
+ *
+ * The loader is memory mapping the file, sending the columns directly to the
+ * computational device, while the saver is submitting the columns to the
+ * writing threads pool, Aqua::InputOutput::WriterPool.
+ *
+ * Since the type sizes are stored, the files cannot be shared between 2D and
+ * 3D simulations, which is conveniently checked by the loader.
+ */
+class Binary : public Particles
+{
+public:
+    /** @brief Constructor
+     * @param sim_data Simulation data
+     * @param first First particle managed by this saver/loader.
+     * @param n Number of particles managed by this saver/loader.
+     * @param iset Particles set index.
+     */
+    Binary(ProblemSetup& sim_data,
+           unsigned int first,
+           unsigned int n,
+           unsigned int iset);
+
+    /// Destructor
+    ~Binary();
+
+    /** @brief Save the data.
+     *
+     * @param t Simulation time
+     */
+    void save(float t);
+
+    /** @brief Load the data.
+     */
+    void load();
+
+    /** @brief Wait for the parallel saving threads.
+     *
+     * Binary saver is submitting the data to the writing threads pool, to
+     * save it in an asynchronous way. Therefore, AQUAgpusph shall wait them
+     * to finish before proceeding to destroy the data
+     */
+    void waitForSavers();
+
+    /** @brief Synchronously write a binary file.
+     *
+     * This method is used by other savers to spill the frames when the
+     * writing threads are falling behind the simulation (see
+     * Aqua::InputOutput::WriterPool).
+     * @param path File path
+     * @param t Simulation time
+     * @param bounds Bounds of the particles index to be written
+     * @param fields Fields to be written
+     * @param data Downloaded data of each field
+     */
+    static void write(const std::string path,
+                      float t,
+                      uivec2 bounds,
+                      const std::vector<std::string> fields,
+                      const std::vector<void*> data);
+private:
+    /** @brief Select the next file to write.
+     * @return The file path.
+     * @see Aqua::InputOutput::Particles::file(const char* basename,
+     *                                         unsigned int start_index,
+     *                                         unsigned int digits=5)
+     */
+    std::string create();
+
+    /// Next output file index
+    unsigned int _next_file_index;
+};  // class InputOutput
+
+}}  // namespaces
+
+#endif // BINARY_H_INCLUDED
@@ -0,0 +1,118 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Binary checkpoints, to resume the simulations.
+ * (See Aqua::InputOutput::Checkpoint for details)
+ */
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include <sphPrerequisites.h>
+#include <TimeManager.h>
+
+namespace Aqua{
+namespace InputOutput{
+
+/** @class Checkpoint Checkpoint.h InputOutput/Checkpoint.h
+ * @brief Binary checkpoints, to resume the simulations.
+ *
+ * The checkpoints are binary archives with the raw content of every single
+ * variable, either scalars or arrays (including the sorting data, like
+ * `id_sorted` or `ihoc`, and the time integration backups, like `r_in`), and
+ * the output counters of the time manager. Since no conversion is carried out,
+ * resuming the simulation from a checkpoint restores exactly the same state.
+ * The arrays reallocated at runtime, like `ihoc`, are reallocated to their
+ * stored size.
+ *
+ * To do not stall the simulation, the variables are copied into a host
+ * snapshot, which is written by a background thread. Just a checkpoint can be
+ * written at the same time, such that a new checkpoint waits for the previous
+ * one to be written. The archive is written in a temporal file, which
+ * replaces the previous checkpoint when it is complete.
+ *
+ * The checkpoints are taken every a wall-clock time interval, independently
+ * of the output frames, which can be configured with the tag `Checkpoint`, in
+ * the `Settings` section:
+ * `<Checkpoint file="checkpoint.chk" interval="600" />`
+ * where the interval is provided in seconds.
+ *
+ * The simulation is resumed with the command line option `--restart`, after
+ * loading the same XML definition files.
+ *
+ * @warning The internal state of some tools is not stored, like the
+ * neighbours lists, which are built again, or the Python scripts.
+ */
+class Checkpoint
+{
+public:
+    /// Constructor
+    Checkpoint();
+
+    /// Destructor
+    ~Checkpoint();
+
+    /** @brief Take a checkpoint.
+     *
+     * The variables are copied into a host snapshot, and written by a
+     * background thread.
+     * @param path Checkpoint file path.
+     * @param t_manager Time manager.
+     */
+    void save(const std::string path, TimeManager &t_manager);
+
+    /** @brief Resume the simulation from a checkpoint.
+     * @param path Checkpoint file path.
+     * @param t_manager Time manager.
+     */
+    void load(const std::string path, TimeManager &t_manager);
+
+    /** @brief Wait for the checkpoint being written, if any.
+     */
+    void wait();
+
+private:
+    /** @brief Write the snapshot.
+     *
+     * This method is executed in a parallel thread.
+     * @param data The checkpoint itself, casted as void*.
+     * @return NULL.
+     */
+    static void* write_pthread(void *data);
+
+    /// Checkpoint file path
+    std::string _path;
+
+    /// Snapshot, i.e. the archive content
+    std::vector<char> _snapshot;
+
+    /// Writing thread
+    pthread_t _tid;
+
+    /// Whether the writing thread has been launched and not joined yet
+    bool _writing;
+};  // class Checkpoint
+
+}}  // namespaces
+
+#endif // CHECKPOINT_H_INCLUDED
@@ -52,6 +52,9 @@ namespace InputOutput{
  * @remarks In the case of integer numbers (signed or unsigned) this class does
  * not care about decimal points, just truncating the value, i.e. 1.5 will be
  * interpreted as 1, and -1.5 will be interpreted as -1.
+ * @note The file is memory mapped, and splitted in chunks at the lines
+ * boundaries, which are parsed in parallel threads, without intermediate
+ * copies of the text.
  * @warning Saving the particles data in plain text format may be heavily hard
  * disk demanding, and therefore it is strongly recommended to consider binary
  * formats like Aqua::InputOutput::VTK.
@@ -73,18 +76,9 @@ public:
     /// Destructor
     ~FastASCII();
 
-private:
-    /** @brief Extract the field value from a line.
-     * @param field Field name.
-     * @param line Text line,
-     * @param index Index of the particle to read.
-     * @param data Data array.
-     * @return Remaining text after extracting the field values.
+    /** @brief Load the data.
      */
-    std::string readField(const std::string field,
-                          const std::string line,
-                          unsigned int index,
-                          void* data);
+    void load();
 };  // class InputOutput
 
 }}  // namespaces
@@ -28,6 +28,7 @@
 #include <sphPrerequisites.h>
 #include <ProblemSetup.h>
 #include <InputOutput/InputOutput.h>
+#include <CalcServer/Quantize.h>
 
 namespace Aqua{
 namespace InputOutput{
@@ -125,13 +126,30 @@ protected:
                       unsigned int digits=5);
 
     /** Download the data from the device, and store it
+     *
+     * If the particles set has output filters (see
+     * Aqua::InputOutput::ProblemSetup::sphParticlesSet::addOutputFilter()),
+     * just the particles meeting them are downloaded.
+     *
+     * If the quantizations are requested, the fields with a quantization
+     * tolerance (see
+     * Aqua::InputOutput::ProblemSetup::sphParticlesSet::addOutputQuantization())
+     * are quantized before downloading them.
      * @param fields Fields to download
+     * @param n Returned number of downloaded particles
+     * @param quants Returned quantization of each field, NULL to download
+     * the fields without quantization.
      * @return host allocated memory
-     * @note The returned data must be manually cleared.
+     * @note The returned buffers are taken from the staging pool (see
+     * Aqua::CalcServer::StagingPool), and must be released back to it when
+     * they are not required anymore.
      */
-    std::vector<void*> download(std::vector<std::string> fields);
+    std::vector<void*> download(std::vector<std::string> fields,
+                                unsigned int &n,
+                                std::vector<CalcServer::quantization> *quants=NULL);
 private:
-    /** Remove the content of the data list.
+    /** Remove the content of the data list, releasing the buffers back to
+     * the staging pool.
      * @param data List of memory allocated arrays to be cleared.
      */
     void clearList(std::vector<void*> *data);
@@ -24,8 +24,6 @@
 #ifndef VTK_H_INCLUDED
 #define VTK_H_INCLUDED
 
-#include <pthread.h>
-
 #include <vtkVersion.h>
 #include <vtkSmartPointer.h>
 #include <vtkXMLUnstructuredGridWriter.h>
@@ -38,6 +36,8 @@
 #include <vtkPoints.h>
 #include <vtkVertex.h>
 #include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkIdTypeArray.h>
 
 #include <xercesc/dom/DOM.hpp>
 #include <xercesc/dom/DOMDocument.hpp>
@@ -88,6 +88,10 @@ namespace InputOutput{
  *   -# \f$ \frac{d \rho}{dt} \f$
  *   -# \f$ m \f$
  *   -# moving flag (see Aqua::InputOutput::Fluid::imove)
+ *
+ * The data is written as raw appended binary data, compressed with the
+ * compressor and level selected for the particles set (see
+ * Aqua::InputOutput::ProblemSetup::sphParticlesSet::outputCompression()).
  */
 class VTK : public Particles
 {
@@ -118,10 +122,14 @@ public:
 
     /** @brief Wait for the parallel saving threads.
      *
-     * VTK saver is launching parallel threads to save the data in an
-     * asynchronous way, significantly improving the performance. Therefore,
-     * AQUAgpusph shall wait them to finish before proceeding to destroy the
-     * data
+     * VTK saver is submitting the data to the writing threads pool, to save
+     * it in an asynchronous way, significantly improving the performance.
+     * Therefore, AQUAgpusph shall wait them to finish before proceeding to
+     * destroy the data.
+     *
+     * If the writing threads are falling behind the simulation, depending on
+     * the policy the frames can be skipped, or spilled into binary files
+     * (see Aqua::InputOutput::Binary) which can be converted later.
      */
     void waitForSavers();
 private:
@@ -162,9 +170,6 @@ private:
     /// PVD file name
     std::string _namePVD;
 
-    /// Launched threads ids
-    std::vector<pthread_t> _tids;
-
 };  // class InputOutput
 
 }}  // namespaces
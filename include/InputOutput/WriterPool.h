@@ -0,0 +1,208 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pool of parallel threads to write the output files.
+ * (See Aqua::InputOutput::WriterPool for details)
+ */
+
+#ifndef WRITERPOOL_H_INCLUDED
+#define WRITERPOOL_H_INCLUDED
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <sphPrerequisites.h>
+#include <Singleton.h>
+
+namespace Aqua{
+namespace InputOutput{
+
+/** @class WriterPool WriterPool.h InputOutput/WriterPool.h
+ * @brief Pool of parallel threads to write the output files.
+ *
+ * The savers are downloading the data from the computational device, and
+ * afterwards they are submitting a writing task (a frame) to this pool, such
+ * that the simulation can continue while the file is written.
+ *
+ * The pool has a fixed number of threads, and a bounded queue of frames, both
+ * in number and in memory. When the writers fall behind the simulation, i.e.
+ * the queue is full, one of the following policies is applied:
+ *   - "block": The simulation waits until there is room in the queue.
+ *   - "skip": The frame is discarded.
+ *   - "spill": The frame is written on the simulation thread, in a fast
+ *     format, if the saver provides it (see
+ *     Aqua::InputOutput::Binary::write()). Otherwise "block" is applied.
+ *
+ * The pool can be configured with the tag `Writers`, in the `Settings`
+ * section:
+ * `<Writers threads="2" queue="4" memory="1024" policy="block" />`
+ * where the memory budget is provided in MB (0 for unlimited memory).
+ *
+ * The queue depth and the writing throughput are reported by
+ * Aqua::CalcServer::Reports::Performance.
+ */
+class WriterPool : public Aqua::Singleton<Aqua::InputOutput::WriterPool>
+{
+public:
+    /// Policies to apply when the queue is full
+    typedef enum {
+        /// Wait until there is room in the queue
+        BLOCK,
+        /// Discard the frame
+        SKIP,
+        /// Write the frame in the fast format on the calling thread
+        SPILL,
+    } policy;
+
+    /// Outcome of a submitted frame
+    typedef enum {
+        /// The frame has been queued
+        QUEUED,
+        /// The frame has been discarded
+        SKIPPED,
+        /// The frame has been written in the fast format
+        SPILLED,
+    } outcome;
+
+    /** @struct task
+     * @brief Frame writing task.
+     */
+    struct task{
+        /// Write the frame. It shall release the frame data
+        std::function<void()> write;
+        /// Write the frame in the fast format. It shall release the frame
+        /// data. Can be empty
+        std::function<void()> spill;
+        /// Release the frame data without writing it
+        std::function<void()> discard;
+        /// Memory retained by the frame, in bytes
+        size_t bytes;
+    };
+
+    /** @brief Constructor
+     * @param n_threads Number of writing threads.
+     * @param max_queue Maximum number of frames queued or being written.
+     * @param max_memory Maximum memory retained by the frames queued or being
+     * written, in bytes. 0 for unlimited memory.
+     * @param pol Policy to apply when the queue is full.
+     */
+    WriterPool(unsigned int n_threads=2,
+               unsigned int max_queue=4,
+               size_t max_memory=0,
+               policy pol=BLOCK);
+
+    /// Destructor
+    ~WriterPool();
+
+    /** @brief Submit a frame to be written.
+     * @param t Writing task.
+     * @return The frame outcome.
+     */
+    outcome submit(task t);
+
+    /** @brief Wait until all the frames have been written.
+     */
+    void wait();
+
+    /** @brief Get the number of frames queued or being written.
+     * @return Queue depth.
+     */
+    unsigned int depth();
+
+    /** @brief Get the maximum number of frames queued or being written.
+     * @return Queue capacity.
+     */
+    unsigned int capacity() const{return _max_queue;}
+
+    /** @brief Get the writing throughput.
+     * @return Written bytes per second of writing threads activity.
+     */
+    float throughput();
+
+    /** @brief Get the number of skipped frames.
+     * @return Skipped frames.
+     */
+    unsigned int skipped() const{return _skipped;}
+
+    /** @brief Get the number of spilled frames.
+     * @return Spilled frames.
+     */
+    unsigned int spilled() const{return _spilled;}
+
+    /** @brief Convert a policy name into a policy.
+     * @param name Policy name: "block", "skip" or "spill".
+     * @return Policy.
+     */
+    static policy toPolicy(const std::string name);
+
+private:
+    /** @brief Writing threads main loop.
+     * @param pool_void The pool (dynamically casted as void*)
+     */
+    static void* worker(void *pool_void);
+
+    /** @brief Check whether a frame can be queued or not.
+     * @param bytes Memory retained by the frame.
+     * @return true if there is room for the frame, false otherwise.
+     * @note The lock shall be already acquired.
+     */
+    bool room(size_t bytes) const;
+
+    /// Maximum number of frames queued or being written
+    unsigned int _max_queue;
+    /// Maximum memory retained by the frames
+    size_t _max_memory;
+    /// Policy to apply when the queue is full
+    policy _policy;
+
+    /// Queued frames
+    std::deque<task> _queue;
+    /// Number of frames being written
+    unsigned int _active;
+    /// Memory retained by the frames queued or being written
+    size_t _memory;
+    /// true when the threads shall finish
+    bool _stop;
+
+    /// Number of written bytes
+    size_t _written;
+    /// Time spent writing the frames, in seconds
+    double _busy;
+    /// Number of skipped frames
+    unsigned int _skipped;
+    /// Number of spilled frames
+    unsigned int _spilled;
+
+    /// Queue access lock
+    pthread_mutex_t _mutex;
+    /// Signal for the writing threads that a new frame is queued
+    pthread_cond_t _cond_task;
+    /// Signal for the simulation that a frame has been written
+    pthread_cond_t _cond_done;
+
+    /// Writing threads
+    std::vector<pthread_t> _tids;
+};  // class WriterPool
+
+}}  // namespaces
+
+#endif // WRITERPOOL_H_INCLUDED
@@ -167,6 +167,106 @@ public:
          * This path is added to the OpenCL include paths.
          */
         std::string base_path;
+
+        /** @brief Folder where the compiled OpenCL programs are cached.
+         *
+         * The binaries of the compiled programs are stored there, and reused
+         * in subsequent runs (see Aqua::CalcServer::ProgramCache). The kernels
+         * arguments are stored there as well (see
+         * Aqua::CalcServer::SignatureIndex). By default
+         * `$XDG_CACHE_HOME/aquagpusph` (or `$HOME/.cache/aquagpusph`) is used.
+         *
+         * This field can be set with the tag `ProgramCache`, for instance:
+         * `<ProgramCache path="./cache" />`
+         * An empty path disables the cache.
+         */
+        std::string program_cache;
+
+        /** @brief Number of in-order command queues used to dispatch the
+         * tools.
+         *
+         * In the concurrent mode, the tools are dispatched across several
+         * in-order command queues, taking into account the variables that
+         * each tool is reading and writing (see
+         * Aqua::CalcServer::CalcServer::update()). 0 selects the legacy
+         * sequential mode, where all the tools are enqueued in the same
+         * command queue.
+         *
+         * This field can be set with the tag `Scheduler`, for instance:
+         * `<Scheduler mode="concurrent" queues="4" />`
+         * or
+         * `<Scheduler mode="sequential" />`
+         */
+        unsigned int queues;
+
+        /** @brief Replay the captured sequences of tools
+         *
+         * If true, the sequences of tools just enqueueing work on the device,
+         * like the kernels, are captured the first time they are executed,
+         * and replayed afterwards with minimal host work (see
+         * Aqua::CalcServer::Replay).
+         *
+         * You can enable the replay with the following tag (the replay is
+         * disabled by default):
+         * `<Replay value="true" />`
+         */
+        bool replay;
+
+        /** @brief Number of threads writing the output files.
+         *
+         * The savers are submitting the output frames to a pool of writing
+         * threads (see Aqua::InputOutput::WriterPool).
+         *
+         * This field can be set with the tag `Writers`, for instance:
+         * `<Writers threads="2" queue="4" memory="1024" policy="block" />`
+         */
+        unsigned int writer_threads;
+
+        /** @brief Maximum number of output frames queued or being written.
+         *
+         * This field can be set with the tag `Writers`, for instance:
+         * `<Writers threads="2" queue="4" memory="1024" policy="block" />`
+         * @see #writer_threads
+         */
+        unsigned int writer_queue;
+
+        /** @brief Maximum memory retained by the output frames queued or
+         * being written, in MB. 0 for unlimited memory.
+         *
+         * This field can be set with the tag `Writers`, for instance:
+         * `<Writers threads="2" queue="4" memory="1024" policy="block" />`
+         * @see #writer_threads
+         */
+        unsigned int writer_memory;
+
+        /** @brief Policy to apply when the writers fall behind the
+         * simulation: "block", "skip" or "spill".
+         *
+         * This field can be set with the tag `Writers`, for instance:
+         * `<Writers threads="2" queue="4" memory="1024" policy="block" />`
+         * @see #writer_threads
+         */
+        std::string writer_policy;
+
+        /** @brief Checkpoint archive path. An empty path disables the
+         * checkpoints.
+         *
+         * The checkpoints are binary archives with all the variables, which
+         * can be used to resume the simulation with the command line option
+         * `--restart` (see Aqua::InputOutput::Checkpoint).
+         *
+         * This field can be set with the tag `Checkpoint`, for instance:
+         * `<Checkpoint file="checkpoint.chk" interval="600" />`
+         */
+        std::string checkpoint_path;
+
+        /** @brief Wall-clock time between checkpoints, in seconds.
+         *
+         * This field can be set with the tag `Checkpoint`, for instance:
+         * `<Checkpoint file="checkpoint.chk" interval="600" />`
+         * @see #checkpoint_path
+         */
+        float checkpoint_interval;
     };
 
     /// Stored settings
@@ -634,6 +734,104 @@ public:
          * @see output()
          */
         std::vector<std::string> outputFields() const {return _out_fields;}
+
+        /** @brief Set the output file compression.
+         *
+         * Just the VTK files are compressed, as appended raw binary data.
+         * This field can be set with the tag `Save`, for instance:
+         * `<Save format="VTK" file="output" fields="r,normal"
+         *        compression="lz4" level="1" />`
+         *
+         * @param compressor Compressor: "none", "zlib", "lz4" or "lzma".
+         * @param level Compression level, from 1 (fastest) to 9 (smallest).
+         * 0 to use the compressor default level.
+         * @see Aqua::InputOutput::VTK
+         */
+        void outputCompression(std::string compressor, unsigned int level=0);
+
+        /** @brief Get the output file compressor
+         * @return Compressor name.
+         * @see outputCompression()
+         */
+        const std::string outputCompressor() const {return _out_compressor;}
+
+        /** @brief Get the output file compression level
+         * @return Compression level, 0 for the compressor default level.
+         * @see outputCompression()
+         */
+        unsigned int outputCompressionLevel() const {return _out_level;}
+
+        /** @brief Add an output filter, such that just the particles
+         * meeting the condition are written.
+         *
+         * The condition is an OpenCL expression, which is evaluated in the
+         * computational device before downloading the data. It can use the
+         * values of the particle fields, by their names, and the index of
+         * the particle in the set, `k`. If several filters are added, the
+         * particles shall meet all of them.
+         *
+         * This field can be set with the tag `Filter`, for instance:
+         * `<Filter type="box" min="0.0, 0.0, 0.0" max="1.0, 1.0, 1.0" />`
+         *
+         * @param condition Condition to be met.
+         * @param fields Fields used by the condition.
+         * @see Aqua::CalcServer::Filter
+         */
+        void addOutputFilter(std::string condition,
+                             std::vector<std::string> fields);
+
+        /** @brief Get the output filters conditions
+         * @return Conditions list, empty if the particles are not filtered.
+         * @see addOutputFilter()
+         */
+        std::vector<std::string> outputFilters() const {return _out_filters;}
+
+        /** @brief Get the output filter condition
+         * @return All the conditions joined, empty if the particles are not
+         * filtered.
+         * @see addOutputFilter()
+         */
+        const std::string outputFilter() const;
+
+        /** @brief Get the fields required by the output filter
+         * @return Fields list.
+         * @see addOutputFilter()
+         */
+        std::vector<std::string> outputFilterFields() const {
+            return _out_filter_fields;
+        }
+
+        /** @brief Quantize an output field, such that it is downloaded and
+         * written with reduced precision.
+         *
+         * The field is quantized in the computational device, with an error
+         * never bigger than the tolerance. Just the binary output files
+         * (see Aqua::InputOutput::Binary) are quantized, being the field
+         * decoded again when the file is loaded.
+         *
+         * This field can be set with the tag `Quantize`, for instance:
+         * `<Quantize field="p" tolerance="1.0" />`
+         *
+         * @param field Field to be quantized.
+         * @param tolerance Maximum quantization error.
+         * @see Aqua::CalcServer::Quantize
+         */
+        void addOutputQuantization(std::string field, float tolerance);
+
+        /** @brief Get the quantized output fields
+         * @return Tolerance of each quantized field.
+         * @see addOutputQuantization()
+         */
+        std::map<std::string, float> outputQuantizations() const {
+            return _out_tolerances;
+        }
+
+        /** @brief Get the quantization tolerance of an output field
+         * @param field Field name.
+         * @return Tolerance, 0 if the field is not quantized.
+         * @see addOutputQuantization()
+         */
+        float outputTolerance(std::string field) const;
     private:
         /// Number of particles
         unsigned int _n;
@@ -660,6 +858,21 @@ public:
 
         /// Fields to write in the file
         std::vector<std::string> _out_fields;
+
+        /// Output file compressor
+        std::string _out_compressor;
+
+        /// Output file compression level
+        unsigned int _out_level;
+
+        /// Output filters conditions
+        std::vector<std::string> _out_filters;
+
+        /// Fields required by the output filters
+        std::vector<std::string> _out_filter_fields;
+
+        /// Quantization tolerance of the output fields
+        std::map<std::string, float> _out_tolerances;
     };
 
     /// Array of particles sets
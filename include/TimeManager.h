@@ -24,6 +24,8 @@
 #ifndef TIMEMANAGER_H_INCLUDED
 #define TIMEMANAGER_H_INCLUDED
 
+#include <sys/time.h>
+
 #include <sphPrerequisites.h>
 #include <ProblemSetup.h>
 
@@ -131,6 +133,17 @@ public:
      */
     float outputFPS(){return _output_fps;}
 
+    /** @brief Check if a checkpoint must be taken.
+     *
+     * The checkpoints are taken every a wall-clock time interval,
+     * independently of the output frames (see
+     * Aqua::InputOutput::ProblemSetup::sphSettings::checkpoint_interval).
+     * @return true if a checkpoint must be taken, false otherwise.
+     * @warning This method is returning true just one time per interval,
+     * i.e. the interval is started again.
+     */
+    bool mustCheckpoint();
+
     /** @brief Get the total simulation time to compute.
      * @return Total simulation time to compute.
      */
@@ -168,6 +181,11 @@ private:
     int _output_step;
     /// IPF for Output files (-1 if Output file must not be printed)
     int _output_ipf;
+
+    /// Wall-clock time between checkpoints (-1 if they are disabled)
+    float _checkpoint_interval;
+    /// Wall-clock time instant of the last checkpoint
+    timeval _checkpoint_time;
 };
 
 }}  // namespace
@@ -85,6 +85,14 @@ public:
      */
     float solve(const std::string eq);
 
+    /** @brief Register the AQUAgpusph specific operators in a parser.
+     *
+     * Other parsers, like the ones used by the compiled expressions (see
+     * Aqua::InputOutput::Expression), should share the same operators.
+     * @param parser Parser where the operators should be registered.
+     */
+    static void defineOperators(mu::Parser &parser);
+
 protected:
     /** @brief Register the default variables.
      *
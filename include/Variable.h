@@ -30,6 +30,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <sphPrerequisites.h>
 #include <Tokenizer/Tokenizer.h>
 
@@ -135,7 +136,8 @@ public:
      * previous event is conveniently released calling clReleaseEvent()
      *
      * Might exists other events linked to this variable, but since those are
-     * considered predecessors, we can just forgive about them.
+     * considered predecessors, we can just forgive about them. The same
+     * applies to the events registered with addReaderEvent().
      *
      * @remarks Events are used even for non-OpenCL variables
      * @param event OpenCL event
@@ -143,10 +145,50 @@ public:
     void setEvent(cl_event event);    
 
     /** @brief Returns the last event associated to this variable
+     *
+     * If there are tools reading the variable since the last write (see
+     * addReaderEvent()), a marker waiting for all of them is enqueued, and
+     * it becomes the new variable event. Hence, the returned event is safe to
+     * be waited before either reading or writing the variable.
      *
      * @return OpenCL event
      */
-    cl_event getEvent(){return _event;}
+    cl_event getEvent();
+
+    /** @brief Register an event of a tool which is just reading the variable
+     *
+     * Several tools can simultaneously read the variable. The next tool
+     * writing the variable shall wait for all of them.
+     *
+     * clRetainEvent() is called on top of the provided event, which will be
+     * released by the next setEvent() call.
+     *
+     * The variables which are never written, like the constants, would
+     * accumulate the reader events forever, so the already complete readers
+     * are released here, and the pending ones are joined in a marker beyond
+     * __MAX_READER_EVENTS__.
+     *
+     * @param event OpenCL event
+     */
+    void addReaderEvent(cl_event event);
+
+    /** @brief Returns the event of the last tool writing the variable
+     *
+     * This event shall be waited before reading the variable.
+     *
+     * @return OpenCL event
+     */
+    cl_event getWriterEvent(){return _event;}
+
+    /** @brief Returns the events of the tools which are reading the variable
+     * since the last write
+     *
+     * These events, together with getWriterEvent(), shall be waited before
+     * writing the variable.
+     *
+     * @return OpenCL events
+     */
+    const std::vector<cl_event> getReaderEvents(){return _reader_events;}
 
 protected:
     /** @brief Wait for variable underlying event to be complete
@@ -168,6 +210,9 @@ private:
     /// List of events affecting this variable
     cl_event _event;
 
+    /// Events of the tools reading the variable since the last write
+    std::vector<cl_event> _reader_events;
+
     /// Shortcut to avoid calling the expensive OpenCL API
     bool _synced;
 };
@@ -854,6 +899,25 @@ public:
                void *data,
                const std::string name="NULL");
 
+    /** @brief Convert a set of components to a typed value.
+     * @param type_name Type of the output desired value.
+     * @param v Components.
+     * @param data Allocated memory where the result should be stored.
+     * @note typeToBytes(type) bytes should be allocated in data.
+     */
+    static void castComponents(const std::string type_name,
+                               const float *v,
+                               void *data);
+
+    /** @brief Split an expression in its components.
+     *
+     * The components are separated by commas, excluding the ones inside
+     * parentheses (i.e. functions arguments).
+     * @param value Expression to split.
+     * @return List of components expressions.
+     */
+    static std::vector<std::string> splitComponents(const std::string value);
+
     /** @brief Populate variables in order that the tokenizer may get the
      * updated value.
      * @param name Name of the variable to be populated, "" if all the
@@ -866,6 +930,15 @@ public:
      * @param var Variable to be populated.
      */
     void populate(Variable* var);
+
+    /** @brief Populate a variable just when the tokenizer requires it.
+     *
+     * This is useful for the variables which are asynchronously downloaded
+     * from the device, such that the host is not blocked until the updated
+     * value is actually required.
+     * @param var Variable to be populated.
+     */
+    void populateDeferred(Variable* var);
 private:
 
     /** Register a scalar variable
@@ -905,6 +978,96 @@ private:
     std::vector<Variable*> _vars;
     /// Tokenizer to evaluate variables
     Tokenizer tok;
+    /// Variables pending to be populated
+    std::vector<Variable*> _deferred;
+};
+
+// ---------------------------------------------------------------------------
+// Compiled expressions
+// ---------------------------------------------------------------------------
+
+/** @class Expression Variable.h Variable.h
+ * @brief Math expression compiled once and evaluated several times.
+ *
+ * Variables::solve() is parsing the expression each time it is called, and
+ * it depends on the values registered in the tokenizer by
+ * Variables::populate(). That is too expensive for the expressions evaluated
+ * each time step, like the number of threads of the kernels, or the
+ * conditions of If, While and Assert tools.
+ *
+ * This class parses the expression just once, binding each symbol to the
+ * variable value, which is read by pointer on each evaluation. Hence, the
+ * variables does not need to be populated.
+ */
+class Expression
+{
+public:
+    /** Constructor.
+     * @param vars Variables manager.
+     * @param type_name Type of the output desired value.
+     * @param value Expression to evaluate.
+     * @param name Name of the resulting variable. The previous components of
+     * the result can be used in the expression, i.e. "name_x" can be used to
+     * compute the "y" component.
+     */
+    Expression(Variables *vars,
+               const std::string type_name,
+               const std::string value,
+               const std::string name="NULL");
+
+    /** Destructor.
+     */
+    ~Expression();
+
+    /** Evaluate the expression.
+     * @param data Allocated memory where the result should be stored.
+     * @note Variables::typeToBytes(type) bytes should be allocated in data.
+     */
+    void solve(void *data);
+
+    /** Get the variables bound to the expression symbols.
+     * @return Bound variables, without duplicates.
+     */
+    std::vector<Variable*> variables() const;
+
+private:
+    /** @brief Bind a symbol of the expression to a variable component.
+     * @param symbol Symbol name.
+     * @param component Component of the result which is being compiled.
+     * @return Memory address where the value of the symbol should be stored.
+     */
+    mu::value_type* bind(const std::string symbol, unsigned int component);
+
+    /** @struct binding
+     * @brief Variable component bound to a parser symbol.
+     */
+    struct binding{
+        /// Variable
+        Variable *var;
+        /// Component of the variable
+        unsigned int component;
+        /// Components base type, 0 for int, 1 for unsigned int, 2 for float
+        unsigned int base_type;
+        /// Value seen by the parser
+        mu::value_type value;
+    };
+
+    /// Type of the output
+    std::string _type;
+    /// Expression
+    std::string _value;
+    /// Name of the resulting variable
+    std::string _name;
+    /// Number of components
+    unsigned int _n;
+    /// Variables manager
+    Variables *_vars;
+    /// Parser of each component
+    std::vector<mu::Parser*> _parsers;
+    /// Bound variables, with stable addresses
+    std::deque<binding> _bindings;
+    /// Already computed components, which can be used by the next ones
+    mu::value_type _results[4];
 };
 
 }}  // namespace
@@ -197,6 +197,15 @@
      */
     #define __CL_MAX_LOCALSIZE__ 1024
 #endif
+#ifndef __MAX_READER_EVENTS__
+    /** @def __MAX_READER_EVENTS__
+     * @brief Maximum number of pending reader events tracked by a variable.
+     *
+     * Beyond this number, the reader events are joined in a marker.
+     * @see Aqua::InputOutput::Variable::addReaderEvent()
+     */
+    #define __MAX_READER_EVENTS__ 8
+#endif
 
 #ifndef __ERROR_SHOW_TIME__
     #ifndef HAVE_NCURSES
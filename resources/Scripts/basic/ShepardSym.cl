@@ -0,0 +1,161 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @addtogroup basic
+ * @{
+ */
+
+/** @file
+ * @brief Shepard renormalization factor computation, visiting each pair of
+ * particles just once.
+ */
+
+#ifndef EXCLUDED_PARTICLE
+    /** @brief Excluded particles from the Shepard renormalization factor
+     * computation.
+     *
+     * @see Shepard.cl
+     */
+    #define EXCLUDED_PARTICLE(index) imove[index] >= 3
+#endif
+
+/** @brief Particles where the Shepard renormalization factor is computed.
+ *
+ * The Shepard renormalization factor is ever computed at the boundary elements
+ * and sensors (imove <= 0), as well as at the not excluded particles.
+ */
+#define SHEPARD_PARTICLE(index) ((imove[index] >= -3) &&                      \
+                                 ((imove[index] <= 0) ||                       \
+                                  !(EXCLUDED_PARTICLE(index))))
+
+#include "resources/Scripts/types/types.h"
+#include "resources/Scripts/KernelFunctions/Kernel.h"
+
+/** @brief Shepard factor computation.
+ *
+ * \f[ \gamma(\mathbf{x}) = \int_{\Omega}
+ *     W(\mathbf{y} - \mathbf{x}) \mathrm{d}\mathbf{y} \f]
+ *
+ * This is the symmetric version of the kernel in Shepard.cl, where each pair
+ * of particles is visited just once (see BEGIN_LOOP_OVER_NEIGHS_SYM), adding
+ * the kernel value to both particles. Each work group is processing the
+ * particles of a cell, accumulating the kernel values on the neighbour
+ * particles in local memory before adding them to the global memory. Hence,
+ * the Shepard factor should be initialized before launching this kernel.
+ *
+ * @param imove Moving flags.
+ *   - imove > 0 for regular fluid particles.
+ *   - imove = 0 for sensors.
+ *   - imove < 0 for boundary elements/particles.
+ * @param r Position \f$ \mathbf{r} \f$.
+ * @param rho Density \f$ \rho \f$.
+ * @param m Mass \f$ m \f$.
+ * @param shepard Shepard term
+ * \f$ \gamma(\mathbf{x}) = \int_{\Omega}
+ *     W(\mathbf{y} - \mathbf{x}) \mathrm{d}\mathbf{y} \f$.
+ * @param icell Cell where each particle is located.
+ * @param ihoc Head of chain for each cell (first particle found).
+ * @param N Number of particles.
+ * @param n_cells Number of cells in each direction
+ */
+__kernel void entry(const __global int* imove,
+                    const __global vec* r,
+                    const __global float* rho,
+                    const __global float* m,
+                    __global float* shepard,
+                    // Link-list data
+                    const __global uint *icell,
+                    const __global uint *ihoc,
+                    // Simulation data
+                    uint N,
+                    uivec4 n_cells)
+{
+    // Neighbours tiles, and their kernel values accumulators
+    #ifdef LOCAL_MEM_SIZE
+        __local char shepard_l[LOCAL_MEM_SIZE];
+        __local char excluded_l[LOCAL_MEM_SIZE];
+        __local vec_xyz r_l[LOCAL_MEM_SIZE];
+        __local float w_l[LOCAL_MEM_SIZE];
+        __local float shepard_acc_l[LOCAL_MEM_SIZE];
+        #define TILE_LOAD(jt, j) {                                             \
+            shepard_l[jt] = SHEPARD_PARTICLE(j);                               \
+            excluded_l[jt] = EXCLUDED_PARTICLE(j);                             \
+            r_l[jt] = r[j].XYZ;                                                \
+            w_l[jt] = m[j] / rho[j];                                           \
+        }
+        #define TILE_CLEAR(jt) {                                               \
+            shepard_acc_l[jt] = 0.f;                                           \
+        }
+        #define TILE_FLUSH(jt, j) if(shepard_l[jt]) {                          \
+            atomic_add_float(shepard + j, shepard_acc_l[jt]);                  \
+        }
+        #define _SHEPARD_J_ shepard_l[jt]
+        #define _EXCLUDED_J_ excluded_l[jt]
+        #define _R_J_ r_l[jt]
+        #define _W_J_ w_l[jt]
+        #define _ADD_SHEPARD_J_(v) atomic_add_local_float(shepard_acc_l + jt, v)
+    #else
+        #define _SHEPARD_J_ SHEPARD_PARTICLE(j)
+        #define _EXCLUDED_J_ EXCLUDED_PARTICLE(j)
+        #define _R_J_ r[j].XYZ
+        #define _W_J_ (m[j] / rho[j])
+        #define _ADD_SHEPARD_J_(v) atomic_add_float(shepard + j, v)
+    #endif
+
+    BEGIN_LOOP_OVER_CELLS(){
+        // The work items without a particle are still required to load and
+        // flush the tiles. The particle may be still contributing to its
+        // neighbours
+        const bool shepard_i = i_valid && SHEPARD_PARTICLE(i);
+        const bool excluded_i = !i_valid || EXCLUDED_PARTICLE(i);
+        const vec_xyz r_i = i_valid ? r[i].XYZ : VEC_ZERO.XYZ;
+        const float w_i = excluded_i ? 0.f : m[i] / rho[i];
+
+        // The particle itself is not visited by the loop
+        float shepard_acc = 0.f;
+        if(shepard_i && !excluded_i)
+            shepard_acc = kernelW(0.f) * CONW * w_i;
+
+        BEGIN_LOOP_OVER_NEIGHS_SYM(){
+            const bool shepard_j = _SHEPARD_J_;
+            const bool excluded_j = _EXCLUDED_J_;
+            if((excluded_j || !shepard_i) && (excluded_i || !shepard_j))
+                continue;
+
+            const vec_xyz r_ij = _R_J_ - r_i;
+            const float q = length(r_ij) / H;
+            if(q >= SUPPORT)
+                continue;
+
+            {
+                const float w_ij = kernelW(q) * CONW;
+                if(shepard_i && !excluded_j)
+                    shepard_acc += w_ij * _W_J_;
+                if(shepard_j && !excluded_i)
+                    _ADD_SHEPARD_J_(w_ij * w_i);
+            }
+        }END_LOOP_OVER_NEIGHS_SYM()
+
+        if(shepard_i)
+            atomic_add_float(shepard + i, shepard_acc);
+    }END_LOOP_OVER_CELLS()
+}
+
+/*
+ * @}
+ */
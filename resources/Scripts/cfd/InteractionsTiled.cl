@@ -0,0 +1,156 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Fluid particles interactions computation, staging the neighbours in
+ * local memory tiles.
+ */
+
+#include "resources/Scripts/types/types.h"
+#include "resources/Scripts/KernelFunctions/Kernel.h"
+
+#if __LAP_FORMULATION__ == __LAP_MONAGHAN__
+    #ifndef HAVE_3D
+        #define __CLEARY__ 8.f
+    #else
+        #define __CLEARY__ 10.f
+    #endif
+#endif
+
+/** @brief Fluid particles interactions computation.
+ *
+ * Compute the differential operators involved in the numerical scheme, taking
+ * into account just the fluid-fluid interactions.
+ *
+ * This is the cells based version of the kernel in Interactions.cl, where
+ * each work group is processing the particles of a cell, cooperatively
+ * loading the neighbour particles in local memory tiles (see
+ * BEGIN_LOOP_OVER_CELLS and BEGIN_LOOP_OVER_NEIGHS_TILED).
+ *
+ * @param imove Moving flags.
+ *   - imove > 0 for regular fluid particles.
+ *   - imove = 0 for sensors.
+ *   - imove < 0 for boundary elements/particles.
+ * @param r Position \f$ \mathbf{r} \f$.
+ * @param u Velocity \f$ \mathbf{u} \f$.
+ * @param rho Density \f$ \rho \f$.
+ * @param m Mass \f$ m \f$.
+ * @param p Pressure \f$ p \f$.
+ * @param grad_p Pressure gradient \f$ \frac{\nabla p}{rho} \f$.
+ * @param lap_u Velocity laplacian \f$ \frac{\Delta \mathbf{u}}{rho} \f$.
+ * @param div_u Velocity divergence \f$ \rho \nabla \cdot \mathbf{u} \f$.
+ * @param icell Cell where each particle is located.
+ * @param ihoc Head of chain for each cell (first particle found).
+ * @param N Number of particles.
+ * @param n_cells Number of cells in each direction
+ */
+__kernel void entry(const __global int* imove,
+                    const __global vec* r,
+                    const __global vec* u,
+                    const __global float* rho,
+                    const __global float* m,
+                    const __global float* p,
+                    __global vec* grad_p,
+                    __global vec* lap_u,
+                    __global float* div_u,
+                    // Link-list data
+                    const __global uint *icell,
+                    const __global uint *ihoc,
+                    // Simulation data
+                    uint N,
+                    uivec4 n_cells)
+{
+    // Neighbours tiles
+    #ifdef LOCAL_MEM_SIZE
+        __local int imove_l[LOCAL_MEM_SIZE];
+        __local vec_xyz r_l[LOCAL_MEM_SIZE];
+        __local vec_xyz u_l[LOCAL_MEM_SIZE];
+        __local float rho_l[LOCAL_MEM_SIZE];
+        __local float m_l[LOCAL_MEM_SIZE];
+        __local float p_l[LOCAL_MEM_SIZE];
+        #define TILE_LOAD(jt, j) {                                             \
+            imove_l[jt] = imove[j];                                            \
+            r_l[jt] = r[j].XYZ;                                                \
+            u_l[jt] = u[j].XYZ;                                                \
+            rho_l[jt] = rho[j];                                                \
+            m_l[jt] = m[j];                                                    \
+            p_l[jt] = p[j];                                                    \
+        }
+        #define _IMOVE_J_ imove_l[jt]
+        #define _R_J_ r_l[jt]
+        #define _U_J_ u_l[jt]
+        #define _RHO_J_ rho_l[jt]
+        #define _M_J_ m_l[jt]
+        #define _P_J_ p_l[jt]
+    #else
+        #define _IMOVE_J_ imove[j]
+        #define _R_J_ r[j].XYZ
+        #define _U_J_ u[j].XYZ
+        #define _RHO_J_ rho[j]
+        #define _M_J_ m[j]
+        #define _P_J_ p[j]
+    #endif
+
+    BEGIN_LOOP_OVER_CELLS(){
+        // The work items without a fluid particle are still required to load
+        // the tiles
+        const bool fluid_i = i_valid && (imove[i] == 1);
+        const vec_xyz r_i = fluid_i ? r[i].XYZ : VEC_ZERO.XYZ;
+        const vec_xyz u_i = fluid_i ? u[i].XYZ : VEC_ZERO.XYZ;
+        const float p_i = fluid_i ? p[i] : 0.f;
+        const float rho_i = fluid_i ? rho[i] : 1.f;
+
+        vec_xyz grad_p_i = VEC_ZERO.XYZ;
+        vec_xyz lap_u_i = VEC_ZERO.XYZ;
+        float div_u_i = 0.f;
+
+        BEGIN_LOOP_OVER_NEIGHS_TILED(){
+            if(!fluid_i || (i == j) || (_IMOVE_J_ != 1))
+                continue;
+            const vec_xyz r_ij = _R_J_ - r_i;
+            const float q = length(r_ij) / H;
+            if(q >= SUPPORT)
+                continue;
+            {
+                const float rho_j = _RHO_J_;
+                const float p_j = _P_J_;
+                const float udr = dot(_U_J_ - u_i, r_ij);
+                const float f_ij = kernelF(q) * CONF * _M_J_;
+
+                grad_p_i += (p_i + p_j) / (rho_i * rho_j) * f_ij * r_ij;
+
+                #if __LAP_FORMULATION__ == __LAP_MONAGHAN__
+                    const float r2 = (q * q + 0.01f) * H * H;
+                    lap_u_i += f_ij * __CLEARY__ * udr / (r2 * rho_i * rho_j) * r_ij;
+                #elif __LAP_FORMULATION__ == __LAP_MORRIS__
+                    lap_u_i += f_ij * 2.f / (rho_i * rho_j) * (_U_J_ - u_i);
+                #else
+                    #error Unknown Laplacian formulation: __LAP_FORMULATION__
+                #endif
+
+                div_u_i += udr * f_ij * rho_i / rho_j;
+            }
+        }END_LOOP_OVER_NEIGHS_TILED()
+
+        if(fluid_i){
+            grad_p[i].XYZ += grad_p_i;
+            lap_u[i].XYZ += lap_u_i;
+            div_u[i] += div_u_i;
+        }
+    }END_LOOP_OVER_CELLS()
+}
@@ -74,4 +74,45 @@ __kernel void entry(const __global uint* iset,
     dudt[i] = -grad_p[i] + visc_dyn[iset[i]] * lap_u[i] + g;
     // Conservation of mass equation
     drhodt[i] = -div_u[i];
-}
\ No newline at end of file
+}
+
+/** @brief Velocity and density variation rates computation, launched just
+ * over the fluid particles.
+ *
+ * The same than entry(), but launched over the list of fluid particles
+ * generated by the preset basic/compact.xml, such that the threads are not
+ * wasted on the sensors, the boundary elements or the buffer particles.
+ *
+ * @param iset Set of particles index.
+ * @param rho Density \f$ \rho_{n+1} \f$.
+ * @param grad_p Pressure gradient \f$ \frac{\nabla p}{rho} \f$.
+ * @param lap_u Velocity laplacian \f$ \frac{\Delta \mathbf{u}}{rho} \f$.
+ * @param div_u Velocity divergence \f$ \rho \nabla \cdot \mathbf{u} \f$.
+ * @param dudt Velocity rate of change
+ * \f$ \left. \frac{d \mathbf{u}}{d t} \right\vert_{n+1} \f$.
+ * @param drhodt Density rate of change
+ * \f$ \left. \frac{d \rho}{d t} \right\vert_{n+1} \f$.
+ * @param visc_dyn Dynamic viscosity \f$ \mu \f$.
+ * @param ifluid List of fluid particles.
+ * @param n_fluid Number of fluid particles.
+ * @param g Gravity acceleration \f$ \mathbf{g} \f$.
+ */
+__kernel void fluid(const __global uint* iset,
+                    const __global float* rho,
+                    const __global vec* grad_p,
+                    const __global vec* lap_u,
+                    const __global float* div_u,
+                    __global vec* dudt,
+                    __global float* drhodt,
+                    __constant float* visc_dyn,
+                    const __global uint* ifluid,
+                    unsigned int n_fluid,
+                    vec g)
+{
+    LIST_PARTICLE(ifluid, n_fluid);
+
+    // Momentum equation
+    dudt[i] = -grad_p[i] + visc_dyn[iset[i]] * lap_u[i] + g;
+    // Conservation of mass equation
+    drhodt[i] = -div_u[i];
+}
@@ -0,0 +1,74 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Differences between the symmetric and the default interactions.
+ */
+
+#include "resources/Scripts/types/types.h"
+
+/** @brief Squared differences between the symmetric and the default
+ * interactions.
+ *
+ * The squared differences, and the squared references, are stored as 4
+ * components vectors, for the pressure gradient, the velocity laplacian, the
+ * velocity divergence and the Shepard factor respectively, such that they can
+ * be reduced to get the relative L2 error of the symmetric kernels.
+ *
+ * @param grad_p Pressure gradient computed by Interactions.cl.
+ * @param lap_u Velocity laplacian computed by Interactions.cl.
+ * @param div_u Velocity divergence computed by Interactions.cl.
+ * @param shepard Shepard factor computed by Shepard.cl.
+ * @param grad_p_sym Pressure gradient computed by InteractionsSym.cl.
+ * @param lap_u_sym Velocity laplacian computed by InteractionsSym.cl.
+ * @param div_u_sym Velocity divergence computed by InteractionsSym.cl.
+ * @param shepard_sym Shepard factor computed by ShepardSym.cl.
+ * @param sym_err_i Squared differences.
+ * @param sym_ref_i Squared references.
+ * @param N Number of particles.
+ */
+__kernel void entry(const __global vec* grad_p,
+                    const __global vec* lap_u,
+                    const __global float* div_u,
+                    const __global float* shepard,
+                    const __global vec* grad_p_sym,
+                    const __global vec* lap_u_sym,
+                    const __global float* div_u_sym,
+                    const __global float* shepard_sym,
+                    __global vec4* sym_err_i,
+                    __global vec4* sym_ref_i,
+                    uint N)
+{
+    const uint i = get_global_id(0);
+    if(i >= N)
+        return;
+
+    const vec_xyz d_grad_p = grad_p_sym[i].XYZ - grad_p[i].XYZ;
+    const vec_xyz d_lap_u = lap_u_sym[i].XYZ - lap_u[i].XYZ;
+    const float d_div_u = div_u_sym[i] - div_u[i];
+    const float d_shepard = shepard_sym[i] - shepard[i];
+
+    sym_err_i[i] = (vec4)(dot(d_grad_p, d_grad_p),
+                          dot(d_lap_u, d_lap_u),
+                          d_div_u * d_div_u,
+                          d_shepard * d_shepard);
+    sym_ref_i[i] = (vec4)(dot(grad_p[i].XYZ, grad_p[i].XYZ),
+                          dot(lap_u[i].XYZ, lap_u[i].XYZ),
+                          div_u[i] * div_u[i],
+                          shepard[i] * shepard[i]);
+}
@@ -0,0 +1,67 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Differences between the tiled and the default interactions.
+ */
+
+#include "resources/Scripts/types/types.h"
+
+/** @brief Squared differences between the tiled and the default
+ * interactions.
+ *
+ * The squared differences, and the squared references, are stored as 3
+ * components vectors, for the pressure gradient, the velocity laplacian and
+ * the velocity divergence respectively, such that they can be reduced to get
+ * the relative L2 error of the tiled kernel.
+ *
+ * @param grad_p Pressure gradient computed by Interactions.cl.
+ * @param lap_u Velocity laplacian computed by Interactions.cl.
+ * @param div_u Velocity divergence computed by Interactions.cl.
+ * @param grad_p_tiled Pressure gradient computed by InteractionsTiled.cl.
+ * @param lap_u_tiled Velocity laplacian computed by InteractionsTiled.cl.
+ * @param div_u_tiled Velocity divergence computed by InteractionsTiled.cl.
+ * @param tiled_err_i Squared differences.
+ * @param tiled_ref_i Squared references.
+ * @param N Number of particles.
+ */
+__kernel void entry(const __global vec* grad_p,
+                    const __global vec* lap_u,
+                    const __global float* div_u,
+                    const __global vec* grad_p_tiled,
+                    const __global vec* lap_u_tiled,
+                    const __global float* div_u_tiled,
+                    __global vec3* tiled_err_i,
+                    __global vec3* tiled_ref_i,
+                    uint N)
+{
+    const uint i = get_global_id(0);
+    if(i >= N)
+        return;
+
+    const vec_xyz d_grad_p = grad_p_tiled[i].XYZ - grad_p[i].XYZ;
+    const vec_xyz d_lap_u = lap_u_tiled[i].XYZ - lap_u[i].XYZ;
+    const float d_div_u = div_u_tiled[i] - div_u[i];
+
+    tiled_err_i[i] = (vec3)(dot(d_grad_p, d_grad_p),
+                            dot(d_lap_u, d_lap_u),
+                            d_div_u * d_div_u);
+    tiled_ref_i[i] = (vec3)(dot(grad_p[i].XYZ, grad_p[i].XYZ),
+                            dot(lap_u[i].XYZ, lap_u[i].XYZ),
+                            div_u[i] * div_u[i]);
+}
@@ -162,6 +162,28 @@
  */
 #define XYZ xyz
 
+/** @brief Get the particle to be computed from a list generated by the
+ * "compact" tool.
+ *
+ * This macro should be used instead of the usual get_global_id(0) based
+ * particle index, when the kernel is launched over the particles in a list,
+ * i.e. setting the number of threads of the tool to the number of listed
+ * particles. The threads beyond the number of listed particles are returned.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - k_i: Position of the particle in the list
+ *   - i: Index of the particle.
+ *
+ * @param list List of particles, e.g. "ifluid".
+ * @param n Number of particles in the list, e.g. "n_fluid".
+ */
+#define LIST_PARTICLE(list, n)                                                 \
+    const uint k_i = get_global_id(0);                                         \
+    if(k_i >= n)                                                               \
+        return;                                                                \
+    const uint i = list[k_i]
+
 /** @brief Utility to can redefine the cell of the particle to be  computed.
  * 
  * It can be used for mirrrored particles, which are temporary associated to a
@@ -171,6 +193,68 @@
  */
 #define C_I() const uint c_i = icell[i]
 
+#ifdef SPARSE_CELLS
+    /** @brief Hash of a cell, to locate it in the sparse cells table.
+     * @param c Linear index of the cell.
+     * @return Hash of the cell.
+     * @see HOC
+     */
+    inline uint cellHash(uint c)
+    {
+        c ^= c >> 16;
+        c *= 0x7feb352du;
+        c ^= c >> 15;
+        c *= 0x846ca68bu;
+        c ^= c >> 16;
+        return c;
+    }
+
+    /** @brief Number of entries of the sparse cells table minus one, i.e. the
+     * mask to be applied to the hashes.
+     *
+     * The table has the smallest power of 2 number of entries not smaller
+     * than 2N, such that it is never more than half full.
+     */
+    #define SPARSE_CELLS_MASK ((1u << (32u - clz(2u * N - 1u))) - 1u)
+
+    /** @brief Look up the head of chain of a cell in the sparse cells table.
+     * @param ihoc Sparse cells table, with the cell, and the head of chain of
+     * the cell, in each pair of components. The empty entries have a cell
+     * equal to 0xFFFFFFFF.
+     * @param c Linear index of the cell.
+     * @param N Number of particles.
+     * @return Head of chain of the cell, N if the cell is empty.
+     */
+    inline uint sparseHoc(const __global uint *ihoc, uint c, uint N)
+    {
+        const uint mask = SPARSE_CELLS_MASK;
+        for(uint k = cellHash(c) & mask; ; k = (k + 1) & mask) {
+            const uint key = ihoc[2 * k];
+            if(key == c)
+                return ihoc[2 * k + 1];
+            if(key == 0xFFFFFFFF)
+                return N;
+        }
+    }
+#endif
+
+/** @brief Head of chain of a cell, i.e. the first particle in the cell.
+ *
+ * By default "ihoc" has a component per cell of the bounding box. If
+ * SPARSE_CELLS is defined (see the "sparse" attribute of the link-list tool),
+ * "ihoc" is a hash table with just the occupied cells instead, such that the
+ * memory and the time required to build it are not depending on the domain
+ * volume, but on the number of particles.
+ *
+ * Either way, N is returned for the empty cells.
+ * @param c Linear index of the cell.
+ */
+#ifdef SPARSE_CELLS
+    #define HOC(c) sparseHoc(ihoc, c, N)
+#else
+    #define HOC(c) ihoc[c]
+#endif
+
 /** @brief Loop over the neighs to compute the interactions.
  * 
  * All the code between this macro and END_LOOP_OVER_NEIGHS will be executed for
@@ -202,7 +286,7 @@
                                  ci +                                          \
                                  cj * n_cells.x +                              \
                                  ck * n_cells.x * n_cells.y;                   \
-                uint j = ihoc[c_j];                                            \
+                uint j = HOC(c_j);                                             \
                 while((j < N) && (icell[j] == c_j)) {
 
 /** @brief End of the loop over the neighs to compute the interactions.
@@ -216,6 +300,397 @@
         }                                                                      \
     }
 
+/** @brief Loop over the neighs, using the Verlet lists computed by the
+ * "neighbour-list" tool.
+ *
+ * This macro can be used in the same way than BEGIN_LOOP_OVER_NEIGHS, but the
+ * kernel should receive the "neighs" and "n_neighs" arrays instead of "icell"
+ * and "ihoc". The lists may contain particles slightly farther than the kernel
+ * support, which should be discarded as usual.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - k_j: Position of the neighbour particle j in the list
+ *   - j: Index of the neighbour particle.
+ *
+ * @see END_LOOP_OVER_NEIGHS_LIST
+ */
+#define BEGIN_LOOP_OVER_NEIGHS_LIST()                                          \
+    for(uint k_j = 0; k_j < n_neighs[i]; k_j++) {                              \
+        uint j = neighs[k_j * N + i];                                          \
+        {
+
+/** @brief End of the loop over the neighs using the Verlet lists.
+ * 
+ * @see BEGIN_LOOP_OVER_NEIGHS_LIST
+ */
+#define END_LOOP_OVER_NEIGHS_LIST()                                            \
+        }                                                                      \
+    }
+
+/** @brief Atomically add a value to a float in the global memory.
+ * @param addr Address of the value to be incremented.
+ * @param val Increment.
+ */
+inline void atomic_add_float(volatile __global float *addr, float val)
+{
+    union {
+        unsigned int u;
+        float f;
+    } old_val, new_val;
+    do {
+        old_val.f = *addr;
+        new_val.f = old_val.f + val;
+    } while(atomic_cmpxchg((volatile __global unsigned int *)addr,
+                           old_val.u,
+                           new_val.u) != old_val.u);
+}
+
+/** @brief Atomically add a vector to a #vec in the global memory.
+ *
+ * Each component is atomically incremented, but not the whole vector at once.
+ * @param addr Address of the vector to be incremented.
+ * @param val Increment.
+ */
+inline void atomic_add_vec(volatile __global vec *addr, vec_xyz val)
+{
+    volatile __global float *v = (volatile __global float *)addr;
+    atomic_add_float(v, val.x);
+    atomic_add_float(v + 1, val.y);
+    atomic_add_float(v + 2, val.z);
+}
+
+/** @brief Atomically add a value to a float in the local memory.
+ * @param addr Address of the value to be incremented.
+ * @param val Increment.
+ */
+inline void atomic_add_local_float(volatile __local float *addr, float val)
+{
+    union {
+        unsigned int u;
+        float f;
+    } old_val, new_val;
+    do {
+        old_val.f = *addr;
+        new_val.f = old_val.f + val;
+    } while(atomic_cmpxchg((volatile __local unsigned int *)addr,
+                           old_val.u,
+                           new_val.u) != old_val.u);
+}
+
+/** @brief Atomically add a vector to a #vec_xyz in the local memory.
+ *
+ * Each component is atomically incremented, but not the whole vector at once.
+ * @param addr Address of the vector to be incremented.
+ * @param val Increment.
+ */
+inline void atomic_add_local_vec(volatile __local vec_xyz *addr, vec_xyz val)
+{
+    volatile __local float *v = (volatile __local float *)addr;
+    atomic_add_local_float(v, val.x);
+    atomic_add_local_float(v + 1, val.y);
+    atomic_add_local_float(v + 2, val.z);
+}
+
+/** @brief Number of particles processed at once by each work group in the
+ * cells based loops.
+ *
+ * @see BEGIN_LOOP_OVER_CELLS
+ */
+#ifdef LOCAL_MEM_SIZE
+    #define TILE_SIZE LOCAL_MEM_SIZE
+#else
+    #define TILE_SIZE get_local_size(0)
+#endif
+
+/** @brief Loop over the cells, processing the particles of each cell by a
+ * whole work group.
+ *
+ * This macro is the counterpart of the usual particle per work item kernels,
+ * to be used together with BEGIN_LOOP_OVER_NEIGHS_TILED. Each work group is
+ * traversing the cells c_i = get_group_id(0) + k * get_num_groups(0), such
+ * that the kernel can be launched with the default number of threads, N. The
+ * particles of each cell are processed in chunks of TILE_SIZE particles, one
+ * per work item, while the empty cells are just skipped.
+ *
+ * If SPARSE_CELLS is defined, the work groups are traversing the entries of
+ * the sparse cells table instead, so just the occupied cells are visited.
+ *
+ * Since all the work items of the group are executing the loop, even if they
+ * have not a particle assigned, the kernel should not return before the loop.
+ * The work items without particle shall be identified with the variable
+ * i_valid.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - icell_l: Local memory cells of the neighbour particles
+ *   - n_tile_l: Local memory number of particles in the tile
+ *   - c_i: The cell processed by the work group
+ *   - hoc_i: Head of chain of the cell c_i
+ *   - k_c: Entry of the sparse cells table (just if SPARSE_CELLS is defined)
+ *   - i0: First particle of the chunk processed by the work group
+ *   - i: Index of the particle.
+ *   - i_valid: Whether there is a particle assigned to the work item or not.
+ *
+ * @see END_LOOP_OVER_CELLS
+ */
+#ifdef LOCAL_MEM_SIZE
+    #define _DECLARE_TILE_CELLS                                                \
+        __local uint icell_l[LOCAL_MEM_SIZE];                                  \
+        __local uint n_tile_l;
+#else
+    #define _DECLARE_TILE_CELLS
+#endif
+#ifdef SPARSE_CELLS
+    #define _BEGIN_LOOP_OVER_OCCUPIED_CELLS()                                  \
+        for(uint k_c = get_group_id(0);                                        \
+            k_c <= SPARSE_CELLS_MASK;                                          \
+            k_c += get_num_groups(0)) {                                        \
+            const uint c_i = ihoc[2 * k_c];                                    \
+            if(c_i == 0xFFFFFFFF)                                              \
+                continue;                                                      \
+            const uint hoc_i = ihoc[2 * k_c + 1];
+#else
+    #define _BEGIN_LOOP_OVER_OCCUPIED_CELLS()                                  \
+        for(uint c_i = get_group_id(0);                                        \
+            c_i < n_cells.w;                                                   \
+            c_i += get_num_groups(0)) {                                        \
+            const uint hoc_i = ihoc[c_i];                                      \
+            if(hoc_i >= N)                                                     \
+                continue;
+#endif
+#define BEGIN_LOOP_OVER_CELLS()                                                \
+    _DECLARE_TILE_CELLS                                                        \
+    _BEGIN_LOOP_OVER_OCCUPIED_CELLS()                                          \
+        for(uint i0 = hoc_i; ; i0 += TILE_SIZE) {                              \
+            const uint i = i0 + get_local_id(0);                               \
+            const bool i_valid = (i < N) && (icell[i] == c_i);                 \
+            {
+
+/** @brief End of the loop over the cells.
+ *
+ * @see BEGIN_LOOP_OVER_CELLS
+ */
+#define END_LOOP_OVER_CELLS()                                                  \
+            }                                                                  \
+            if((i0 + TILE_SIZE > N) || (icell[i0 + TILE_SIZE - 1] != c_i))     \
+                break;                                                         \
+        }                                                                      \
+    }
+
+/** @brief Loop over the particles of a neighbour cell, staging them in local
+ * memory tiles if possible.
+ *
+ * @see BEGIN_LOOP_OVER_NEIGHS_TILED
+ */
+#ifdef LOCAL_MEM_SIZE
+    #define _BEGIN_LOOP_OVER_TILE()                                            \
+        for(uint j0 = HOC(c_j); ; j0 += LOCAL_MEM_SIZE) {                      \
+            {                                                                  \
+                const uint jt = get_local_id(0);                               \
+                const uint j = j0 + jt;                                        \
+                icell_l[jt] = (j < N) ? icell[j] : 0xFFFFFFFF;                 \
+                if(icell_l[jt] == c_j) {                                       \
+                    TILE_LOAD(jt, j)                                           \
+                }                                                              \
+            }                                                                  \
+            barrier(CLK_LOCAL_MEM_FENCE);                                      \
+            for(uint jt = 0;                                                   \
+                i_valid && (jt < LOCAL_MEM_SIZE) && (icell_l[jt] == c_j);      \
+                jt++) {                                                        \
+                const uint j = j0 + jt;
+
+    #define _END_LOOP_OVER_TILE()                                              \
+            }                                                                  \
+            const bool tile_full = icell_l[LOCAL_MEM_SIZE - 1] == c_j;         \
+            barrier(CLK_LOCAL_MEM_FENCE);                                      \
+            if(!tile_full)                                                     \
+                break;                                                         \
+        }
+#else
+    #define _BEGIN_LOOP_OVER_TILE()                                            \
+        for(uint j = HOC(c_j); i_valid && (j < N) && (icell[j] == c_j); j++) {
+
+    #define _END_LOOP_OVER_TILE()                                              \
+        }
+#endif
+
+/** @brief Loop over the neighs of the particles of a cell, staging them in
+ * local memory tiles.
+ *
+ * This macro shall be used within BEGIN_LOOP_OVER_CELLS. The particles of the
+ * neighbour cells are cooperatively loaded by the work group in tiles of
+ * TILE_SIZE particles, such that each work item is then traversing the tile
+ * reading the local memory, instead of the global one.
+ *
+ * The kernel shall declare the local memory tiles for the required fields,
+ * with LOCAL_MEM_SIZE components, and define the macro TILE_LOAD(jt, j),
+ * which copies the fields of the particle j into the position jt of the
+ * tiles. The fields of the neighbour particle shall be read afterwards from
+ * the tiles at the position jt. If local memory is not available (i.e.
+ * LOCAL_MEM_SIZE is not defined), the loop is falling back to read the global
+ * memory directly, so the fields of the neighbour particle shall be read at
+ * the position j.
+ *
+ * Unlike BEGIN_LOOP_OVER_NEIGHS, the loop over the neighbours is a for loop,
+ * so the neighbour particles can be discarded with a plain continue, without
+ * incrementing j.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - ci: Index of the cell of the neighbour particle j, in the x direction
+ *   - cj: Index of the cell of the neighbour particle j, in the y direction
+ *   - ck: Index of the cell of the neighbour particle j, in the z direction
+ *   - c_j: Index of the cell of the neighbour particle j
+ *   - j0: First particle of the tile
+ *   - jt: Position of the neighbour particle j in the tile
+ *   - j: Index of the neighbour particle.
+ *
+ * @see END_LOOP_OVER_NEIGHS_TILED
+ */
+#define BEGIN_LOOP_OVER_NEIGHS_TILED()                                         \
+    for(int ci = -1; ci <= 1; ci++) {                                          \
+        for(int cj = -1; cj <= 1; cj++) {                                      \
+            for(int ck = -1; ck <= 1; ck++) {                                  \
+                const uint c_j = c_i +                                         \
+                                 ci +                                          \
+                                 cj * n_cells.x +                              \
+                                 ck * n_cells.x * n_cells.y;                   \
+                _BEGIN_LOOP_OVER_TILE()
+
+/** @brief End of the loop over the neighs staged in local memory tiles.
+ *
+ * @see BEGIN_LOOP_OVER_NEIGHS_TILED
+ */
+#define END_LOOP_OVER_NEIGHS_TILED()                                           \
+                _END_LOOP_OVER_TILE()                                          \
+            }                                                                  \
+        }                                                                      \
+    }
+
+/** @brief Loop over the neighbour particles of a cell staged in local memory
+ * tiles, accumulating the interactions on them as well.
+ *
+ * @see BEGIN_LOOP_OVER_NEIGHS_SYM
+ */
+#ifdef LOCAL_MEM_SIZE
+    #define _BEGIN_LOOP_OVER_SYM_TILE()                                        \
+        for(uint j0 = HOC(c_j); ; j0 += LOCAL_MEM_SIZE) {                      \
+            {                                                                  \
+                const uint jt = get_local_id(0);                               \
+                const uint j = j0 + jt;                                        \
+                if((j < N) && (icell[j] == c_j)) {                             \
+                    TILE_LOAD(jt, j)                                           \
+                    TILE_CLEAR(jt)                                             \
+                    if((jt == LOCAL_MEM_SIZE - 1) || (j + 1 == N) ||           \
+                       (icell[j + 1] != c_j))                                  \
+                        n_tile_l = jt + 1;                                     \
+                }                                                              \
+                else if(jt == 0) {                                             \
+                    n_tile_l = 0;                                              \
+                }                                                              \
+            }                                                                  \
+            barrier(CLK_LOCAL_MEM_FENCE);                                      \
+            const uint n_tile = n_tile_l;                                      \
+            for(uint k = 0; i_valid && (k < n_tile); k++) {                    \
+                const uint jt = (k + get_local_id(0)) % n_tile;                \
+                const uint j = j0 + jt;                                        \
+                if(!dc && (j <= i))                                            \
+                    continue;
+
+    #define _END_LOOP_OVER_SYM_TILE()                                          \
+            }                                                                  \
+            barrier(CLK_LOCAL_MEM_FENCE);                                      \
+            if(get_local_id(0) < n_tile) {                                     \
+                TILE_FLUSH(get_local_id(0), j0 + get_local_id(0))              \
+            }                                                                  \
+            if(n_tile < LOCAL_MEM_SIZE)                                        \
+                break;                                                         \
+        }
+
+#else
+    #define _BEGIN_LOOP_OVER_SYM_TILE()                                        \
+        for(uint j = dc ? HOC(c_j) : i + 1;                                    \
+            i_valid && (j < N) && (icell[j] == c_j);                           \
+            j++) {
+
+    #define _END_LOOP_OVER_SYM_TILE()                                          \
+        }
+
+#endif
+
+/** @brief Loop over each pair of neighbours just once, to compute symmetric
+ * interactions.
+ *
+ * This macro shall be used within BEGIN_LOOP_OVER_CELLS, in the same way than
+ * BEGIN_LOOP_OVER_NEIGHS_TILED, but just the neighbour cells with a bigger
+ * index than the cell c_i (the forward half of the stencil, 13 out of 26
+ * cells), and the particles j > i of the cell c_i itself, are traversed.
+ * Hence, each pair is visited by just one of the particles, which shall
+ * accumulate the interaction on both of them, such that the pair terms are
+ * computed just once (Newton's third law).
+ *
+ * The neighbour particles are cooperatively loaded in local memory tiles by
+ * the work group, along with local memory accumulators for their
+ * interactions. The kernel shall define the macros TILE_LOAD(jt, j), which
+ * copies the fields of the particle j into the position jt of the tiles,
+ * TILE_CLEAR(jt), which resets the accumulators at the position jt, and
+ * TILE_FLUSH(jt, j), which adds the accumulators at the position jt to the
+ * particle j in the global memory, e.g. with atomic_add_float() and
+ * atomic_add_vec(). The interactions on the neighbour particle shall be
+ * accumulated in the position jt, with atomic_add_local_float() and
+ * atomic_add_local_vec(). Each work item is traversing the tile starting at
+ * a different particle, so the work items are rarely accumulating on the
+ * same particle at once. Hence, the global memory atomic operations are
+ * carried out once per neighbour particle and tile, instead of once per pair.
+ *
+ * If local memory is not available (i.e. LOCAL_MEM_SIZE is not defined), the
+ * loop is falling back to read the global memory directly, so the fields of
+ * the neighbour particle shall be read at the position j, and the
+ * interactions on it shall be atomically added in the global memory.
+ *
+ * Since other work groups are accumulating interactions on the particle i as
+ * well, the output arrays should be initialized before launching the kernel,
+ * and the interactions on the particle i shall be atomically added at the
+ * end of the loop.
+ *
+ * The following variables will be declared, and therefore cannot be used
+ * elsewhere:
+ *   - ci: Index of the cell of the neighbour particle j, in the x direction
+ *   - cj: Index of the cell of the neighbour particle j, in the y direction
+ *   - ck: Index of the cell of the neighbour particle j, in the z direction
+ *   - dc: Offset between the cells c_i and c_j
+ *   - c_j: Index of the cell of the neighbour particle j
+ *   - j0: First particle of the tile
+ *   - n_tile: Number of particles in the tile
+ *   - k: Counter of the visited particles of the tile
+ *   - jt: Position of the neighbour particle j in the tile
+ *   - j: Index of the neighbour particle.
+ *
+ * @see END_LOOP_OVER_NEIGHS_SYM
+ */
+#define BEGIN_LOOP_OVER_NEIGHS_SYM()                                           \
+    for(int ci = -1; ci <= 1; ci++) {                                          \
+        for(int cj = -1; cj <= 1; cj++) {                                      \
+            for(int ck = -1; ck <= 1; ck++) {                                  \
+                const int dc = ci +                                            \
+                               cj * (int)n_cells.x +                           \
+                               ck * (int)(n_cells.x * n_cells.y);              \
+                if(dc < 0)                                                     \
+                    continue;                                                  \
+                const uint c_j = c_i + dc;                                     \
+                _BEGIN_LOOP_OVER_SYM_TILE()
+
+/** @brief End of the loop over each pair of neighbours.
+ *
+ * @see BEGIN_LOOP_OVER_NEIGHS_SYM
+ */
+#define END_LOOP_OVER_NEIGHS_SYM()                                             \
+                _END_LOOP_OVER_SYM_TILE()                                      \
+            }                                                                  \
+        }                                                                      \
+    }
+
 /** @brief Multiply a matrix by a vector (inner product)
  *
  * @note The vector should have 3 components, not 4.
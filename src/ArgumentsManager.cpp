@@ -33,9 +33,10 @@
 
 // Short and long runtime options (see
 // http://www.gnu.org/software/libc/manual/html_node/Getopt.html#Getopt)
-static const char *opts = "i:vh";
+static const char *opts = "i:r:vh";
 static const struct option longOpts[] = {
     { "input", required_argument, NULL, 'i' },
+    { "restart", required_argument, NULL, 'r' },
     { "version", no_argument, NULL, 'v' },
     { "help", no_argument, NULL, 'h' },
     { NULL, no_argument, NULL, 0 }
@@ -60,6 +61,8 @@ void displayUsage()
               << "the short ones." << std::endl;
     std::cout << "  -i, --input=INPUT            XML definition input file "
               << "(Input.xml by default)" << std::endl;
+    std::cout << "  -r, --restart=CHECKPOINT     Resume the simulation from a "
+              << "checkpoint" << std::endl;
     std::cout << "  -v, --version                Show the AQUAgpusph version" << std::endl;
     std::cout << "  -h, --help                   Show this help page" << std::endl;
 }
@@ -79,6 +82,14 @@ void parse(int argc, char **argv, FileManager &file_manager)
                 LOG(L_INFO, msg.str());
                 break;
 
+            case 'r':
+                file_manager.restartFile(optarg);
+                msg.str(std::string());
+                msg << "Restart file = " << file_manager.restartFile()
+                    << std::endl;
+                LOG(L_INFO, msg.str());
+                break;
+
             case 'v':
                 std::cout << "VERSION: " << PACKAGE_VERSION << std::endl << std::endl;
                 return;
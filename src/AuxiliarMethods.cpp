@@ -31,8 +31,16 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
 
 #include <AuxiliarMethods.h>
 #include <ProblemSetup.h>
@@ -229,6 +237,167 @@ bool isRelativePath(const std::string path)
     return true;
 }
 
+bool makeFolder(const std::string path)
+{
+    std::string partial;
+    std::istringstream tokens(path);
+    std::string token;
+    if(path.size() && (path.at(0) == '/'))
+        partial = "/";
+    while(std::getline(tokens, token, '/')) {
+        if(token.empty())
+            continue;
+        partial += token + "/";
+        if(mkdir(partial.c_str(), 0755) && (errno != EEXIST))
+            return false;
+    }
+    return true;
+}
+
+uint64_t hashString(const std::string data, uint64_t hash)
+{
+    for(auto c : data) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// Content of the included files already read during this run
+static std::map<std::string, std::string> included_files;
+
+static uint64_t hashIncludes(const std::string source,
+                             const std::string folder,
+                             const std::vector<std::string> &dirs,
+                             std::set<std::string> &visited,
+                             uint64_t hash);
+
+/** @brief Hash a file path and its content, as well as the files it
+ * includes.
+ * @param file_path File path.
+ * @param dirs Include folders.
+ * @param visited Already hashed files, to avoid hashing them twice.
+ * @param hash Initial hash value.
+ * @return Hash value.
+ */
+static uint64_t hashFile(const std::string file_path,
+                         const std::vector<std::string> &dirs,
+                         std::set<std::string> &visited,
+                         uint64_t hash)
+{
+    if(!visited.insert(file_path).second)
+        return hash;
+
+    auto it = included_files.find(file_path);
+    if(it == included_files.end()) {
+        std::ifstream f(file_path, std::ios::in | std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(f)),
+                             std::istreambuf_iterator<char>());
+        it = included_files.insert(std::make_pair(file_path, content)).first;
+    }
+
+    hash = hashString(file_path, hash);
+    hash = hashString(it->second, hash);
+    return hashIncludes(it->second,
+                        getFolderFromFilePath(file_path),
+                        dirs,
+                        visited,
+                        hash);
+}
+
+/** @brief Hash the files included by a source code, recursively.
+ * @param source Source code.
+ * @param folder Folder of the including file.
+ * @param dirs Include folders.
+ * @param visited Already hashed files, to avoid hashing them twice.
+ * @param hash Initial hash value.
+ * @return Hash value.
+ */
+static uint64_t hashIncludes(const std::string source,
+                             const std::string folder,
+                             const std::vector<std::string> &dirs,
+                             std::set<std::string> &visited,
+                             uint64_t hash)
+{
+    std::istringstream lines(source);
+    std::string line;
+    while(std::getline(lines, line)) {
+        line = trimCopy(line);
+        if(line.empty() || (line[0] != '#'))
+            continue;
+        line = ltrimCopy(line.substr(1));
+        if(line.compare(0, 7, "include"))
+            continue;
+        line = trimCopy(line.substr(7));
+        if(line.empty())
+            continue;
+
+        // The folders to look for the file, in order
+        std::vector<std::string> search_dirs;
+        if(!folder.empty())
+            search_dirs.push_back(folder);
+        search_dirs.insert(search_dirs.end(), dirs.begin(), dirs.end());
+        search_dirs.push_back(".");
+
+        if((line[0] == '"') || (line[0] == '<')) {
+            const char end = (line[0] == '"') ? '"' : '>';
+            const std::string name = line.substr(
+                1, line.find(end, 1) - 1);
+            for(auto dir : search_dirs) {
+                const std::string file_path = dir + "/" + name;
+                if(isFile(file_path)) {
+                    hash = hashFile(file_path, dirs, visited, hash);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // Computed include. Get the folder from the path passed to the macro,
+        // and hash all the files there
+        std::string name = line;
+        if(name.find('(') != std::string::npos)
+            name = name.substr(name.find('(') + 1);
+        name = name.substr(0, name.find_first_of(")\"\t "));
+        const std::size_t last_sep = name.find_last_of('/');
+        name = (last_sep == std::string::npos) ? "" : name.substr(0, last_sep);
+        if(name.empty() && !folder.empty())
+            search_dirs = {folder};
+        for(auto dir : search_dirs) {
+            const std::string folder_path = name.empty() ? dir
+                                                         : dir + "/" + name;
+            DIR *d = opendir(folder_path.c_str());
+            if(!d)
+                continue;
+            std::vector<std::string> files;
+            struct dirent *entry;
+            while((entry = readdir(d))) {
+                const std::string file_path = folder_path + "/" +
+                                              entry->d_name;
+                struct stat file_stat;
+                if(!stat(file_path.c_str(), &file_stat) &&
+                   S_ISREG(file_stat.st_mode))
+                    files.push_back(file_path);
+            }
+            closedir(d);
+            std::sort(files.begin(), files.end());
+            for(auto file_path : files)
+                hash = hashFile(file_path, dirs, visited, hash);
+            break;
+        }
+    }
+    return hash;
+}
+
+uint64_t hashIncludes(const std::string source,
+                      const std::string folder,
+                      const std::vector<std::string> &dirs,
+                      uint64_t hash)
+{
+    std::set<std::string> visited;
+    return hashIncludes(source, folder, dirs, visited, hash);
+}
+
 size_t getLocalWorkSize(cl_uint n, cl_command_queue queue)
 {
     cl_int flag;
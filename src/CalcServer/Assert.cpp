@@ -33,11 +33,13 @@ namespace Aqua{ namespace CalcServer{
 Assert::Assert(const std::string name, const std::string condition, bool once)
     : Tool(name, once)
     , _condition(condition)
+    , _expr(NULL)
 {
 }
 
 Assert::~Assert()
 {
+    if(_expr) delete _expr; _expr = NULL;
 }
 
 void Assert::setup()
@@ -46,26 +48,16 @@ void Assert::setup()
     msg << "Loading the tool \"" << name() << "\"..." << std::endl;
     LOG(L_INFO, msg.str());
     Tool::setup();
+    _expr = new InputOutput::Expression(CalcServer::singleton()->variables(),
+                                        "int",
+                                        _condition,
+                                        "assert_result");
 }
 
 cl_event Assert::_execute(const std::vector<cl_event> events)
 {
     int result;
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
-
-    void *data = malloc(sizeof(int));
-    if(!data){
-        std::stringstream msg;
-        msg << "Failure allocating memory for the integer result" << std::endl;
-        LOG(L_ERROR, msg.str());
-        throw std::bad_alloc();
-    }
-
-    vars->solve("int", _condition, data, "assert_result");
-
-    // Check the result
-    memcpy(&result, data, sizeof(int));
-    free(data);
+    _expr->solve(&result);
     if(result == 0){
         std::stringstream msg;
         msg << "Assertion error. The expression \"" <<
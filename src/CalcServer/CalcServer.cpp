@@ -26,21 +26,27 @@
 #include <limits>
 #include <string>
 #include <stack>
+#include <algorithm>
 
 #include <CalcServer.h>
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer/Assert.h>
+#include <CalcServer/Compact.h>
 #include <CalcServer/Conditional.h>
 #include <CalcServer/Copy.h>
 #include <CalcServer/Kernel.h>
 #include <CalcServer/LinkList.h>
+#include <CalcServer/NeighbourList.h>
 #include <CalcServer/Python.h>
 #include <CalcServer/RadixSort.h>
 #include <CalcServer/Reduction.h>
 #include <CalcServer/Set.h>
 #include <CalcServer/SetScalar.h>
+#include <CalcServer/Swap.h>
 #include <CalcServer/UnSort.h>
+#include <CalcServer/Filter.h>
+#include <CalcServer/Quantize.h>
 #include <CalcServer/Reports/Performance.h>
 #include <CalcServer/Reports/Screen.h>
 #include <CalcServer/Reports/TabFile.h>
@@ -48,6 +54,10 @@
 
 namespace Aqua{ namespace CalcServer{
 
+#ifndef DOWNLOAD_ALIGNMENT
+    #define DOWNLOAD_ALIGNMENT 128
+#endif // DOWNLOAD_ALIGNMENT
+
 CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
     : _num_platforms(0)
     , _platforms(NULL)
@@ -58,12 +68,29 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
     , _platform(NULL)
     , _device(NULL)
     , _command_queue(NULL)
+    , _next_queue(0)
+    , _program_cache(NULL)
+    , _signatures(NULL)
+    , _staging(NULL)
+    , _unsort_mem(NULL)
+    , _unsort_mem_size(0)
+    , _filter_mem(NULL)
+    , _filter_mem_size(0)
+    , _quantize(NULL)
+    , _quant_mem(NULL)
+    , _quant_mem_size(0)
     , _current_tool_name(NULL)
     , _sim_data(sim_data)
 {
     unsigned int i, j;
 
     setupOpenCL();
+    _program_cache = new ProgramCache(_sim_data.settings.program_cache,
+                                      _context,
+                                      _platform,
+                                      _device);
+    _signatures = new SignatureIndex(_sim_data.settings.program_cache);
+    _staging = new StagingPool(_context, _command_queue);
 
     _base_path = _sim_data.settings.base_path;
     _current_tool_name = new char[256];
@@ -117,6 +144,20 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
     _vars.registerVariable("id_unsorted", "unsigned int*", valstr.str(), "");
     _vars.registerVariable("icell", "unsigned int*", valstr.str(), "");
     _vars.registerVariable("ihoc", "unsigned int*", "n_cells_w", "");
+    // Neighbours lists, just if they are actually computed
+    unsigned int max_neighs = 0;
+    for(auto t : _sim_data.tools){
+        if(t->get("type").compare("neighbour-list"))
+            continue;
+        max_neighs = std::max(max_neighs,
+                              (unsigned int)std::stoi(t->get("max_neighs")));
+    }
+    if(max_neighs){
+        valstr.str(""); valstr << N;
+        _vars.registerVariable("n_neighs", "unsigned int*", valstr.str(), "");
+        valstr.str(""); valstr << N * max_neighs;
+        _vars.registerVariable("neighs", "unsigned int*", valstr.str(), "");
+    }
 
     // Register the user variables and arrays
     for(i = 0; i < _sim_data.variables.names.size(); i++){
@@ -176,6 +217,13 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
                                   once);
             _tools.push_back(tool);
         }
+        else if(!t->get("type").compare("swap")){
+            Swap *tool = new Swap(t->get("name"),
+                                  t->get("in"),
+                                  t->get("out"),
+                                  once);
+            _tools.push_back(tool);
+        }
         else if(!t->get("type").compare("python")){
             Python *tool = new Python(t->get("name"),
                                       t->get("path"),
@@ -205,9 +253,39 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
                                             once);
             _tools.push_back(tool);
         }
+        else if(!t->get("type").compare("compact")){
+            Compact *tool = new Compact(t->get("name"),
+                                        t->get("in"),
+                                        t->get("out"),
+                                        t->get("n"),
+                                        t->get("condition"),
+                                        once);
+            _tools.push_back(tool);
+        }
         else if(!t->get("type").compare("link-list")){
+            bool incremental = false;
+            if(!toLowerCopy(t->get("incremental")).compare("true")){
+                incremental = true;
+            }
+            bool sparse = false;
+            if(!toLowerCopy(t->get("sparse")).compare("true")){
+                sparse = true;
+            }
             LinkList *tool = new LinkList(t->get("name"),
-                                          t->get("in"));
+                                          t->get("in"),
+                                          incremental,
+                                          std::stof(t->get("threshold")),
+                                          t->get("ordering"),
+                                          sparse);
+            _tools.push_back(tool);
+        }
+        else if(!t->get("type").compare("neighbour-list")){
+            NeighbourList *tool = new NeighbourList(
+                t->get("name"),
+                t->get("in"),
+                std::stof(t->get("skin")),
+                (unsigned int)std::stoi(t->get("max_neighs")),
+                once);
             _tools.push_back(tool);
         }
         else if(!t->get("type").compare("radix-sort")){
@@ -314,6 +392,10 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
             unsigned int ipf = std::stoi(t->get("ipf"));
             float fps = std::stof(t->get("fps"));
 
+            // And the particles selection and the output format
+            bool binary = !t->get("format").compare("binary");
+            unsigned int flush = std::stoi(t->get("flush"));
+
             Reports::SetTabFile *tool = new Reports::SetTabFile(
                 t->get("name"),
                 t->get("fields"),
@@ -321,7 +403,10 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
                 _sim_data.sets.at(set_id)->n(),
                 t->get("path"),
                 ipf,
-                fps);
+                fps,
+                t->get("ids"),
+                binary,
+                flush);
             _tools.push_back(tool);
         }
         else if(!t->get("type").compare("report_performance")){
@@ -392,6 +477,10 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
             unsigned int ipf = std::stoi(r->get("ipf"));
             float fps = std::stof(r->get("fps"));
 
+            // And the particles selection and the output format
+            bool binary = !r->get("format").compare("binary");
+            unsigned int flush = std::stoi(r->get("flush"));
+
             Reports::SetTabFile *tool = new Reports::SetTabFile(
                 r->get("name"),
                 r->get("fields"),
@@ -399,7 +488,10 @@ CalcServer::CalcServer(const Aqua::InputOutput::ProblemSetup& sim_data)
                 _sim_data.sets.at(set_id)->n(),
                 r->get("path"),
                 ipf,
-                fps);
+                fps,
+                r->get("ids"),
+                binary,
+                flush);
             _tools.push_back(tool);
         }
         else if(!r->get("type").compare("performance")){
@@ -438,11 +530,18 @@ CalcServer::~CalcServer()
     unsigned int i;
     delete[] _current_tool_name;
 
+    // The pinned buffers shall be released before the context
+    if(_staging) delete _staging; _staging = NULL;
+
     if(_context) clReleaseContext(_context); _context = NULL;
     for(i = 0; i < _num_devices; i++){
         if(_command_queues[i]) clReleaseCommandQueue(_command_queues[i]);
         _command_queues[i] = NULL;
     }
+    for(auto queue : _queues){
+        clReleaseCommandQueue(queue);
+    }
+    _queues.clear();
 
     if(_platforms) delete[] _platforms; _platforms=NULL;
     if(_devices) delete[] _devices; _devices=NULL;
@@ -456,23 +555,61 @@ CalcServer::~CalcServer()
     for (auto& unsorter : unsorters) {
         delete unsorter.second;
     }
+    if(_unsort_mem) clReleaseMemObject(_unsort_mem); _unsort_mem = NULL;
+    for (auto& filter : filters) {
+        delete filter.second;
+    }
+    if(_filter_mem) clReleaseMemObject(_filter_mem); _filter_mem = NULL;
+    if(_quantize) delete _quantize; _quantize = NULL;
+    if(_quant_mem) clReleaseMemObject(_quant_mem); _quant_mem = NULL;
+
+    for(auto replay : _replays){
+        if(replay.second) delete replay.second;
+    }
+    _replays.clear();
+
+    if(_program_cache) delete _program_cache; _program_cache = NULL;
+    if(_signatures) delete _signatures; _signatures = NULL;
 }
 
-void CalcServer::update(InputOutput::TimeManager& t_manager)
+bool CalcServer::update(InputOutput::TimeManager& t_manager)
 {
     unsigned int i;
     while(!t_manager.mustPrintOutput() && !t_manager.mustStop()){
+        if(t_manager.mustCheckpoint())
+            return false;
+
         InputOutput::Logger::singleton()->initFrame();
 
         // Execute the tools
         Tool* tool = _tools.front();
         while(tool) {
+            Replay *sequence = _sim_data.settings.replay ? replay(tool) : NULL;
+            if(sequence){
+                try {
+                    sequence->execute();
+                } catch (std::runtime_error &e) {
+                    sleep(__ERROR_SHOW_TIME__);
+                    throw;
+                }
+                tool = sequence->next_tool();
+                continue;
+            }
+            if(_queues.size())
+                _command_queue = schedule(tool);
             try {
                 tool->execute();
             } catch (std::runtime_error &e) {
+                _command_queue = _command_queues[_sim_data.settings.device_id];
                 sleep(__ERROR_SHOW_TIME__);
                 throw;
             }
+            if(_queues.size()){
+                // The events are waited from other queues, so the commands
+                // should be submitted to the device
+                clFlush(_command_queue);
+                _command_queue = _command_queues[_sim_data.settings.device_id];
+            }
             tool = tool->next_tool();
         }
         strcpy(_current_tool_name, "__post execution__");
@@ -488,54 +625,470 @@ void CalcServer::update(InputOutput::TimeManager& t_manager)
 
         InputOutput::Logger::singleton()->endFrame();
     }
+    return true;
+}
+
+cl_command_queue CalcServer::schedule(Tool *tool)
+{
+    std::vector<InputOutput::Variable*> vars = tool->getDependencies();
+    std::vector<InputOutput::Variable*> inputs = tool->getInputs();
+    vars.insert(vars.end(), inputs.begin(), inputs.end());
+
+    // Follow the queue of the last writer of any of the variables
+    int queue_id = -1;
+    for(auto var : vars){
+        auto writer = _writers.find(var);
+        if(writer == _writers.end())
+            continue;
+        for(unsigned int i = 0; i < _queues_tail.size(); i++){
+            if(_queues_tail.at(i) == writer->second){
+                queue_id = i;
+                break;
+            }
+        }
+        if(queue_id >= 0)
+            break;
+    }
+    // Otherwise, take the next one
+    if(queue_id < 0){
+        queue_id = _next_queue;
+        _next_queue = (_next_queue + 1) % _queues.size();
+    }
+
+    _queues_tail.at(queue_id) = tool;
+    for(auto var : tool->getDependencies()){
+        _writers[var] = tool;
+    }
+    return _queues.at(queue_id);
+}
+
+Replay* CalcServer::replay(Tool *tool)
+{
+    auto it = _replays.find(tool);
+    if(it != _replays.end())
+        return it->second;
+
+    // Collect the tools until a non-replayable one is found. The tools
+    // executed just once are excluded, since they are not enqueued every time
+    std::vector<Tool*> tools;
+    Tool *next = tool;
+    while(next){
+        if(!next->replayable() || next->once())
+            break;
+        tools.push_back(next);
+        next = next->next_tool();
+    }
+
+    Replay *sequence = NULL;
+    if(tools.size() > 1)
+        sequence = new Replay(tools);
+    _replays[tool] = sequence;
+    return sequence;
 }
 
-cl_event CalcServer::getUnsortedMem(const std::string var_name,
-                                    size_t offset,
-                                    size_t cb,
-                                    void *ptr)
+UnSort* CalcServer::unsort(const std::vector<std::string> var_names,
+                           unsigned int first,
+                           unsigned int n,
+                           cl_mem map,
+                           unsigned int m)
 {
     cl_int err_code;
 
-    // Generate the unsorted if it does not exist yet
+    // Generate the unsorter if it does not exist yet
+    std::ostringstream key;
+    for(auto var_name : var_names)
+        key << var_name << ",";
     UnSort *unsorter = NULL;
-    if(unsorters.find(var_name) == unsorters.end()){
-        unsorter = new UnSort(var_name.c_str(), var_name.c_str());
+    if(unsorters.find(key.str()) == unsorters.end()){
+        unsorter = new UnSort(key.str(), var_names);
         try {
             unsorter->setup();
         } catch(std::runtime_error &e) {
             delete unsorter;
             return NULL;
         }
-        unsorters.insert(std::make_pair(var_name, unsorter));
+        unsorters.insert(std::make_pair(key.str(), unsorter));
     }
     // Get the unsorter
-    unsorter = unsorters[var_name];
+    unsorter = unsorters[key.str()];
+
+    // Grow the packed data buffer if required
+    size_t size = unsorter->offsets(map ? m : n).back();
+    if(size > _unsort_mem_size){
+        if(_unsort_mem) clReleaseMemObject(_unsort_mem); _unsort_mem = NULL;
+        _unsort_mem_size = 0;
+        _unsort_mem = clCreateBuffer(context(),
+                                     CL_MEM_READ_WRITE,
+                                     size,
+                                     NULL,
+                                     &err_code);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure allocating " << size
+                << " bytes for the unsorted data." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            return NULL;
+        }
+        _unsort_mem_size = size;
+    }
+
     try {
+        unsorter->range(first, n, _unsort_mem, map, m);
         unsorter->execute();
     } catch (std::runtime_error &e) {
         return NULL;
     }
-    cl_mem mem = unsorter->output();
-    cl_event event = NULL, event_wait = unsorter->input()->getEvent();
-    err_code = clEnqueueReadBuffer(command_queue(),
-                                   mem,
-                                   CL_FALSE,
-                                   offset,
-                                   cb,
-                                   ptr,
-                                   1,
-                                   &event_wait,
-                                   &event);
+    return unsorter;
+}
+
+cl_event CalcServer::getUnsortedMem(const std::vector<std::string> var_names,
+                                    unsigned int first,
+                                    unsigned int n,
+                                    std::vector<void*> &ptrs,
+                                    const std::vector<float> tolerances,
+                                    std::vector<quantization> *quants)
+{
+    UnSort *unsorter = unsort(var_names, first, n);
+    if(!unsorter)
+        return NULL;
+
+    return download(_unsort_mem,
+                    unsorter->offsets(n),
+                    unsorter->input(),
+                    n,
+                    unsorter->input().front()->getEvent(),
+                    tolerances,
+                    ptrs,
+                    quants);
+}
+
+cl_event CalcServer::getGatheredMem(const std::vector<std::string> var_names,
+                                    unsigned int first,
+                                    unsigned int n,
+                                    cl_mem map,
+                                    unsigned int m,
+                                    std::vector<void*> &ptrs)
+{
+    UnSort *unsorter = unsort(var_names, first, n, map, m);
+    if(!unsorter)
+        return NULL;
+
+    return download(_unsort_mem,
+                    unsorter->offsets(m),
+                    unsorter->input(),
+                    m,
+                    unsorter->input().front()->getEvent(),
+                    std::vector<float>(),
+                    ptrs,
+                    NULL);
+}
+
+cl_event CalcServer::getFilteredMem(const std::vector<std::string> var_names,
+                                    unsigned int first,
+                                    unsigned int n,
+                                    const std::string condition,
+                                    const std::vector<std::string> condition_names,
+                                    std::vector<void*> &ptrs,
+                                    unsigned int &m,
+                                    const std::vector<float> tolerances,
+                                    std::vector<quantization> *quants)
+{
+    cl_int err_code;
+
+    // The variables required by the condition are unsorted as well, after
+    // the ones to be downloaded
+    std::vector<std::string> names = var_names;
+    for(auto name : condition_names){
+        if(std::find(names.begin(), names.end(), name) == names.end())
+            names.push_back(name);
+    }
+    UnSort *unsorter = unsort(names, first, n);
+    if(!unsorter)
+        return NULL;
+
+    // Generate the filter if it does not exist yet
+    std::ostringstream key;
+    for(auto name : names)
+        key << name << ",";
+    key << var_names.size() << ":" << condition;
+    Filter *filter = NULL;
+    if(filters.find(key.str()) == filters.end()){
+        std::ostringstream name;
+        name << "filter" << filters.size();
+        filter = new Filter(name.str(),
+                            condition,
+                            unsorter->input(),
+                            condition_names,
+                            var_names.size());
+        try {
+            filter->setup();
+        } catch(std::runtime_error &e) {
+            delete filter;
+            return NULL;
+        }
+        filters.insert(std::make_pair(key.str(), filter));
+    }
+    filter = filters[key.str()];
+
+    // Grow the packed filtered data buffer if required
+    std::vector<size_t> offsets = filter->offsets(n);
+    if(offsets.back() > _filter_mem_size){
+        if(_filter_mem) clReleaseMemObject(_filter_mem); _filter_mem = NULL;
+        _filter_mem_size = 0;
+        _filter_mem = clCreateBuffer(context(),
+                                     CL_MEM_READ_WRITE,
+                                     offsets.back(),
+                                     NULL,
+                                     &err_code);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure allocating " << offsets.back()
+                << " bytes for the filtered data." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            return NULL;
+        }
+        _filter_mem_size = offsets.back();
+    }
+
+    cl_event event_wait;
+    try {
+        event_wait = filter->execute(_unsort_mem,
+                                     unsorter->offsets(n),
+                                     _filter_mem,
+                                     n,
+                                     unsorter->input().front()->getEvent(),
+                                     m);
+    } catch (std::runtime_error &e) {
+        return NULL;
+    }
+
+    // Download just the kept particles of each field
+    std::vector<InputOutput::ArrayVariable*> vars(
+        unsorter->input().begin(),
+        unsorter->input().begin() + var_names.size());
+    cl_event event = download(_filter_mem,
+                              offsets,
+                              vars,
+                              m,
+                              event_wait,
+                              tolerances,
+                              ptrs,
+                              quants);
+    clReleaseEvent(event_wait);
+    return event;
+}
+
+cl_event CalcServer::download(cl_mem mem,
+                              const std::vector<size_t> offsets,
+                              const std::vector<InputOutput::ArrayVariable*> vars,
+                              unsigned int n,
+                              cl_event event_wait,
+                              const std::vector<float> tolerances,
+                              std::vector<void*> &ptrs,
+                              std::vector<quantization> *quants)
+{
+    unsigned int i;
+    cl_int err_code;
+    auto align = [](size_t offset) {
+        return ((offset + DOWNLOAD_ALIGNMENT - 1) / DOWNLOAD_ALIGNMENT) *
+               DOWNLOAD_ALIGNMENT;
+    };
+
+    // Select the quantization of each field
+    std::vector<quantization> q(vars.size(), {0, 0.f, 0.f});
+    for(i = 0; n && (i < tolerances.size()) && (i < vars.size()); i++){
+        if(tolerances.at(i) <= 0.f)
+            continue;
+        std::string type = trimCopy(vars.at(i)->type());
+        unsigned int n_values = InputOutput::Variables::typeToN(type);
+        if((type.find("float") != 0) && (type.find("vec") != 0) &&
+           (type.find("matrix") != 0)){
+            std::ostringstream msg;
+            msg << "The variable \"" << vars.at(i)->name() << "\" of type \""
+                << type << "\" cannot be quantized." << std::endl;
+            LOG(L_ERROR, msg.str());
+            return NULL;
+        }
+        if(InputOutput::Variables::typeToBytes(type) !=
+           n_values * sizeof(cl_float)){
+            // The padding component of the 3 components vectors is
+            // uninitialized, so it cannot be quantized
+            std::ostringstream msg;
+            msg << "The variable \"" << vars.at(i)->name() << "\" of type \""
+                << type << "\" cannot be quantized (padded type)." << std::endl;
+            LOG(L_ERROR, msg.str());
+            return NULL;
+        }
+        if(!_quantize){
+            _quantize = new Quantize();
+            try {
+                _quantize->setup();
+            } catch(std::runtime_error &e) {
+                delete _quantize; _quantize = NULL;
+                return NULL;
+            }
+        }
+        float vmin, vmax;
+        try {
+            _quantize->range(mem,
+                             offsets.at(i),
+                             n * n_values,
+                             event_wait,
+                             vmin,
+                             vmax);
+        } catch(std::runtime_error &e) {
+            return NULL;
+        }
+        q.at(i) = Quantize::bits(vmin, vmax, tolerances.at(i));
+        if(!q.at(i).bits){
+            std::ostringstream msg;
+            msg << "The variable \"" << vars.at(i)->name()
+                << "\" range cannot be quantized with a tolerance of "
+                << tolerances.at(i) << ". It is downloaded as is." << std::endl;
+            LOG(L_WARNING, msg.str());
+        }
+    }
+
+    // Layout of the host data, and of the quantized columns in the device
+    std::vector<size_t> host_offsets, host_bytes, q_offsets;
+    size_t host_size = 0, q_size = 0;
+    bool packed = true;
+    for(i = 0; i < vars.size(); i++){
+        size_t typesize = InputOutput::Variables::typeToBytes(
+            vars.at(i)->type());
+        size_t bytes = typesize * n;
+        q_offsets.push_back(q_size);
+        if(q.at(i).bits){
+            bytes = (size_t)n * (typesize / sizeof(cl_float)) *
+                    q.at(i).bits / 8;
+            q_size = align(q_size + bytes);
+        }
+        host_offsets.push_back(host_size);
+        host_bytes.push_back(bytes);
+        packed = packed && !q.at(i).bits &&
+                 (host_size == offsets.at(i));
+        host_size = align(host_size + bytes);
+    }
+    packed = packed && (host_size == offsets.at(vars.size()));
+
+    // Quantize the columns
+    std::vector<cl_event> q_events(vars.size(), NULL);
+    auto release_events = [&q_events]() {
+        for(auto event : q_events){
+            if(event)
+                clReleaseEvent(event);
+        }
+    };
+    if(q_size > _quant_mem_size){
+        if(_quant_mem) clReleaseMemObject(_quant_mem); _quant_mem = NULL;
+        _quant_mem_size = 0;
+        _quant_mem = clCreateBuffer(context(),
+                                    CL_MEM_READ_WRITE,
+                                    q_size,
+                                    NULL,
+                                    &err_code);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure allocating " << q_size
+                << " bytes for the quantized data." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            return NULL;
+        }
+        _quant_mem_size = q_size;
+    }
+    for(i = 0; i < vars.size(); i++){
+        if(!q.at(i).bits)
+            continue;
+        size_t typesize = InputOutput::Variables::typeToBytes(
+            vars.at(i)->type());
+        try {
+            q_events.at(i) = _quantize->encode(mem,
+                                               offsets.at(i),
+                                               n * (typesize / sizeof(cl_float)),
+                                               q.at(i),
+                                               _quant_mem,
+                                               q_offsets.at(i),
+                                               event_wait);
+        } catch(std::runtime_error &e) {
+            release_events();
+            return NULL;
+        }
+    }
+
+    void *ptr;
+    try {
+        ptr = _staging->acquire(max(host_size, (size_t)1), vars.size());
+    } catch (...) {
+        release_events();
+        return NULL;
+    }
+
+    // Download the data. The unsorted fields without quantization can be
+    // downloaded in a single transfer, otherwise each column is read on its
+    // own. In the latter case, each read waits for the previous one, so the
+    // last one is returned
+    cl_event event = NULL;
+    err_code = CL_SUCCESS;
+    if(!n){
+        clRetainEvent(event_wait);
+        event = event_wait;
+    }
+    else if(packed){
+        err_code = clEnqueueReadBuffer(command_queue(),
+                                       mem,
+                                       CL_FALSE,
+                                       0,
+                                       host_size,
+                                       ptr,
+                                       1,
+                                       &event_wait,
+                                       &event);
+    }
+    else{
+        for(i = 0; i < vars.size(); i++){
+            std::vector<cl_event> wait_list;
+            wait_list.push_back(q.at(i).bits ? q_events.at(i) : event_wait);
+            if(event)
+                wait_list.push_back(event);
+            cl_event read_event;
+            err_code = clEnqueueReadBuffer(command_queue(),
+                                           q.at(i).bits ? _quant_mem : mem,
+                                           CL_FALSE,
+                                           q.at(i).bits ? q_offsets.at(i) :
+                                                          offsets.at(i),
+                                           host_bytes.at(i),
+                                           (char*)ptr + host_offsets.at(i),
+                                           wait_list.size(),
+                                           wait_list.data(),
+                                           &read_event);
+            if(err_code != CL_SUCCESS)
+                break;
+            if(event)
+                clReleaseEvent(event);
+            event = read_event;
+        }
+    }
+    release_events();
     if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure receiving the variable \"" << var_name
-            << "\" from server." << std::endl;
-        LOG(L_ERROR, msg.str());
+        if(event){
+            clWaitForEvents(1, &event);
+            clReleaseEvent(event);
+        }
+        for(i = 0; i < vars.size(); i++)
+            _staging->release(ptr);
+        LOG(L_ERROR, "Failure receiving the variables from server.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         return NULL;
     }
 
+    ptrs.clear();
+    for(i = 0; i < vars.size(); i++)
+        ptrs.push_back((char*)ptr + host_offsets.at(i));
+    if(quants)
+        *quants = q;
     return event;
 }
 
@@ -821,6 +1374,29 @@ void CalcServer::setupDevices()
     // Store the selected ones
     _device = _devices[_sim_data.settings.device_id];
     _command_queue = _command_queues[_sim_data.settings.device_id];
+    // Create the in-order command queues for the concurrent scheduler
+    for(i = 0; i < _sim_data.settings.queues; i++) {
+        cl_command_queue queue = clCreateCommandQueue(_context,
+                                                      _device,
+                                                      0,
+                                                      &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::ostringstream msg;
+            msg << "Failure generating the scheduler command queue number "
+                << i << "." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        _queues.push_back(queue);
+        _queues_tail.push_back(NULL);
+    }
+    if(_queues.size()){
+        std::ostringstream msg;
+        msg << "Concurrent scheduler with " << _queues.size()
+            << " command queues" << std::endl;
+        LOG(L_INFO, msg.str());
+    }
 }
 
 void CalcServer::setup()
@@ -920,6 +1496,14 @@ void CalcServer::setup()
     for(auto tool : _tools){
         tool->setup();
     }
+
+    if(_program_cache->enabled()){
+        std::ostringstream msg;
+        msg << "OpenCL programs cache: " << _program_cache->hits()
+            << " hits, " << _program_cache->misses() << " misses"
+            << std::endl;
+        LOG(L_INFO, msg.str());
+    }
 }
 
 }}  // namespace
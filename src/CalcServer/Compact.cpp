@@ -0,0 +1,420 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Compacted lists of the array elements meeting a condition.
+ * (See Aqua::CalcServer::Compact for details)
+ * @note Hardcoded versions of the files CalcServer/Compact.cl.in and
+ * CalcServer/Compact.hcl.in are internally included as a text array.
+ */
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+#include <CalcServer/Compact.h>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#include "CalcServer/Compact.hcl"
+#include "CalcServer/Compact.cl"
+#endif
+std::string COMPACT_INC = xxd2string(Compact_hcl_in, Compact_hcl_in_len);
+std::string COMPACT_SRC = xxd2string(Compact_cl_in, Compact_cl_in_len);
+
+#ifndef COMPACT_MAX_LOCALSIZE
+    #define COMPACT_MAX_LOCALSIZE 256
+#endif // COMPACT_MAX_LOCALSIZE
+
+Compact::Compact(const std::string name,
+                 const std::string input_name,
+                 const std::string output_name,
+                 const std::string n_name,
+                 const std::string condition,
+                 bool once)
+    : Tool(name, once)
+    , _input_name(input_name)
+    , _output_name(output_name)
+    , _n_name(n_name)
+    , _condition(condition)
+    , _input_var(NULL)
+    , _output_var(NULL)
+    , _n_var(NULL)
+    , _n(0)
+    , _n_groups(0)
+    , _counts_mem(NULL)
+    , _count(NULL)
+    , _scan(NULL)
+    , _compact(NULL)
+    , _local_work_size(0)
+    , _global_work_size(0)
+{
+}
+
+Compact::~Compact()
+{
+    if(_count) clReleaseKernel(_count); _count=NULL;
+    if(_scan) clReleaseKernel(_scan); _scan=NULL;
+    if(_compact) clReleaseKernel(_compact); _compact=NULL;
+    if(_counts_mem) clReleaseMemObject(_counts_mem); _counts_mem=NULL;
+}
+
+void Compact::setup()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    Tool::setup();
+    variables();
+
+    // Setup the kernels. The value of each element is exposed to the
+    // condition with the name of the input array
+    std::string type = trimCopy(_input_var->type());
+    type.pop_back();
+    type = trimCopy(type);
+    if(!type.compare("unsigned int"))
+        type = "uint";
+    std::ostringstream source;
+    source << COMPACT_INC;
+    source << "#define T " << type << std::endl;
+    source << "#define COMPACT_LOAD const T " << _input_name
+           << " = input[k];" << std::endl;
+    source << "#define COMPACT_CONDITION " << _condition << std::endl;
+    source << COMPACT_SRC;
+    compile(source.str());
+
+    // The local work size shall be a power of 2, to carry out the reductions
+    size_t max_local_size = COMPACT_MAX_LOCALSIZE;
+    for(auto kernel : {_count, _compact}){
+        size_t local_size;
+        err_code = clGetKernelWorkGroupInfo(kernel,
+                                            C->device(),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            &local_size,
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure querying the work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        max_local_size = min(max_local_size, local_size);
+    }
+    _local_work_size = 1;
+    while(2 * _local_work_size <= max_local_size)
+        _local_work_size *= 2;
+    if(_local_work_size < __CL_MIN_LOCALSIZE__){
+        LOG(L_ERROR, "insufficient local memory.\n");
+        std::stringstream msg;
+        msg << "\t" << _local_work_size
+            << " local work group size with __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+    _global_work_size = roundUp(_n, _local_work_size);
+    _n_groups = _global_work_size / _local_work_size;
+
+    // The last component of the counts is the total number of elements
+    _counts_mem = clCreateBuffer(C->context(),
+                                 CL_MEM_READ_WRITE,
+                                 (_n_groups + 1) * sizeof(cl_uint),
+                                 NULL,
+                                 &err_code);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure allocating device memory in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+    allocatedMemory((_n_groups + 1) * sizeof(cl_uint));
+
+    setArg(_count, 1, sizeof(cl_mem), &_counts_mem);
+    setArg(_count, 2, sizeof(unsigned int), &_n);
+    setArg(_count, 3, _local_work_size * sizeof(cl_uint), NULL);
+    setArg(_scan, 0, sizeof(cl_mem), &_counts_mem);
+    setArg(_scan, 1, sizeof(unsigned int), &_n_groups);
+    setArg(_compact, 2, sizeof(cl_mem), &_counts_mem);
+    setArg(_compact, 3, sizeof(unsigned int), &_n);
+    setArg(_compact, 4, _local_work_size * sizeof(cl_uint), NULL);
+}
+
+cl_event Compact::_execute(const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    cl_event event, event_wait;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    // The arrays may have been swapped (e.g. by the sorting)
+    setArg(_count, 0, _input_var->typesize(), _input_var->get());
+    setArg(_compact, 0, _input_var->typesize(), _input_var->get());
+    setArg(_compact, 1, _output_var->typesize(), _output_var->get());
+
+    event = enqueue(_count, _global_work_size, _local_work_size, events);
+    event_wait = event;
+    event = enqueue(_scan, 1, 1, {event_wait});
+    clReleaseEvent(event_wait);
+    event_wait = event;
+    event = enqueue(_compact,
+                    _global_work_size,
+                    _local_work_size,
+                    {event_wait});
+    clReleaseEvent(event_wait);
+    event_wait = event;
+
+    // Get back the number of listed elements. It is asynchronously read, such
+    // that the host is not blocked until the value is actually required
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _counts_mem,
+                                   CL_FALSE,
+                                   _n_groups * sizeof(cl_uint),
+                                   sizeof(cl_uint),
+                                   _n_var->get(),
+                                   1,
+                                   &event_wait,
+                                   &event);
+    clReleaseEvent(event_wait);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure reading back the number of elements within the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    // The output array is handled as a regular dependency. The scalar variable
+    // is marked as pending, and populated just when the tokenizer requires it
+    _n_var->setEvent(event);
+    vars->populateDeferred(_n_var);
+
+    return event;
+}
+
+void Compact::variables()
+{
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+
+    const std::string names[3] = {_input_name, _output_name, _n_name};
+    for(auto var_name : names){
+        if(!vars->get(var_name)){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" is asking the undeclared variable \""
+                << var_name << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+    }
+
+    InputOutput::Variable *var = vars->get(_input_name);
+    if(var->type().compare("int*") && var->type().compare("unsigned int*")){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the input variable \"" << _input_name
+            << "\", which has an invalid type" << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t\"int*\" or \"unsigned int*\" was expected, but \""
+            << var->type() << "\" was found." << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+    _input_var = (InputOutput::ArrayVariable*)var;
+    _n = _input_var->size() / vars->typeToBytes(_input_var->type());
+
+    var = vars->get(_output_name);
+    if(var->type().compare("unsigned int*")){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the output variable \"" << _output_name
+            << "\", which has an invalid type" << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t\"unsigned int*\" was expected, but \""
+            << var->type() << "\" was found." << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+    _output_var = (InputOutput::ArrayVariable*)var;
+    if(_output_var->size() < _n * sizeof(cl_uint)){
+        std::stringstream msg;
+        msg << "The array \"" << _output_name
+            << "\" is too short for the tool \"" << name() << "\"."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << _n << " components are required, but "
+            << _output_var->size() / sizeof(cl_uint) << " were found"
+            << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid variable length");
+    }
+
+    var = vars->get(_n_name);
+    if(var->type().compare("unsigned int")){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the variable \"" << _n_name
+            << "\", which has an invalid type" << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t\"unsigned int\" was expected, but \""
+            << var->type() << "\" was found." << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+    _n_var = var;
+
+    // The scalar output variable event is internally handled by the tool
+    std::vector<InputOutput::Variable*> inputs = {_input_var};
+    setInputs(inputs);
+    std::vector<InputOutput::Variable*> deps = {_output_var};
+    setDependencies(deps);
+}
+
+void Compact::compile(const std::string source)
+{
+    cl_int err_code;
+    cl_program program;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream flags;
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG ";
+    #else
+        flags << " -DNDEBUG ";
+    #endif
+    flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D ";
+    #else
+        flags << " -DHAVE_2D ";
+    #endif
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
+        LOG(L_ERROR, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the source code\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log); log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    const char *names[3] = {"count", "scan", "compact"};
+    cl_kernel *kernels[3] = {&_count, &_scan, &_compact};
+    for(unsigned int i = 0; i < 3; i++){
+        *(kernels[i]) = clCreateKernel(program, names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the \"" << names[i] << "\" kernel."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    clReleaseProgram(program);
+}
+
+void Compact::setArg(cl_kernel kernel,
+                     cl_uint index,
+                     size_t size,
+                     const void* value)
+{
+    cl_int err_code = clSetKernelArg(kernel, index, size, value);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure sending the argument " << index
+            << " in the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+cl_event Compact::enqueue(cl_kernel kernel,
+                          size_t global_work_size,
+                          size_t local_work_size,
+                          const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      events.size(),
+                                      events.size() ? events.data() : NULL,
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+}}  // namespace
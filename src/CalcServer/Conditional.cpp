@@ -33,6 +33,7 @@ namespace Aqua{ namespace CalcServer{
 Conditional::Conditional(const std::string name, const std::string condition, bool once)
     : Tool(name, once)
     , _condition(condition)
+    , _expr(NULL)
     , _ending_tool(NULL)
     , _result(true)
 {
@@ -40,6 +41,7 @@ Conditional::Conditional(const std::string name, const std::string condition, bo
 
 Conditional::~Conditional()
 {
+    if(_expr) delete _expr; _expr = NULL;
 }
 
 void Conditional::setup()
@@ -77,6 +79,11 @@ void Conditional::setup()
     else
         _ending_tool = tools.at(i + 1);
 
+    _expr = new InputOutput::Expression(CalcServer::singleton()->variables(),
+                                        "int",
+                                        _condition,
+                                        "if_result");
+
     // Get the next tool in case the condition is fulfilled
     Tool::setup();
 }
@@ -91,21 +98,7 @@ Tool* Conditional::next_tool()
 cl_event Conditional::_execute(const std::vector<cl_event> events)
 {
     int result;
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
-
-    void *data = malloc(sizeof(int));
-    if(!data){
-        std::stringstream msg;
-        msg << "Failure allocating memory for the integer result" << std::endl;
-        LOG(L_ERROR, msg.str());
-        throw std::bad_alloc();
-    }
-
-    vars->solve("int", _condition, data, "if_result");
-
-    // Check the result
-    memcpy(&result, data, sizeof(int));
-    free(data);
+    _expr->solve(&result);
     _result = result != 0;
 
     return NULL;
@@ -0,0 +1,453 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Output particles filtering, carried out in the computational device.
+ * (See Aqua::CalcServer::Filter for details)
+ * @note Hardcoded versions of the files CalcServer/Filter.cl.in and
+ * CalcServer/Filter.hcl.in are internally included as a text array.
+ */
+
+#include <algorithm>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/Filter.h>
+#include <CalcServer.h>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#include "CalcServer/Filter.hcl"
+#include "CalcServer/Filter.cl"
+#endif
+std::string FILTER_INC = xxd2string(Filter_hcl_in, Filter_hcl_in_len);
+std::string FILTER_SRC = xxd2string(Filter_cl_in, Filter_cl_in_len);
+
+#ifndef FILTER_ALIGNMENT
+    #define FILTER_ALIGNMENT 128
+#endif // FILTER_ALIGNMENT
+
+#ifndef FILTER_MAX_LOCALSIZE
+    #define FILTER_MAX_LOCALSIZE 256
+#endif // FILTER_MAX_LOCALSIZE
+
+/** @brief Get the OpenCL name of a variable type
+ * @param var Array variable
+ * @return The OpenCL type name, without the asterisk
+ */
+static std::string clType(InputOutput::ArrayVariable *var)
+{
+    std::string t = trimCopy(var->type());
+    t.pop_back();  // Remove the asterisk
+    if(!t.compare("unsigned int"))
+        t = "uint";
+    return t;
+}
+
+Filter::Filter(const std::string name,
+               const std::string condition,
+               const std::vector<InputOutput::ArrayVariable*> vars,
+               const std::vector<std::string> condition_vars,
+               unsigned int n_out)
+    : _name(name)
+    , _condition(condition)
+    , _vars(vars)
+    , _condition_vars(condition_vars)
+    , _n_out(n_out)
+    , _flags_mem(NULL)
+    , _counts_mem(NULL)
+    , _n_alloc(0)
+    , _mark(NULL)
+    , _count(NULL)
+    , _scan(NULL)
+    , _compact(NULL)
+    , _local_work_size(0)
+{
+}
+
+Filter::~Filter()
+{
+    if(_mark) clReleaseKernel(_mark); _mark=NULL;
+    if(_count) clReleaseKernel(_count); _count=NULL;
+    if(_scan) clReleaseKernel(_scan); _scan=NULL;
+    if(_compact) clReleaseKernel(_compact); _compact=NULL;
+    if(_flags_mem) clReleaseMemObject(_flags_mem); _flags_mem=NULL;
+    if(_counts_mem) clReleaseMemObject(_counts_mem); _counts_mem=NULL;
+}
+
+void Filter::setup()
+{
+    std::ostringstream msg;
+    msg << "Loading the output filter \"" << _name << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    for(auto var_name : _condition_vars){
+        auto it = std::find_if(_vars.begin(), _vars.end(),
+            [&var_name](InputOutput::ArrayVariable *var){
+                return !var->name().compare(var_name);
+            });
+        if(it == _vars.end()){
+            std::stringstream msg;
+            msg << "The output filter \"" << _name
+                << "\" is asking the unavailable variable \""
+                << var_name << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+    }
+
+    setupOpenCL();
+}
+
+std::vector<size_t> Filter::offsets(unsigned int n) const
+{
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    for(unsigned int i = 0; i < _n_out; i++){
+        offsets.push_back(offset);
+        offset += InputOutput::Variables::typeToBytes(_vars.at(i)->type()) * n;
+        offset = ((offset + FILTER_ALIGNMENT - 1) / FILTER_ALIGNMENT) *
+                 FILTER_ALIGNMENT;
+    }
+    offsets.push_back(offset);
+    return offsets;
+}
+
+cl_event Filter::execute(cl_mem input,
+                         const std::vector<size_t> in_offsets,
+                         cl_mem output,
+                         unsigned int n,
+                         cl_event event_wait,
+                         unsigned int &m)
+{
+    unsigned int i;
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    allocate(n);
+    size_t global_work_size = roundUp(n, _local_work_size);
+    unsigned int n_groups = global_work_size / _local_work_size;
+    std::vector<size_t> out_offsets = offsets(n);
+
+    // Condition evaluation
+    setArg(_mark, 0, sizeof(cl_mem), &input);
+    setArg(_mark, 2, sizeof(unsigned int), &n);
+    for(i = 0; i < _vars.size(); i++){
+        cl_ulong offset = in_offsets.at(i);
+        setArg(_mark, 3 + i, sizeof(cl_ulong), &offset);
+    }
+    cl_event mark_event = enqueue(_mark,
+                                  global_work_size,
+                                  _local_work_size,
+                                  event_wait);
+
+    // Counting and scanning
+    setArg(_count, 2, sizeof(unsigned int), &n);
+    cl_event count_event = enqueue(_count,
+                                   global_work_size,
+                                   _local_work_size,
+                                   mark_event);
+    clReleaseEvent(mark_event);
+    setArg(_scan, 1, sizeof(unsigned int), &n_groups);
+    cl_event scan_event = enqueue(_scan, 1, 1, count_event);
+    clReleaseEvent(count_event);
+
+    // Compaction
+    setArg(_compact, 0, sizeof(cl_mem), &input);
+    setArg(_compact, 1, sizeof(cl_mem), &output);
+    setArg(_compact, 4, sizeof(unsigned int), &n);
+    for(i = 0; i < _n_out; i++){
+        cl_ulong offset = in_offsets.at(i);
+        setArg(_compact, 6 + 2 * i, sizeof(cl_ulong), &offset);
+        offset = out_offsets.at(i);
+        setArg(_compact, 7 + 2 * i, sizeof(cl_ulong), &offset);
+    }
+    cl_event event;
+    try {
+        event = enqueue(_compact,
+                        global_work_size,
+                        _local_work_size,
+                        scan_event);
+    } catch(std::runtime_error &e) {
+        clReleaseEvent(scan_event);
+        throw;
+    }
+
+    // Get the number of kept particles, while the compaction is carried out
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _counts_mem,
+                                   CL_TRUE,
+                                   n_groups * sizeof(cl_uint),
+                                   sizeof(cl_uint),
+                                   &m,
+                                   1,
+                                   &scan_event,
+                                   NULL);
+    clReleaseEvent(scan_event);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure reading the number of particles kept by the filter \""
+            << _name << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clReleaseEvent(event);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+void Filter::setupOpenCL()
+{
+    unsigned int i;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream source;
+    source << FILTER_INC;
+    source << "#define FILTER_MARK_ARGS";
+    for(i = 0; i < _vars.size(); i++){
+        source << " , ulong in" << i;
+    }
+    source << std::endl << "#define FILTER_LOAD";
+    for(i = 0; i < _vars.size(); i++){
+        if(std::find(_condition_vars.begin(),
+                     _condition_vars.end(),
+                     _vars.at(i)->name()) == _condition_vars.end())
+            continue;
+        std::string t = clType(_vars.at(i));
+        source << " const " << t << " " << _vars.at(i)->name()
+               << " = ((const __global " << t << "*)(input + in" << i
+               << "))[k];";
+    }
+    source << std::endl << "#define FILTER_CONDITION " << _condition;
+    source << std::endl << "#define FILTER_COMPACT_ARGS";
+    for(i = 0; i < _n_out; i++){
+        source << " , ulong in" << i << ", ulong out" << i;
+    }
+    source << std::endl << "#define FILTER_COMPACT";
+    for(i = 0; i < _n_out; i++){
+        std::string t = clType(_vars.at(i));
+        source << " ((__global " << t << "*)(output + out" << i
+               << "))[j] = ((const __global " << t << "*)(input + in" << i
+               << "))[k];";
+    }
+    source << std::endl << FILTER_SRC;
+
+    compile(source.str());
+
+    // The local work size shall be a power of 2, to carry out the reductions
+    size_t max_local_size = FILTER_MAX_LOCALSIZE;
+    for(auto kernel : {_mark, _count, _compact}){
+        size_t local_size;
+        cl_int err_code = clGetKernelWorkGroupInfo(kernel,
+                                                   C->device(),
+                                                   CL_KERNEL_WORK_GROUP_SIZE,
+                                                   sizeof(size_t),
+                                                   &local_size,
+                                                   NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure querying the work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        max_local_size = min(max_local_size, local_size);
+    }
+    _local_work_size = 1;
+    while(2 * _local_work_size <= max_local_size)
+        _local_work_size *= 2;
+    if(_local_work_size < __CL_MIN_LOCALSIZE__){
+        std::stringstream msg;
+        LOG(L_ERROR, "Filter cannot be performed.\n");
+        msg << "\t" << _local_work_size
+            << " elements can be executed, but __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+
+    setArg(_count, 3, _local_work_size * sizeof(cl_uint), NULL);
+    setArg(_compact, 5, _local_work_size * sizeof(cl_uint), NULL);
+}
+
+void Filter::compile(const std::string source)
+{
+    cl_int err_code;
+    cl_program program;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream flags;
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG ";
+    #else
+        flags << " -DNDEBUG ";
+    #endif
+    flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D";
+    #else
+        flags << " -DHAVE_2D";
+    #endif
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
+        LOG(L_ERROR, "Failure creating the OpenCL program\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the OpenCL script\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log); log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+
+    const char* names[4] = {"mark", "count", "scan", "compact"};
+    cl_kernel* kernels[4] = {&_mark, &_count, &_scan, &_compact};
+    for(unsigned int i = 0; i < 4; i++){
+        *(kernels[i]) = clCreateKernel(program, names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the OpenCL kernel \"" << names[i]
+                << "\"" << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    clReleaseProgram(program);
+}
+
+void Filter::allocate(unsigned int n)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    if(n <= _n_alloc)
+        return;
+
+    if(_flags_mem) clReleaseMemObject(_flags_mem); _flags_mem=NULL;
+    if(_counts_mem) clReleaseMemObject(_counts_mem); _counts_mem=NULL;
+    _n_alloc = 0;
+
+    unsigned int n_groups = roundUp(n, _local_work_size) / _local_work_size;
+    _flags_mem = clCreateBuffer(C->context(),
+                                CL_MEM_READ_WRITE,
+                                n * sizeof(cl_uint),
+                                NULL,
+                                &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Buffer memory allocation failure.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    _counts_mem = clCreateBuffer(C->context(),
+                                 CL_MEM_READ_WRITE,
+                                 (n_groups + 1) * sizeof(cl_uint),
+                                 NULL,
+                                 &err_code);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Buffer memory allocation failure.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    _n_alloc = n;
+
+    setArg(_mark, 1, sizeof(cl_mem), &_flags_mem);
+    setArg(_count, 0, sizeof(cl_mem), &_flags_mem);
+    setArg(_count, 1, sizeof(cl_mem), &_counts_mem);
+    setArg(_scan, 0, sizeof(cl_mem), &_counts_mem);
+    setArg(_compact, 2, sizeof(cl_mem), &_flags_mem);
+    setArg(_compact, 3, sizeof(cl_mem), &_counts_mem);
+}
+
+void Filter::setArg(cl_kernel kernel,
+                    cl_uint index,
+                    size_t size,
+                    const void* value)
+{
+    cl_int err_code = clSetKernelArg(kernel, index, size, value);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure sending the argument " << index
+            << " to the output filter \"" << _name << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+cl_event Filter::enqueue(cl_kernel kernel,
+                         size_t global_work_size,
+                         size_t local_work_size,
+                         cl_event event_wait)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      event_wait ? 1 : 0,
+                                      event_wait ? &event_wait : NULL,
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing the output filter \"" << _name
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+}}  // namespace
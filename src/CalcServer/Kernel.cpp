@@ -21,8 +21,8 @@
  * (see Aqua::CalcServer::Kernel for details)
  */
 
-#include <clang-c/Index.h>
-#include <clang-c/Platform.h>
+#include <algorithm>
+
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer.h>
@@ -39,6 +39,7 @@ Kernel::Kernel(const std::string tool_name,
     , _path(kernel_path)
     , _entry_point(entry_point)
     , _n(n)
+    , _n_expr(NULL)
     , _kernel(NULL)
     , _work_group_size(0)
     , _global_work_size(0)
@@ -48,6 +49,7 @@ Kernel::Kernel(const std::string tool_name,
 Kernel::~Kernel()
 {
     if(_kernel) clReleaseKernel(_kernel); _kernel=NULL;
+    if(_n_expr) delete _n_expr; _n_expr=NULL;
 
     for(auto it = _var_values.begin(); it < _var_values.end(); it++){
         free(*it);
@@ -65,21 +67,61 @@ void Kernel::setup()
     compile(_entry_point);
     variables(_entry_point);
     setVariables();
+    _n_expr = new InputOutput::Expression(
+        CalcServer::singleton()->variables(), "unsigned int", _n);
     computeGlobalWorkSize();
 }
 
 cl_event Kernel::_execute(const std::vector<cl_event> events)
 {
-    cl_int err_code;
-    cl_event event;
-    CalcServer *C = CalcServer::singleton();
+    capture();
+    return _replay(events);
+}
 
+void Kernel::capture()
+{
     setVariables();
     computeGlobalWorkSize();
+}
+
+const std::vector<InputOutput::Variable*> Kernel::bindings()
+{
+    std::vector<InputOutput::Variable*> vars = _var_pointers;
+    for(auto var : _n_expr->variables()) {
+        if(std::find(vars.begin(), vars.end(), var) == vars.end())
+            vars.push_back(var);
+    }
+    return vars;
+}
+
+cl_event Kernel::_replay(const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
 
     cl_uint num_events_in_wait_list = events.size();
     const cl_event *event_wait_list = events.size() ? events.data() : NULL;
 
+    // The number of threads may be null, e.g. when the kernel is launched
+    // over an empty list generated by Aqua::CalcServer::Compact. Null global
+    // sizes are not accepted by OpenCL 1.2, so a marker is used instead
+    if(!_global_work_size){
+        err_code = clEnqueueMarkerWithWaitList(C->command_queue(),
+                                               num_events_in_wait_list,
+                                               event_wait_list,
+                                               &event);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure skipping the tool \"" <<
+                   name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        return event;
+    }
+
     err_code = clEnqueueNDRangeKernel(C->command_queue(),
                                       _kernel,
                                       1,
@@ -110,7 +152,6 @@ void Kernel::compile(const std::string entry_point,
     cl_kernel kernel;
     std::ostringstream source;
     std::ostringstream flags;
-    size_t source_length = 0;
     cl_int err_code = CL_SUCCESS;
     size_t work_group_size = 0;
     CalcServer *C = CalcServer::singleton();
@@ -154,21 +195,14 @@ void Kernel::compile(const std::string entry_point,
 
     // Try to compile without using local memory
     LOG(L_INFO, "Compiling without local memory... ");
-    source_length = source.str().size();
     std::string source_str = source.str();
-    const char *source_cstr = source_str.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    program = C->program_cache()->build(source_str, flags.str(), &err_code);
+    if(!program) {
         LOG0(L_DEBUG, "FAIL\n");
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG0(L_DEBUG, "FAIL\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -236,20 +270,15 @@ void Kernel::compile(const std::string entry_point,
 
     // Try to compile with local memory
     LOG(L_INFO, "Compiling with local memory... ");
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
+    program = C->program_cache()->build(source_str, flags.str(), &err_code);
+    if(!program) {
         LOG0(L_DEBUG, "FAIL\n");
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         LOG(L_INFO, "Falling back to no local memory usage.\n");
         return;
     }
-    flags << " -DLOCAL_MEM_SIZE=" << work_group_size;
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG0(L_DEBUG, "FAIL\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -344,100 +373,41 @@ void Kernel::compile(const std::string entry_point,
     _kernel = kernel;
 }
 
-/** @brief Main traverse method, which will parse all tokens except functions
- * declarations.
- * @param cursor the cursor whose child may be visited. All kinds of cursors can
- * be visited, including invalid cursors (which, by definition, have no
- * children).
- * @param parent the visitor function that will be invoked for each child of
- * parent.
- * @param client_data pointer data supplied by the client, which will be passed
- * to the visitor each time it is invoked.
- * @return CXChildVisit_Continue if a function declaration is found,
- * CXChildVisit_Recurse otherwise.
- */
-CXChildVisitResult cursorVisitor(CXCursor cursor,
-                                 CXCursor parent,
-                                 CXClientData client_data);
-
-/** Method traverse method, which will parse the input arguments.
- * @param cursor the cursor whose child may be visited. All kinds of cursors can
- * be visited, including invalid cursors (which, by definition, have no
- * children).
- * @param parent the visitor function that will be invoked for each child of
- * parent.
- * @param client_data pointer data supplied by the client, which will be passed
- * to the visitor each time it is invoked.
- * @return CXChildVisit_Continue.
- */
-CXChildVisitResult functionDeclVisitor(CXCursor cursor,
-                                       CXCursor parent,
-                                       CXClientData client_data);
-
-/** @struct clientData
- * @brief Data structure to store the variables requested and a flag
- * to know if the entry point has been found.
- */
-struct clientData{
-    /// Entry point
-    std::string entry_point;
-    /// Number of instances of the entry point found.
-    unsigned int entry_points;
-    /// List of required variables
-    std::vector<std::string> var_names;
-};
-
 void Kernel::variables(const std::string entry_point)
 {
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
-
-    CXIndex index = clang_createIndex(0, 0);
-    if(index == 0){
-        LOG(L_ERROR, "Failure creating parser index.\n");
-        throw std::runtime_error("clang initialization failure");
-    }
-
-    int argc = 2;
-    const char* argv[2] = {"Kernel", _path.c_str()};
-    CXTranslationUnit translation_unit = clang_parseTranslationUnit(
-        index,
-        0,
-        argv,
-        argc,
-        NULL,
-        0,
-        CXTranslationUnit_None);
-    if(translation_unit == 0){
-        LOG(L_ERROR, "Failure parsing the source code.\n");
-        throw std::runtime_error("clang parsing error");
-    }
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
 
-    CXCursor root_cursor = clang_getTranslationUnitCursor(translation_unit);
-    struct clientData client_data;
-    client_data.entry_point = entry_point;
-    client_data.entry_points = 0;
-    client_data.var_names = _var_names;
-    clang_visitChildren(root_cursor, *cursorVisitor, &client_data);
-    if(client_data.entry_points == 0){
+    std::vector<std::string> var_names;
+    std::vector<bool> read_only;
+    unsigned int entry_points = C->signatures()->get(_path,
+                                                     entry_point,
+                                                     var_names,
+                                                     read_only);
+    if(entry_points == 0){
         std::stringstream msg;
         msg << "The entry point \"" << entry_point
             << "\" cannot be found." << std::endl;
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid entry point");
     }
-    if(client_data.entry_points != 1){
+    if(entry_points != 1){
         std::stringstream msg;
         msg << "The entry point \"" << entry_point
-            << "\" has been found " << client_data.entry_points
+            << "\" has been found " << entry_points
             << "times." << std::endl;
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid entry point");
     }
-    _var_names = client_data.var_names;
+    _var_names = var_names;
+    _var_pointers.clear();
     // Retain just the array variables as dependencies, provided that scalar
-    // variables are synced when passed using clSetKernelArg()
-    std::vector<InputOutput::Variable*> deps;
-    for(auto var_name : _var_names) {
+    // variables are synced when passed using clSetKernelArg(). The read-only
+    // arrays are considered as inputs, so they can be simultaneously read by
+    // several tools
+    std::vector<InputOutput::Variable*> deps, inputs;
+    for(unsigned int i = 0; i < _var_names.size(); i++) {
+        const std::string var_name = _var_names.at(i);
         InputOutput::Variable *var = vars->get(var_name);
         if(!var){
             std::stringstream msg;
@@ -447,67 +417,31 @@ void Kernel::variables(const std::string entry_point)
             LOG(L_ERROR, msg.str());
             throw std::runtime_error("Invalid variable");
         }
-        if(var->isArray())
+        _var_pointers.push_back(var);
+        if(!var->isArray())
+            continue;
+        if(read_only.at(i))
+            inputs.push_back(var);
+        else
             deps.push_back(var);
     }
     setDependencies(deps);
+    setInputs(inputs);
     
     for(unsigned int i = 0; i < _var_names.size(); i++){
         _var_values.push_back(NULL);
     }
-
-    clang_disposeTranslationUnit(translation_unit);
-    clang_disposeIndex(index);
-}
-
-CXChildVisitResult cursorVisitor(CXCursor cursor,
-                                 CXCursor parent,
-                                 CXClientData client_data)
-{
-    struct clientData *data = (struct clientData *)client_data;
-    CXCursorKind kind = clang_getCursorKind(cursor);
-    CXString name = clang_getCursorSpelling(cursor);
-    if (kind == CXCursor_FunctionDecl ||
-        kind == CXCursor_ObjCInstanceMethodDecl)
-    {
-        if(!data->entry_point.compare(clang_getCString(name))){
-            data->entry_points++;
-            clang_visitChildren(cursor, *functionDeclVisitor, client_data);
-        }
-        return CXChildVisit_Continue;
-    }
-    return CXChildVisit_Recurse;
-}
-
-CXChildVisitResult functionDeclVisitor(CXCursor cursor,
-                                       CXCursor parent,
-                                       CXClientData client_data)
-{
-    struct clientData *data = (struct clientData *)client_data;
-    CXCursorKind kind = clang_getCursorKind(cursor);
-    if (kind == CXCursor_ParmDecl){
-        CXString name = clang_getCursorSpelling(cursor);
-        data->var_names.push_back(clang_getCString(name));
-    }
-    return CXChildVisit_Continue;
 }
 
 void Kernel::setVariables()
 {
     unsigned int i;
     cl_int err_code;
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
+    // The variables have been already resolved by variables(), so the
+    // expensive lookup by name is not required anymore
     for(i = 0; i < _var_names.size(); i++){
-        InputOutput::Variable *var = vars->get(_var_names.at(i));
-        if(!var){
-            std::stringstream msg;
-            msg << "The tool \"" << name()
-                << "\" is asking the undeclared variable \""
-                << _var_names.at(i) << "\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            throw std::runtime_error("Invalid variable");
-        }
+        InputOutput::Variable *var = _var_pointers.at(i);
         if(_var_values.at(i) == NULL){
             _var_values.at(i) = malloc(var->typesize());
         }
@@ -538,9 +472,8 @@ void Kernel::computeGlobalWorkSize()
         LOG(L_ERROR, "Work group size must be greater than 0.\n");
         throw std::runtime_error("Null work group size");
     }
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
     try {
-        vars->solve("unsigned int", _n, &N);
+        _n_expr->solve(&N);
     } catch(...) {
         LOG(L_ERROR, "Failure evaluating the number of threads.\n");
         throw std::runtime_error("Invalid number of threads");
@@ -41,10 +41,19 @@ std::string LINKLIST_SRC = xxd2string(LinkList_cl_in, LinkList_cl_in_len);
 
 LinkList::LinkList(const std::string tool_name,
                    const std::string input,
+                   bool incremental,
+                   float threshold,
+                   const std::string ordering,
+                   bool sparse,
                    bool once)
     : Tool(tool_name, once)
     , _input_name(input)
     , _cell_length(0.f)
+    , _incremental(incremental)
+    , _threshold(threshold)
+    , _ordering(toLowerCopy(ordering))
+    , _sparse(sparse)
+    , _n_hash(0)
     , _min_pos(NULL)
     , _max_pos(NULL)
     , _ihoc(NULL)
@@ -56,7 +65,21 @@ LinkList::LinkList(const std::string tool_name,
     , _ll(NULL)
     , _ll_lws(0)
     , _ll_gws(0)
+    , _disorder(NULL)
+    , _disorder_lws(0)
+    , _disorder_mem(NULL)
+    , _init_perms(NULL)
+    , _init_perms_lws(0)
+    , _sort_blocks(NULL)
+    , _sort_blocks_lws(0)
+    , _inv_perms(NULL)
+    , _inv_perms_lws(0)
+    , _linear_cell(NULL)
+    , _linear_cell_lws(0)
 {
+    // Force the full sorting in the first execution
+    _prev_n_cells.x = 0; _prev_n_cells.y = 0;
+    _prev_n_cells.z = 0; _prev_n_cells.w = 0;
     std::stringstream min_pos_name;
     min_pos_name << tool_name << "->Min. Pos.";
     std::string min_pos_op = "c.x = (a.x < b.x) ? a.x : b.x;\nc.y = (a.y < b.y) ? a.y : b.y;\n#ifdef HAVE_3D\nc.z = (a.z < b.z) ? a.z : b.z;\nc.w = 0.f;\n#endif\n";
@@ -86,6 +109,12 @@ LinkList::~LinkList()
     if(_ihoc) clReleaseKernel(_ihoc); _ihoc=NULL;
     if(_icell) clReleaseKernel(_icell); _icell=NULL;
     if(_ll) clReleaseKernel(_ll); _ll=NULL;
+    if(_disorder) clReleaseKernel(_disorder); _disorder=NULL;
+    if(_init_perms) clReleaseKernel(_init_perms); _init_perms=NULL;
+    if(_sort_blocks) clReleaseKernel(_sort_blocks); _sort_blocks=NULL;
+    if(_inv_perms) clReleaseKernel(_inv_perms); _inv_perms=NULL;
+    if(_linear_cell) clReleaseKernel(_linear_cell); _linear_cell=NULL;
+    if(_disorder_mem) clReleaseMemObject(_disorder_mem); _disorder_mem=NULL;
     for(auto arg : _ihoc_args){
         free(arg);
     }
@@ -102,7 +131,8 @@ LinkList::~LinkList()
 
 void LinkList::setup()
 {
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
 
     std::ostringstream msg;
     msg << "Loading the tool \"" << name() << "\"..." << std::endl;
@@ -110,6 +140,38 @@ void LinkList::setup()
 
     Tool::setup();
 
+    if(_ordering.compare("linear") &&
+       _ordering.compare("morton") &&
+       _ordering.compare("hilbert")){
+        std::stringstream msg;
+        msg << "Unknown cells ordering \"" << _ordering << "\" in the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "\tValid orderings are \"linear\", \"morton\" and \"hilbert\"\n");
+        throw std::runtime_error("Invalid cells ordering");
+    }
+
+    // The kernels traversing the cells shall be aware of the sparse storage
+    std::vector<std::string> defs = C->definitions();
+    const bool defined = std::find(defs.begin(), defs.end(),
+                                   "-DSPARSE_CELLS") != defs.end();
+    if(_sparse != defined){
+        std::stringstream msg;
+        msg << "Mismatching cells storage in the tool \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        if(_sparse)
+            msg << "\tThe sparse cells require the SPARSE_CELLS definition";
+        else
+            msg << "\tSPARSE_CELLS is defined, but the cells are dense";
+        msg << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid cells storage");
+    }
+    unsigned int N = *(unsigned int*)vars->get("N")->get();
+    _n_hash = nextPowerOf2(2 * N);
+
     // Setup the reduction tools
     _min_pos->setup();
     _max_pos->setup();
@@ -121,6 +183,10 @@ void LinkList::setup()
 
     // Setup the kernels
     setupOpenCL();
+    if(_incremental)
+        setupIncremental();
+    if(_ordering.compare("linear"))
+        setupOrdering();
 
     // Setup the radix-sort
     _sort->setup();
@@ -190,8 +256,20 @@ cl_event LinkList::_execute(const std::vector<cl_event> events_prior)
         throw std::runtime_error("OpenCL execution error");
     }
 
-    // Sort the particles from the cells
-    _sort->execute();
+    // Sort the particles from the cells. If the grid has not changed, the
+    // keys are probably almost sorted, so the incremental mode can be tried
+    bool sorted = false;
+    if(_incremental &&
+       (_n_cells.x == _prev_n_cells.x) &&
+       (_n_cells.y == _prev_n_cells.y) &&
+       (_n_cells.z == _prev_n_cells.z)){
+        sorted = sortIncremental();
+    }
+    if(!sorted)
+        _sort->execute();
+    _prev_n_cells = _n_cells;
+    if(_ordering.compare("linear"))
+        linearCells();
 
     // Now our transactional event is the one coming from sorting algorithm
     // Such a new event can be taken from the last dependency (see setup())
@@ -284,7 +362,7 @@ void LinkList::setupOpenCL()
         throw std::runtime_error("OpenCL error");
     }
     n_cells = *(uivec4*)vars->get("n_cells")->get();
-    _ihoc_gws = roundUp(n_cells.w, _ihoc_lws);
+    _ihoc_gws = roundUp(_sparse ? _n_hash : n_cells.w, _ihoc_lws);
     const char *_ihoc_vars[3] = {"ihoc", "N", "n_cells"};
     for(i = 0; i < 3; i++){
         err_code = clSetKernelArg(_ihoc,
@@ -409,19 +487,18 @@ void LinkList::compile(const std::string source)
     #else
         flags << " -DHAVE_2D ";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    if(_sparse)
+        flags << " -DSPARSE_CELLS ";
+    if(!_ordering.compare("morton"))
+        flags << " -DCELL_ORDERING_MORTON ";
+    else if(!_ordering.compare("hilbert"))
+        flags << " -DCELL_ORDERING_HILBERT ";
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -477,6 +554,33 @@ void LinkList::compile(const std::string source)
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
+    if(_incremental){
+        const char *names[4] = {"disorder", "initPermutations", "sortBlocks",
+                                "inversePermutations"};
+        cl_kernel *kernels[4] = {&_disorder, &_init_perms, &_sort_blocks,
+                                 &_inv_perms};
+        for(unsigned int i = 0; i < 4; i++){
+            *(kernels[i]) = clCreateKernel(program, names[i], &err_code);
+            if(err_code != CL_SUCCESS) {
+                std::stringstream msg;
+                msg << "Failure creating the \"" << names[i] << "\" kernel."
+                    << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                clReleaseProgram(program);
+                throw std::runtime_error("OpenCL error");
+            }
+        }
+    }
+    if(_ordering.compare("linear")){
+        _linear_cell = clCreateKernel(program, "linearCell", &err_code);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure creating the \"linearCell\" kernel.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
 
     clReleaseProgram(program);
 }
@@ -504,7 +608,49 @@ void LinkList::nCells()
     #else
         _n_cells.z = 1;
     #endif
+    // The last linear index is reserved for the particles out of bounds
+    const unsigned long long n_cells = (unsigned long long)_n_cells.x *
+                                       _n_cells.y * _n_cells.z;
+    if(n_cells >= 0xFFFFFFFFull){
+        std::stringstream msg;
+        msg << "Too many cells in the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << _n_cells.x << "x" << _n_cells.y << "x" << _n_cells.z
+            << " cells cannot be linearly indexed" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid number of cells");
+    }
     _n_cells.w = _n_cells.x * _n_cells.y * _n_cells.z;
+
+    if(!_ordering.compare("linear"))
+        return;
+
+    // The space-filling curves keys are bounded by the bits of the largest
+    // coordinate, and the particles out of bounds are placed after them
+    #ifdef HAVE_3D
+        const unsigned int dims = 3;
+        unsigned int n = std::max(std::max(_n_cells.x, _n_cells.y), _n_cells.z);
+    #else
+        const unsigned int dims = 2;
+        unsigned int n = std::max(_n_cells.x, _n_cells.y);
+    #endif
+    unsigned int bits;
+    for(bits = 0; (n - 1) >> bits; bits++);
+    if(dims * bits + 1 > 8 * sizeof(cl_uint)){
+        std::stringstream msg;
+        msg << "Too many cells for the \"" << _ordering
+            << "\" ordering in the tool \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << n << " cells found in a single direction, while "
+            << (1u << ((8 * sizeof(cl_uint) - 1) / dims))
+            << " is the maximum. Use the \"linear\" ordering instead"
+            << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid number of cells");
+    }
+    _sort->maxKey(1u << (dims * bits));
 }
 
 void LinkList::allocate()
@@ -529,11 +675,21 @@ void LinkList::allocate()
 
     n_cells = *(uivec4*)vars->get("n_cells")->get();
 
-    if(_n_cells.w <= n_cells.w){
+    if(_sparse){
+        // The sparse cells table is not depending on the number of cells, so
+        // it is just allocated the first time
+        vars->get("n_cells")->set(&_n_cells);
+        if(vars->get("ihoc")->size() >= 2 * _n_hash * sizeof(unsigned int))
+            return;
+    }
+    else if(_n_cells.w <= n_cells.w){
         n_cells.x = _n_cells.x;
         n_cells.y = _n_cells.y;
         n_cells.z = _n_cells.z;
         vars->get("n_cells")->set(&n_cells);
+        // The allocated cells are not necessarily the ones allocated by this
+        // tool, e.g. after resuming the simulation from a checkpoint
+        _ihoc_gws = roundUp(n_cells.w, _ihoc_lws);
         return;
     }
 
@@ -544,9 +700,10 @@ void LinkList::allocate()
     cl_mem mem = *(cl_mem*)ihoc_var->get();
     if(mem) clReleaseMemObject(mem); mem = NULL;
 
+    const unsigned int n_ihoc = _sparse ? 2 * _n_hash : _n_cells.w;
     mem = clCreateBuffer(C->context(),
                          CL_MEM_READ_WRITE,
-                         _n_cells.w * sizeof(unsigned int),
+                         n_ihoc * sizeof(unsigned int),
                          NULL,
                          &err_code);
     if(err_code != CL_SUCCESS){
@@ -560,7 +717,7 @@ void LinkList::allocate()
 
     vars->get("n_cells")->set(&_n_cells);
     ihoc_var->set(&mem);
-    _ihoc_gws = roundUp(_n_cells.w, _ihoc_lws);
+    _ihoc_gws = roundUp(_sparse ? _n_hash : _n_cells.w, _ihoc_lws);
 }
 
 void LinkList::setVariables()
@@ -637,4 +794,318 @@ void LinkList::setVariables()
     }
 }
 
+void LinkList::setupIncremental()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    const char *names[4] = {"disorder", "initPermutations", "sortBlocks",
+                            "inversePermutations"};
+    cl_kernel kernels[4] = {_disorder, _init_perms, _sort_blocks, _inv_perms};
+    size_t *lws[4] = {&_disorder_lws, &_init_perms_lws, &_sort_blocks_lws,
+                      &_inv_perms_lws};
+    for(unsigned int i = 0; i < 4; i++){
+        err_code = clGetKernelWorkGroupInfo(kernels[i],
+                                            C->device(),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            lws[i],
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure querying the work group size (\"" << names[i]
+                << "\")." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    // The blocks should be a power of 2, fitting in the local memory
+    cl_ulong local_mem;
+    err_code = clGetDeviceInfo(C->device(),
+                               CL_DEVICE_LOCAL_MEM_SIZE,
+                               sizeof(cl_ulong),
+                               &local_mem,
+                               NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure querying the available local memory.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(!isPowerOf2(_sort_blocks_lws)){
+        _sort_blocks_lws = nextPowerOf2(_sort_blocks_lws) / 2;
+    }
+    while(2 * _sort_blocks_lws * sizeof(cl_uint) > local_mem){
+        _sort_blocks_lws /= 2;
+    }
+    if(_sort_blocks_lws < __CL_MIN_LOCALSIZE__){
+        std::stringstream msg;
+        msg << "Insufficient local memory for the incremental mode of \""
+            << name() << "\"." << std::endl;
+        LOG(L_WARNING, msg.str());
+        LOG0(L_DEBUG, "\tThe full radix sort will be always used\n");
+        _incremental = false;
+        return;
+    }
+
+    _disorder_mem = clCreateBuffer(C->context(),
+                                   CL_MEM_READ_WRITE,
+                                   sizeof(cl_uint),
+                                   NULL,
+                                   &err_code);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure allocating device memory in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+    allocatedMemory(sizeof(cl_uint) + allocatedMemory());
+}
+
+unsigned int LinkList::disorder()
+{
+    cl_int err_code;
+    cl_event event, fill_event;
+    cl_uint zero = 0, n_disorder = 0;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    InputOutput::Variable *icell = vars->get("icell");
+    unsigned int n = *(unsigned int*)vars->get("n_radix")->get();
+
+    err_code = clEnqueueFillBuffer(C->command_queue(),
+                                   _disorder_mem,
+                                   &zero,
+                                   sizeof(cl_uint),
+                                   0,
+                                   sizeof(cl_uint),
+                                   0,
+                                   NULL,
+                                   &fill_event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure resetting the disorder counter in tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    event = enqueue(_disorder,
+                    {{icell->typesize(), icell->get()},
+                     {sizeof(cl_mem), &_disorder_mem},
+                     {sizeof(unsigned int), &n}},
+                    roundUp(n, (unsigned int)_disorder_lws),
+                    _disorder_lws,
+                    {icell->getEvent(), fill_event},
+                    "disorder");
+    clReleaseEvent(fill_event);
+
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _disorder_mem,
+                                   CL_TRUE,
+                                   0,
+                                   sizeof(cl_uint),
+                                   &n_disorder,
+                                   1,
+                                   &event,
+                                   NULL);
+    clReleaseEvent(event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure reading the disorder counter in tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return n_disorder;
+}
+
+bool LinkList::sortIncremental()
+{
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    InputOutput::Variable *icell = vars->get("icell");
+    InputOutput::Variable *perms = vars->get("id_unsorted");
+    InputOutput::Variable *inv_perms = vars->get("id_sorted");
+    unsigned int N = *(unsigned int*)vars->get("N")->get();
+    unsigned int n = *(unsigned int*)vars->get("n_radix")->get();
+
+    unsigned int n_disorder = disorder();
+    if(n_disorder > _threshold * N)
+        return false;
+
+    event = enqueue(_init_perms,
+                    {{perms->typesize(), perms->get()},
+                     {sizeof(unsigned int), &n}},
+                    roundUp(n, (unsigned int)_init_perms_lws),
+                    _init_perms_lws,
+                    {perms->getEvent()},
+                    "initPermutations");
+    perms->setEvent(event);
+    clReleaseEvent(event);
+
+    if(n_disorder){
+        // n_radix is a power of 2, so it is divisible by the blocks size
+        size_t lws = _sort_blocks_lws;
+        while(lws > n)
+            lws /= 2;
+        for(unsigned int pass = 0; pass < _LINKLIST_SORT_PASSES; pass++){
+            // Alternate the blocks, such that the keys can cross the blocks
+            // boundaries
+            const unsigned int offsets[2] = {0, (unsigned int)lws / 2};
+            for(auto offset : offsets){
+                if(offset && (n <= lws))
+                    continue;
+                event = enqueue(_sort_blocks,
+                                {{icell->typesize(), icell->get()},
+                                 {perms->typesize(), perms->get()},
+                                 {sizeof(unsigned int), &offset},
+                                 {sizeof(unsigned int), &n},
+                                 {lws * sizeof(cl_uint), nullptr},
+                                 {lws * sizeof(cl_uint), nullptr}},
+                                offset ? n - lws : n,
+                                lws,
+                                {icell->getEvent(), perms->getEvent()},
+                                "sortBlocks");
+                icell->setEvent(event);
+                perms->setEvent(event);
+                clReleaseEvent(event);
+            }
+        }
+
+        if(disorder()){
+            // The particles moved too much. Restore the keys, and let the
+            // radix sort do the work
+            event = enqueue(_icell,
+                            {},
+                            _icell_gws,
+                            _icell_lws,
+                            {icell->getEvent(),
+                             getDependencies().front()->getEvent()},
+                            "iCell");
+            icell->setEvent(event);
+            clReleaseEvent(event);
+            return false;
+        }
+    }
+
+    event = enqueue(_inv_perms,
+                    {{perms->typesize(), perms->get()},
+                     {inv_perms->typesize(), inv_perms->get()},
+                     {sizeof(unsigned int), &n}},
+                    roundUp(n, (unsigned int)_inv_perms_lws),
+                    _inv_perms_lws,
+                    {perms->getEvent(), inv_perms->getEvent()},
+                    "inversePermutations");
+    inv_perms->setEvent(event);
+    perms->addReaderEvent(event);
+    clReleaseEvent(event);
+
+    return true;
+}
+
+cl_event LinkList::enqueue(cl_kernel kernel,
+                           const std::vector<std::pair<size_t, const void*>> args,
+                           size_t gws,
+                           size_t lws,
+                           const std::vector<cl_event> events,
+                           const std::string kernel_name)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    for(unsigned int i = 0; i < args.size(); i++){
+        err_code = clSetKernelArg(kernel,
+                                  i,
+                                  args.at(i).first,
+                                  args.at(i).second);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure sending the argument " << i << " to \""
+                << kernel_name << "\" in tool \"" << name() << "\"."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &gws,
+                                      &lws,
+                                      events.size(),
+                                      events.data(),
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing \"" << kernel_name << "\" from tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+void LinkList::setupOrdering()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clGetKernelWorkGroupInfo(_linear_cell,
+                                        C->device(),
+                                        CL_KERNEL_WORK_GROUP_SIZE,
+                                        sizeof(size_t),
+                                        &_linear_cell_lws,
+                                        NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Failure querying the work group size (\"linearCell\").\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+void LinkList::linearCells()
+{
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    InputOutput::Variable *icell = vars->get("icell");
+    InputOutput::Variable *perms = vars->get("id_unsorted");
+    InputOutput::Variable *r = getDependencies().front();
+    const char *names[6] = {"N", "n_radix", "r_min", "support", "h",
+                            "n_cells"};
+    std::vector<std::pair<size_t, const void*>> args = {
+        {icell->typesize(), icell->get()},
+        {perms->typesize(), perms->get()},
+        {r->typesize(), r->get()}};
+    for(auto var_name : names){
+        InputOutput::Variable *var = vars->get(var_name);
+        args.push_back({var->typesize(), var->get()});
+    }
+    unsigned int n = *(unsigned int*)vars->get("n_radix")->get();
+
+    event = enqueue(_linear_cell,
+                    args,
+                    roundUp(n, (unsigned int)_linear_cell_lws),
+                    _linear_cell_lws,
+                    {icell->getEvent(), perms->getEvent(), r->getEvent()},
+                    "linearCell");
+    icell->setEvent(event);
+    perms->addReaderEvent(event);
+    r->addReaderEvent(event);
+    clReleaseEvent(event);
+}
+
 }}  // namespace
@@ -0,0 +1,546 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Verlet neighbours lists, built on top of the link-list.
+ * (See Aqua::CalcServer::NeighbourList for details)
+ * @note Hardcoded versions of the files CalcServer/NeighbourList.cl.in and
+ * CalcServer/NeighbourList.hcl.in are internally included as a text array.
+ */
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+#include <CalcServer/NeighbourList.h>
+#include <algorithm>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#include "CalcServer/NeighbourList.hcl"
+#include "CalcServer/NeighbourList.cl"
+#endif
+std::string NEIGHBOURLIST_INC = xxd2string(NeighbourList_hcl_in,
+                                           NeighbourList_hcl_in_len);
+std::string NEIGHBOURLIST_SRC = xxd2string(NeighbourList_cl_in,
+                                           NeighbourList_cl_in_len);
+
+
+NeighbourList::NeighbourList(const std::string tool_name,
+                             const std::string input,
+                             float skin,
+                             unsigned int max_neighs,
+                             bool once)
+    : Tool(tool_name, once)
+    , _input_name(input)
+    , _skin(skin)
+    , _max_neighs(max_neighs)
+    , _support(0.f)
+    , _built(false)
+    , _neighs_mem(NULL)
+    , _n_neighs_mem(NULL)
+    , _r_ref_mem(NULL)
+    , _r_ref_in_mem(NULL)
+    , _rebuild_mem(NULL)
+    , _overflow_mem(NULL)
+    , _overflow(0)
+    , _overflow_event(NULL)
+    , _permute(NULL)
+    , _displacement(NULL)
+    , _build(NULL)
+    , _lws(0)
+    , _gws(0)
+{
+}
+
+NeighbourList::~NeighbourList()
+{
+    if(_overflow_event) clWaitForEvents(1, &_overflow_event);
+    if(_overflow_event) clReleaseEvent(_overflow_event); _overflow_event=NULL;
+    if(_permute) clReleaseKernel(_permute); _permute=NULL;
+    if(_displacement) clReleaseKernel(_displacement); _displacement=NULL;
+    if(_build) clReleaseKernel(_build); _build=NULL;
+    if(_neighs_mem) clReleaseMemObject(_neighs_mem); _neighs_mem=NULL;
+    if(_n_neighs_mem) clReleaseMemObject(_n_neighs_mem); _n_neighs_mem=NULL;
+    if(_r_ref_mem) clReleaseMemObject(_r_ref_mem); _r_ref_mem=NULL;
+    if(_r_ref_in_mem) clReleaseMemObject(_r_ref_in_mem); _r_ref_in_mem=NULL;
+    if(_rebuild_mem) clReleaseMemObject(_rebuild_mem); _rebuild_mem=NULL;
+    if(_overflow_mem) clReleaseMemObject(_overflow_mem); _overflow_mem=NULL;
+}
+
+void NeighbourList::setup()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    Tool::setup();
+
+    if((_skin < 0.f) || (_skin > 1.f)){
+        std::stringstream msg;
+        msg << "Invalid skin " << _skin << " in the tool \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "\tIt should be in the interval [0, 1]\n");
+        throw std::runtime_error("Invalid skin");
+    }
+    if(!_max_neighs){
+        std::stringstream msg;
+        msg << "Null lists capacity in the tool \"" << name()
+            << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid max_neighs");
+    }
+
+    // Check the variables
+    if(!vars->get(_input_name)){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the undeclared variable \""
+            << _input_name << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable");
+    }
+    if(vars->get(_input_name)->type().compare("vec*")){
+        std::stringstream msg;
+        msg << "The tool \"" << name()
+            << "\" is asking the variable \"" << _input_name
+            << "\", which has an invalid type" << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t\"vec*\" was expected, but \""
+            << vars->get(_input_name)->type() << "\" was found." << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+    unsigned int N = *(unsigned int*)vars->get("N")->get();
+    const char *lists[2] = {"n_neighs", "neighs"};
+    const size_t lens[2] = {N, N * _max_neighs};
+    for(unsigned int i = 0; i < 2; i++){
+        InputOutput::Variable *var = vars->get(lists[i]);
+        if(!var || var->type().compare("unsigned int*")){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" requires the array \"" << lists[i]
+                << "\", of type \"unsigned int*\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        if(var->size() < lens[i] * sizeof(cl_uint)){
+            std::stringstream msg;
+            msg << "The array \"" << lists[i] << "\" is too short for the tool \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            msg << "\t" << lens[i] << " components are required, but "
+                << var->size() / sizeof(cl_uint) << " were found" << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Invalid variable length");
+        }
+    }
+
+    // Compute the kernel support
+    InputOutput::Variable *s = vars->get("support");
+    InputOutput::Variable *h = vars->get("h");
+    _support = *(float*)s->get() * *(float*)h->get();
+
+    // Setup the kernels
+    std::ostringstream source;
+    source << NEIGHBOURLIST_INC << NEIGHBOURLIST_SRC;
+    compile(source.str());
+
+    cl_kernel kernels[3] = {_permute, _displacement, _build};
+    _lws = 0;
+    for(auto kernel : kernels){
+        size_t lws;
+        err_code = clGetKernelWorkGroupInfo(kernel,
+                                            C->device(),
+                                            CL_KERNEL_WORK_GROUP_SIZE,
+                                            sizeof(size_t),
+                                            &lws,
+                                            NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure querying the work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        _lws = _lws ? std::min(_lws, lws) : lws;
+    }
+    if(_lws < __CL_MIN_LOCALSIZE__){
+        LOG(L_ERROR, "insufficient local memory.\n");
+        std::stringstream msg;
+        msg << "\t" << _lws
+            << " local work group size with __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+    _gws = roundUp(N, _lws);
+
+    allocate();
+
+    std::vector<std::string> deps = {"neighs", "n_neighs"};
+    setDependencies(deps);
+    std::vector<InputOutput::Variable*> inputs = {vars->get(_input_name),
+                                                  vars->get("id_sorted"),
+                                                  vars->get("icell"),
+                                                  vars->get("ihoc")};
+    setInputs(inputs);
+}
+
+cl_event NeighbourList::_execute(const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    cl_event event, event_wait;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+
+    checkOverflow();
+
+    InputOutput::Variable *neighs = vars->get("neighs");
+    InputOutput::Variable *n_neighs = vars->get("n_neighs");
+    InputOutput::Variable *r = vars->get(_input_name);
+    InputOutput::Variable *id_sorted = vars->get("id_sorted");
+    InputOutput::Variable *icell = vars->get("icell");
+    InputOutput::Variable *ihoc = vars->get("ihoc");
+    InputOutput::Variable *N = vars->get("N");
+    InputOutput::Variable *n_cells = vars->get("n_cells");
+
+    if(_built){
+        // Follow the particles sorting, swapping the lists by the scratch
+        // buffers, which are released by the readers of the previous lists
+        cl_mem neighs_in = *(cl_mem*)neighs->get();
+        cl_mem n_neighs_in = *(cl_mem*)n_neighs->get();
+        event_wait = enqueue(_permute,
+                             {{sizeof(cl_mem), &neighs_in},
+                              {sizeof(cl_mem), &_neighs_mem},
+                              {sizeof(cl_mem), &n_neighs_in},
+                              {sizeof(cl_mem), &_n_neighs_mem},
+                              {sizeof(cl_mem), &_r_ref_mem},
+                              {sizeof(cl_mem), &_r_ref_in_mem},
+                              {id_sorted->typesize(), id_sorted->get()},
+                              {N->typesize(), N->get()}},
+                             events,
+                             "permute");
+        neighs->set(&_neighs_mem);
+        n_neighs->set(&_n_neighs_mem);
+        _neighs_mem = neighs_in;
+        _n_neighs_mem = n_neighs_in;
+        std::swap(_r_ref_mem, _r_ref_in_mem);
+
+        // Check whether the lists are still valid
+        event = fill(_rebuild_mem, 0, {event_wait});
+        clReleaseEvent(event_wait);
+        event_wait = event;
+        float max_disp = 0.5f * _skin * _support;
+        event = enqueue(_displacement,
+                        {{sizeof(cl_mem), &_rebuild_mem},
+                         {r->typesize(), r->get()},
+                         {sizeof(cl_mem), &_r_ref_mem},
+                         {N->typesize(), N->get()},
+                         {sizeof(float), &max_disp}},
+                        {event_wait},
+                        "displacement");
+        clReleaseEvent(event_wait);
+        event_wait = event;
+    }
+    else{
+        event_wait = fill(_rebuild_mem, 1, events);
+    }
+
+    // Build the lists, if required. The rebuild flag is checked on the device,
+    // so we are not synchronizing here
+    float rc = (1.f + _skin) * _support;
+    int n_layers = (_skin > 0.f) ? 2 : 1;
+    event = enqueue(_build,
+                    {{neighs->typesize(), neighs->get()},
+                     {n_neighs->typesize(), n_neighs->get()},
+                     {sizeof(cl_mem), &_r_ref_mem},
+                     {sizeof(cl_mem), &_overflow_mem},
+                     {sizeof(cl_mem), &_rebuild_mem},
+                     {r->typesize(), r->get()},
+                     {icell->typesize(), icell->get()},
+                     {ihoc->typesize(), ihoc->get()},
+                     {N->typesize(), N->get()},
+                     {n_cells->typesize(), n_cells->get()},
+                     {sizeof(float), &rc},
+                     {sizeof(int), &n_layers},
+                     {sizeof(unsigned int), &_max_neighs}},
+                    {event_wait},
+                    "build");
+    clReleaseEvent(event_wait);
+    _built = true;
+
+    // Read the overflow counter, which is checked in the next execution
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _overflow_mem,
+                                   CL_FALSE,
+                                   0,
+                                   sizeof(cl_uint),
+                                   &_overflow,
+                                   1,
+                                   &event,
+                                   &_overflow_event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure reading the overflow counter in tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+void NeighbourList::compile(const std::string source)
+{
+    cl_int err_code;
+    cl_program program;
+    CalcServer *C = CalcServer::singleton();
+
+    std::ostringstream flags;
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG ";
+    #else
+        flags << " -DNDEBUG ";
+    #endif
+    flags << " -cl-mad-enable -cl-fast-relaxed-math";
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D ";
+    #else
+        flags << " -DHAVE_2D ";
+    #endif
+    // Follow the link-list cells storage
+    std::vector<std::string> defs = C->definitions();
+    if(std::find(defs.begin(), defs.end(), "-DSPARSE_CELLS") != defs.end())
+        flags << " -DSPARSE_CELLS ";
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
+        LOG(L_ERROR, "Failure creating the OpenCL program.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the source code\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log); log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+    const char *names[3] = {"permute", "displacement", "build"};
+    cl_kernel *kernels[3] = {&_permute, &_displacement, &_build};
+    for(unsigned int i = 0; i < 3; i++){
+        *(kernels[i]) = clCreateKernel(program, names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the \"" << names[i] << "\" kernel."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    clReleaseProgram(program);
+}
+
+void NeighbourList::allocate()
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    unsigned int N = *(unsigned int*)vars->get("N")->get();
+
+    // The scratch buffers should match the lists, which are swapped with them
+    const size_t sizes[6] = {vars->get("neighs")->size(),
+                             vars->get("n_neighs")->size(),
+                             N * sizeof(vec),
+                             N * sizeof(vec),
+                             sizeof(cl_uint),
+                             sizeof(cl_uint)};
+    cl_mem *mems[6] = {&_neighs_mem, &_n_neighs_mem, &_r_ref_mem,
+                       &_r_ref_in_mem, &_rebuild_mem, &_overflow_mem};
+    for(unsigned int i = 0; i < 6; i++){
+        *(mems[i]) = clCreateBuffer(C->context(),
+                                    CL_MEM_READ_WRITE,
+                                    sizes[i],
+                                    NULL,
+                                    &err_code);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure allocating device memory in the tool \"" <<
+                   name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL allocation error");
+        }
+        allocatedMemory(sizes[i] + allocatedMemory());
+    }
+
+    cl_event event = fill(_overflow_mem, 0, {});
+    err_code = clWaitForEvents(1, &event);
+    clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure resetting the overflow counter in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+}
+
+void NeighbourList::checkOverflow()
+{
+    if(!_overflow_event)
+        return;
+
+    cl_int err_code = clWaitForEvents(1, &_overflow_event);
+    clReleaseEvent(_overflow_event);
+    _overflow_event = NULL;
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure reading the overflow counter in the tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+    if(_overflow){
+        std::stringstream msg;
+        msg << "The neighbours lists of the tool \"" << name()
+            << "\" overflowed." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\t" << _overflow << " neighbours have been found, but "
+            << "max_neighs=" << _max_neighs << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Neighbours lists overflow");
+    }
+}
+
+cl_event NeighbourList::enqueue(
+    cl_kernel kernel,
+    const std::vector<std::pair<size_t, const void*>> args,
+    const std::vector<cl_event> events,
+    const std::string kernel_name)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    for(unsigned int i = 0; i < args.size(); i++){
+        err_code = clSetKernelArg(kernel,
+                                  i,
+                                  args.at(i).first,
+                                  args.at(i).second);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure sending the argument " << i << " to \""
+                << kernel_name << "\" in tool \"" << name() << "\"."
+                << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &_gws,
+                                      &_lws,
+                                      events.size(),
+                                      events.size() ? events.data() : NULL,
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing \"" << kernel_name << "\" from tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+cl_event NeighbourList::fill(cl_mem mem,
+                             cl_uint value,
+                             const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clEnqueueFillBuffer(C->command_queue(),
+                                   mem,
+                                   &value,
+                                   sizeof(cl_uint),
+                                   0,
+                                   sizeof(cl_uint),
+                                   events.size(),
+                                   events.size() ? events.data() : NULL,
+                                   &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure filling a buffer in tool \"" <<
+               name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+}}  // namespace
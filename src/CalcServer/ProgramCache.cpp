@@ -0,0 +1,311 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief On-disk cache of compiled OpenCL programs.
+ * (See Aqua::CalcServer::ProgramCache for details)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <algorithm>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+#include <CalcServer/ProgramCache.h>
+
+namespace Aqua{ namespace CalcServer{
+
+ProgramCache::ProgramCache(const std::string path,
+                           cl_context context,
+                           cl_platform_id platform,
+                           cl_device_id device)
+    : _path(path)
+    , _context(context)
+    , _device(device)
+    , _hits(0)
+    , _misses(0)
+{
+    if(!enabled())
+        return;
+
+    // Collect the platform and device identity, which shall be considered in
+    // the key to avoid reusing binaries compiled by other devices/drivers
+    char aux[1024];
+    std::ostringstream identity;
+    const cl_platform_info platform_params[] = {CL_PLATFORM_NAME,
+                                                CL_PLATFORM_VERSION};
+    for(auto param : platform_params) {
+        strcpy(aux, "");
+        clGetPlatformInfo(platform, param, sizeof(aux), aux, NULL);
+        identity << aux << ";";
+    }
+    const cl_device_info device_params[] = {CL_DEVICE_NAME,
+                                            CL_DEVICE_VENDOR,
+                                            CL_DEVICE_VERSION,
+                                            CL_DRIVER_VERSION};
+    for(auto param : device_params) {
+        strcpy(aux, "");
+        clGetDeviceInfo(device, param, sizeof(aux), aux, NULL);
+        identity << aux << ";";
+    }
+    _identity = identity.str();
+
+    if(!makeFolder(_path)){
+        std::ostringstream msg;
+        msg << "Failure creating the programs cache folder \"" << _path
+            << "\". The cache will be disabled" << std::endl;
+        LOG(L_WARNING, msg.str());
+        _path = "";
+        return;
+    }
+    std::ostringstream msg;
+    msg << "OpenCL programs cache at \"" << _path << "\"" << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+ProgramCache::~ProgramCache()
+{
+}
+
+cl_program ProgramCache::build(const std::string source,
+                               const std::string flags,
+                               cl_int *err_code)
+{
+    cl_program program = NULL;
+    std::string file_path = "";
+
+    if(enabled()) {
+        file_path = _path + "/" + key(source, flags) + ".bin";
+        program = load(file_path, flags);
+        if(program) {
+            _hits++;
+            *err_code = CL_SUCCESS;
+            return program;
+        }
+        _misses++;
+    }
+
+    size_t source_length = source.size();
+    const char *source_cstr = source.c_str();
+    program = clCreateProgramWithSource(_context,
+                                        1,
+                                        &source_cstr,
+                                        &source_length,
+                                        err_code);
+    if(*err_code != CL_SUCCESS)
+        return NULL;
+    *err_code = clBuildProgram(program, 0, NULL, flags.c_str(), NULL, NULL);
+    if((*err_code == CL_SUCCESS) && enabled())
+        store(file_path, program);
+    return program;
+}
+
+std::string ProgramCache::key(const std::string source,
+                              const std::string flags)
+{
+    // The user definitions are usually already part of the flags, but they
+    // are added anyway, so the embedded programs are invalidated as well
+    std::ostringstream definitions;
+    for(auto def : CalcServer::singleton()->definitions()) {
+        definitions << def << " ";
+    }
+
+    // The included files are not part of the source code, so they should be
+    // traced on the include folders set in the flags
+    std::vector<std::string> dirs;
+    std::istringstream flags_stream(flags);
+    std::string flag;
+    while(flags_stream >> flag) {
+        if(flag.compare(0, 2, "-I"))
+            continue;
+        if(flag.size() > 2)
+            dirs.push_back(flag.substr(2));
+        else if(flags_stream >> flag)
+            dirs.push_back(flag);
+    }
+
+    uint64_t hash = hashString(_identity);
+    hash = hashString(flags, hash);
+    hash = hashString(definitions.str(), hash);
+    hash = hashString(source, hash);
+    hash = hashIncludes(source, "", dirs, hash);
+
+    std::ostringstream hex;
+    hex << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return hex.str();
+}
+
+bool ProgramCache::loadRecord(const std::string name, std::string &record)
+{
+    auto it = _records.find(name);
+    if(it != _records.end()) {
+        record = it->second;
+        return true;
+    }
+    if(!enabled())
+        return false;
+
+    const std::string file_path = recordPath(name);
+    if(!isFile(file_path))
+        return false;
+    std::ifstream f(file_path);
+    if(!std::getline(f, record) || record.empty())
+        return false;
+    _records[name] = record;
+    return true;
+}
+
+void ProgramCache::storeRecord(const std::string name,
+                               const std::string record)
+{
+    _records[name] = record;
+    if(!enabled())
+        return;
+
+    // Write in a temporary file, and rename it afterwards, as in store()
+    const std::string file_path = recordPath(name);
+    std::ostringstream tmp_path;
+    tmp_path << file_path << "." << getpid() << ".tmp";
+    std::ofstream f(tmp_path.str());
+    f << record << std::endl;
+    f.close();
+    if(!f || rename(tmp_path.str().c_str(), file_path.c_str())) {
+        std::ostringstream msg;
+        msg << "Failure writing the record \"" << file_path << "\""
+            << std::endl;
+        LOG(L_WARNING, msg.str());
+        remove(tmp_path.str().c_str());
+    }
+}
+
+std::string ProgramCache::recordPath(const std::string name)
+{
+    uint64_t hash = hashString(_identity);
+    hash = hashString(name, hash);
+
+    std::ostringstream file_path;
+    file_path << _path << "/" << std::hex << std::setfill('0')
+              << std::setw(16) << hash << ".txt";
+    return file_path.str();
+}
+
+cl_program ProgramCache::load(const std::string file_path,
+                              const std::string flags)
+{
+    cl_int err_code, binary_status;
+
+    if(!isFile(file_path))
+        return NULL;
+
+    std::ifstream f(file_path, std::ios::in | std::ios::binary);
+    std::string binary((std::istreambuf_iterator<char>(f)),
+                        std::istreambuf_iterator<char>());
+    f.close();
+    if(binary.empty()) {
+        remove(file_path.c_str());
+        return NULL;
+    }
+
+    size_t binary_length = binary.size();
+    const unsigned char *binary_cstr = (const unsigned char*)binary.c_str();
+    cl_program program = clCreateProgramWithBinary(_context,
+                                                   1,
+                                                   &_device,
+                                                   &binary_length,
+                                                   &binary_cstr,
+                                                   &binary_status,
+                                                   &err_code);
+    if((err_code == CL_SUCCESS) && (binary_status == CL_SUCCESS)) {
+        err_code = clBuildProgram(program,
+                                  0,
+                                  NULL,
+                                  flags.c_str(),
+                                  NULL,
+                                  NULL);
+        if(err_code == CL_SUCCESS)
+            return program;
+    }
+
+    // Stale binary, just drop it
+    if(program) clReleaseProgram(program);
+    std::ostringstream msg;
+    msg << "Discarding the stale binary \"" << file_path << "\"" << std::endl;
+    LOG(L_WARNING, msg.str());
+    remove(file_path.c_str());
+    return NULL;
+}
+
+void ProgramCache::store(const std::string file_path, cl_program program)
+{
+    cl_int err_code;
+    size_t binary_length = 0;
+
+    err_code = clGetProgramInfo(program,
+                                CL_PROGRAM_BINARY_SIZES,
+                                sizeof(size_t),
+                                &binary_length,
+                                NULL);
+    if((err_code != CL_SUCCESS) || !binary_length) {
+        LOG(L_WARNING, "Failure getting the OpenCL program binary size.\n");
+        return;
+    }
+    unsigned char *binary = (unsigned char*)malloc(binary_length);
+    if(!binary) {
+        std::ostringstream msg;
+        msg << "Failure allocating " << binary_length
+            << " bytes for the OpenCL program binary" << std::endl;
+        LOG(L_WARNING, msg.str());
+        return;
+    }
+    err_code = clGetProgramInfo(program,
+                                CL_PROGRAM_BINARIES,
+                                sizeof(unsigned char*),
+                                &binary,
+                                NULL);
+    if(err_code != CL_SUCCESS) {
+        LOG(L_WARNING, "Failure getting the OpenCL program binary.\n");
+        free(binary);
+        return;
+    }
+
+    // Write in a temporary file, and rename it afterwards. That way several
+    // simultaneous runs would not produce corrupted binaries
+    std::ostringstream tmp_path;
+    tmp_path << file_path << "." << getpid() << ".tmp";
+    std::ofstream f(tmp_path.str(), std::ios::out | std::ios::binary);
+    f.write((const char*)binary, binary_length);
+    f.close();
+    free(binary);
+    if(!f || rename(tmp_path.str().c_str(), file_path.c_str())) {
+        std::ostringstream msg;
+        msg << "Failure writing the OpenCL program binary \"" << file_path
+            << "\"" << std::endl;
+        LOG(L_WARNING, msg.str());
+        remove(tmp_path.str().c_str());
+    }
+}
+
+}}  // namespaces
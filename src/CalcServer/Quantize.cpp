@@ -0,0 +1,389 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Output fields quantization, carried out in the computational device.
+ * (See Aqua::CalcServer::Quantize for details)
+ * @note Hardcoded versions of the files CalcServer/Quantize.cl.in and
+ * CalcServer/Quantize.hcl.in are internally included as a text array.
+ */
+
+#include <cmath>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/Quantize.h>
+#include <CalcServer.h>
+
+namespace Aqua{ namespace CalcServer{
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+#include "CalcServer/Quantize.hcl"
+#include "CalcServer/Quantize.cl"
+#endif
+std::string QUANTIZE_INC = xxd2string(Quantize_hcl_in, Quantize_hcl_in_len);
+std::string QUANTIZE_SRC = xxd2string(Quantize_cl_in, Quantize_cl_in_len);
+
+#ifndef QUANTIZE_MAX_LOCALSIZE
+    #define QUANTIZE_MAX_LOCALSIZE 256
+#endif // QUANTIZE_MAX_LOCALSIZE
+
+#ifndef QUANTIZE_MAX_GROUPS
+    #define QUANTIZE_MAX_GROUPS 256
+#endif // QUANTIZE_MAX_GROUPS
+
+Quantize::Quantize()
+    : _mins_mem(NULL)
+    , _maxs_mem(NULL)
+    , _n_groups(0)
+    , _range(NULL)
+    , _encode8(NULL)
+    , _encode16(NULL)
+    , _local_work_size(0)
+{
+}
+
+Quantize::~Quantize()
+{
+    if(_range) clReleaseKernel(_range); _range=NULL;
+    if(_encode8) clReleaseKernel(_encode8); _encode8=NULL;
+    if(_encode16) clReleaseKernel(_encode16); _encode16=NULL;
+    if(_mins_mem) clReleaseMemObject(_mins_mem); _mins_mem=NULL;
+    if(_maxs_mem) clReleaseMemObject(_maxs_mem); _maxs_mem=NULL;
+}
+
+void Quantize::setup()
+{
+    CalcServer *C = CalcServer::singleton();
+
+    LOG(L_INFO, "Loading the output fields quantization...\n");
+
+    std::ostringstream source;
+    source << QUANTIZE_INC << QUANTIZE_SRC;
+    compile(source.str());
+
+    // The local work size shall be a power of 2, to carry out the reductions
+    size_t max_local_size = QUANTIZE_MAX_LOCALSIZE;
+    for(auto kernel : {_range, _encode8, _encode16}){
+        size_t local_size;
+        cl_int err_code = clGetKernelWorkGroupInfo(kernel,
+                                                   C->device(),
+                                                   CL_KERNEL_WORK_GROUP_SIZE,
+                                                   sizeof(size_t),
+                                                   &local_size,
+                                                   NULL);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Failure querying the work group size.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        max_local_size = min(max_local_size, local_size);
+    }
+    _local_work_size = 1;
+    while(2 * _local_work_size <= max_local_size)
+        _local_work_size *= 2;
+    if(_local_work_size < __CL_MIN_LOCALSIZE__){
+        std::stringstream msg;
+        LOG(L_ERROR, "Quantization cannot be performed.\n");
+        msg << "\t" << _local_work_size
+            << " elements can be executed, but __CL_MIN_LOCALSIZE__="
+            << __CL_MIN_LOCALSIZE__ << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("OpenCL error");
+    }
+
+    setArg(_range, 5, _local_work_size * sizeof(cl_float), NULL);
+    setArg(_range, 6, _local_work_size * sizeof(cl_float), NULL);
+}
+
+void Quantize::range(cl_mem input,
+                     size_t offset,
+                     unsigned int n,
+                     cl_event event_wait,
+                     float &vmin,
+                     float &vmax)
+{
+    unsigned int i;
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    // Each work item is reducing several values, so the number of groups,
+    // and therefore the data to be read back, is bounded
+    unsigned int n_groups = roundUp(n, _local_work_size) / _local_work_size;
+    n_groups = max(1u, min(n_groups, (unsigned int)QUANTIZE_MAX_GROUPS));
+    allocate(n_groups);
+
+    cl_ulong in_offset = offset;
+    setArg(_range, 0, sizeof(cl_mem), &input);
+    setArg(_range, 1, sizeof(cl_ulong), &in_offset);
+    setArg(_range, 2, sizeof(unsigned int), &n);
+    cl_event event = enqueue(_range,
+                             n_groups * _local_work_size,
+                             _local_work_size,
+                             event_wait);
+
+    std::vector<float> mins(n_groups), maxs(n_groups);
+    err_code = clEnqueueReadBuffer(C->command_queue(),
+                                   _mins_mem,
+                                   CL_TRUE,
+                                   0,
+                                   n_groups * sizeof(cl_float),
+                                   mins.data(),
+                                   1,
+                                   &event,
+                                   NULL);
+    if(err_code == CL_SUCCESS){
+        err_code = clEnqueueReadBuffer(C->command_queue(),
+                                       _maxs_mem,
+                                       CL_TRUE,
+                                       0,
+                                       n_groups * sizeof(cl_float),
+                                       maxs.data(),
+                                       1,
+                                       &event,
+                                       NULL);
+    }
+    clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure reading the range of the quantized field.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+    vmin = INFINITY;
+    vmax = -INFINITY;
+    for(i = 0; i < n_groups; i++){
+        // fmin() and fmax() are ignoring the NaN values, which shall be
+        // propagated to fall back to the raw output
+        if(std::isnan(mins.at(i)) || std::isnan(maxs.at(i))){
+            vmin = vmax = NAN;
+            break;
+        }
+        vmin = fmin(vmin, mins.at(i));
+        vmax = fmax(vmax, maxs.at(i));
+    }
+}
+
+quantization Quantize::bits(float vmin, float vmax, float tolerance)
+{
+    quantization q;
+    q.bits = 0;
+    q.vmin = vmin;
+    q.step = 2.f * tolerance;
+    if(!(tolerance > 0.f) || !std::isfinite(vmin) || !std::isfinite(vmax))
+        return q;
+
+    // The values are rounded to the nearest level, so the biggest quantized
+    // value is never exceeding the ceil
+    double levels = std::ceil(((double)vmax - (double)vmin) / q.step);
+    if(levels < 256.0)
+        q.bits = 8;
+    else if(levels < 65536.0)
+        q.bits = 16;
+    return q;
+}
+
+cl_event Quantize::encode(cl_mem input,
+                          size_t offset,
+                          unsigned int n,
+                          const quantization q,
+                          cl_mem output,
+                          size_t out_offset,
+                          cl_event event_wait)
+{
+    cl_kernel kernel;
+    if(q.bits == 8)
+        kernel = _encode8;
+    else if(q.bits == 16)
+        kernel = _encode16;
+    else{
+        std::stringstream msg;
+        msg << "Unsupported quantization with " << q.bits
+            << " bits." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid quantization");
+    }
+
+    cl_ulong in_offset = offset, q_offset = out_offset;
+    cl_float inv_step = 1.f / q.step;
+    setArg(kernel, 0, sizeof(cl_mem), &input);
+    setArg(kernel, 1, sizeof(cl_ulong), &in_offset);
+    setArg(kernel, 2, sizeof(unsigned int), &n);
+    setArg(kernel, 3, sizeof(cl_float), &(q.vmin));
+    setArg(kernel, 4, sizeof(cl_float), &inv_step);
+    setArg(kernel, 5, sizeof(cl_mem), &output);
+    setArg(kernel, 6, sizeof(cl_ulong), &q_offset);
+    return enqueue(kernel,
+                   roundUp(n, _local_work_size),
+                   _local_work_size,
+                   event_wait);
+}
+
+void Quantize::compile(const std::string source)
+{
+    cl_int err_code;
+    cl_program program;
+    CalcServer *C = CalcServer::singleton();
+
+    // The relaxed math is not enabled, since the infinite and NaN values shall
+    // be detected
+    std::ostringstream flags;
+    #ifdef AQUA_DEBUG
+        flags << " -DDEBUG ";
+    #else
+        flags << " -DNDEBUG ";
+    #endif
+    #ifdef HAVE_3D
+        flags << " -DHAVE_3D";
+    #else
+        flags << " -DHAVE_2D";
+    #endif
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
+        LOG(L_ERROR, "Failure creating the OpenCL program\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    if(err_code != CL_SUCCESS) {
+        LOG(L_ERROR, "Error compiling the OpenCL script\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        LOG0(L_ERROR, "--- Build log ---------------------------------\n");
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              0,
+                              NULL,
+                              &log_size);
+        char *log = (char*)malloc(log_size + sizeof(char));
+        if(!log){
+            std::stringstream msg;
+            msg << "Failure allocating " << log_size
+                << " bytes for the building log" << std::endl;
+            LOG0(L_ERROR, msg.str());
+            LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+            throw std::bad_alloc();
+        }
+        strcpy(log, "");
+        clGetProgramBuildInfo(program,
+                              C->device(),
+                              CL_PROGRAM_BUILD_LOG,
+                              log_size,
+                              log,
+                              NULL);
+        strcat(log, "\n");
+        LOG0(L_DEBUG, log);
+        LOG0(L_ERROR, "--------------------------------- Build log ---\n");
+        free(log); log=NULL;
+        clReleaseProgram(program);
+        throw std::runtime_error("OpenCL compilation error");
+    }
+
+    const char* names[3] = {"range", "encode8", "encode16"};
+    cl_kernel* kernels[3] = {&_range, &_encode8, &_encode16};
+    for(unsigned int i = 0; i < 3; i++){
+        *(kernels[i]) = clCreateKernel(program, names[i], &err_code);
+        if(err_code != CL_SUCCESS) {
+            std::stringstream msg;
+            msg << "Failure creating the OpenCL kernel \"" << names[i]
+                << "\"" << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            clReleaseProgram(program);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    clReleaseProgram(program);
+}
+
+void Quantize::allocate(unsigned int n_groups)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+
+    if(n_groups <= _n_groups)
+        return;
+
+    if(_mins_mem) clReleaseMemObject(_mins_mem); _mins_mem=NULL;
+    if(_maxs_mem) clReleaseMemObject(_maxs_mem); _maxs_mem=NULL;
+    _n_groups = 0;
+
+    for(auto mem : {&_mins_mem, &_maxs_mem}){
+        *mem = clCreateBuffer(C->context(),
+                              CL_MEM_READ_WRITE,
+                              n_groups * sizeof(cl_float),
+                              NULL,
+                              &err_code);
+        if(err_code != CL_SUCCESS) {
+            LOG(L_ERROR, "Buffer memory allocation failure.\n");
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+    _n_groups = n_groups;
+
+    setArg(_range, 3, sizeof(cl_mem), &_mins_mem);
+    setArg(_range, 4, sizeof(cl_mem), &_maxs_mem);
+}
+
+void Quantize::setArg(cl_kernel kernel,
+                      cl_uint index,
+                      size_t size,
+                      const void* value)
+{
+    cl_int err_code = clSetKernelArg(kernel, index, size, value);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure sending the argument " << index
+            << " to the output fields quantization." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+}
+
+cl_event Quantize::enqueue(cl_kernel kernel,
+                           size_t global_work_size,
+                           size_t local_work_size,
+                           cl_event event_wait)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+
+    err_code = clEnqueueNDRangeKernel(C->command_queue(),
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      event_wait ? 1 : 0,
+                                      event_wait ? &event_wait : NULL,
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        std::stringstream msg;
+        msg << "Failure executing the output fields quantization."
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+
+    return event;
+}
+
+}}  // namespace
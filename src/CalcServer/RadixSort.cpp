@@ -24,6 +24,11 @@
  * CalcServer/RadixSort.hcl.in are internally included as a text array.
  */
 
+#include <chrono>
+#include <random>
+#include <limits>
+#include <algorithm>
+
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer/RadixSort.h>
@@ -50,42 +55,22 @@ RadixSort::RadixSort(const std::string tool_name,
     , _perms(NULL)
     , _inv_perms(NULL)
     , _n(0)
-    , _init_kernel(NULL)
-    , _histograms_kernel(NULL)
-    , _scan_kernel(NULL)
-    , _paste_kernel(NULL)
-    , _sort_kernel(NULL)
+    , _kernels({NULL, NULL, NULL, NULL, NULL, NULL, NULL})
     , _inv_perms_kernel(NULL)
-    , _in_keys(NULL)
-    , _out_keys(NULL)
-    , _in_permut(NULL)
-    , _out_permut(NULL)
-    , _histograms(NULL)
-    , _global_sums(NULL)
-    , _temp_mem(NULL)
-    , _items(_ITEMS)
-    , _groups(_GROUPS)
-    , _bits(_STEPBITS)
-    , _radix(_RADIX)
-    , _histo_split(_HISTOSPLIT)
+    , _mems({NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL})
+    , _params({false, _STEPBITS, _ITEMS, _GROUPS, _HISTOSPLIT, 0})
+    , _max_key(0)
 {
 }
 
 RadixSort::~RadixSort()
 {
-    if(_init_kernel) clReleaseKernel(_init_kernel); _init_kernel=NULL;
-    if(_histograms_kernel) clReleaseKernel(_histograms_kernel); _histograms_kernel=NULL;
-    if(_scan_kernel) clReleaseKernel(_scan_kernel); _scan_kernel=NULL;
-    if(_paste_kernel) clReleaseKernel(_paste_kernel); _paste_kernel=NULL;
-    if(_sort_kernel) clReleaseKernel(_sort_kernel); _sort_kernel=NULL;
-    if(_inv_perms_kernel) clReleaseKernel(_inv_perms_kernel); _inv_perms_kernel=NULL;
-    if(_in_keys) clReleaseMemObject(_in_keys); _in_keys=NULL;
-    if(_out_keys) clReleaseMemObject(_out_keys); _out_keys=NULL;
-    if(_in_permut) clReleaseMemObject(_in_permut); _in_permut=NULL;
-    if(_out_permut) clReleaseMemObject(_out_permut); _out_permut=NULL;
-    if(_histograms) clReleaseMemObject(_histograms); _histograms=NULL;
-    if(_global_sums) clReleaseMemObject(_global_sums); _global_sums=NULL;
-    if(_temp_mem) clReleaseMemObject(_temp_mem); _temp_mem=NULL;
+    for(auto kernel : {&_kernels.init, &_kernels.histogram, &_kernels.scan,
+                       &_kernels.paste, &_kernels.sort, &_kernels.counts,
+                       &_kernels.onesweep, &_inv_perms_kernel}){
+        if(*kernel) clReleaseKernel(*kernel); *kernel=NULL;
+    }
+    RadixSortPasses::release(_mems);
 }
 
 void RadixSort::setup()
@@ -106,28 +91,12 @@ void RadixSort::setup()
 cl_event RadixSort::_execute(const std::vector<cl_event> events)
 {
     cl_int err_code;
-    unsigned int i, max_val;
-    cl_event event, event_wait, event_perms_in;
+    cl_event event, event_wait;
     CalcServer *C = CalcServer::singleton();
-    InputOutput::Variables *vars = C->variables();
 
     // Get maximum key bits, and needed pass
-    max_val = UINT_MAX;
-    if(!_var_name.compare("icell")){
-        uivec4 n_cells = *(uivec4 *)vars->get("n_cells")->get();
-        max_val = nextPowerOf2(n_cells.w);
-    }
-    else if(!isPowerOf2(max_val)){
-        max_val = nextPowerOf2(max_val / 2);
-    }
-    for(i=0; (max_val&1) == 0; max_val >>= 1, i++);
-    _key_bits = i;
-    _key_bits = roundUp(_key_bits, _bits);
-    if(_key_bits > __UINTBITS__){
-        LOG(L_ERROR, "Resultant keys overflows unsigned int type.\n");
-        throw std::runtime_error("Unsigned int overflow");
-    }
-    _n_pass = _key_bits / _bits;
+    _key_bits = keyBits();
+    _n_pass = std::max(1u, (_key_bits + _params.bits - 1) / _params.bits);
 
     // Even though we are using Tool dependencies stuff, we are really
     // interested in following a more complex events chain, due to the large and
@@ -135,7 +104,7 @@ cl_event RadixSort::_execute(const std::vector<cl_event> events)
     event_wait = _var->getEvent();
     err_code = clEnqueueCopyBuffer(C->command_queue(),
                                    *(cl_mem *)_var->get(),
-                                   _in_keys,
+                                   _mems.in_keys,
                                    0,
                                    0,
                                    _n * sizeof(cl_uint),
@@ -161,27 +130,11 @@ cl_event RadixSort::_execute(const std::vector<cl_event> events)
         throw std::runtime_error("OpenCL execution error");
     }
 
-    event_perms_in = init();
-
-    event_wait = NULL;
-    for(_pass = 0; _pass < _n_pass; _pass++){
-        event_wait = histograms(event, event_wait);
-        event_wait = scan(event_wait);
-        event_wait = reorder(event_perms_in, event_wait);
-    }
-    err_code = clReleaseEvent(event_perms_in);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure releasing permutations event within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
+    event_wait = passes(event);
 
     const cl_event event_wait_list1[] = {event_wait, _var->getEvent()};
     err_code = clEnqueueCopyBuffer(C->command_queue(),
-                                   _in_keys,
+                                   _mems.in_keys,
                                    *(cl_mem *)_var->get(),
                                    0,
                                    0,
@@ -210,7 +163,7 @@ cl_event RadixSort::_execute(const std::vector<cl_event> events)
 
     const cl_event event_wait_list2[] = {event_wait, _perms->getEvent()};
     err_code = clEnqueueCopyBuffer(C->command_queue(),
-                                   _in_permut,
+                                   _mems.in_permut,
                                    *(cl_mem *)_perms->get(),
                                    0,
                                    0,
@@ -252,385 +205,40 @@ cl_event RadixSort::_execute(const std::vector<cl_event> events)
     return inversePermutations();
 }
 
-cl_event RadixSort::init()
-{
-    cl_int err_code;
-    cl_event event;
-    CalcServer *C = CalcServer::singleton();
-
-    err_code = clSetKernelArg(_init_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_in_permut);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"init\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _init_kernel,
-                                      1,
-                                      NULL,
-                                      &_global_work_size,
-                                      NULL,
-                                      0,
-                                      NULL,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"init\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-
-    return event;
-}
-
-cl_event RadixSort::histograms(cl_event keys_event, cl_event histograms_event)
-{
-    cl_int err_code;
-    cl_event event;
-    CalcServer *C = CalcServer::singleton();
-    size_t local_work_size = _items;
-    size_t global_work_size = _groups * _items;
-
-    err_code = clSetKernelArg(_histograms_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_in_keys);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_histograms_kernel,
-                              2,
-                              sizeof(cl_uint),
-                              (void*)&_pass);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 2 to \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    std::vector<cl_event> events = {keys_event};
-    if(histograms_event)
-        events.push_back(histograms_event);
-    cl_uint num_events_in_wait_list = events.size();
-    const cl_event *event_wait_list = events.size() ? events.data() : NULL;
-
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _histograms_kernel,
-                                      1,
-                                      NULL,
-                                      &global_work_size,
-                                      &local_work_size,
-                                      num_events_in_wait_list,
-                                      event_wait_list,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-
-    if(histograms_event) {
-        err_code = clReleaseEvent(histograms_event);
-        if(err_code != CL_SUCCESS) {
-            std::ostringstream msg;
-            msg << "Failure releasing \"histogram\" event within the tool \""
-                << name() << "\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            throw std::runtime_error("OpenCL execution error");
-        }
-    }
-
-    return event;
-}
-
-cl_event RadixSort::scan(cl_event event_histo)
+unsigned int RadixSort::keyBits()
 {
-    cl_int err_code;
-    cl_event event, event_wait = event_histo;
-    CalcServer *C = CalcServer::singleton();
-    size_t global_work_size = _radix * _groups * _items / 2;
-    size_t local_work_size = global_work_size / _histo_split;
-    unsigned int maxmemcache=max(_histo_split,
-                                 _items * _groups * _radix / _histo_split);
-
-    // 1st scan
-    // ========
-    err_code = clSetKernelArg(_scan_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_histograms);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"scan\" (1st call) "
-            << "within the tool \"" << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_scan_kernel,
-                              2,
-                              sizeof(cl_mem),
-                              (void*)&_global_sums);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 2 to \"scan\" (1st call) "
-            << "within the tool \"" << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _scan_kernel,
-                                      1,
-                                      NULL,
-                                      &global_work_size,
-                                      &local_work_size,
-                                      1,
-                                      &event_wait,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"scan\" (1st call) within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-    err_code = clReleaseEvent(event_wait);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure releasing \"scan\" (1st call) event within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-    event_wait = event;
-
-    // 2nd scan
-    // ========
-    global_work_size = _histo_split / 2;
-    local_work_size = global_work_size;
-    err_code = clSetKernelArg(_scan_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_global_sums);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"scan\" (2nd call) "
-            << "within the tool \"" << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_scan_kernel,
-                              2,
-                              sizeof(cl_mem),
-                              (void*)&_temp_mem);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 2 to \"scan\" (2nd call) "
-            << "within the tool \"" << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
+    unsigned int i, max_val = UINT_MAX;
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
 
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _scan_kernel,
-                                      1,
-                                      NULL,
-                                      &global_work_size,
-                                      &local_work_size,
-                                      1,
-                                      &event_wait,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"scan\" (2nd call) within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
+    // The maximum key is included, e.g. the "icell" of the particles out of
+    // bounds is "n_cells.w"
+    if(_max_key){
+        max_val = _max_key;
     }
-    err_code = clReleaseEvent(event_wait);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure releasing \"scan\" (2nd call) event within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-    event_wait = event;
-
-    // Histograms paste
-    // ================
-    global_work_size = _radix * _groups * _items / 2;
-    local_work_size = global_work_size / _histo_split;
-
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _paste_kernel,
-                                      1,
-                                      NULL,
-                                      &global_work_size,
-                                      &local_work_size,
-                                      1,
-                                      &event_wait,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"paste\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-    err_code = clReleaseEvent(event_wait);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure releasing \"scan\" (2nd call) event within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
+    else if(!_var_name.compare("icell")){
+        uivec4 n_cells = *(uivec4 *)vars->get("n_cells")->get();
+        max_val = n_cells.w;
     }
-
-    return event;
+    for(i = 0; (i < __UINTBITS__) && (max_val >> i); i++);
+    return i;
 }
 
-cl_event RadixSort::reorder(cl_event perms_event, cl_event histograms_event)
-{
-    cl_int err_code;
-    cl_event event;
-    CalcServer *C = CalcServer::singleton();
-    size_t local_work_size = _items;
-    size_t global_work_size = _groups * _items;
-
-    err_code = clSetKernelArg(_sort_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_in_keys);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              1,
-                              sizeof(cl_mem),
-                              (void*)&_out_keys);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 1 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              3,
-                              sizeof(cl_uint),
-                              (void*)&_pass);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 3 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              4,
-                              sizeof(cl_mem),
-                              (void*)&_in_permut);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 4 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              5,
-                              sizeof(cl_mem),
-                              (void*)&_out_permut);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 5 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    std::vector<cl_event> events = {perms_event, histograms_event};
-    cl_uint num_events_in_wait_list = events.size();
-    const cl_event *event_wait_list = events.size() ? events.data() : NULL;
-
-    err_code = clEnqueueNDRangeKernel(C->command_queue(),
-                                      _sort_kernel,
-                                      1,
-                                      NULL,
-                                      &global_work_size,
-                                      &local_work_size,
-                                      num_events_in_wait_list,
-                                      event_wait_list,
-                                      &event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure executing \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-    err_code = clReleaseEvent(histograms_event);
-    if(err_code != CL_SUCCESS) {
-        std::ostringstream msg;
-        msg << "Failure releasing \"scan\" (2nd call) event within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL execution error");
-    }
-
-    // Swap the memory identifiers for the next pass
-    cl_mem d_temp;
-
-    d_temp = _in_keys;
-    _in_keys = _out_keys;
-    _out_keys = d_temp;
+cl_event RadixSort::passes(cl_event keys_event)
+{
+    cl_event event = NULL;
+    CalcServer *C = CalcServer::singleton();
 
-    d_temp = _in_permut;
-    _in_permut = _out_permut;
-    _out_permut = d_temp;
+    try {
+        event = RadixSortPasses::passes(C->command_queue(),
+                                        _kernels,
+                                        _mems,
+                                        _params,
+                                        _n,
+                                        _n_pass,
+                                        keys_event);
+    } catch(RadixSortPasses::opencl_error &e) {
+        error(e);
+    }
 
     return event;
 }
@@ -644,7 +252,7 @@ cl_event RadixSort::inversePermutations()
     err_code = clSetKernelArg(_inv_perms_kernel,
                               0,
                               sizeof(cl_mem),
-                              (void*)&_in_permut);
+                              (void*)&_mems.in_permut);
     if(err_code != CL_SUCCESS){
         std::ostringstream msg;
         msg << "Failure sending argument 0 to \"inversePermutation\" within the tool \""
@@ -817,24 +425,202 @@ void RadixSort::variables()
 
 void RadixSort::setupOpenCL()
 {
-    std::ostringstream source;
-    source << RADIXSORT_INC << RADIXSORT_SRC;
-    compile(source.str());
+    // Select the engine, compiling the kernels and setting up the memory
+    // objects
+    tune();
+
+    std::ostringstream msg;
+    msg << "\tengine: " << (_params.onesweep ? "onesweep" : "classic") << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    msg.str(""); msg << "\tbits: " << _params.bits << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    msg.str(""); msg << "\titems: " << _params.items << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    msg.str(""); msg << "\tgroups: " << _params.groups << std::endl;
+    LOG0(L_DEBUG, msg.str());
+    if(_params.onesweep){
+        msg.str(""); msg << "\tkeys per thread: " << _params.kpt << std::endl;
+        LOG0(L_DEBUG, msg.str());
+    }
+    else{
+        msg.str(""); msg << "\tsplits: " << _params.histo_split << std::endl;
+        LOG0(L_DEBUG, msg.str());
+    }
+}
+
+void RadixSort::tune()
+{
+    CalcServer *C = CalcServer::singleton();
+    ProgramCache *cache = C->program_cache();
+
+    // The keys bound may be still unknown, e.g. the number of cells of the
+    // link-list is computed later
+    unsigned int key_bits = keyBits();
+    if(!key_bits)
+        key_bits = __UINTBITS__;
+    std::ostringstream record_name;
+    record_name << "RadixSort n=" << _n << " key_bits=" << key_bits;
+    std::string record;
+    RadixSortPasses::params best;
+    if(cache->loadRecord(record_name.str(), record)){
+        std::istringstream fields(record);
+        if(fields >> best.onesweep >> best.bits >> best.items >> best.groups
+                  >> best.histo_split >> best.kpt){
+            configure(best);
+            return;
+        }
+    }
+
+    // Time the candidates on a sample of random keys, which is large enough
+    // to be representative, while the tuning remains fast
+    const unsigned int n = _n;
+    _n = std::min(_n, 1u << 22);
+    _key_bits = key_bits;
+    std::vector<unsigned int> keys(_n);
+    std::mt19937 generator(0);
+    const unsigned int mask = (key_bits < __UINTBITS__) ?
+                              (1u << key_bits) - 1u : UINT_MAX;
+    for(auto &key : keys)
+        key = generator() & mask;
+
+    RadixSortPasses::params classic = {false,
+                                       _STEPBITS,
+                                       _ITEMS,
+                                       _GROUPS,
+                                       _HISTOSPLIT,
+                                       0};
+    configure(classic);
+    best = _params;
+    double best_time = benchmark(keys);
+    // The look-back status is packing the counts in 30 bits
+    if(n < (1u << 30)){
+        for(auto bits : {4u, 6u, 8u}){
+            for(auto p : candidates(bits)){
+                configure(p);
+                const double t = benchmark(keys);
+                if(t < best_time){
+                    best = p;
+                    best_time = t;
+                }
+            }
+        }
+    }
+    _n = n;
+    configure(best);
+
+    std::ostringstream fields;
+    fields << best.onesweep << " " << best.bits << " " << best.items << " "
+           << best.groups << " " << best.histo_split << " " << best.kpt;
+    cache->storeRecord(record_name.str(), fields.str());
+
+    std::ostringstream msg;
+    msg << "Tuned the \"" << name() << "\" sorting engine: "
+        << (best.onesweep ? "onesweep" : "classic") << ", " << best.bits
+        << " bits per pass (" << keys.size() / best_time * 1.e-6
+        << " Mkeys/s)" << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+std::vector<RadixSortPasses::params> RadixSort::candidates(unsigned int bits)
+{
+    std::vector<RadixSortPasses::params> result;
+    CalcServer *C = CalcServer::singleton();
+
+    if(_params.bits != bits){
+        _params.bits = bits;
+        std::ostringstream source;
+        source << RADIXSORT_INC << RADIXSORT_SRC;
+        compile(source.str());
+    }
+
+    try {
+        result = RadixSortPasses::candidates(C->device(), _kernels, bits);
+    } catch(RadixSortPasses::opencl_error &e) {
+        error(e);
+    }
+    return result;
+}
+
+void RadixSort::configure(const RadixSortPasses::params p)
+{
+    CalcServer *C = CalcServer::singleton();
+
+    const bool recompile = !_kernels.init || (_params.bits != p.bits);
+    _params = p;
+    if(recompile){
+        std::ostringstream source;
+        source << RADIXSORT_INC << RADIXSORT_SRC;
+        compile(source.str());
+    }
 
-    // Check and correct _items, _groups and _histo_split
-    setupDims();
+    if(_params.onesweep){
+        const unsigned int n_tiles = RadixSortPasses::tiles(_params, _n);
+        _params.groups = std::min(n_tiles, 256u);
+    }
+    else{
+        // Check and correct the items, groups and histogram splits
+        try {
+            RadixSortPasses::classicDims(C->device(), _kernels, _params);
+        } catch(RadixSortPasses::opencl_error &e) {
+            error(e);
+        }
+    }
+    _local_work_size = getLocalWorkSize(_n, C->command_queue());
+    _global_work_size = getGlobalWorkSize(_n, _local_work_size);
 
     // Setup the memory objects
     setupMems();
     setupArgs();
+}
 
-    std::ostringstream msg;
-    msg << "\titems: " << _items << std::endl;
-    LOG0(L_DEBUG, msg.str());
-    msg.str(""); msg << "\tgroups: " << _groups << std::endl;
-    LOG0(L_DEBUG, msg.str());
-    msg.str(""); msg << "\tsplits: " << _histo_split << std::endl;
-    LOG0(L_DEBUG, msg.str());
+double RadixSort::benchmark(const std::vector<unsigned int> &keys)
+{
+    cl_int err_code;
+    cl_event event;
+    CalcServer *C = CalcServer::singleton();
+    double best_time = std::numeric_limits<double>::max();
+
+    _n_pass = std::max(1u, (_key_bits + _params.bits - 1) / _params.bits);
+    // The first execution is discarded, since it may include some
+    // initialization overhead
+    for(unsigned int i = 0; i < 4; i++){
+        err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                        _mems.in_keys,
+                                        CL_TRUE,
+                                        0,
+                                        _n * sizeof(cl_uint),
+                                        keys.data(),
+                                        0,
+                                        NULL,
+                                        NULL);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure sending the tuning keys within the tool \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        event = passes(NULL);
+        err_code = clWaitForEvents(1, &event);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure sorting the tuning keys within the tool \""
+                << name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+        clReleaseEvent(event);
+        if(i && (elapsed.count() < best_time))
+            best_time = elapsed.count();
+    }
+
+    return best_time;
 }
 
 void RadixSort::compile(const std::string source)
@@ -843,8 +629,16 @@ void RadixSort::compile(const std::string source)
     cl_program program;
     CalcServer *C = CalcServer::singleton();
 
+    // The kernels may be already compiled with other bits per pass
+    for(auto kernel : {&_kernels.init, &_kernels.histogram, &_kernels.scan,
+                       &_kernels.paste, &_kernels.sort, &_kernels.counts,
+                       &_kernels.onesweep, &_inv_perms_kernel}){
+        if(*kernel) clReleaseKernel(*kernel); *kernel=NULL;
+    }
+
     std::ostringstream flags;
-    flags << "-D_BITS=" << _bits << " -D_RADIX=" << _radix << " -DPERMUT";
+    flags << "-D_BITS=" << _params.bits << " -D_RADIX=" << (1u << _params.bits)
+          << " -DPERMUT";
     #ifdef AQUA_DEBUG
         flags << " -DDEBUG";
     #else
@@ -856,19 +650,12 @@ void RadixSort::compile(const std::string source)
     #else
         flags << " -DHAVE_2D";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -904,35 +691,35 @@ void RadixSort::compile(const std::string source)
         throw std::runtime_error("OpenCL compilation error");
     }
 
-    _init_kernel = clCreateKernel(program, "init", &err_code);
+    _kernels.init = clCreateKernel(program, "init", &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the \"init\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    _histograms_kernel = clCreateKernel(program, "histogram", &err_code);
+    _kernels.histogram = clCreateKernel(program, "histogram", &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the \"histogram\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    _scan_kernel = clCreateKernel(program, "scan", &err_code);
+    _kernels.scan = clCreateKernel(program, "scan", &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the \"scan\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    _paste_kernel = clCreateKernel(program, "paste", &err_code);
+    _kernels.paste = clCreateKernel(program, "paste", &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the \"paste\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    _sort_kernel = clCreateKernel(program, "sort", &err_code);
+    _kernels.sort = clCreateKernel(program, "sort", &err_code);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Failure creating the \"sort\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -946,351 +733,46 @@ void RadixSort::compile(const std::string source)
         clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    clReleaseProgram(program);
-}
-
-void RadixSort::setupDims()
-{
-    cl_int err_code;
-    size_t max_local_work_size, sort_local_work_size, scan_local_work_size;
-    CalcServer *C = CalcServer::singleton();
-
-    // For the _histograms_kernel and _sort_kernel _items can be used as the
-    // upper bound
-    err_code = clGetKernelWorkGroupInfo(_histograms_kernel,
-                                        C->device(),
-                                        CL_KERNEL_WORK_GROUP_SIZE,
-                                        sizeof(size_t),
-                                        &max_local_work_size,
-                                        NULL);
-    if(err_code != CL_SUCCESS) {
-        LOG(L_ERROR, "Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"histogram\".\n");
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clGetKernelWorkGroupInfo(_sort_kernel,
-                                        C->device(),
-                                        CL_KERNEL_WORK_GROUP_SIZE,
-                                        sizeof(size_t),
-                                        &sort_local_work_size,
-                                        NULL);
-    if(err_code != CL_SUCCESS) {
-        LOG(L_ERROR, "Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"sort\".\n");
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    if(sort_local_work_size < max_local_work_size)
-        max_local_work_size = sort_local_work_size;
-    if(max_local_work_size < _items)
-        _items = max_local_work_size;
-    if(!isPowerOf2(_items))
-        _items = nextPowerOf2(_items) / 2;
-
-    // The _scan_kernel can be used to set an upper bound to the number of
-    // histogram splits
-    err_code = clGetKernelWorkGroupInfo(_scan_kernel,
-                                        C->device(),
-                                        CL_KERNEL_WORK_GROUP_SIZE,
-                                        sizeof(size_t),
-                                        &scan_local_work_size,
-                                        NULL);
+    _kernels.counts = clCreateKernel(program, "digitCounts", &err_code);
     if(err_code != CL_SUCCESS) {
-        LOG(L_ERROR, "Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"scan\".\n");
+        LOG(L_ERROR, "Failure creating the \"digitCounts\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    if(scan_local_work_size < _histo_split / 2)
-        _histo_split = 2 * scan_local_work_size;
-    if(!isPowerOf2(_histo_split))
-        _histo_split = nextPowerOf2(_histo_split) / 2;
-
-    // Finally using _scan_kernel and _paste_kernel we can adjust _groups,
-    // _items and _radix
-    err_code = clGetKernelWorkGroupInfo(_paste_kernel,
-                                        C->device(),
-                                        CL_KERNEL_WORK_GROUP_SIZE,
-                                        sizeof(size_t),
-                                        &max_local_work_size,
-                                        NULL);
+    _kernels.onesweep = clCreateKernel(program, "onesweep", &err_code);
     if(err_code != CL_SUCCESS) {
-        LOG(L_ERROR, "Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"paste\".\n");
+        LOG(L_ERROR, "Failure creating the \"onesweep\" kernel.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clReleaseProgram(program);
         throw std::runtime_error("OpenCL error");
     }
-    max_local_work_size = min(max_local_work_size, scan_local_work_size);
-    while(max_local_work_size < _radix * _groups * _items / 2 / _histo_split){
-        // We can't increase _histo_split, so we may start decreasing the number
-        // of items
-        _items /= 2;
-        if(_items < __CL_MIN_LOCALSIZE__){
-            _items = __CL_MIN_LOCALSIZE__;
-            break;
-        }
-    }
-    while(max_local_work_size < _radix * _groups * _items / 2 / _histo_split){
-        // We have reached the minimum possible number of items, so we can
-        // continue decreasing the number of groups
-        _groups /= 2;
-        if(!_groups){
-            _groups = 1;
-            break;
-        }
-    }
-    if(max_local_work_size < _radix * _groups * _items / 2 / _histo_split){
-        // We can try to reduce the radix, but it is a bad business
-        LOG(L_ERROR, "Failure setting a number of items and groups compatible with \"scan\" and \"paste\".\n");
-        LOG0(L_DEBUG, "\tYou can try to recompile the code decreasing __CL_MIN_LOCALSIZE__\n");
-        throw std::runtime_error("OpenCL error");
-    }
-
-    _local_work_size = getLocalWorkSize(_n, C->command_queue());
-    _global_work_size = getGlobalWorkSize(_n, _local_work_size);
+    clReleaseProgram(program);
 }
 
 void RadixSort::setupMems()
 {
-    cl_int err_code;
     CalcServer *C = CalcServer::singleton();
 
-    if(_in_keys) clReleaseMemObject(_in_keys); _in_keys=NULL;
-    if(_out_keys) clReleaseMemObject(_out_keys); _out_keys=NULL;
-    if(_in_permut) clReleaseMemObject(_in_permut); _in_permut=NULL;
-    if(_out_permut) clReleaseMemObject(_out_permut); _out_permut=NULL;
-    if(_histograms) clReleaseMemObject(_histograms); _histograms=NULL;
-    if(_global_sums) clReleaseMemObject(_global_sums); _global_sums=NULL;
-    if(_temp_mem) clReleaseMemObject(_temp_mem); _temp_mem=NULL;
     allocatedMemory(0);
-
-    // Get the memory identifiers
-    _in_keys = clCreateBuffer(C->context(),
-                              CL_MEM_READ_WRITE,
-                              _n * sizeof(unsigned int),
-                              NULL,
-                              &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _out_keys = clCreateBuffer(C->context(),
-                              CL_MEM_READ_WRITE,
-                              _n * sizeof(unsigned int),
-                              NULL,
-                              &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _in_permut = clCreateBuffer(C->context(),
-                                CL_MEM_READ_WRITE,
-                                _n * sizeof(unsigned int),
-                                NULL,
-                                &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _out_permut = clCreateBuffer(C->context(),
-                                 CL_MEM_READ_WRITE,
-                                 _n * sizeof(unsigned int),
-                                 NULL,
-                                 &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _histograms = clCreateBuffer(C->context(),
-                                 CL_MEM_READ_WRITE,
-                                 (_radix * _groups * _items) * sizeof(unsigned int),
-                                 NULL,
-                                 &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _global_sums = clCreateBuffer(C->context(),
-                                  CL_MEM_READ_WRITE,
-                                  _histo_split * sizeof(unsigned int),
-                                  NULL,
-                                  &err_code);
-    if(err_code != CL_SUCCESS) {
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    _temp_mem = clCreateBuffer(C->context(),
-                               CL_MEM_READ_WRITE,
-                               sizeof(unsigned int),
-                               NULL,
-                               &err_code);
-    if(err_code != CL_SUCCESS) {
+    try {
+        allocatedMemory(RadixSortPasses::allocate(C->context(),
+                                                  _params,
+                                                  _n,
+                                                  _mems));
+    } catch(RadixSortPasses::opencl_error &e) {
         std::stringstream msg;
         msg << "Failure allocating device memory in the tool \"" <<
                name() << "\"." << std::endl;
         LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        InputOutput::Logger::singleton()->printOpenCLError(e.code());
         throw std::runtime_error("OpenCL allocation error");
     }
-
-    allocatedMemory(4 * _n * sizeof(unsigned int) +
-                    (_radix * _groups * _items) * sizeof(unsigned int) +
-                    _histo_split * sizeof(unsigned int) +
-                    sizeof(unsigned int));
 }
 
 void RadixSort::setupArgs()
 {
     cl_int err_code;
-    CalcServer *C = CalcServer::singleton();
-
-    err_code = clSetKernelArg(_init_kernel,
-                              1,
-                              sizeof(cl_uint),
-                              (void*)&_n);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 1 to \"init\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    err_code = clSetKernelArg(_histograms_kernel,
-                              1,
-                              sizeof(cl_mem),
-                              (void*)&_histograms);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 1 to \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_histograms_kernel,
-                              3,
-                              sizeof(cl_uint) * _radix * _items,
-                              NULL);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 3 to \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_histograms_kernel,
-                              4,
-                              sizeof(cl_uint),
-                              (void*)&_n);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 4 to \"histogram\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    unsigned int maxmemcache = max(_histo_split,
-                                   _items * _groups * _radix / _histo_split);
-    err_code = clSetKernelArg(_scan_kernel,
-                              1,
-                              sizeof(cl_uint) * maxmemcache,
-                              NULL);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 1 to \"scan\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    err_code = clSetKernelArg(_paste_kernel,
-                              0,
-                              sizeof(cl_mem),
-                              (void*)&_histograms);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 0 to \"paste\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_paste_kernel,
-                              1,
-                              sizeof(cl_mem),
-                              (void*)&_global_sums);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 1 to \"paste\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-
-    err_code = clSetKernelArg(_sort_kernel,
-                              2,
-                              sizeof(cl_mem),
-                              (void*)&_histograms);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 2 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              6,
-                              sizeof(cl_uint) * _radix * _items,
-                              NULL);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 6 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_sort_kernel,
-                              7,
-                              sizeof(cl_uint),
-                              (void*)&_n);
-    if(err_code != CL_SUCCESS){
-        std::ostringstream msg;
-        msg << "Failure sending argument 7 to \"sort\" within the tool \""
-            << name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
 
     err_code = clSetKernelArg(_inv_perms_kernel,
                               1,
@@ -1315,4 +797,13 @@ void RadixSort::setupArgs()
     }
 }
 
+void RadixSort::error(const RadixSortPasses::opencl_error &e)
+{
+    std::ostringstream msg;
+    msg << e.what() << " within the tool \"" << name() << "\"." << std::endl;
+    LOG(L_ERROR, msg.str());
+    InputOutput::Logger::singleton()->printOpenCLError(e.code());
+    throw std::runtime_error("OpenCL execution error");
+}
+
 }}  // namespace
@@ -0,0 +1,484 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Host side orchestration of the radix sort engines.
+ * (See Aqua::CalcServer::RadixSortPasses for details)
+ */
+
+#include <sstream>
+#include <algorithm>
+
+#include <sphPrerequisites.h>
+#include <CalcServer/RadixSortPasses.h>
+
+namespace Aqua{ namespace CalcServer{ namespace RadixSortPasses{
+
+/** @brief Maximum work group size of a kernel.
+ * @param device Device where the kernel is compiled.
+ * @param kernel Kernel.
+ * @param kernel_name Name of the kernel, to report errors
+ * @return Maximum work group size.
+ */
+static size_t maxLocalSize(cl_device_id device,
+                           cl_kernel kernel,
+                           const std::string kernel_name)
+{
+    size_t size;
+    cl_int err_code = clGetKernelWorkGroupInfo(kernel,
+                                               device,
+                                               CL_KERNEL_WORK_GROUP_SIZE,
+                                               sizeof(size_t),
+                                               &size,
+                                               NULL);
+    if(err_code != CL_SUCCESS) {
+        throw opencl_error("Failure getting CL_KERNEL_WORK_GROUP_SIZE from \"" +
+                           kernel_name + "\"", err_code);
+    }
+    return size;
+}
+
+/** @brief Largest power of 2 not greater than a value.
+ * @param x Value, which should be greater than 0.
+ * @return Power of 2.
+ */
+static unsigned int floorPowerOf2(unsigned int x)
+{
+    unsigned int p = 1;
+    while(p <= x / 2)
+        p *= 2;
+    return p;
+}
+
+/** @brief Set the arguments of a kernel and enqueue it.
+ * @param queue Command queue.
+ * @param kernel Kernel.
+ * @param args Arguments, as pairs of size and value pointer.
+ * @param global_work_size Global work size.
+ * @param local_work_size Local work size.
+ * @param events Events to be waited. The NULL ones are ignored.
+ * @param kernel_name Name of the kernel, to report errors
+ * @return Kernel event
+ */
+static cl_event enqueue(cl_command_queue queue,
+                        cl_kernel kernel,
+                        const std::vector<std::pair<size_t, const void*>> args,
+                        size_t global_work_size,
+                        size_t local_work_size,
+                        const std::vector<cl_event> events,
+                        const std::string kernel_name)
+{
+    cl_int err_code;
+    cl_event event;
+
+    for(unsigned int i = 0; i < args.size(); i++){
+        err_code = clSetKernelArg(kernel,
+                                  i,
+                                  args.at(i).first,
+                                  args.at(i).second);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure sending the argument " << i << " to \""
+                << kernel_name << "\"";
+            throw opencl_error(msg.str(), err_code);
+        }
+    }
+
+    std::vector<cl_event> wait_list;
+    for(auto e : events){
+        if(e)
+            wait_list.push_back(e);
+    }
+    err_code = clEnqueueNDRangeKernel(queue,
+                                      kernel,
+                                      1,
+                                      NULL,
+                                      &global_work_size,
+                                      &local_work_size,
+                                      wait_list.size(),
+                                      wait_list.size() ? wait_list.data() : NULL,
+                                      &event);
+    if(err_code != CL_SUCCESS) {
+        throw opencl_error("Failure executing \"" + kernel_name + "\"",
+                           err_code);
+    }
+
+    return event;
+}
+
+/** @brief Release an event.
+ * @param event Event.
+ * @param kernel_name Name of the kernel which generated the event, to report
+ * errors
+ */
+static void release(cl_event event, const std::string kernel_name)
+{
+    cl_int err_code = clReleaseEvent(event);
+    if(err_code != CL_SUCCESS) {
+        throw opencl_error("Failure releasing \"" + kernel_name + "\" event",
+                           err_code);
+    }
+}
+
+/** @brief Create a device buffer.
+ * @param context Context where the buffer is allocated.
+ * @param size Size in bytes.
+ * @return Memory object.
+ */
+static cl_mem buffer(cl_context context, size_t size)
+{
+    cl_int err_code;
+    cl_mem mem = clCreateBuffer(context,
+                                CL_MEM_READ_WRITE,
+                                size,
+                                NULL,
+                                &err_code);
+    if(err_code != CL_SUCCESS) {
+        std::ostringstream msg;
+        msg << "Failure allocating " << size << " bytes of device memory";
+        throw opencl_error(msg.str(), err_code);
+    }
+    return mem;
+}
+
+unsigned int tiles(const params &p, cl_uint n)
+{
+    return (n + p.items * p.kpt - 1) / (p.items * p.kpt);
+}
+
+void classicDims(cl_device_id device, const kernels &k, params &p)
+{
+    const unsigned int radix = 1u << p.bits;
+
+    // For the histogram and sort kernels, items can be used as the upper
+    // bound
+    const size_t max_items = std::min(
+        maxLocalSize(device, k.histogram, "histogram"),
+        maxLocalSize(device, k.sort, "sort"));
+    if(max_items < p.items)
+        p.items = max_items;
+    p.items = floorPowerOf2(p.items);
+
+    // The scan kernel can be used to set an upper bound to the number of
+    // histogram splits
+    const size_t scan_size = maxLocalSize(device, k.scan, "scan");
+    if(scan_size < p.histo_split / 2)
+        p.histo_split = 2 * scan_size;
+    p.histo_split = floorPowerOf2(p.histo_split);
+
+    // Finally using the scan and paste kernels we can adjust the groups,
+    // items and radix
+    const size_t max_size = std::min(scan_size,
+                                     maxLocalSize(device, k.paste, "paste"));
+    while(max_size < radix * p.groups * p.items / 2 / p.histo_split){
+        // We can't increase the histogram splits, so we may start decreasing
+        // the number of items
+        p.items /= 2;
+        if(p.items < __CL_MIN_LOCALSIZE__){
+            p.items = __CL_MIN_LOCALSIZE__;
+            break;
+        }
+    }
+    while(max_size < radix * p.groups * p.items / 2 / p.histo_split){
+        // We have reached the minimum possible number of items, so we can
+        // continue decreasing the number of groups
+        p.groups /= 2;
+        if(!p.groups){
+            p.groups = 1;
+            break;
+        }
+    }
+    if(max_size < radix * p.groups * p.items / 2 / p.histo_split){
+        // We can try to reduce the radix, but it is a bad business
+        throw opencl_error("Failure setting a number of items and groups "
+                           "compatible with \"scan\" and \"paste\"",
+                           CL_INVALID_WORK_GROUP_SIZE);
+    }
+}
+
+std::vector<params> candidates(cl_device_id device,
+                               const kernels &k,
+                               unsigned int bits)
+{
+    cl_ulong local_mem_size;
+    std::vector<params> result;
+    const unsigned int radix = 1u << bits;
+
+    const size_t max_items = maxLocalSize(device, k.onesweep, "onesweep");
+    cl_int err_code = clGetDeviceInfo(device,
+                                      CL_DEVICE_LOCAL_MEM_SIZE,
+                                      sizeof(cl_ulong),
+                                      &local_mem_size,
+                                      NULL);
+    if(err_code != CL_SUCCESS) {
+        throw opencl_error("Failure getting CL_DEVICE_LOCAL_MEM_SIZE",
+                           err_code);
+    }
+
+    for(auto items : {64u, 128u, 256u}){
+        if(items > max_items)
+            continue;
+        for(auto kpt : {4u, 8u, 16u}){
+            // Histograms, scan, offsets, 4 tile arrays and the tile index
+            const cl_ulong local_mem = sizeof(cl_uint) *
+                (radix * items + items + radix + 4 * items * kpt + 1);
+            if(local_mem > local_mem_size)
+                continue;
+            result.push_back({true, bits, items, 0, 0, kpt});
+        }
+    }
+    return result;
+}
+
+size_t allocate(cl_context context, const params &p, cl_uint n, mems &m)
+{
+    const unsigned int radix = 1u << p.bits;
+    size_t allocated = 4 * n * sizeof(cl_uint);
+
+    release(m);
+    m.in_keys = buffer(context, n * sizeof(cl_uint));
+    m.out_keys = buffer(context, n * sizeof(cl_uint));
+    m.in_permut = buffer(context, n * sizeof(cl_uint));
+    m.out_permut = buffer(context, n * sizeof(cl_uint));
+    if(p.onesweep){
+        // Radices counts and tiles counters of all the possible passes
+        const unsigned int n_pass = (32 + p.bits - 1) / p.bits;
+        const size_t counts_size = (n_pass * radix + n_pass) * sizeof(cl_uint);
+        const size_t status_size = 2 * tiles(p, n) * radix * sizeof(cl_uint);
+        m.counts = buffer(context, counts_size);
+        m.status = buffer(context, status_size);
+        return allocated + counts_size + status_size;
+    }
+
+    const size_t histograms_size = radix * p.groups * p.items * sizeof(cl_uint);
+    m.histograms = buffer(context, histograms_size);
+    m.global_sums = buffer(context, p.histo_split * sizeof(cl_uint));
+    m.temp = buffer(context, sizeof(cl_uint));
+    return allocated + histograms_size +
+           p.histo_split * sizeof(cl_uint) + sizeof(cl_uint);
+}
+
+void release(mems &m)
+{
+    for(auto mem : {&m.in_keys, &m.out_keys, &m.in_permut, &m.out_permut,
+                    &m.histograms, &m.global_sums, &m.temp, &m.counts,
+                    &m.status}){
+        if(*mem) clReleaseMemObject(*mem);
+        *mem = NULL;
+    }
+}
+
+cl_event passes(cl_command_queue queue,
+                const kernels &k,
+                mems &m,
+                const params &p,
+                cl_uint n,
+                cl_uint n_pass,
+                cl_event keys_event)
+{
+    if(p.onesweep)
+        return onesweep(queue, k, m, p, n, n_pass, keys_event);
+    return classic(queue, k, m, p, n, n_pass, keys_event);
+}
+
+cl_event classic(cl_command_queue queue,
+                 const kernels &k,
+                 mems &m,
+                 const params &p,
+                 cl_uint n,
+                 cl_uint n_pass,
+                 cl_event keys_event)
+{
+    cl_event event, perms_event;
+    const unsigned int radix = 1u << p.bits;
+    const size_t histo_size = radix * p.groups * p.items / 2;
+    const unsigned int cache = std::max(p.histo_split,
+                                        radix * p.groups * p.items /
+                                        p.histo_split);
+
+    perms_event = enqueue(queue,
+                          k.init,
+                          {{sizeof(cl_mem), &m.in_permut},
+                           {sizeof(cl_uint), &n}},
+                          ((n + p.items - 1) / p.items) * p.items,
+                          p.items,
+                          {},
+                          "init");
+
+    event = NULL;
+    for(cl_uint pass = 0; pass < n_pass; pass++){
+        cl_event histo_event = enqueue(
+            queue,
+            k.histogram,
+            {{sizeof(cl_mem), &m.in_keys},
+             {sizeof(cl_mem), &m.histograms},
+             {sizeof(cl_uint), &pass},
+             {sizeof(cl_uint) * radix * p.items, NULL},
+             {sizeof(cl_uint), &n}},
+            p.groups * p.items,
+            p.items,
+            {keys_event, event},
+            "histogram");
+        if(event)
+            release(event, "sort");
+
+        event = enqueue(queue,
+                        k.scan,
+                        {{sizeof(cl_mem), &m.histograms},
+                         {sizeof(cl_uint) * cache, NULL},
+                         {sizeof(cl_mem), &m.global_sums}},
+                        histo_size,
+                        histo_size / p.histo_split,
+                        {histo_event},
+                        "scan");
+        release(histo_event, "histogram");
+        histo_event = event;
+
+        event = enqueue(queue,
+                        k.scan,
+                        {{sizeof(cl_mem), &m.global_sums},
+                         {sizeof(cl_uint) * cache, NULL},
+                         {sizeof(cl_mem), &m.temp}},
+                        p.histo_split / 2,
+                        p.histo_split / 2,
+                        {histo_event},
+                        "scan");
+        release(histo_event, "scan");
+        histo_event = event;
+
+        event = enqueue(queue,
+                        k.paste,
+                        {{sizeof(cl_mem), &m.histograms},
+                         {sizeof(cl_mem), &m.global_sums}},
+                        histo_size,
+                        histo_size / p.histo_split,
+                        {histo_event},
+                        "paste");
+        release(histo_event, "scan");
+        histo_event = event;
+
+        event = enqueue(queue,
+                        k.sort,
+                        {{sizeof(cl_mem), &m.in_keys},
+                         {sizeof(cl_mem), &m.out_keys},
+                         {sizeof(cl_mem), &m.histograms},
+                         {sizeof(cl_uint), &pass},
+                         {sizeof(cl_mem), &m.in_permut},
+                         {sizeof(cl_mem), &m.out_permut},
+                         {sizeof(cl_uint) * radix * p.items, NULL},
+                         {sizeof(cl_uint), &n}},
+                        p.groups * p.items,
+                        p.items,
+                        {perms_event, histo_event},
+                        "sort");
+        release(histo_event, "paste");
+
+        // Swap the memory identifiers for the next pass
+        std::swap(m.in_keys, m.out_keys);
+        std::swap(m.in_permut, m.out_permut);
+    }
+    release(perms_event, "init");
+
+    return event;
+}
+
+cl_event onesweep(cl_command_queue queue,
+                  const kernels &k,
+                  mems &m,
+                  const params &p,
+                  cl_uint n,
+                  cl_uint n_pass,
+                  cl_event keys_event)
+{
+    cl_int err_code;
+    cl_event event, counts_event;
+    const cl_uint zero = 0;
+    const unsigned int radix = 1u << p.bits;
+    const cl_uint n_tiles = tiles(p, n);
+    const cl_uint n_status = n_tiles * radix;
+    const unsigned int n_counts = n_pass * radix + n_pass;
+    const unsigned int groups = std::min(n_tiles, 256u);
+    const size_t tile_size = sizeof(cl_uint) * p.items * p.kpt;
+
+    err_code = clEnqueueFillBuffer(queue,
+                                   m.counts,
+                                   &zero,
+                                   sizeof(cl_uint),
+                                   0,
+                                   n_counts * sizeof(cl_uint),
+                                   keys_event ? 1 : 0,
+                                   keys_event ? &keys_event : NULL,
+                                   &event);
+    if(err_code != CL_SUCCESS) {
+        throw opencl_error("Failure clearing the radices counts", err_code);
+    }
+
+    counts_event = enqueue(queue,
+                           k.counts,
+                           {{sizeof(cl_mem), &m.in_keys},
+                            {sizeof(cl_mem), &m.counts},
+                            {sizeof(cl_mem), &m.status},
+                            {sizeof(cl_uint) * n_pass * radix, NULL},
+                            {sizeof(cl_uint), &n_pass},
+                            {sizeof(cl_uint), &n_status},
+                            {sizeof(cl_uint), &n}},
+                           groups * p.items,
+                           p.items,
+                           {event},
+                           "digitCounts");
+    release(event, "clearing");
+
+    event = counts_event;
+    for(cl_uint pass = 0; pass < n_pass; pass++){
+        cl_event pass_event = enqueue(
+            queue,
+            k.onesweep,
+            {{sizeof(cl_mem), &m.in_keys},
+             {sizeof(cl_mem), &m.out_keys},
+             {sizeof(cl_mem), &m.in_permut},
+             {sizeof(cl_mem), &m.out_permut},
+             {sizeof(cl_mem), &m.counts},
+             {sizeof(cl_mem), &m.status},
+             {sizeof(cl_uint) * radix * p.items, NULL},
+             {sizeof(cl_uint) * p.items, NULL},
+             {sizeof(cl_uint) * radix, NULL},
+             {tile_size, NULL},
+             {tile_size, NULL},
+             {tile_size, NULL},
+             {tile_size, NULL},
+             {sizeof(cl_uint), &pass},
+             {sizeof(cl_uint), &n_pass},
+             {sizeof(cl_uint), &n_tiles},
+             {sizeof(cl_uint), &p.kpt},
+             {sizeof(cl_uint), &n}},
+            n_tiles * p.items,
+            p.items,
+            {event},
+            "onesweep");
+        release(event, pass ? "onesweep" : "digitCounts");
+        event = pass_event;
+
+        // Swap the memory identifiers for the next pass
+        std::swap(m.in_keys, m.out_keys);
+        std::swap(m.in_permut, m.out_permut);
+    }
+
+    return event;
+}
+
+}}}  // namespace
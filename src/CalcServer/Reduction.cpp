@@ -127,18 +127,33 @@ cl_event Reduction::_execute(const std::vector<cl_event> events_src)
         events.push_back(event);
     }
 
-    // Get back the result
+    // Get back the result. If the output is an array, it is kept on the
+    // device. Otherwise, it is asynchronously read, such that the host is not
+    // blocked until the value is actually required
     cl_uint num_events_in_wait_list = events.size();
     const cl_event *event_wait_list = events.size() ? events.data() : NULL;
-    err_code = clEnqueueReadBuffer(C->command_queue(),
-                                   _mems.at(_mems.size()-1),
-                                   CL_TRUE,
-                                   0,
-                                   _output_var->typesize(),
-                                   _output_var->get(),
-                                   num_events_in_wait_list,
-                                   event_wait_list,
-                                   &event);
+    if(_output_var->isArray()){
+        err_code = clEnqueueCopyBuffer(C->command_queue(),
+                                       _mems.at(_mems.size()-1),
+                                       *(cl_mem*)_output_var->get(),
+                                       0,
+                                       0,
+                                       vars->typeToBytes(_output_var->type()),
+                                       num_events_in_wait_list,
+                                       event_wait_list,
+                                       &event);
+    }
+    else{
+        err_code = clEnqueueReadBuffer(C->command_queue(),
+                                       _mems.at(_mems.size()-1),
+                                       CL_FALSE,
+                                       0,
+                                       _output_var->typesize(),
+                                       _output_var->get(),
+                                       num_events_in_wait_list,
+                                       event_wait_list,
+                                       &event);
+    }
     if(err_code != CL_SUCCESS) {
         std::ostringstream msg;
         msg << "Failure reading back the result within the tool \""
@@ -161,10 +176,13 @@ cl_event Reduction::_execute(const std::vector<cl_event> events_src)
         }
     }
 
-    // Ensure that the variable is populated, this is in fact a blocking
-    // operation
-    _output_var->setEvent(event);
-    vars->populate(_output_var);
+    // The array outputs are handled as regular dependencies. The scalar
+    // variables are marked as pending, and populated just when the
+    // tokenizer requires them
+    if(_output_var->isScalar()){
+        _output_var->setEvent(event);
+        vars->populateDeferred(_output_var);
+    }
 
     return event;
 }
@@ -197,15 +215,15 @@ void Reduction::variables()
         LOG(L_ERROR, msg.str());
         throw std::runtime_error("Invalid variable");
     }
-    if(vars->get(_output_name)->isArray()){
+    _output_var = vars->get(_output_name);
+    if(_output_var->isArray() && !_output_var->size()){
         std::stringstream msg;
         msg << "The tool \"" << name()
-            << "\" is asking the output variable \"" << _output_name
-            << "\", which is an array." << std::endl;
+            << "\" is asking the output array \"" << _output_name
+            << "\", which has not been allocated." << std::endl;
         LOG(L_ERROR, msg.str());
-        throw std::runtime_error("Invalid variable type");
+        throw std::runtime_error("Invalid variable length");
     }
-    _output_var = vars->get(_output_name);
     if(!vars->isSameType(_input_var->type(), _output_var->type())){
         std::stringstream msg;
         msg << "Mismatching input and output types within the tool \"" << name()
@@ -223,8 +241,14 @@ void Reduction::variables()
         throw std::runtime_error("Invalid variable type");
     }
 
-    // The scalar variable event is internally handled by the tool
-    std::vector<InputOutput::Variable*> deps = {_input_var};
+    // The input array is just read. The scalar output variable event is
+    // internally handled by the tool, while the array outputs are regular
+    // dependencies
+    std::vector<InputOutput::Variable*> inputs = {_input_var};
+    setInputs(inputs);
+    std::vector<InputOutput::Variable*> deps;
+    if(_output_var->isArray())
+        deps.push_back(_output_var);
     setDependencies(deps);
 }
 
@@ -366,13 +390,18 @@ cl_kernel Reduction::compile(const std::string source, size_t local_work_size)
     cl_kernel kernel;
     CalcServer *C = CalcServer::singleton();
 
+    // The output can be either a scalar or an array, so the type is taken
+    // from the input array
+    std::string type = trimCopy(_input_var->type());
+    type.pop_back();
+    type = trimCopy(type);
     std::ostringstream flags;
-    if(!_output_var->type().compare("unsigned int")){
+    if(!type.compare("unsigned int")){
         // Spaces are not a good business into definitions passed as args
         flags << "-DT=uint";
     }
     else{
-        flags << "-DT=" << _output_var->type();
+        flags << "-DT=" << type;
     }
     flags << " -DLOCAL_WORK_SIZE=" << local_work_size << "u";
     #ifdef AQUA_DEBUG
@@ -387,19 +416,12 @@ cl_kernel Reduction::compile(const std::string source, size_t local_work_size)
         flags << " -DHAVE_2D";
     #endif
 
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
         LOG(L_ERROR, "Failure creating the OpenCL program.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL compilation error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG0(L_ERROR, "Error compiling the source code\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
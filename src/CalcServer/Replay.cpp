@@ -0,0 +1,190 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Captured sequence of tools, which can be replayed with minimal host
+ * work.
+ * (See Aqua::CalcServer::Replay for details)
+ */
+
+#include <string.h>
+#include <map>
+#include <algorithm>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+#include <CalcServer/Replay.h>
+
+namespace Aqua{ namespace CalcServer{
+
+Replay::Replay(const std::vector<Tool*> tools)
+    : _tools(tools)
+{
+    // Resolve the state of the tools, and keep the values it depends on
+    std::map<InputOutput::Variable*, unsigned int> bound;
+    for(unsigned int i = 0; i < _tools.size(); i++) {
+        _tools.at(i)->capture();
+        for(auto var : _tools.at(i)->bindings()) {
+            if(bound.find(var) == bound.end()) {
+                bound[var] = _bindings.size();
+                const char *value = (const char*)var->get();
+                _bindings.push_back(
+                    {var, std::vector<char>(value, value + var->typesize()),
+                     {}});
+            }
+            _bindings.at(bound[var]).tools.push_back(i);
+        }
+    }
+
+    // Traverse the sequence tracking the last writer and the subsequent
+    // readers of each variable, following the same rules than
+    // Aqua::CalcServer::Tool::getEvents()
+    std::map<InputOutput::Variable*, outcome> states;
+    for(unsigned int i = 0; i < _tools.size(); i++) {
+        std::vector<dependency> deps;
+        auto add = [&deps](dependency dep) {
+            if(std::find(deps.begin(), deps.end(), dep) == deps.end())
+                deps.push_back(dep);
+        };
+
+        for(auto var : _tools.at(i)->getDependencies()) {
+            if(states.find(var) == states.end())
+                states[var] = {var, -1, {}};
+            outcome &state = states[var];
+            if(state.writer >= 0) {
+                add({state.writer, NULL, false});
+            }
+            else {
+                add({-1, var, false});
+                add({-1, var, true});
+            }
+            for(auto reader : state.readers)
+                add({reader, NULL, false});
+            state.writer = i;
+            state.readers.clear();
+        }
+        for(auto var : _tools.at(i)->getInputs()) {
+            if(states.find(var) == states.end())
+                states[var] = {var, -1, {}};
+            outcome &state = states[var];
+            if(state.writer >= 0)
+                add({state.writer, NULL, false});
+            else
+                add({-1, var, false});
+            state.readers.push_back(i);
+        }
+
+        _dependencies.push_back(deps);
+    }
+
+    for(auto state : states) {
+        _outcomes.push_back(state.second);
+    }
+
+    std::ostringstream msg;
+    msg << "Captured a sequence of " << _tools.size()
+        << " tools, starting at \"" << _tools.front()->name() << "\""
+        << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+Replay::~Replay()
+{
+}
+
+void Replay::execute()
+{
+    cl_int err_code;
+    std::vector<cl_event> events;
+
+    validate();
+
+    for(unsigned int i = 0; i < _tools.size(); i++) {
+        // The variables events are not modified until the end of the
+        // sequence, so they remain retained by the variables
+        std::vector<cl_event> wait_list;
+        auto add = [&wait_list](cl_event event) {
+            if(std::find(wait_list.begin(), wait_list.end(), event) ==
+               wait_list.end())
+                wait_list.push_back(event);
+        };
+        for(auto dep : _dependencies.at(i)) {
+            if(dep.tool >= 0)
+                add(events.at(dep.tool));
+            else if(!dep.readers)
+                add(dep.var->getWriterEvent());
+            else
+                for(auto event : dep.var->getReaderEvents())
+                    add(event);
+        }
+
+        cl_event event;
+        try {
+            event = _tools.at(i)->replay(wait_list);
+        } catch(std::runtime_error &e) {
+            for(auto captured : events)
+                clReleaseEvent(captured);
+            throw;
+        }
+        events.push_back(event);
+    }
+
+    // Update the variables events
+    for(auto state : _outcomes) {
+        if(state.writer >= 0)
+            state.var->setEvent(events.at(state.writer));
+        for(auto reader : state.readers)
+            state.var->addReaderEvent(events.at(reader));
+    }
+
+    for(auto event : events) {
+        err_code = clReleaseEvent(event);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure releasing the events of the sequence starting at \""
+                << _tools.front()->name() << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+    }
+}
+
+void Replay::validate()
+{
+    std::vector<bool> invalid(_tools.size(), false);
+    bool any_invalid = false;
+    for(auto &b : _bindings) {
+        const void *value = b.var->get();
+        if(!memcmp(b.value.data(), value, b.value.size()))
+            continue;
+        memcpy(b.value.data(), value, b.value.size());
+        for(auto i : b.tools)
+            invalid.at(i) = true;
+        any_invalid = true;
+    }
+    if(!any_invalid)
+        return;
+
+    for(unsigned int i = 0; i < _tools.size(); i++) {
+        if(invalid.at(i))
+            _tools.at(i)->capture();
+    }
+}
+
+}}  // namespace
@@ -25,6 +25,7 @@
 #include <iomanip>
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
+#include <InputOutput/WriterPool.h>
 #include <CalcServer.h>
 #include <CalcServer/Reports/Performance.h>
 
@@ -64,7 +65,8 @@ void Performance::setup()
         _f.open(_output_file.c_str(), std::ios::out);
         // Write the header
         _f << "# t elapsed average(elapsed) variance(elapsed) "
-           << "overhead average(overhead) variance(overhead) progress ETA"
+           << "overhead average(overhead) variance(overhead) progress ETA "
+           << "writers_depth writers_throughput(MB/s)"
            << std::endl;
     }
 
@@ -129,6 +131,23 @@ cl_event Performance::_execute(const std::vector<cl_event> events)
     data << "Overhead=" << std::setw(16) << elapsedTime() - elapsed_ave
          << "s" << std::endl;
 
+    // Writing threads status
+    InputOutput::WriterPool *writers = InputOutput::WriterPool::singleton();
+    unsigned int writers_depth = 0;
+    float writers_throughput = 0.f;
+    if(writers){
+        writers_depth = writers->depth();
+        writers_throughput = writers->throughput() / (1024.f * 1024.f);
+        data << "Writers=" << std::setw(10) << writers_depth << "/"
+             << writers->capacity() << "  (" << writers_throughput
+             << "MB/s";
+        if(writers->skipped())
+            data << ", " << writers->skipped() << " skipped";
+        if(writers->spilled())
+            data << ", " << writers->spilled() << " spilled";
+        data << ")" << std::endl;
+    }
+
     // Compute the progress
     InputOutput::Variables *vars = C->variables();
     float progress = 0.f;
@@ -167,7 +186,8 @@ cl_event Performance::_execute(const std::vector<cl_event> events)
            << elapsedTimeVariance() << " "
            << elapsedTime(false) - elapsed << " "
            << elapsedTime() - elapsed_ave << " "
-           << progress * 100.f << " " << ETA << std::endl;
+           << progress * 100.f << " " << ETA << " "
+           << writers_depth << " " << writers_throughput << std::endl;
     }
 
     return NULL;
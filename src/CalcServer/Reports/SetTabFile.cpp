@@ -21,21 +21,69 @@
  * (See Aqua::CalcServer::Reports::SetTabFile for details)
  */
 
+#include <algorithm>
+#include <cstring>
+
+#include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
 #include <CalcServer.h>
 #include <CalcServer/Reports/SetTabFile.h>
 
+#ifndef SETTAB_MAGIC
+    #define SETTAB_MAGIC "AQUAtab"
+#endif // SETTAB_MAGIC
+
+#ifndef SETTAB_VERSION
+    #define SETTAB_VERSION 1
+#endif // SETTAB_VERSION
+
 namespace Aqua{ namespace CalcServer{ namespace Reports{
 
+/** @brief Binary file head
+ */
+typedef struct{
+    /// Magic string, SETTAB_MAGIC
+    char magic[8];
+    /// Format version, SETTAB_VERSION
+    uint32_t version;
+    /// Number of particles
+    uint32_t n;
+    /// Number of fields
+    uint32_t n_fields;
+    /// Row length in bytes
+    uint32_t row_bytes;
+}settab_head;
+
+/** @brief Binary field record
+ */
+typedef struct{
+    /// Field name
+    char name[64];
+    /// Field type name
+    char type[32];
+    /// Type size in bytes
+    uint32_t typesize;
+    /// Field offset in the rows
+    uint32_t offset;
+}settab_field;
+
 SetTabFile::SetTabFile(const std::string tool_name,
                        const std::string fields,
                        unsigned int first,
                        unsigned int n,
                        const std::string output_file,
                        unsigned int ipf,
-                       float fps)
+                       float fps,
+                       const std::string ids,
+                       bool binary,
+                       unsigned int flush)
     : Report(tool_name, fields, ipf, fps)
     , _output_file(output_file)
+    , _ids_str(ids)
+    , _map(NULL)
+    , _binary(binary)
+    , _flush(flush ? flush : 1)
+    , _rows(0)
 {
     _bounds.x = first;
     _bounds.y = first + n;
@@ -44,6 +92,7 @@ SetTabFile::SetTabFile(const std::string tool_name,
 SetTabFile::~SetTabFile()
 {
     if(_f.is_open()) _f.close();
+    if(_map) clReleaseMemObject(_map); _map=NULL;
 }
 
 void SetTabFile::setup()
@@ -54,16 +103,25 @@ void SetTabFile::setup()
     msg << "Loading the report \"" << name() << "\"..." << std::endl;
     LOG(L_INFO, msg.str());
 
-    _f.open(_output_file.c_str(), std::ios::out);
+    if(_binary)
+        _f.open(_output_file.c_str(), std::ios::out | std::ios::binary);
+    else
+        _f.open(_output_file.c_str(), std::ios::out);
 
     Report::setup();
+    selection(_ids_str);
 
     // Write the header
+    if(_binary){
+        binaryHeader();
+        return;
+    }
     _f << "# Time ";
     std::vector<InputOutput::Variable*> vars = variables();
-    for(i = _bounds.x; i < _bounds.y; i++){
+    for(i = 0; i < nParticles(); i++){
+        unsigned int id = _bounds.x + (_ids.size() ? _ids.at(i) : i);
         for(auto var : vars){
-            _f << var->name() << "_" << i;
+            _f << var->name() << "_" << id << " ";
         }
     }
     _f << std::endl;
@@ -77,12 +135,8 @@ cl_event SetTabFile::_execute(const std::vector<cl_event> events)
     }
 
     unsigned int i, j;
-    cl_int err_code;
     CalcServer *C = CalcServer::singleton();
 
-    // Print the time instant
-    _f << C->variables()->get("t")->asString() << " ";
-
     // Get the data to be printed
     std::vector<InputOutput::Variable*> vars = variables();
     for(auto var : vars){
@@ -108,8 +162,17 @@ cl_event SetTabFile::_execute(const std::vector<cl_event> events)
     }
     std::vector<void*> data = download(vars);
 
+    if(_binary){
+        binaryRow(data);
+        clearList(&data);
+        return NULL;
+    }
+
+    // Print the time instant
+    _f << C->variables()->get("t")->asString() << " ";
+
     // Print the data
-    for(i = 0; i < bounds().y - bounds().x; i++){
+    for(i = 0; i < nParticles(); i++){
         for(j = 0; j < vars.size(); j++){
             InputOutput::ArrayVariable *var = (InputOutput::ArrayVariable*)vars.at(j);
             const std::string type_name = var->type();
@@ -221,12 +284,12 @@ cl_event SetTabFile::_execute(const std::vector<cl_event> events)
         }
     }
     _f << std::endl;
-    _f.flush();
-
-    for(i = 0; i < vars.size(); i++){
-        free(data.at(i)); data.at(i) = NULL;
+    if(++_rows >= _flush){
+        _f.flush();
+        _rows = 0;
     }
-    data.clear();
+
+    clearList(&data);
 
     return NULL;
 }
@@ -234,7 +297,7 @@ cl_event SetTabFile::_execute(const std::vector<cl_event> events)
 std::vector<void*> SetTabFile::download(std::vector<InputOutput::Variable*> vars)
 {
     std::vector<void*> data;
-    std::vector<cl_event> events;  // vector storage is continuous memory
+    std::vector<std::string> names;
     size_t typesize, len;
     cl_int err_code;
     CalcServer *C = CalcServer::singleton();
@@ -249,53 +312,51 @@ std::vector<void*> SetTabFile::download(std::vector<InputOutput::Variable*> vars
                 << var->name() << "\" because is not long enough."
                 << std::endl;
             LOG(L_ERROR, msg.str());
-            clearList(&data);
             throw std::runtime_error("Invalid variable type");
         }
-        void *store = malloc(typesize * (bounds().y - bounds().x));
-        if(!store){
-            std::stringstream msg;
-            msg << "Failure allocating " << typesize * (bounds().y - bounds().x)
-                << " bytes for the field \"" << var->name()
-                << "\"." << std::endl;
-            clearList(&data);
-            throw std::bad_alloc();
-        }
-        data.push_back(store);
-
-        cl_event event;
-        try {
-            event = C->getUnsortedMem(var->name().c_str(),
-                                      typesize * bounds().x,
-                                      typesize * (bounds().y - bounds().x),
-                                      store);
-        } catch(...) {
-            clearList(&data);
-            throw;
-        }
+        names.push_back(var->name());
+    }
 
-        events.push_back(event);
+    cl_event event;
+    if(_map){
+        event = C->getGatheredMem(names,
+                                  bounds().x,
+                                  bounds().y - bounds().x,
+                                  _map,
+                                  _ids.size(),
+                                  data);
+    }
+    else{
+        event = C->getUnsortedMem(names,
+                                  bounds().x,
+                                  bounds().y - bounds().x,
+                                  data);
+    }
+    if(!event){
+        std::stringstream msg;
+        msg << "The report \"" << name()
+            << "\" failed downloading the fields." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("OpenCL error");
     }
 
     // Wait until all the data has been downloaded
-    err_code = clWaitForEvents(events.size(),
-                               events.data());
+    err_code = clWaitForEvents(1, &event);
     if(err_code != CL_SUCCESS){
         LOG(L_ERROR, "Failure waiting for the variables download.\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clReleaseEvent(event);
         clearList(&data);
         throw std::runtime_error("OpenCL error");
     }
 
-    // Destroy the events
-    for(auto event : events){
-        err_code = clReleaseEvent(event);
-        if(err_code != CL_SUCCESS){
-            LOG(L_ERROR, "Failure releasing the events.\n");
-            InputOutput::Logger::singleton()->printOpenCLError(err_code);
-            clearList(&data);
-            throw std::runtime_error("OpenCL error");
-        }
+    // Destroy the event
+    err_code = clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure releasing the event.\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        clearList(&data);
+        throw std::runtime_error("OpenCL error");
     }
 
     return data;
@@ -303,11 +364,148 @@ std::vector<void*> SetTabFile::download(std::vector<InputOutput::Variable*> vars
 
 void SetTabFile::clearList(std::vector<void*> *data)
 {
+    StagingPool *staging = CalcServer::singleton()->staging();
     for(auto d : *data){
         if(d)
-            free(d);
+            staging->release(d);
     }
     data->clear();
 }
 
+void SetTabFile::selection(const std::string ids)
+{
+    cl_int err_code;
+    CalcServer *C = CalcServer::singleton();
+    const unsigned int n = _bounds.y - _bounds.x;
+
+    _ids.clear();
+    std::istringstream tokens(replaceAllCopy(ids, " ", ","));
+    std::string token;
+    while(getline(tokens, token, ',')){
+        if(token == "")
+            continue;
+        unsigned int id_first, id_last;
+        try {
+            size_t dash = token.find('-');
+            id_first = std::stoul(token.substr(0, dash));
+            id_last = (dash == std::string::npos) ?
+                      id_first : std::stoul(token.substr(dash + 1));
+        } catch(std::exception &e) {
+            std::ostringstream msg;
+            msg << "The report \"" << name()
+                << "\" cannot parse the particles selection \"" << token
+                << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid particles selection");
+        }
+        if((id_last < id_first) || (id_last >= n)){
+            std::ostringstream msg;
+            msg << "The report \"" << name()
+                << "\" selected the particles \"" << token
+                << "\", but the set has " << n << " particles." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid particles selection");
+        }
+        for(unsigned int id = id_first; id <= id_last; id++)
+            _ids.push_back(id);
+    }
+    if(!_ids.size())
+        return;
+
+    // Build the map with the position of each particle in the downloaded
+    // data, rejecting the repeated ones
+    std::vector<cl_uint> map(n, 0xFFFFFFFF);
+    for(unsigned int i = 0; i < _ids.size(); i++){
+        if(map.at(_ids.at(i)) != 0xFFFFFFFF){
+            std::ostringstream msg;
+            msg << "The report \"" << name()
+                << "\" selected the particle " << _ids.at(i)
+                << " several times." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid particles selection");
+        }
+        map.at(_ids.at(i)) = i;
+    }
+
+    _map = clCreateBuffer(C->context(),
+                          CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                          n * sizeof(cl_uint),
+                          map.data(),
+                          &err_code);
+    if(err_code != CL_SUCCESS){
+        std::ostringstream msg;
+        msg << "Failure allocating the particles selection of the report \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL allocation error");
+    }
+
+    std::ostringstream msg;
+    msg << "The report \"" << name() << "\" is printing " << _ids.size()
+        << " particles of " << n << "." << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+void SetTabFile::binaryHeader()
+{
+    unsigned int i;
+    CalcServer *C = CalcServer::singleton();
+    std::vector<InputOutput::Variable*> vars = variables();
+
+    std::vector<settab_field> fields;
+    uint32_t offset = sizeof(float);
+    for(auto var : vars){
+        settab_field field;
+        memset(&field, 0, sizeof(settab_field));
+        strncpy(field.name, var->name().c_str(), sizeof(field.name) - 1);
+        strncpy(field.type, var->type().c_str(), sizeof(field.type) - 1);
+        field.typesize = C->variables()->typeToBytes(var->type());
+        field.offset = offset;
+        offset += field.typesize * nParticles();
+        fields.push_back(field);
+    }
+
+    settab_head head;
+    memset(&head, 0, sizeof(settab_head));
+    strcpy(head.magic, SETTAB_MAGIC);
+    head.version = SETTAB_VERSION;
+    head.n = nParticles();
+    head.n_fields = fields.size();
+    head.row_bytes = offset;
+
+    std::vector<uint32_t> ids;
+    for(i = 0; i < nParticles(); i++)
+        ids.push_back(_bounds.x + (_ids.size() ? _ids.at(i) : i));
+
+    _f.write((const char*)&head, sizeof(settab_head));
+    _f.write((const char*)fields.data(), fields.size() * sizeof(settab_field));
+    _f.write((const char*)ids.data(), ids.size() * sizeof(uint32_t));
+    _f.flush();
+}
+
+void SetTabFile::binaryRow(const std::vector<void*> data)
+{
+    CalcServer *C = CalcServer::singleton();
+    std::vector<InputOutput::Variable*> vars = variables();
+
+    float t = *(float*)C->variables()->get("t")->get();
+    _f.write((const char*)&t, sizeof(float));
+    for(unsigned int i = 0; i < vars.size(); i++){
+        size_t typesize = C->variables()->typeToBytes(vars.at(i)->type());
+        _f.write((const char*)data.at(i), typesize * nParticles());
+    }
+    if(!_f.good()){
+        std::ostringstream msg;
+        msg << "Failure writing the report \"" << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Failure writing the report");
+    }
+
+    if(++_rows >= _flush){
+        _f.flush();
+        _rows = 0;
+    }
+}
+
 }}} // namespace
@@ -35,11 +35,15 @@ SetScalar::SetScalar(const std::string name,
     , _var_name(var_name)
     , _value(value)
     , _var(NULL)
+    , _expr(NULL)
+    , _data(NULL)
 {
 }
 
 SetScalar::~SetScalar()
 {
+    if(_expr) delete _expr; _expr = NULL;
+    if(_data) free(_data); _data = NULL;
 }
 
 void SetScalar::setup()
@@ -50,15 +54,12 @@ void SetScalar::setup()
 
     Tool::setup();
     variable();
-}
-
-
-cl_event SetScalar::_execute(const std::vector<cl_event> events)
-{
-    InputOutput::Variables *vars = CalcServer::singleton()->variables();
-
-    void *data = malloc(_var->typesize());
-    if(!data){
+    _expr = new InputOutput::Expression(CalcServer::singleton()->variables(),
+                                        _var->type(),
+                                        _value,
+                                        _var->name());
+    _data = malloc(_var->typesize());
+    if(!_data){
         std::stringstream msg;
         msg << "Failure allocating " << _var->typesize()
             << " bytes for the variable \""
@@ -66,18 +67,18 @@ cl_event SetScalar::_execute(const std::vector<cl_event> events)
         LOG(L_ERROR, msg.str());
         throw std::bad_alloc();
     }
+}
 
-    try {
-        vars->solve(_var->type(), _value, data, _var->name());
-    } catch(...) {
-        free(data);
-        throw;
-    }
 
-    _var->set(data);
-    free(data);
-    // Ensure that the variable is populated
-    vars->populate(_var);
+cl_event SetScalar::_execute(const std::vector<cl_event> events)
+{
+    InputOutput::Variables *vars = CalcServer::singleton()->variables();
+
+    _expr->solve(_data);
+    _var->set(_data);
+    // The compiled expressions are reading the variable by pointer, so just
+    // the tokenizer users which are not compiled yet require the new value
+    vars->populateDeferred(_var);
 
     return NULL;
 }
@@ -0,0 +1,316 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Index of the OpenCL kernels arguments.
+ * (See Aqua::CalcServer::SignatureIndex for details)
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+#include <clang-c/Index.h>
+#include <clang-c/Platform.h>
+
+#include <AuxiliarMethods.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer/SignatureIndex.h>
+
+namespace Aqua{ namespace CalcServer{
+
+/** @brief Main traverse method, which will parse all tokens except functions
+ * declarations.
+ * @param cursor the cursor whose child may be visited. All kinds of cursors can
+ * be visited, including invalid cursors (which, by definition, have no
+ * children).
+ * @param parent the visitor function that will be invoked for each child of
+ * parent.
+ * @param client_data pointer data supplied by the client, which will be passed
+ * to the visitor each time it is invoked.
+ * @return CXChildVisit_Continue if a function declaration is found,
+ * CXChildVisit_Recurse otherwise.
+ */
+CXChildVisitResult cursorVisitor(CXCursor cursor,
+                                 CXCursor parent,
+                                 CXClientData client_data);
+
+/** Method traverse method, which will parse the input arguments.
+ * @param cursor the cursor whose child may be visited. All kinds of cursors can
+ * be visited, including invalid cursors (which, by definition, have no
+ * children).
+ * @param parent the visitor function that will be invoked for each child of
+ * parent.
+ * @param client_data pointer data supplied by the client, which will be passed
+ * to the visitor each time it is invoked.
+ * @return CXChildVisit_Continue.
+ */
+CXChildVisitResult functionDeclVisitor(CXCursor cursor,
+                                       CXCursor parent,
+                                       CXClientData client_data);
+
+/** @struct clientData
+ * @brief Data structure to store the signatures of the functions found.
+ */
+struct clientData{
+    /// Translation unit
+    CXTranslationUnit translation_unit;
+    /// List of signatures
+    std::vector<SignatureIndex::signature> sigs;
+};
+
+/** @brief Version of the signatures files format, to be added to the key
+ */
+#define SIGNATURES_FORMAT_VERSION "2"
+
+SignatureIndex::SignatureIndex(const std::string path)
+    : _path(path)
+{
+    if(_path.empty())
+        return;
+    if(!makeFolder(_path)){
+        std::ostringstream msg;
+        msg << "Failure creating the kernels signatures folder \"" << _path
+            << "\". They will not be stored" << std::endl;
+        LOG(L_WARNING, msg.str());
+        _path = "";
+    }
+}
+
+SignatureIndex::~SignatureIndex()
+{
+}
+
+unsigned int SignatureIndex::get(const std::string file_path,
+                                 const std::string entry_point,
+                                 std::vector<std::string> &args,
+                                 std::vector<bool> &read_only)
+{
+    unsigned int entry_points = 0;
+    for(auto sig : signatures(file_path)) {
+        if(sig.name.compare(entry_point))
+            continue;
+        entry_points++;
+        args = sig.args;
+        read_only = sig.read_only;
+    }
+    return entry_points;
+}
+
+const std::vector<SignatureIndex::signature>& SignatureIndex::signatures(
+    const std::string file_path)
+{
+    auto it = _index.find(file_path);
+    if(it != _index.end())
+        return it->second;
+
+    std::string sig_path = "";
+    if(!_path.empty()) {
+        std::ifstream f(file_path, std::ios::in | std::ios::binary);
+        std::string source((std::istreambuf_iterator<char>(f)),
+                            std::istreambuf_iterator<char>());
+        f.close();
+        CXString version = clang_getClangVersion();
+        uint64_t hash = hashString(clang_getCString(version));
+        clang_disposeString(version);
+        hash = hashString(SIGNATURES_FORMAT_VERSION, hash);
+        hash = hashString(source, hash);
+        // The included files may change the arguments types as well
+        hash = hashIncludes(source,
+                            getFolderFromFilePath(file_path),
+                            std::vector<std::string>(),
+                            hash);
+        std::ostringstream hex;
+        hex << std::hex << std::setfill('0') << std::setw(16) << hash;
+        sig_path = _path + "/" + hex.str() + ".sig";
+
+        std::vector<signature> sigs;
+        if(load(sig_path, sigs)) {
+            _index[file_path] = sigs;
+            return _index[file_path];
+        }
+    }
+
+    _index[file_path] = parse(file_path);
+    if(!sig_path.empty())
+        save(sig_path, _index[file_path]);
+    return _index[file_path];
+}
+
+std::vector<SignatureIndex::signature> SignatureIndex::parse(
+    const std::string file_path)
+{
+    std::ostringstream msg;
+    msg << "Parsing the kernels signatures of \"" << file_path << "\"..."
+        << std::endl;
+    LOG(L_INFO, msg.str());
+
+    CXIndex index = clang_createIndex(0, 0);
+    if(index == 0){
+        LOG(L_ERROR, "Failure creating parser index.\n");
+        throw std::runtime_error("clang initialization failure");
+    }
+
+    int argc = 2;
+    const char* argv[2] = {"Kernel", file_path.c_str()};
+    CXTranslationUnit translation_unit = clang_parseTranslationUnit(
+        index,
+        0,
+        argv,
+        argc,
+        NULL,
+        0,
+        CXTranslationUnit_None);
+    if(translation_unit == 0){
+        LOG(L_ERROR, "Failure parsing the source code.\n");
+        clang_disposeIndex(index);
+        throw std::runtime_error("clang parsing error");
+    }
+
+    CXCursor root_cursor = clang_getTranslationUnitCursor(translation_unit);
+    struct clientData client_data;
+    client_data.translation_unit = translation_unit;
+    clang_visitChildren(root_cursor, *cursorVisitor, &client_data);
+
+    clang_disposeTranslationUnit(translation_unit);
+    clang_disposeIndex(index);
+
+    return client_data.sigs;
+}
+
+bool SignatureIndex::load(const std::string sig_path,
+                          std::vector<signature> &sigs)
+{
+    if(!isFile(sig_path))
+        return false;
+
+    // Each line contains the function name, followed by its arguments. The
+    // read-only arguments are suffixed by ":const"
+    std::ifstream f(sig_path);
+    std::string line;
+    while(std::getline(f, line)) {
+        std::istringstream tokens(line);
+        std::string token;
+        if(!(tokens >> token))
+            continue;
+        signature sig;
+        sig.name = token;
+        while(tokens >> token) {
+            bool read_only = hasSuffix(token, ":const");
+            if(read_only)
+                token = token.substr(0, token.size() - 6);
+            sig.args.push_back(token);
+            sig.read_only.push_back(read_only);
+        }
+        sigs.push_back(sig);
+    }
+    return !f.bad();
+}
+
+void SignatureIndex::save(const std::string sig_path,
+                          const std::vector<signature> &sigs)
+{
+    // Write in a temporary file, and rename it afterwards. That way several
+    // simultaneous runs would not produce corrupted files
+    std::ostringstream tmp_path;
+    tmp_path << sig_path << "." << getpid() << ".tmp";
+    std::ofstream f(tmp_path.str());
+    for(auto sig : sigs) {
+        f << sig.name;
+        for(unsigned int i = 0; i < sig.args.size(); i++) {
+            f << " " << sig.args.at(i);
+            if(sig.read_only.at(i))
+                f << ":const";
+        }
+        f << std::endl;
+    }
+    f.close();
+    if(!f || rename(tmp_path.str().c_str(), sig_path.c_str())) {
+        std::ostringstream msg;
+        msg << "Failure writing the kernels signatures \"" << sig_path
+            << "\"" << std::endl;
+        LOG(L_WARNING, msg.str());
+        remove(tmp_path.str().c_str());
+    }
+}
+
+CXChildVisitResult cursorVisitor(CXCursor cursor,
+                                 CXCursor parent,
+                                 CXClientData client_data)
+{
+    struct clientData *data = (struct clientData *)client_data;
+    CXCursorKind kind = clang_getCursorKind(cursor);
+    if (kind == CXCursor_FunctionDecl ||
+        kind == CXCursor_ObjCInstanceMethodDecl)
+    {
+        CXString name = clang_getCursorSpelling(cursor);
+        SignatureIndex::signature sig;
+        sig.name = clang_getCString(name);
+        data->sigs.push_back(sig);
+        clang_disposeString(name);
+        clang_visitChildren(cursor, *functionDeclVisitor, client_data);
+        return CXChildVisit_Continue;
+    }
+    return CXChildVisit_Recurse;
+}
+
+CXChildVisitResult functionDeclVisitor(CXCursor cursor,
+                                       CXCursor parent,
+                                       CXClientData client_data)
+{
+    struct clientData *data = (struct clientData *)client_data;
+    CXCursorKind kind = clang_getCursorKind(cursor);
+    if (kind == CXCursor_ParmDecl){
+        CXString name = clang_getCursorSpelling(cursor);
+        data->sigs.back().args.push_back(clang_getCString(name));
+        clang_disposeString(name);
+
+        // Look for the qualifiers in the tokens, which works even if the
+        // types cannot be resolved (e.g. missing includes)
+        bool is_pointer = false, is_const = false, is_constant = false;
+        CXToken *tokens = NULL;
+        unsigned int n_tokens = 0;
+        clang_tokenize(data->translation_unit,
+                       clang_getCursorExtent(cursor),
+                       &tokens,
+                       &n_tokens);
+        for(unsigned int i = 0; i < n_tokens; i++){
+            CXString token = clang_getTokenSpelling(data->translation_unit,
+                                                    tokens[i]);
+            std::string spelling = clang_getCString(token);
+            clang_disposeString(token);
+            if(!spelling.compare("*"))
+                is_pointer = true;
+            else if(!spelling.compare("const") && !is_pointer)
+                is_const = true;
+            else if(!spelling.compare("__constant") ||
+                    !spelling.compare("constant"))
+                is_constant = true;
+        }
+        if(tokens)
+            clang_disposeTokens(data->translation_unit, tokens, n_tokens);
+        data->sigs.back().read_only.push_back(
+            !is_pointer || is_const || is_constant);
+    }
+    return CXChildVisit_Continue;
+}
+
+}}  // namespaces
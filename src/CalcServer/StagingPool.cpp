@@ -0,0 +1,131 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pool of pinned host buffers, to download data from the device.
+ * (See Aqua::CalcServer::StagingPool for details)
+ */
+
+#include <sstream>
+#include <stdexcept>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer/StagingPool.h>
+
+namespace Aqua{ namespace CalcServer{
+
+StagingPool::StagingPool(cl_context context, cl_command_queue queue)
+    : _context(context)
+    , _queue(queue)
+    , _allocated(0)
+{
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+StagingPool::~StagingPool()
+{
+    for(auto buf : _buffers){
+        clEnqueueUnmapMemObject(_queue, buf.mem, buf.ptr, 0, NULL, NULL);
+    }
+    clFinish(_queue);
+    for(auto buf : _buffers){
+        clReleaseMemObject(buf.mem);
+    }
+    _buffers.clear();
+    pthread_mutex_destroy(&_mutex);
+}
+
+void* StagingPool::acquire(size_t size, unsigned int users)
+{
+    cl_int err_code;
+
+    pthread_mutex_lock(&_mutex);
+    buffer *best = NULL;
+    for(auto &buf : _buffers){
+        if(buf.users || (buf.size < size))
+            continue;
+        if(!best || (buf.size < best->size))
+            best = &buf;
+    }
+    if(best){
+        best->users = users;
+        void *ptr = best->ptr;
+        pthread_mutex_unlock(&_mutex);
+        return ptr;
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    // A new buffer shall be allocated
+    buffer buf;
+    buf.size = size;
+    buf.users = users;
+    buf.mem = clCreateBuffer(_context,
+                             CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                             size,
+                             NULL,
+                             &err_code);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure allocating " << size
+            << " bytes of pinned host memory." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::bad_alloc();
+    }
+    buf.ptr = clEnqueueMapBuffer(_queue,
+                                 buf.mem,
+                                 CL_TRUE,
+                                 CL_MAP_READ | CL_MAP_WRITE,
+                                 0,
+                                 size,
+                                 0,
+                                 NULL,
+                                 NULL,
+                                 &err_code);
+    if(err_code != CL_SUCCESS){
+        clReleaseMemObject(buf.mem);
+        std::stringstream msg;
+        msg << "Failure mapping " << size
+            << " bytes of pinned host memory." << std::endl;
+        LOG(L_ERROR, msg.str());
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _buffers.push_back(buf);
+    _allocated += size;
+    pthread_mutex_unlock(&_mutex);
+    return buf.ptr;
+}
+
+void StagingPool::release(void *ptr)
+{
+    pthread_mutex_lock(&_mutex);
+    for(auto &buf : _buffers){
+        if(((char*)ptr >= (char*)buf.ptr) &&
+           ((char*)ptr < (char*)buf.ptr + buf.size)){
+            if(buf.users)
+                buf.users--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+}}  // namespace
@@ -0,0 +1,175 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Arrays swapping tool.
+ * (see Aqua::CalcServer::Swap for details)
+ */
+
+#include <vector>
+
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+#include <CalcServer/Swap.h>
+
+namespace Aqua{ namespace CalcServer{
+
+Swap::Swap(const std::string name,
+           const std::string input_name,
+           const std::string output_name,
+           bool once)
+    : Tool(name, once)
+    , _input_name(input_name)
+    , _output_name(output_name)
+    , _input_var(NULL)
+    , _output_var(NULL)
+{
+}
+
+Swap::~Swap()
+{
+}
+
+void Swap::setup()
+{
+    std::ostringstream msg;
+    msg << "Loading the tool \"" << name() << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    Tool::setup();
+    variables();
+}
+
+
+cl_event Swap::_execute(const std::vector<cl_event> events)
+{
+    cl_int err_code;
+    InputOutput::ArrayVariable *vars[2] = {_input_var, _output_var};
+    cl_mem mems[2];
+    cl_event writers[2];
+    std::vector<cl_event> readers[2];
+
+    // Keep the events retained while they are exchanged
+    for(unsigned int i = 0; i < 2; i++){
+        mems[i] = *(cl_mem*)vars[i]->get();
+        writers[i] = vars[i]->getWriterEvent();
+        readers[i] = vars[i]->getReaderEvents();
+        std::vector<cl_event> retained = readers[i];
+        retained.push_back(writers[i]);
+        for(auto event : retained){
+            err_code = clRetainEvent(event);
+            if(err_code != CL_SUCCESS){
+                std::stringstream msg;
+                msg << "Failure retaining the events in the tool \"" <<
+                       name() << "\"." << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL execution error");
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < 2; i++){
+        vars[i]->set(&mems[1 - i]);
+        vars[i]->setEvent(writers[1 - i]);
+        for(auto event : readers[1 - i])
+            vars[i]->addReaderEvent(event);
+    }
+
+    for(unsigned int i = 0; i < 2; i++){
+        std::vector<cl_event> retained = readers[i];
+        retained.push_back(writers[i]);
+        for(auto event : retained){
+            err_code = clReleaseEvent(event);
+            if(err_code != CL_SUCCESS){
+                std::stringstream msg;
+                msg << "Failure releasing the events in the tool \"" <<
+                       name() << "\"." << std::endl;
+                LOG(L_ERROR, msg.str());
+                InputOutput::Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL execution error");
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void Swap::variables()
+{
+    CalcServer *C = CalcServer::singleton();
+    InputOutput::Variables *vars = C->variables();
+    const std::string names[2] = {_input_name, _output_name};
+    InputOutput::ArrayVariable **var_ptrs[2] = {&_input_var, &_output_var};
+    for(unsigned int i = 0; i < 2; i++){
+        if(!vars->get(names[i])){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" is asking the undeclared variable \""
+                << names[i] << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        if(vars->get(names[i])->type().find('*') == std::string::npos){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" may not use a scalar variable (\""
+                << names[i] << "\")." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable type");
+        }
+        *(var_ptrs[i]) = (InputOutput::ArrayVariable *)vars->get(names[i]);
+    }
+
+    if(!vars->isSameType(_input_var->type(), _output_var->type())){
+        std::stringstream msg;
+        msg << "The input and output types mismatch for the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\tInput variable \"" << _input_var->name()
+            << "\" is of type \"" << _input_var->type() << "\"" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        msg.str("");
+        msg << "\tOutput variable \"" << _output_var->name()
+            << "\" is of type \"" << _output_var->type() << "\"" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Incompatible types");
+    }
+    // The memory objects are exchanged, so they should have the same size
+    if(_input_var->size() != _output_var->size()){
+        std::stringstream msg;
+        msg << "Input and output lengths mismatch for the tool \""
+            << name() << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << "\tInput variable \"" << _input_var->name()
+            << "\" has " << _input_var->size() << " bytes" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        msg.str("");
+        msg << "\tOutput variable \"" << _output_var->name()
+            << "\" has " << _output_var->size() << " bytes" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Incompatible lenghts");
+    }
+
+    std::vector<InputOutput::Variable*> deps = {_input_var, _output_var};
+    setDependencies(deps);
+}
+
+}}  // namespaces
@@ -81,6 +81,10 @@ void Tool::execute()
         for(auto it = vars.begin(); it < vars.end(); it++){
             (*it)->setEvent(event);
         }
+        // And register it as a reader of the inputs
+        for(auto it = _inputs.begin(); it < _inputs.end(); it++){
+            (*it)->addReaderEvent(event);
+        }
 
         // Release the event now that it is retained by its users
         err_code = clReleaseEvent(event);
@@ -116,6 +120,22 @@ void Tool::execute()
     addElapsedTime(elapsed_seconds);
 }
 
+cl_event Tool::replay(const std::vector<cl_event> events)
+{
+    timeval tic, tac;
+    gettimeofday(&tic, NULL);
+
+    cl_event event = _replay(events);
+
+    gettimeofday(&tac, NULL);
+    float elapsed_seconds;
+    elapsed_seconds = (float)(tac.tv_sec - tic.tv_sec);
+    elapsed_seconds += (float)(tac.tv_usec - tic.tv_usec) * 1E-6f;
+    addElapsedTime(elapsed_seconds);
+
+    return event;
+}
+
 int Tool::id_in_pipeline()
 {
     std::vector<Tool*> tools = CalcServer::singleton()->tools();
@@ -169,12 +189,34 @@ const std::vector<InputOutput::Variable*> Tool::getDependencies()
     return _vars;
 }
 
+void Tool::setInputs(std::vector<InputOutput::Variable*> vars)
+{
+    _inputs = vars;
+}
+
+const std::vector<InputOutput::Variable*> Tool::getInputs()
+{
+    return _inputs;
+}
+
 const std::vector<cl_event> Tool::getEvents()
 {
     cl_int err_code;
     _events.clear();
+    // The written variables shall wait for both the last writer and the
+    // readers, while the inputs should just wait for the last writer
+    std::vector<std::pair<InputOutput::Variable*, cl_event>> var_events;
     for(auto it = _vars.begin(); it < _vars.end(); it++){
-        cl_event event = (*it)->getEvent();
+        var_events.push_back(std::make_pair(*it, (*it)->getWriterEvent()));
+        for(auto event : (*it)->getReaderEvents())
+            var_events.push_back(std::make_pair(*it, event));
+    }
+    for(auto it = _inputs.begin(); it < _inputs.end(); it++){
+        var_events.push_back(std::make_pair(*it, (*it)->getWriterEvent()));
+    }
+
+    for(auto var_event : var_events){
+        cl_event event = var_event.second;
         if(std::find(_events.begin(), _events.end(), event) != _events.end())
             continue;
         // Retain the event until we work with it
@@ -182,7 +224,7 @@ const std::vector<cl_event> Tool::getEvents()
         if(err_code != CL_SUCCESS){
             std::stringstream msg;
             msg << "Failure reteaning the event for \"" <<
-                (*it)->name() << "\" variable in \"" <<
+                var_event.first->name() << "\" variable in \"" <<
                 name() << "\" tool." << std::endl;
             LOG(L_ERROR, msg.str());
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -37,14 +37,18 @@ namespace Aqua{ namespace CalcServer{
 std::string UNSORT_INC = xxd2string(UnSort_hcl_in, UnSort_hcl_in_len);
 std::string UNSORT_SRC = xxd2string(UnSort_cl_in, UnSort_cl_in_len);
 
+#ifndef UNSORT_ALIGNMENT
+    #define UNSORT_ALIGNMENT 128
+#endif // UNSORT_ALIGNMENT
 
-UnSort::UnSort(const std::string name, const std::string var_name, bool once)
+
+UnSort::UnSort(const std::string name,
+               const std::vector<std::string> var_names,
+               bool once)
     : Tool(name, once)
-    , _var_name(var_name)
-    , _var(NULL)
-    , _input(NULL)
+    , _var_names(var_names)
+    , _id_var(NULL)
     , _id_input(NULL)
-    , _output(NULL)
     , _kernel(NULL)
     , _global_work_size(0)
     , _local_work_size(0)
@@ -54,7 +58,6 @@ UnSort::UnSort(const std::string name, const std::string var_name, bool once)
 
 UnSort::~UnSort()
 {
-    if(_output) clReleaseMemObject(_output); _output=NULL;
     if(_kernel) clReleaseKernel(_kernel); _kernel=NULL;
 }
 
@@ -62,17 +65,82 @@ void UnSort::setup()
 {
     Tool::setup();
     variables();
-    setupMem();
 
     _id_input = *(cl_mem*)_id_var->get();
-    _input = *(cl_mem*)_var->get();
+    for(auto var : _vars)
+        _inputs_mem.push_back(*(cl_mem*)var->get());
     _n = _id_var->size() / InputOutput::Variables::typeToBytes(_id_var->type());
     setupOpenCL();
 }
 
+std::vector<size_t> UnSort::offsets(unsigned int n) const
+{
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    for(auto var : _vars){
+        offsets.push_back(offset);
+        offset += InputOutput::Variables::typeToBytes(var->type()) * n;
+        offset = ((offset + UNSORT_ALIGNMENT - 1) / UNSORT_ALIGNMENT) *
+                 UNSORT_ALIGNMENT;
+    }
+    offsets.push_back(offset);
+    return offsets;
+}
+
+void UnSort::range(unsigned int first,
+                   unsigned int n,
+                   cl_mem output,
+                   cl_mem map,
+                   unsigned int m)
+{
+    cl_int err_code;
+    if(!map)
+        m = n;
+
+    err_code = clSetKernelArg(_kernel, 1, sizeof(cl_mem), (void*)&output);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the output array argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    err_code = clSetKernelArg(_kernel, 2, sizeof(unsigned int), (void*)&first);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the first particle argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    err_code = clSetKernelArg(_kernel, 3, sizeof(unsigned int), (void*)&n);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the number of particles argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    err_code = clSetKernelArg(_kernel, 5, sizeof(cl_mem), (void*)&map);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure sending the gathering map argument\n");
+        InputOutput::Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL error");
+    }
+    std::vector<size_t> offs = offsets(m);
+    for(unsigned int i = 0; i < _vars.size(); i++){
+        cl_ulong offset = offs.at(i);
+        err_code = clSetKernelArg(_kernel,
+                                  7 + 2 * i,
+                                  sizeof(cl_ulong),
+                                  (void*)&offset);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure sending the offset of \"" << _vars.at(i)->name()
+                << "\" argument" << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+}
+
 cl_event UnSort::_execute(const std::vector<cl_event> events)
 {
-    unsigned int i;
     cl_int err_code;
     cl_event event;
     CalcServer *C = CalcServer::singleton();
@@ -127,74 +195,80 @@ void UnSort::variables()
         throw std::runtime_error("Invalid variable type");
     }
     _id_var = (InputOutput::ArrayVariable *)vars->get("id");
+    size_t len_id = _id_var->size() /
+                    InputOutput::Variables::typeToBytes(_id_var->type());
 
-    if(!vars->get(_var_name)){
-        std::stringstream msg;
-        msg << "The tool \"" << name()
-            << "\" is asking the undeclared variable \""
-            << _var_name << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        throw std::runtime_error("Invalid variable");
-    }
-    if(vars->get(_var_name)->type().find('*') == std::string::npos){
-        std::stringstream msg;
-        msg << "The tool \"" << name()
-            << "\" may not use a scalar variable (\""
-            << _var_name << "\")." << std::endl;
-        LOG(L_ERROR, msg.str());
-        throw std::runtime_error("Invalid variable type");
+    std::vector<InputOutput::Variable*> deps = {_id_var};
+    for(auto var_name : _var_names){
+        if(!vars->get(var_name)){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" is asking the undeclared variable \""
+                << var_name << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        if(vars->get(var_name)->type().find('*') == std::string::npos){
+            std::stringstream msg;
+            msg << "The tool \"" << name()
+                << "\" may not use a scalar variable (\""
+                << var_name << "\")." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable type");
+        }
+        InputOutput::ArrayVariable *var =
+            (InputOutput::ArrayVariable *)vars->get(var_name);
+        size_t len_var = var->size() /
+                         InputOutput::Variables::typeToBytes(var->type());
+        if(len_id > len_var){
+            std::stringstream msg;
+            msg << "Wrong variable length in the tool \"" << name()
+                << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            msg << "\t\"" << "id" << "\" has length " << len_id << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            msg.str("");
+            msg << "\t\"" << var_name << "\" has length " << len_var
+                << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Invalid variable length");
+        }
+        _vars.push_back(var);
+        deps.push_back(var);
     }
-    _var = (InputOutput::ArrayVariable *)vars->get(_var_name);
 
-    std::vector<InputOutput::Variable*> deps = {_id_var, _var};
     setDependencies(deps);
 }
 
-void UnSort::setupMem()
-{
-    cl_int err_code;
-    size_t len_id, len_var;
-    CalcServer *C = CalcServer::singleton();
-
-    len_id = _id_var->size() / InputOutput::Variables::typeToBytes(_id_var->type());
-    len_var = _var->size() / InputOutput::Variables::typeToBytes(_var->type());
-    if(len_id > len_var){
-        std::stringstream msg;
-        msg << "Wrong variable length in the tool \"" << name()
-            << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        msg.str("");
-        msg << "\t\"" << "id" << "\" has length " << len_id << std::endl;
-        LOG0(L_DEBUG, msg.str());
-        msg.str("");
-        msg << "\t\"" << _var_name << "\" has length " << len_var << std::endl;
-        LOG0(L_DEBUG, msg.str());
-        throw std::runtime_error("Invalid variable length");
-    }
-
-    _output = clCreateBuffer(C->context(),
-                             CL_MEM_WRITE_ONLY,
-                             len_id * InputOutput::Variables::typeToBytes(_var->type()),
-                             NULL,
-                               &err_code);
-    if(err_code != CL_SUCCESS){
-        std::stringstream msg;
-        msg << "Failure allocating device memory in the tool \"" <<
-               name() << "\"." << std::endl;
-        LOG(L_ERROR, msg.str());
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL allocation error");
-    }
-    allocatedMemory(len_id * InputOutput::Variables::typeToBytes(_var->type()));
-}
-
 void UnSort::setupOpenCL()
 {
+    unsigned int i;
     cl_int err_code;
     CalcServer *C = CalcServer::singleton();
 
+    // Generate the arguments and the copies for each variable
     std::ostringstream source;
-    source << UNSORT_INC << UNSORT_SRC;
+    source << UNSORT_INC;
+    source << "#define UNSORT_ARGS";
+    for(i = 0; i < _vars.size(); i++){
+        std::string t = trimCopy(_vars.at(i)->type());
+        t.pop_back();  // Remove the asterisk
+        if(!t.compare("unsigned int"))
+            t = "uint";
+        source << " , const __global " << t << " *in" << i
+               << ", ulong offset" << i;
+    }
+    source << std::endl << "#define UNSORT_BODY";
+    for(i = 0; i < _vars.size(); i++){
+        std::string t = trimCopy(_vars.at(i)->type());
+        t.pop_back();
+        if(!t.compare("unsigned int"))
+            t = "uint";
+        source << " ((__global " << t << "*)(output + offset" << i
+               << "))[j] = in" << i << "[i];";
+    }
+    source << std::endl << UNSORT_SRC;
 
     // Starts a dummy kernel in order to study the local size that can be used
     _kernel = compile(source.str());
@@ -230,25 +304,7 @@ void UnSort::setupOpenCL()
         throw std::runtime_error("OpenCL error");
     }
     err_code = clSetKernelArg(_kernel,
-                              1,
-                              _var->typesize(),
-                              _var->get());
-    if(err_code != CL_SUCCESS){
-        LOG(L_ERROR, "Failure sending the input array argument\n");
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_kernel,
-                              2,
-                              sizeof(cl_mem),
-                              (void*)&_output);
-    if(err_code != CL_SUCCESS){
-        LOG(L_ERROR, "Failure sending the output array argument\n");
-        InputOutput::Logger::singleton()->printOpenCLError(err_code);
-        throw std::runtime_error("OpenCL error");
-    }
-    err_code = clSetKernelArg(_kernel,
-                              3,
+                              4,
                               sizeof(unsigned int),
                               (void*)&_n);
     if(err_code != CL_SUCCESS){
@@ -256,6 +312,20 @@ void UnSort::setupOpenCL()
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
+    for(i = 0; i < _vars.size(); i++){
+        err_code = clSetKernelArg(_kernel,
+                                  6 + 2 * i,
+                                  _vars.at(i)->typesize(),
+                                  _vars.at(i)->get());
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure sending the \"" << _vars.at(i)->name()
+                << "\" array argument" << std::endl;
+            LOG(L_ERROR, msg.str());
+            InputOutput::Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
 }
 
 cl_kernel UnSort::compile(const std::string source)
@@ -266,15 +336,6 @@ cl_kernel UnSort::compile(const std::string source)
     CalcServer *C = CalcServer::singleton();
 
     std::ostringstream flags;
-    if(!_var->type().compare("unsigned int*")){
-        // Spaces are not a good business to define a variable
-        flags << "-DT=uint";
-    }
-    else{
-        std::string t = trimCopy(_var->type());
-        t.pop_back();  // Remove the asterisk
-        flags << "-DT=" << t;
-    }
     #ifdef AQUA_DEBUG
         flags << " -DDEBUG ";
     #else
@@ -286,19 +347,12 @@ cl_kernel UnSort::compile(const std::string source)
     #else
         flags << " -DHAVE_2D";
     #endif
-    size_t source_length = source.size();
-    const char* source_cstr = source.c_str();
-    program = clCreateProgramWithSource(C->context(),
-                                        1,
-                                        &source_cstr,
-                                        &source_length,
-                                        &err_code);
-    if(err_code != CL_SUCCESS) {
+    program = C->program_cache()->build(source, flags.str(), &err_code);
+    if(!program) {
         LOG(L_ERROR, "Failure creating the OpenCL program\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
         throw std::runtime_error("OpenCL error");
     }
-    err_code = clBuildProgram(program, 0, NULL, flags.str().c_str(), NULL, NULL);
     if(err_code != CL_SUCCESS) {
         LOG(L_ERROR, "Error compiling the OpenCL script\n");
         InputOutput::Logger::singleton()->printOpenCLError(err_code);
@@ -363,20 +417,22 @@ void UnSort::setVariables()
         }
         _id_input = *(cl_mem *)_id_var->get();
     }
-    if(_input != *(cl_mem*)_var->get()){
+    for(unsigned int i = 0; i < _vars.size(); i++){
+        if(_inputs_mem.at(i) == *(cl_mem*)_vars.at(i)->get())
+            continue;
         err_code = clSetKernelArg(_kernel,
-                                  1,
-                                  _var->typesize(),
-                                  _var->get());
+                                  6 + 2 * i,
+                                  _vars.at(i)->typesize(),
+                                  _vars.at(i)->get());
         if(err_code != CL_SUCCESS) {
             std::stringstream msg;
-            msg << "Failure setting the variable \"" << _var->name()
+            msg << "Failure setting the variable \"" << _vars.at(i)->name()
                 << "\" to the tool \"" << name() << "\"." << std::endl;
             LOG(L_ERROR, msg.str());
             InputOutput::Logger::singleton()->printOpenCLError(err_code);
             throw std::runtime_error("OpenCL error");
         }
-        _input = *(cl_mem *)_var->get();
+        _inputs_mem.at(i) = *(cl_mem *)_vars.at(i)->get();
     }
 }
 
@@ -25,6 +25,7 @@
 #include <InputOutput/Logger.h>
 #include <InputOutput/ASCII.h>
 #include <InputOutput/FastASCII.h>
+#include <InputOutput/Binary.h>
 #ifdef HAVE_VTK
     #include <InputOutput/VTK.h>
 #endif // HAVE_VTK
@@ -35,6 +36,9 @@ FileManager::FileManager()
     : _state()
     , _simulation()
     , _in_file("Input.xml")
+    , _writers(NULL)
+    , _restart_file("")
+    , _checkpoint()
 {
 }
 
@@ -46,6 +50,8 @@ FileManager::~FileManager()
     for(auto saver : _savers) {
         delete saver;
     }
+    if(_writers)
+        delete _writers;
 }
 
 void FileManager::inputFile(std::string path)
@@ -69,6 +75,18 @@ CalcServer::CalcServer* FileManager::load()
     // Build the calculation server
     CalcServer::CalcServer *C = new CalcServer::CalcServer(_simulation);
 
+    // Launch the writing threads
+    try {
+        _writers = new WriterPool(
+            _simulation.settings.writer_threads,
+            _simulation.settings.writer_queue,
+            (size_t)_simulation.settings.writer_memory * 1024 * 1024,
+            WriterPool::toPolicy(_simulation.settings.writer_policy));
+    } catch(std::runtime_error &e) {
+        delete C;
+        throw;
+    }
+
     // Now we can build the loaders/savers
     unsigned int i = 0;
     for(auto set : _simulation.sets){
@@ -80,6 +98,10 @@ CalcServer::CalcServer* FileManager::load()
             FastASCII *loader = new FastASCII(_simulation, n, set->n(), i);
             _loaders.push_back((Particles*)loader);
         }
+        else if(!set->inputFormat().compare("Binary")){
+            Binary *loader = new Binary(_simulation, n, set->n(), i);
+            _loaders.push_back((Particles*)loader);
+        }
         else if(!set->inputFormat().compare("VTK")){
             #ifdef HAVE_VTK
                 VTK *loader = new VTK(_simulation, n, set->n(), i);
@@ -102,6 +124,10 @@ CalcServer::CalcServer* FileManager::load()
             ASCII *saver = new ASCII(_simulation, n, set->n(), i);
             _savers.push_back((Particles*)saver);
         }
+        else if(!set->outputFormat().compare("Binary")){
+            Binary *saver = new Binary(_simulation, n, set->n(), i);
+            _savers.push_back((Particles*)saver);
+        }
         else if(!set->outputFormat().compare("VTK")){
             #ifdef HAVE_VTK
                 VTK *saver = new VTK(_simulation, n, set->n(), i);
@@ -143,12 +169,27 @@ void FileManager::save(float t)
     _state.save(_simulation, _savers);
 }
 
+void FileManager::restart(TimeManager &t_manager)
+{
+    if(!_restart_file.size())
+        return;
+    _checkpoint.load(_restart_file, t_manager);
+}
+
+void FileManager::checkpoint(TimeManager &t_manager)
+{
+    _checkpoint.save(_simulation.settings.checkpoint_path, t_manager);
+}
+
 void FileManager::waitForSavers()
 {
     LOG(L_INFO, "Waiting for the writers...\n");
     for(auto saver : _savers) {
         saver->waitForSavers();
     }
+    if(_writers)
+        _writers->wait();
+    _checkpoint.wait();
 }
 
 }}  // namespace
@@ -266,9 +266,10 @@ void ASCII::save(float t)
             throw std::runtime_error("Invalid variable length");
         }
     }
-    std::vector<void*> data = download(fields);
+    unsigned int n;
+    std::vector<void*> data = download(fields, n);
 
-    for(i = 0; i < bounds().y - bounds().x; i++){
+    for(i = 0; i < n; i++){
         for(j = 0; j < fields.size(); j++){
             ArrayVariable *var = (ArrayVariable*)vars->get(fields.at(j).c_str());
             std::string type_name = var->type();
@@ -396,7 +397,7 @@ void ASCII::save(float t)
     }
 
     for(auto d : data){
-        free(d);
+        CalcServer::CalcServer::singleton()->staging()->release(d);
     }
     data.clear();
 
@@ -0,0 +1,610 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Particles binary columnar data files loader/saver.
+ * (See Aqua::InputOutput::Binary for details)
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <memory>
+#include <deque>
+
+#include <InputOutput/Binary.h>
+#include <InputOutput/Logger.h>
+#include <InputOutput/WriterPool.h>
+#include <ProblemSetup.h>
+#include <CalcServer.h>
+#include <AuxiliarMethods.h>
+
+#ifndef BINARY_MAGIC
+    #define BINARY_MAGIC "AQUAbin"
+#endif // BINARY_MAGIC
+
+#ifndef BINARY_VERSION
+    #define BINARY_VERSION 2
+#endif // BINARY_VERSION
+
+#ifndef BINARY_ALIGNMENT
+    #define BINARY_ALIGNMENT 4096
+#endif // BINARY_ALIGNMENT
+
+namespace Aqua{ namespace InputOutput{
+
+/** @brief File head
+ */
+typedef struct{
+    /// Magic string, BINARY_MAGIC
+    char magic[8];
+    /// Format version, BINARY_VERSION
+    uint32_t version;
+    /// Number of particles
+    uint32_t n;
+    /// Number of fields
+    uint32_t n_fields;
+    /// Simulation time
+    float t;
+}binary_head;
+
+/** @brief Field record
+ */
+typedef struct{
+    /// Field name
+    char name[64];
+    /// Field type name
+    char type[32];
+    /// Type size in bytes
+    uint32_t typesize;
+    /// Bits of the quantized values, 0 if the column is not quantized
+    uint32_t encoding;
+    /// Column offset in the file
+    uint64_t offset;
+    /// Column length in bytes
+    uint64_t bytes;
+}binary_field;
+
+/** @brief Quantized column head
+ *
+ * Each quantized value q stands for the value vmin + q * step
+ */
+typedef struct{
+    /// Value represented by the quantized 0
+    float vmin;
+    /// Quantization step
+    float step;
+}binary_quantization;
+
+/** @brief Check whether the host is a little-endian machine or not
+ * @return true if the host is a little-endian machine, false otherwise
+ */
+static bool isLittleEndian()
+{
+    const uint16_t one = 1;
+    return *((const uint8_t*)&one) == 1;
+}
+
+/** @brief Check that a field can be loaded/saved
+ * @param field Field name
+ * @param last Index of the last particle to be loaded/saved
+ * @return The array variable
+ */
+static ArrayVariable* checkField(const std::string field, unsigned int last)
+{
+    Variables *vars = CalcServer::CalcServer::singleton()->variables();
+    if(!vars->get(field)){
+        std::ostringstream msg;
+        msg << "Undeclared variable \"" << field << "\"." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable");
+    }
+    if(vars->get(field)->type().find('*') == std::string::npos){
+        std::ostringstream msg;
+        msg << "Scalar variable \"" << field
+            << "\" cannot be loaded/saved." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+    if(field.size() >= sizeof(((binary_field*)0)->name) ||
+       vars->get(field)->type().size() >= sizeof(((binary_field*)0)->type)){
+        std::ostringstream msg;
+        msg << "Variable \"" << field
+            << "\" name or type name is too long." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable name");
+    }
+    ArrayVariable *var = (ArrayVariable*)vars->get(field);
+    size_t typesize = vars->typeToBytes(var->type());
+    size_t len = var->size() / typesize;
+    if(len < last){
+        std::ostringstream msg;
+        msg << "Array variable \"" << field
+            << "\" is not long enough." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable length");
+    }
+    return var;
+}
+
+/** @brief Align an offset to the columns alignment, BINARY_ALIGNMENT
+ * @param offset Offset in the file
+ * @return The aligned offset
+ */
+static uint64_t alignOffset(uint64_t offset)
+{
+    return ((offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT) *
+           BINARY_ALIGNMENT;
+}
+
+/** @brief Write a whole buffer in a file, at a specific position
+ * @param fd File descriptor
+ * @param buf Data to write
+ * @param size Number of bytes to write
+ * @param offset Position in the file
+ * @return true if the data was written, false otherwise
+ */
+static bool pwriteAll(int fd, const void *buf, size_t size, off_t offset)
+{
+    const char *ptr = (const char*)buf;
+    while(size){
+        ssize_t written = pwrite(fd, ptr, size, offset);
+        if(written < 0){
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        ptr += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+Binary::Binary(ProblemSetup& sim_data,
+               unsigned int first,
+               unsigned int n,
+               unsigned int iset)
+    : Particles(sim_data, first, n, iset)
+    , _next_file_index(0)
+{
+}
+
+Binary::~Binary()
+{
+    waitForSavers();
+}
+
+void Binary::load()
+{
+    unsigned int n;
+    cl_int err_code;
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+
+    loadDefault();
+
+    std::string path = simData().sets.at(setId())->inputPath();
+    std::ostringstream msg;
+    msg << "Loading particles from binary file \"" << path
+        << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    if(!isLittleEndian()){
+        LOG(L_ERROR, "Binary files require a little-endian host.\n");
+        throw std::runtime_error("Unsupported host");
+    }
+
+    std::vector<std::string> fields = simData().sets.at(setId())->inputFields();
+    if(!fields.size()){
+        LOG(L_ERROR, "0 fields were set to be read from the file.\n");
+        throw std::runtime_error("No fields have been marked to read");
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        LOG(L_ERROR, "The file cannot be read.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Failure reading file");
+    }
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(binary_head)){
+        close(fd);
+        LOG(L_ERROR, "Invalid binary file.\n");
+        throw std::runtime_error("Bad binary file format");
+    }
+    size_t file_size = st.st_size;
+    void *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        LOG(L_ERROR, "Failure mapping the file in memory.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Failure reading file");
+    }
+    madvise(map, file_size, MADV_SEQUENTIAL);
+
+    std::vector<cl_event> events;
+    // Decoded quantized columns, which shall be kept until they are sent
+    std::deque<std::vector<float>> decoded;
+    try {
+        binary_head head;
+        memcpy(&head, map, sizeof(binary_head));
+        if(strncmp(head.magic, BINARY_MAGIC, sizeof(head.magic)) ||
+           !head.version || (head.version > BINARY_VERSION) ||
+           (file_size < sizeof(binary_head) +
+                        head.n_fields * sizeof(binary_field))){
+            LOG(L_ERROR, "Invalid binary file.\n");
+            throw std::runtime_error("Bad binary file format");
+        }
+
+        // Assert that the number of particles is right
+        n = bounds().y - bounds().x;
+        if(n != head.n){
+            std::ostringstream msg;
+            msg << "Expected " << n << " particles, but the file contains "
+                << head.n << " ones." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid number of particles in file");
+        }
+
+        std::vector<binary_field> records(head.n_fields);
+        memcpy(records.data(),
+               (char*)map + sizeof(binary_head),
+               head.n_fields * sizeof(binary_field));
+
+        for(auto field : fields){
+            ArrayVariable *var = checkField(field, bounds().y);
+            size_t typesize = Variables::typeToBytes(var->type());
+
+            binary_field *record = NULL;
+            for(auto &r : records){
+                if(!strncmp(r.name, field.c_str(), sizeof(r.name))){
+                    record = &r;
+                    break;
+                }
+            }
+            if(!record){
+                std::ostringstream msg;
+                msg << "Field \"" << field
+                    << "\" cannot be found in the file." << std::endl;
+                LOG(L_ERROR, msg.str());
+                throw std::runtime_error("Missing field");
+            }
+            if(strncmp(record->type, var->type().c_str(), sizeof(record->type)) ||
+               (record->typesize != typesize)){
+                std::ostringstream msg;
+                msg << "Field \"" << field << "\" was stored as \""
+                    << std::string(record->type, strnlen(record->type,
+                                                         sizeof(record->type)))
+                    << "\" (" << record->typesize << " bytes), but \""
+                    << var->type() << "\" (" << typesize
+                    << " bytes) was expected." << std::endl;
+                LOG(L_ERROR, msg.str());
+                throw std::runtime_error("Invalid field type");
+            }
+            // The quantized columns (just in version 2 files) are composed by
+            // a binary_quantization head and the quantized values of each
+            // float component
+            size_t n_values = typesize / sizeof(float) * n;
+            size_t bytes = typesize * n;
+            if(record->encoding){
+                bytes = sizeof(binary_quantization) +
+                        n_values * record->encoding / 8;
+            }
+            if(((record->encoding != 0) &&
+                (record->encoding != 8) &&
+                (record->encoding != 16)) ||
+               (record->encoding && (head.version < 2)) ||
+               (record->bytes != bytes) ||
+               (record->offset + record->bytes > file_size)){
+                std::ostringstream msg;
+                msg << "Field \"" << field
+                    << "\" column is corrupted." << std::endl;
+                LOG(L_ERROR, msg.str());
+                throw std::runtime_error("Bad binary file format");
+            }
+
+            const void *column = (char*)map + record->offset;
+            if(record->encoding){
+                binary_quantization q;
+                memcpy(&q, column, sizeof(binary_quantization));
+                const char *values = (const char*)column +
+                                     sizeof(binary_quantization);
+                decoded.push_back(std::vector<float>(n_values));
+                std::vector<float> &data = decoded.back();
+                for(size_t i = 0; i < n_values; i++){
+                    float v = (record->encoding == 8) ?
+                        ((const uint8_t*)values)[i] :
+                        ((const uint16_t*)values)[i];
+                    data[i] = q.vmin + v * q.step;
+                }
+                column = data.data();
+            }
+
+            cl_event event;
+            cl_mem mem = *(cl_mem*)var->get();
+            err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                            mem,
+                                            CL_FALSE,
+                                            typesize * bounds().x,
+                                            typesize * n,
+                                            column,
+                                            0,
+                                            NULL,
+                                            &event);
+            if(err_code != CL_SUCCESS){
+                std::ostringstream msg;
+                msg << "Failure sending variable \"" << field
+                    << "\" to the computational device." << std::endl;
+                LOG(L_ERROR, msg.str());
+                Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL error");
+            }
+            events.push_back(event);
+        }
+
+        // The mapped memory cannot be released until all the columns are sent
+        err_code = clWaitForEvents(events.size(), events.data());
+        if(err_code != CL_SUCCESS){
+            LOG(L_ERROR, "Failure sending the fields to the computational device.\n");
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    } catch(...) {
+        if(events.size())
+            clWaitForEvents(events.size(), events.data());
+        for(auto event : events)
+            clReleaseEvent(event);
+        munmap(map, file_size);
+        throw;
+    }
+
+    for(auto event : events)
+        clReleaseEvent(event);
+    munmap(map, file_size);
+}
+
+/** @brief Data to be written in a binary file
+ */
+typedef struct{
+    /// File head
+    binary_head head;
+    /// Field records
+    std::vector<binary_field> records;
+    /// The data associated to each field
+    std::vector<void*> data;
+    /// Quantized columns heads, for the fields with a non null encoding
+    std::vector<binary_quantization> quants;
+}binary_frame;
+
+/** @brief Build the head and the field records of a binary file
+ * @param frame Data to be written
+ * @param t Simulation time
+ * @param bounds Bounds of the particles index to be written
+ * @param fields Fields to be written
+ * @param quants Quantization of each field, empty if none is quantized
+ * @return Total number of bytes of the columns
+ */
+static size_t setupFrame(binary_frame &frame,
+                         float t,
+                         uivec2 bounds,
+                         const std::vector<std::string> fields,
+                         const std::vector<CalcServer::quantization> quants=
+                            std::vector<CalcServer::quantization>())
+{
+    unsigned int i;
+    size_t bytes = 0;
+    memset(&(frame.head), 0, sizeof(binary_head));
+    strncpy(frame.head.magic, BINARY_MAGIC, sizeof(frame.head.magic));
+    frame.head.version = BINARY_VERSION;
+    frame.head.n = bounds.y - bounds.x;
+    frame.head.n_fields = fields.size();
+    frame.head.t = t;
+    uint64_t offset = alignOffset(sizeof(binary_head) +
+                                  fields.size() * sizeof(binary_field));
+    frame.quants.clear();
+    for(i = 0; i < fields.size(); i++){
+        const std::string field = fields.at(i);
+        ArrayVariable *var = checkField(field, bounds.y);
+        binary_field record;
+        memset(&record, 0, sizeof(binary_field));
+        strncpy(record.name, field.c_str(), sizeof(record.name));
+        strncpy(record.type, var->type().c_str(), sizeof(record.type));
+        record.typesize = Variables::typeToBytes(var->type());
+        record.offset = offset;
+        record.bytes = (uint64_t)record.typesize * frame.head.n;
+        binary_quantization q = {0.f, 0.f};
+        if((i < quants.size()) && quants.at(i).bits){
+            record.encoding = quants.at(i).bits;
+            record.bytes = sizeof(binary_quantization) +
+                           (uint64_t)record.typesize / sizeof(float) *
+                           frame.head.n * record.encoding / 8;
+            q.vmin = quants.at(i).vmin;
+            q.step = quants.at(i).step;
+        }
+        frame.quants.push_back(q);
+        offset = alignOffset(offset + record.bytes);
+        bytes += record.bytes;
+        frame.records.push_back(record);
+    }
+    return bytes;
+}
+
+/** @brief Write a binary file.
+ *
+ * This function can be called from the writing threads, so the errors are
+ * just reported with the thread safe Aqua::InputOutput::Logger::addMessageF()
+ * @param path File path
+ * @param frame Data to be written
+ * @return true if the file was written, false otherwise
+ */
+static bool writeFrame(const std::string path, const binary_frame &frame)
+{
+    unsigned int i;
+    Logger *S = Logger::singleton();
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        std::ostringstream msg;
+        msg << "Failure creating the binary file \"" << path << "\": "
+            << strerror(errno) << std::endl;
+        S->addMessageF(L_ERROR, msg.str());
+        return false;
+    }
+
+    // The head and the records are written at once, and then each column
+    std::vector<char> head(sizeof(binary_head) +
+                           frame.records.size() * sizeof(binary_field));
+    memcpy(head.data(), &(frame.head), sizeof(binary_head));
+    memcpy(head.data() + sizeof(binary_head),
+           frame.records.data(),
+           frame.records.size() * sizeof(binary_field));
+    bool success = pwriteAll(fd, head.data(), head.size(), 0);
+    for(i = 0; success && (i < frame.records.size()); i++){
+        const binary_field &record = frame.records.at(i);
+        if(!record.encoding){
+            success = pwriteAll(fd,
+                                frame.data.at(i),
+                                record.bytes,
+                                record.offset);
+            continue;
+        }
+        success = pwriteAll(fd,
+                            &(frame.quants.at(i)),
+                            sizeof(binary_quantization),
+                            record.offset) &&
+                  pwriteAll(fd,
+                            frame.data.at(i),
+                            record.bytes - sizeof(binary_quantization),
+                            record.offset + sizeof(binary_quantization));
+    }
+    if(!success){
+        std::ostringstream msg;
+        msg << "Failure writing the binary file \"" << path << "\": "
+            << strerror(errno) << std::endl;
+        S->addMessageF(L_ERROR, msg.str());
+    }
+    close(fd);
+    return success;
+}
+
+/** @brief Give back the downloaded data to the staging buffers pool
+ * @param data Downloaded data
+ */
+static void releaseData(const std::vector<void*> &data)
+{
+    for(auto d : data)
+        CalcServer::CalcServer::singleton()->staging()->release(d);
+}
+
+void Binary::save(float t)
+{
+    if(!isLittleEndian()){
+        LOG(L_ERROR, "Binary files require a little-endian host.\n");
+        throw std::runtime_error("Unsupported host");
+    }
+
+    std::vector<std::string> fields = simData().sets.at(setId())->outputFields();
+    if(!fields.size()){
+        LOG(L_ERROR, "0 fields were set to be saved into the file.\n");
+        throw std::runtime_error("No fields have been marked to be saved");
+    }
+
+    // Setup the data to be written by the pool
+    std::shared_ptr<binary_frame> frame(new binary_frame);
+    unsigned int n;
+    std::vector<CalcServer::quantization> quants;
+    frame->data = download(fields, n, &quants);
+    if(!frame->data.size()){
+        throw std::runtime_error("Failure downloading data");
+    }
+    uivec2 frame_bounds = bounds();
+    frame_bounds.y = frame_bounds.x + n;
+    size_t bytes;
+    try {
+        bytes = setupFrame(*frame, t, frame_bounds, fields, quants);
+    } catch(...) {
+        releaseData(frame->data);
+        throw;
+    }
+    const std::string prev_file = file();
+    const std::string path = create();
+
+    WriterPool::task task;
+    task.bytes = bytes;
+    task.write = [frame, path](){
+        writeFrame(path, *frame);
+        releaseData(frame->data);
+    };
+    // There is nothing faster to spill the frame into, so the spill policy
+    // shall block
+    task.spill = nullptr;
+    task.discard = [this, frame, prev_file](){
+        releaseData(frame->data);
+        file(prev_file);
+        _next_file_index--;
+    };
+    WriterPool::singleton()->submit(task);
+}
+
+void Binary::write(const std::string path,
+                   float t,
+                   uivec2 bounds,
+                   const std::vector<std::string> fields,
+                   const std::vector<void*> data)
+{
+    if(!isLittleEndian()){
+        LOG(L_ERROR, "Binary files require a little-endian host.\n");
+        throw std::runtime_error("Unsupported host");
+    }
+
+    binary_frame frame;
+    setupFrame(frame, t, bounds, fields);
+    frame.data = data;
+    if(!writeFrame(path, frame))
+        throw std::runtime_error("Failure writing file");
+}
+
+void Binary::waitForSavers(){
+    WriterPool *pool = WriterPool::singleton();
+    if(pool)
+        pool->wait();
+}
+
+std::string Binary::create(){
+    std::ostringstream basename;
+
+    basename << simData().sets.at(setId())->outputPath() << ".%d.bin";
+    std::string basename_str = basename.str();  // Avoid static mem free
+    _next_file_index = file(basename_str.c_str(), _next_file_index);
+
+    std::ostringstream msg;
+    msg << "Writing \"" << file() << "\" binary file..." << std::endl;
+    LOG(L_INFO, msg.str());
+    _next_file_index++;
+
+    return file();
+}
+
+}}  // namespace
@@ -0,0 +1,431 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Binary checkpoints, to resume the simulations.
+ * (See Aqua::InputOutput::Checkpoint for details)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fstream>
+#include <algorithm>
+
+#include <InputOutput/Checkpoint.h>
+#include <InputOutput/Logger.h>
+#include <CalcServer.h>
+
+#ifndef CHECKPOINT_MAGIC
+    #define CHECKPOINT_MAGIC "AQUAchk"
+#endif // CHECKPOINT_MAGIC
+
+#ifndef CHECKPOINT_VERSION
+    #define CHECKPOINT_VERSION 1
+#endif // CHECKPOINT_VERSION
+
+#ifndef CHECKPOINT_ALIGNMENT
+    #define CHECKPOINT_ALIGNMENT 64
+#endif // CHECKPOINT_ALIGNMENT
+
+namespace Aqua{ namespace InputOutput{
+
+/** @brief Archive head
+ */
+typedef struct{
+    /// Magic string, CHECKPOINT_MAGIC
+    char magic[8];
+    /// Format version, CHECKPOINT_VERSION
+    uint32_t version;
+    /// Number of variables
+    uint32_t n_vars;
+    /// Time of the last output frame
+    float output_time;
+    /// Time step of the last output frame
+    int32_t output_step;
+}checkpoint_head;
+
+/** @brief Variable record
+ */
+typedef struct{
+    /// Variable name
+    char name[64];
+    /// Variable type name
+    char type[32];
+    /// Data offset in the archive
+    uint64_t offset;
+    /// Data length in bytes
+    uint64_t bytes;
+}checkpoint_var;
+
+/** @brief Variables which are not restored, since they are set from the
+ * simulation definition, such that it can be extended when it is resumed.
+ */
+static const std::vector<std::string> checkpoint_skip = {
+    "end_t", "end_iter", "end_frame"
+};
+
+/** @brief Arrays which are reallocated at runtime by the tools, such that
+ * the stored size may differ from the one of a fresh simulation.
+ *
+ * The device memory of these arrays is reallocated to the stored size when
+ * they are restored.
+ */
+static const std::vector<std::string> checkpoint_resizable = {
+    "ihoc"
+};
+
+Checkpoint::Checkpoint()
+    : _path("")
+    , _writing(false)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    wait();
+}
+
+void Checkpoint::save(const std::string path, TimeManager &t_manager)
+{
+    unsigned int i;
+    cl_int err_code;
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+    std::vector<Variable*> vars = C->variables()->getAll();
+
+    // The previous snapshot shall be written before overwriting it
+    wait();
+
+    std::ostringstream msg;
+    msg << "Writing the checkpoint \"" << path << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    // Build the archive layout
+    checkpoint_head head;
+    memset(&head, 0, sizeof(checkpoint_head));
+    strncpy(head.magic, CHECKPOINT_MAGIC, sizeof(head.magic));
+    head.version = CHECKPOINT_VERSION;
+    head.n_vars = vars.size();
+    head.output_time = t_manager.outputTime();
+    head.output_step = t_manager.outputStep();
+    std::vector<checkpoint_var> records;
+    uint64_t offset = sizeof(checkpoint_head) +
+                      vars.size() * sizeof(checkpoint_var);
+    for(auto var : vars){
+        if((var->name().size() >= sizeof(((checkpoint_var*)0)->name)) ||
+           (var->type().size() >= sizeof(((checkpoint_var*)0)->type))){
+            std::ostringstream msg;
+            msg << "Variable \"" << var->name()
+                << "\" name or type name is too long." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable name");
+        }
+        checkpoint_var record;
+        memset(&record, 0, sizeof(checkpoint_var));
+        strncpy(record.name, var->name().c_str(), sizeof(record.name));
+        strncpy(record.type, var->type().c_str(), sizeof(record.type));
+        offset = ((offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT) *
+                 CHECKPOINT_ALIGNMENT;
+        record.offset = offset;
+        record.bytes = var->size();
+        offset += record.bytes;
+        records.push_back(record);
+    }
+
+    // Take the snapshot
+    try {
+        _snapshot.resize(offset);
+    } catch(std::bad_alloc &e) {
+        std::ostringstream msg;
+        msg << "Failure allocating " << offset
+            << " bytes for the checkpoint snapshot." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw;
+    }
+    memcpy(_snapshot.data(), &head, sizeof(checkpoint_head));
+    memcpy(_snapshot.data() + sizeof(checkpoint_head),
+           records.data(),
+           records.size() * sizeof(checkpoint_var));
+    std::vector<cl_event> events;
+    for(i = 0; i < vars.size(); i++){
+        Variable *var = vars.at(i);
+        char *dst = _snapshot.data() + records.at(i).offset;
+        if(!var->isArray()){
+            // Scalars are synchronized by get()
+            memcpy(dst, var->get(), records.at(i).bytes);
+            continue;
+        }
+        cl_mem mem = *(cl_mem*)var->get();
+        if(!mem || !records.at(i).bytes)
+            continue;
+        cl_event event, event_wait = var->getEvent();
+        err_code = clEnqueueReadBuffer(C->command_queue(),
+                                       mem,
+                                       CL_FALSE,
+                                       0,
+                                       records.at(i).bytes,
+                                       dst,
+                                       1,
+                                       &event_wait,
+                                       &event);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure downloading the variable \"" << var->name()
+                << "\" for the checkpoint." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            if(events.size())
+                clWaitForEvents(events.size(), events.data());
+            for(auto e : events)
+                clReleaseEvent(e);
+            throw std::runtime_error("OpenCL error");
+        }
+        events.push_back(event);
+    }
+    if(events.size()){
+        err_code = clWaitForEvents(events.size(), events.data());
+        for(auto e : events)
+            clReleaseEvent(e);
+        if(err_code != CL_SUCCESS){
+            LOG(L_ERROR, "Failure downloading the variables for the checkpoint.\n");
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    // Write it in background
+    _path = path;
+    int err = pthread_create(&_tid, NULL, &Checkpoint::write_pthread, this);
+    if(err){
+        std::ostringstream msg;
+        msg << "Failure launching the checkpoint writing thread: "
+            << strerror(err) << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Failure launching thread");
+    }
+    _writing = true;
+}
+
+void Checkpoint::load(const std::string path, TimeManager &t_manager)
+{
+    unsigned int i;
+    cl_int err_code;
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+    Variables *vars = C->variables();
+
+    std::ostringstream msg;
+    msg << "Resuming the simulation from the checkpoint \"" << path
+        << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    std::ifstream f(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!f.is_open()){
+        LOG(L_ERROR, "The checkpoint cannot be read.\n");
+        throw std::runtime_error("Failure reading file");
+    }
+    std::vector<char> archive(f.tellg());
+    f.seekg(0);
+    f.read(archive.data(), archive.size());
+    if(!f){
+        LOG(L_ERROR, "The checkpoint cannot be read.\n");
+        throw std::runtime_error("Failure reading file");
+    }
+    f.close();
+
+    checkpoint_head head;
+    if(archive.size() < sizeof(checkpoint_head)){
+        LOG(L_ERROR, "Invalid checkpoint file.\n");
+        throw std::runtime_error("Bad checkpoint file format");
+    }
+    memcpy(&head, archive.data(), sizeof(checkpoint_head));
+    if(strncmp(head.magic, CHECKPOINT_MAGIC, sizeof(head.magic)) ||
+       (head.version != CHECKPOINT_VERSION) ||
+       (archive.size() < sizeof(checkpoint_head) +
+                         head.n_vars * sizeof(checkpoint_var))){
+        LOG(L_ERROR, "Invalid checkpoint file.\n");
+        throw std::runtime_error("Bad checkpoint file format");
+    }
+    std::vector<checkpoint_var> records(head.n_vars);
+    memcpy(records.data(),
+           archive.data() + sizeof(checkpoint_head),
+           head.n_vars * sizeof(checkpoint_var));
+
+    std::vector<std::string> restored;
+    for(i = 0; i < records.size(); i++){
+        const checkpoint_var &record = records.at(i);
+        const std::string name(record.name,
+                               strnlen(record.name, sizeof(record.name)));
+        const std::string type(record.type,
+                               strnlen(record.type, sizeof(record.type)));
+        if(std::find(checkpoint_skip.begin(),
+                     checkpoint_skip.end(),
+                     name) != checkpoint_skip.end())
+            continue;
+        Variable *var = vars->get(name);
+        if(!var){
+            std::ostringstream msg;
+            msg << "The checkpoint variable \"" << name
+                << "\" is not declared." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        const bool resizable = var->isArray() &&
+            (std::find(checkpoint_resizable.begin(),
+                       checkpoint_resizable.end(),
+                       name) != checkpoint_resizable.end());
+        if(var->type().compare(type) ||
+           (!resizable && (var->size() != record.bytes))){
+            std::ostringstream msg;
+            msg << "The checkpoint variable \"" << name << "\" was stored as \""
+                << type << "\" (" << record.bytes << " bytes), but \""
+                << var->type() << "\" (" << var->size()
+                << " bytes) was expected." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable type");
+        }
+        if(record.offset + record.bytes > archive.size()){
+            std::ostringstream msg;
+            msg << "The checkpoint variable \"" << name
+                << "\" is corrupted." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Bad checkpoint file format");
+        }
+
+        char *src = archive.data() + record.offset;
+        restored.push_back(name);
+        if(!var->isArray()){
+            var->set(src);
+            continue;
+        }
+        cl_mem mem = *(cl_mem*)var->get();
+        cl_event event_wait = var->getEvent();
+        if(resizable && (var->size() != record.bytes)){
+            clWaitForEvents(1, &event_wait);
+            if(mem) clReleaseMemObject(mem); mem = NULL;
+            if(record.bytes){
+                mem = clCreateBuffer(C->context(),
+                                     CL_MEM_READ_WRITE,
+                                     record.bytes,
+                                     NULL,
+                                     &err_code);
+                if(err_code != CL_SUCCESS){
+                    std::ostringstream msg;
+                    msg << "Failure allocating the checkpoint variable \""
+                        << name << "\" in the computational device."
+                        << std::endl;
+                    LOG(L_ERROR, msg.str());
+                    Logger::singleton()->printOpenCLError(err_code);
+                    throw std::runtime_error("OpenCL allocation error");
+                }
+            }
+            var->set(&mem);
+        }
+        if(!mem || !record.bytes)
+            continue;
+        err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                        mem,
+                                        CL_TRUE,
+                                        0,
+                                        record.bytes,
+                                        src,
+                                        1,
+                                        &event_wait,
+                                        NULL);
+        if(err_code != CL_SUCCESS){
+            std::ostringstream msg;
+            msg << "Failure sending the checkpoint variable \"" << name
+                << "\" to the computational device." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+    }
+
+    for(auto var : vars->getAll()){
+        if((std::find(restored.begin(),
+                      restored.end(),
+                      var->name()) == restored.end()) &&
+           (std::find(checkpoint_skip.begin(),
+                      checkpoint_skip.end(),
+                      var->name()) == checkpoint_skip.end())){
+            std::ostringstream msg;
+            msg << "The variable \"" << var->name()
+                << "\" is not in the checkpoint, it is not restored."
+                << std::endl;
+            LOG(L_WARNING, msg.str());
+        }
+    }
+
+    t_manager.outputTime(head.output_time);
+    t_manager.outputStep(head.output_step);
+}
+
+void Checkpoint::wait()
+{
+    if(!_writing)
+        return;
+    pthread_join(_tid, NULL);
+    _writing = false;
+}
+
+void* Checkpoint::write_pthread(void *data)
+{
+    Checkpoint *self = (Checkpoint*)data;
+    Logger *S = Logger::singleton();
+
+    // Write a temporal file, such that the previous checkpoint is kept until
+    // the new one is complete
+    const std::string tmp_path = self->_path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if(!f){
+        std::ostringstream msg;
+        msg << "Failure creating the checkpoint \"" << tmp_path << "\": "
+            << strerror(errno) << std::endl;
+        S->addMessageF(L_ERROR, msg.str());
+        return NULL;
+    }
+    size_t written = fwrite(self->_snapshot.data(),
+                            1,
+                            self->_snapshot.size(),
+                            f);
+    bool success = (written == self->_snapshot.size());
+    success = !fclose(f) && success;
+    if(!success){
+        std::ostringstream msg;
+        msg << "Failure writing the checkpoint \"" << tmp_path << "\": "
+            << strerror(errno) << std::endl;
+        S->addMessageF(L_ERROR, msg.str());
+        remove(tmp_path.c_str());
+        return NULL;
+    }
+    if(rename(tmp_path.c_str(), self->_path.c_str())){
+        std::ostringstream msg;
+        msg << "Failure replacing the checkpoint \"" << self->_path << "\": "
+            << strerror(errno) << std::endl;
+        S->addMessageF(L_ERROR, msg.str());
+        return NULL;
+    }
+
+    std::ostringstream msg;
+    msg << "Checkpoint \"" << self->_path << "\" written" << std::endl;
+    S->addMessageF(L_INFO, msg.str());
+    return NULL;
+}
+
+}}  // namespace
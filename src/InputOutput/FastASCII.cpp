@@ -22,18 +22,271 @@
  */
 
 #include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <InputOutput/FastASCII.h>
 #include <InputOutput/Logger.h>
 #include <ProblemSetup.h>
 #include <CalcServer.h>
 #include <AuxiliarMethods.h>
 
-#ifndef MAX_LINE_LEN
-    #define MAX_LINE_LEN 1024
-#endif // MAX_LINE_LEN
+#ifndef MAX_TOKEN_LEN
+    #define MAX_TOKEN_LEN 64
+#endif // MAX_TOKEN_LEN
+
+#ifndef MIN_CHUNK_LEN
+    #define MIN_CHUNK_LEN (1 << 20)
+#endif // MIN_CHUNK_LEN
 
 namespace Aqua{ namespace InputOutput{
 
+/** @brief Numeric type of the components of a field
+ */
+typedef enum{
+    COMPONENT_UINT,
+    COMPONENT_INT,
+    COMPONENT_FLOAT,
+}component_type;
+
+/** @brief Field to be read
+ */
+typedef struct{
+    /// Host storage
+    void *data;
+    /// Type size in bytes
+    size_t typesize;
+    /// Number of components
+    unsigned int n;
+    /// Components type
+    component_type type;
+}field_info;
+
+/** @brief Chunk of the file to be parsed by a thread
+ */
+typedef struct{
+    /// First character of the chunk
+    const char *begin;
+    /// Character after the end of the chunk
+    const char *end;
+    /// Number of lines in the chunk
+    unsigned int n_lines;
+    /// Number of particles in the chunk
+    unsigned int n_particles;
+    /// Number of lines before the chunk
+    unsigned int first_line;
+    /// Number of particles before the chunk
+    unsigned int first;
+    /// Fields to be read
+    const std::vector<field_info> *fields;
+    /// Error message, empty if the chunk was successfully parsed
+    std::string error;
+}chunk_data;
+
+/** @brief Check whether a character is a fields separator or not
+ * @param c Character
+ * @return true if it is a separator, false otherwise
+ */
+static inline bool isSeparator(char c)
+{
+    switch(c){
+        case ' ': case ',': case ';': case '(': case ')':
+        case '[': case ']': case '{': case '}': case '\t': case '\r':
+            return true;
+    }
+    return false;
+}
+
+/** @brief Look for the next value in a line
+ * @param pos Position in the line, which is moved after the value
+ * @param end End of the line
+ * @param token First character of the value
+ * @param len Number of characters of the value
+ * @return true if a value has been found, false otherwise
+ */
+static inline bool nextToken(const char* &pos,
+                             const char *end,
+                             const char* &token,
+                             size_t &len)
+{
+    while((pos < end) && isSeparator(*pos))
+        pos++;
+    if((pos == end) || (*pos == '#')){
+        // The remaining text is a comment
+        pos = end;
+        return false;
+    }
+    token = pos;
+    while((pos < end) && !isSeparator(*pos) && (*pos != '#'))
+        pos++;
+    len = pos - token;
+    return true;
+}
+
+/** @brief Get the end of the line
+ * @param pos Position in the line
+ * @param end End of the chunk
+ * @return Position of the line break, or the end of the chunk
+ */
+static inline const char* lineEnd(const char *pos, const char *end)
+{
+    const char *eol = (const char*)memchr(pos, '\n', end - pos);
+    return eol ? eol : end;
+}
+
+/** @brief Parallel thread to count the lines and the particles of a chunk
+ * @param data_void Input data of type chunk_data* (dynamically casted as
+ * void*)
+ */
+static void* count_pthread(void *data_void)
+{
+    chunk_data *data = (chunk_data*)data_void;
+    const char *pos = data->begin, *token;
+    size_t len;
+    data->n_lines = 0;
+    data->n_particles = 0;
+    while(pos < data->end){
+        const char *eol = lineEnd(pos, data->end);
+        if(nextToken(pos, eol, token, len))
+            data->n_particles++;
+        data->n_lines++;
+        pos = (eol < data->end) ? eol + 1 : eol;
+    }
+    return NULL;
+}
+
+/** @brief Parallel thread to parse the particles of a chunk
+ * @param data_void Input data of type chunk_data* (dynamically casted as
+ * void*)
+ */
+static void* parse_pthread(void *data_void)
+{
+    chunk_data *data = (chunk_data*)data_void;
+    const char *pos = data->begin, *token;
+    size_t len;
+    char buf[MAX_TOKEN_LEN];
+    unsigned int i = data->first, i_line = data->first_line;
+    while(pos < data->end){
+        const char *eol = lineEnd(pos, data->end);
+        i_line++;
+        const char *line = pos;
+        if(!nextToken(pos, eol, token, len)){
+            pos = (eol < data->end) ? eol + 1 : eol;
+            continue;
+        }
+        pos = line;
+
+        for(auto field : *(data->fields)){
+            char *ptr = (char*)field.data + field.typesize * i;
+            for(unsigned int k = 0; k < field.n; k++){
+                if(!nextToken(pos, eol, token, len)){
+                    std::ostringstream msg;
+                    msg << "Line " << i_line
+                        << " has not fields enough." << std::endl;
+                    data->error = msg.str();
+                    return NULL;
+                }
+                if(len >= MAX_TOKEN_LEN){
+                    std::ostringstream msg;
+                    msg << "Line " << i_line << " has a too long value, \""
+                        << std::string(token, len) << "\"." << std::endl;
+                    data->error = msg.str();
+                    return NULL;
+                }
+                // The mapped file is not null terminated, so the value shall
+                // be copied in order to convert it
+                memcpy(buf, token, len);
+                buf[len] = '\0';
+                char *val_end;
+                errno = 0;
+                switch(field.type){
+                    case COMPONENT_UINT:{
+                        unsigned int val = (unsigned int)strtoul(buf,
+                                                                 &val_end,
+                                                                 10);
+                        memcpy(ptr, &val, sizeof(unsigned int));
+                        break;
+                    }
+                    case COMPONENT_INT:{
+                        int val = (int)strtol(buf, &val_end, 10);
+                        memcpy(ptr, &val, sizeof(int));
+                        break;
+                    }
+                    case COMPONENT_FLOAT:{
+                        float val = strtof(buf, &val_end);
+                        memcpy(ptr, &val, sizeof(float));
+                        break;
+                    }
+                }
+                // The decimals are just truncated on integer numbers
+                if((field.type != COMPONENT_FLOAT) && (val_end != buf) &&
+                   (*val_end == '.')){
+                    val_end++;
+                    while(isdigit(*val_end))
+                        val_end++;
+                }
+                // The whole token shall be consumed, otherwise it has
+                // trailing garbage, e.g. "1.5abc"
+                if((val_end == buf) || (val_end != buf + len)){
+                    std::ostringstream msg;
+                    msg << "Cannot extract a number from \"" << buf
+                        << "\" string, in line " << i_line << "." << std::endl;
+                    data->error = msg.str();
+                    return NULL;
+                }
+                if(errno == ERANGE){
+                    std::ostringstream msg;
+                    msg << "The number extracted from \"" << buf
+                        << "\" string, in line " << i_line
+                        << ", overflows its type." << std::endl;
+                    data->error = msg.str();
+                    return NULL;
+                }
+                ptr += field.typesize / field.n;
+            }
+        }
+        if(nextToken(pos, eol, token, len)){
+            std::ostringstream msg;
+            msg << "Line " << i_line
+                << " has more fields than the required ones." << std::endl;
+            data->error = msg.str();
+            return NULL;
+        }
+
+        i++;
+        pos = (eol < data->end) ? eol + 1 : eol;
+    }
+    return NULL;
+}
+
+/** @brief Run a function on each chunk, in parallel threads
+ * @param chunks Chunks of the file
+ * @param func Function to be executed
+ */
+static void runChunks(std::vector<chunk_data> &chunks,
+                      void* (*func)(void*))
+{
+    std::vector<pthread_t> tids;
+    for(unsigned int i = 1; i < chunks.size(); i++){
+        pthread_t tid;
+        if(pthread_create(&tid, NULL, func, (void*)&(chunks.at(i)))){
+            // Just parse it on the current thread
+            func((void*)&(chunks.at(i)));
+            continue;
+        }
+        tids.push_back(tid);
+    }
+    func((void*)&(chunks.at(0)));
+    for(auto tid : tids){
+        pthread_join(tid, NULL);
+    }
+}
+
 FastASCII::FastASCII(ProblemSetup& sim_data,
                      unsigned int first,
                      unsigned int n,
@@ -46,67 +299,222 @@ FastASCII::~FastASCII()
 {
 }
 
-std::string FastASCII::readField(const std::string field,
-                                 const std::string line,
-                                 unsigned int index,
-                                 void* data)
+void FastASCII::load()
 {
-    unsigned int i;
-    Variables *vars = CalcServer::CalcServer::singleton()->variables();
-    ArrayVariable *var = (ArrayVariable*)vars->get(field);
-
-    // Extract the variable type data
-    unsigned int n = vars->typeToN(var->type());
-    size_t type_size = vars->typeToBytes(var->type());
-    std::string type = trimCopy(var->type());
-    if (type.back() == '*') {
-        type.pop_back();
-    }
-
-    // Point to the chunk of data to become read
-    void* ptr = (void*)((char*)data + type_size * index);
-
-    std::string remaining = line;
-    for(i = 0; i < n; i++){
-        std::string::size_type end_pos;
-        try {
-            if(!type.compare("unsigned int") ||
-            (type.find("uivec") != std::string::npos)){
-                unsigned int val = (unsigned int)std::stoul(remaining, &end_pos);
-                memcpy(ptr, &val, sizeof(unsigned int));
-            }
-            else if(!type.compare("int") ||
-            (type.find("ivec") != std::string::npos)){
-                int val = std::stoi(remaining, &end_pos);
-                memcpy(ptr, &val, sizeof(int));
-            }
-            else{
-                float val = std::stof(remaining, &end_pos);
-                memcpy(ptr, &val, sizeof(int));
-            }
-        } catch(const std::invalid_argument& e) {
+    unsigned int i, n, N;
+    cl_int err_code;
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+
+    loadDefault();
+
+    std::string path = simData().sets.at(setId())->inputPath();
+    std::ostringstream msg;
+    msg << "Loading particles from ASCII file \"" << path
+        << "\"..." << std::endl;
+    LOG(L_INFO, msg.str());
+
+    // Check the fields to read
+    std::vector<std::string> fields = simData().sets.at(setId())->inputFields();
+    if(!fields.size()){
+        LOG(L_ERROR, "0 fields were set to be read from the file.\n");
+        throw std::runtime_error("No fields have to be read");
+    }
+    bool have_r = false;
+    for(auto field : fields){
+        if(!field.compare("r")){
+            have_r = true;
+            break;
+        }
+    }
+    if(!have_r){
+        LOG(L_ERROR, "\"r\" field was not set to be read from the file.\n");
+        throw std::runtime_error("Reading \"r\" field is mandatory");
+    }
+    Variables *vars = C->variables();
+    for(auto field : fields){
+        if(!vars->get(field)){
+            std::ostringstream msg;
+            msg << "Undeclared variable \"" << field
+                << "\" set to be read." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable");
+        }
+        if(vars->get(field)->type().find('*') == std::string::npos){
             std::ostringstream msg;
-            msg << "Cannot extract a number from \"" << remaining
-                << "\" string." << std::endl;
+            msg << "Can't read scalar variable \"" << field
+                << "\"." << std::endl;
             LOG(L_ERROR, msg.str());
-            throw;
-        } catch(const std::out_of_range & e) {
+            throw std::runtime_error("Invalid variable type");
+        }
+        ArrayVariable *var = (ArrayVariable*)vars->get(field);
+        size_t typesize = vars->typeToBytes(var->type());
+        size_t len = var->size() / typesize;
+        if(len < bounds().y) {
             std::ostringstream msg;
-            msg << "The number extracted from \"" << remaining
-                << "\" string overflows \""
-                << type << "\" type." << std::endl;
-            LOG(L_ERROR, msg.str());                
-            throw;
+            msg << "Array variable \"" << field
+                << "\" is not long enough." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::runtime_error("Invalid variable length");
         }
+    }
 
-        // Go to the next field, we already asserted that there are fields
-        // enough, so we don't need to care about that
-        ptr = ((char*)ptr) + type_size / n;
-        remaining = remaining.substr(end_pos);
-        if (remaining.find(',') != std::string::npos)
-            remaining = remaining.substr(remaining.find(',') + 1);
+    // Map the file
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        LOG(L_ERROR, "The file cannot be read.\n");
+        std::ostringstream msg;
+        msg << "\t" << strerror(errno) << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Failure reading file");
+    }
+    struct stat st;
+    if(fstat(fd, &st)){
+        close(fd);
+        LOG(L_ERROR, "The file cannot be read.\n");
+        throw std::runtime_error("Failure reading file");
+    }
+    size_t file_size = st.st_size;
+    const char *map = NULL;
+    if(file_size){
+        void *addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED){
+            close(fd);
+            LOG(L_ERROR, "Failure mapping the file in memory.\n");
+            std::ostringstream msg;
+            msg << "\t" << strerror(errno) << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Failure reading file");
+        }
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+        map = (const char*)addr;
+    }
+    close(fd);
+
+    // Split the file in chunks, at the line breaks
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_chunks = file_size / MIN_CHUNK_LEN + 1;
+    if((n_cpus > 0) && (n_chunks > (size_t)n_cpus))
+        n_chunks = n_cpus;
+    std::vector<chunk_data> chunks;
+    const char *pos = map;
+    for(i = 0; i < n_chunks; i++){
+        chunk_data chunk;
+        chunk.begin = pos;
+        chunk.end = map + file_size * (i + 1) / n_chunks;
+        if(chunk.end < chunk.begin)
+            chunk.end = chunk.begin;
+        if(chunk.end < map + file_size)
+            chunk.end = lineEnd(chunk.end, map + file_size) + 1;
+        if(chunk.end > map + file_size)
+            chunk.end = map + file_size;
+        chunk.n_lines = 0;
+        chunk.n_particles = 0;
+        chunk.first_line = 0;
+        chunk.first = 0;
+        chunk.fields = NULL;
+        chunks.push_back(chunk);
+        pos = chunk.end;
+    }
+
+    // Count the particles, and assert that the number is right
+    runChunks(chunks, &count_pthread);
+    N = 0;
+    unsigned int n_lines = 0;
+    for(auto &chunk : chunks){
+        chunk.first = N;
+        chunk.first_line = n_lines;
+        N += chunk.n_particles;
+        n_lines += chunk.n_lines;
+    }
+    n = bounds().y - bounds().x;
+    if(n != N){
+        if(map)
+            munmap((void*)map, file_size);
+        std::ostringstream msg;
+        msg << "Expected " << n << " particles, but the file contains just "
+            << N << " ones." << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid number of particles in file");
+    }
+
+    // Setup an storage
+    std::vector<field_info> infos;
+    for(auto field : fields){
+        ArrayVariable *var = (ArrayVariable*)vars->get(field);
+        field_info info;
+        info.typesize = vars->typeToBytes(var->type());
+        info.n = vars->typeToN(var->type());
+        std::string type = trimCopy(var->type());
+        if(!type.compare("unsigned int*") ||
+           (type.find("uivec") != std::string::npos)){
+            info.type = COMPONENT_UINT;
+        }
+        else if(!type.compare("int*") ||
+           (type.find("ivec") != std::string::npos)){
+            info.type = COMPONENT_INT;
+        }
+        else{
+            info.type = COMPONENT_FLOAT;
+        }
+        info.data = malloc(info.typesize * n);
+        if(!info.data){
+            for(auto other : infos)
+                free(other.data);
+            if(map)
+                munmap((void*)map, file_size);
+            std::ostringstream msg;
+            msg << "Failure allocating " << info.typesize * n
+                << "bytes for variable \"" << field
+                << "\"." << std::endl;
+            LOG(L_ERROR, msg.str());
+            throw std::bad_alloc();
+        }
+        infos.push_back(info);
+    }
+
+    // Read the particles
+    for(auto &chunk : chunks){
+        chunk.fields = &infos;
+    }
+    runChunks(chunks, &parse_pthread);
+    if(map)
+        munmap((void*)map, file_size);
+    for(auto chunk : chunks){
+        if(chunk.error == "")
+            continue;
+        for(auto info : infos)
+            free(info.data);
+        LOG(L_ERROR, chunk.error);
+        throw std::runtime_error("Bad formatted file");
+    }
+
+    // Send the data to the server and release it
+    i = 0;
+    for(auto field : fields){
+        ArrayVariable *var = (ArrayVariable*)vars->get(field);
+        cl_mem mem = *(cl_mem*)var->get();
+        err_code = clEnqueueWriteBuffer(C->command_queue(),
+                                        mem,
+                                        CL_TRUE,
+                                        infos.at(i).typesize * bounds().x,
+                                        infos.at(i).typesize * n,
+                                        infos.at(i).data,
+                                        0,
+                                        NULL,
+                                        NULL);
+        free(infos.at(i).data); infos.at(i).data = NULL;
+        if(err_code != CL_SUCCESS){
+            for(auto info : infos)
+                free(info.data);
+            std::ostringstream msg;
+            msg << "Failure sending variable \"" << field
+                << "\" to the server." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL error");
+        }
+        i++;
     }
-    return remaining;
 }
 
 }}  // namespace
@@ -177,10 +177,11 @@ unsigned int Particles::file(const std::string basename,
     return i;
 }
 
-std::vector<void*> Particles::download(std::vector<std::string> fields)
+std::vector<void*> Particles::download(std::vector<std::string> fields,
+                                       unsigned int &n,
+                                       std::vector<CalcServer::quantization> *quants)
 {
     std::vector<void*> data;
-    std::vector<cl_event> events;
     size_t typesize, len;
     cl_int err_code;
     CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
@@ -192,14 +193,12 @@ std::vector<void*> Particles::download(std::vector<std::string> fields)
             msg << "Can't download undeclared variable \"" << field
                 << "\"." << std::endl;
             LOG(L_ERROR, msg.str());
-            clearList(&data);
             throw std::runtime_error("Invalid variable");
         }
         if(vars->get(field)->type().find('*') == std::string::npos){
             std::ostringstream msg;
             msg << "Variable \"" << field << "\" is a scalar." << std::endl;
             LOG(L_ERROR, msg.str());
-            clearList(&data);
             throw std::runtime_error("Invalid variable type");
         }
         ArrayVariable *var = (ArrayVariable*)vars->get(field);
@@ -213,54 +212,62 @@ std::vector<void*> Particles::download(std::vector<std::string> fields)
             msg << "length = " << bounds().y << "is required, but just "
                 << len << " components are available." << std::endl;
             LOG0(L_DEBUG, msg.str());
-            clearList(&data);
             throw std::runtime_error("Invalid variable length");
         }
-        void *store = malloc(typesize * (bounds().y - bounds().x));
-        if(!store){
-            std::ostringstream msg;
-            msg << "Failure allocating " << typesize * (bounds().y - bounds().x)
-                << "bytes for variable \"" << field << "\"." << std::endl;
-            LOG(L_ERROR, msg.str());
-            clearList(&data);
-            throw std::bad_alloc();
-        }
-        data.push_back(store);
+    }
 
-        cl_event event;
-        try {
-            event = C->getUnsortedMem(
-                var->name().c_str(),
-                typesize * bounds().x,
-                typesize * (bounds().y - bounds().x),
-                store);
-        } catch (...) {
-            clearList(&data);
-            throw;
+    std::vector<float> tolerances;
+    if(quants){
+        for(auto field : fields){
+            tolerances.push_back(
+                simData().sets.at(setId())->outputTolerance(field));
         }
+    }
 
-        events.push_back(event);
+    cl_event event;
+    n = bounds().y - bounds().x;
+    const std::string filter = simData().sets.at(setId())->outputFilter();
+    if(filter.size()){
+        event = C->getFilteredMem(fields,
+                                  bounds().x,
+                                  bounds().y - bounds().x,
+                                  filter,
+                                  simData().sets.at(setId())->outputFilterFields(),
+                                  data,
+                                  n,
+                                  tolerances,
+                                  quants);
+    }
+    else{
+        event = C->getUnsortedMem(fields,
+                                  bounds().x,
+                                  bounds().y - bounds().x,
+                                  data,
+                                  tolerances,
+                                  quants);
+    }
+    if(!event){
+        LOG(L_ERROR, "Failure downloading the variables.\n");
+        throw std::runtime_error("OpenCL error");
     }
 
     // Wait until all the data has been downloaded
-    err_code = clWaitForEvents(events.size(),
-                               events.data());
+    err_code = clWaitForEvents(1, &event);
     if(err_code != CL_SUCCESS){
         LOG(L_ERROR, "Failure waiting for the variables download.\n");
         Logger::singleton()->printOpenCLError(err_code);
+        clReleaseEvent(event);
         clearList(&data);
         throw std::runtime_error("OpenCL error");
     }
 
-    // Destroy the events
-    for(auto event : events){
-        err_code = clReleaseEvent(event);
-        if(err_code != CL_SUCCESS){
-            LOG(L_ERROR, "Failure releasing the events.\n");
-            Logger::singleton()->printOpenCLError(err_code);
-            clearList(&data);
-            throw std::runtime_error("OpenCL error");
-        }
+    // Destroy the event
+    err_code = clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        LOG(L_ERROR, "Failure releasing the event.\n");
+        Logger::singleton()->printOpenCLError(err_code);
+        clearList(&data);
+        throw std::runtime_error("OpenCL error");
     }
 
     return data;
@@ -268,9 +275,11 @@ std::vector<void*> Particles::download(std::vector<std::string> fields)
 
 void Particles::clearList(std::vector<void*> *data)
 {
+    CalcServer::StagingPool *staging =
+        CalcServer::CalcServer::singleton()->staging();
     for(auto d : *data){
         if(d)
-            free(d);
+            staging->release(d);
     }
     data->clear();
 }
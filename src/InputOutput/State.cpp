@@ -29,6 +29,7 @@
 
 #include <InputOutput/State.h>
 #include <InputOutput/Logger.h>
+#include <InputOutput/WriterPool.h>
 #include <CalcServer.h>
 #include <AuxiliarMethods.h>
 
@@ -362,6 +363,99 @@ void State::parseSettings(DOMElement *root,
             DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
             sim_data.settings.base_path = xmlAttribute(s_elem, "path");
         }
+        s_nodes = elem->getElementsByTagName(xmlS("ProgramCache"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            sim_data.settings.program_cache = xmlAttribute(s_elem, "path");
+        }
+        s_nodes = elem->getElementsByTagName(xmlS("Replay"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            if(!toLowerCopy(xmlAttribute(s_elem, "value")).compare("true")){
+                sim_data.settings.replay = true;
+            }
+            else{
+                sim_data.settings.replay = false;
+            }
+        }
+        s_nodes = elem->getElementsByTagName(xmlS("Scheduler"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            if(!xmlAttribute(s_elem, "mode").compare("sequential")){
+                sim_data.settings.queues = 0;
+            }
+            else if(!xmlAttribute(s_elem, "mode").compare("concurrent")){
+                sim_data.settings.queues = 4;
+                if(xmlHasAttribute(s_elem, "queues")){
+                    sim_data.settings.queues =
+                        std::stoi(xmlAttribute(s_elem, "queues"));
+                }
+            }
+            else{
+                std::ostringstream msg;
+                msg << "Unknow \"" << xmlAttribute(s_elem, "mode")
+                    << "\" scheduler mode" << std::endl;
+                LOG(L_ERROR, msg.str());
+                LOG0(L_DEBUG, "\tThe valid options are:\n");
+                LOG0(L_DEBUG, "\t\tsequential\n");
+                LOG0(L_DEBUG, "\t\tconcurrent\n");
+                throw std::runtime_error("Invalid scheduler mode");
+            }
+        }
+        s_nodes = elem->getElementsByTagName(xmlS("Writers"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            if(xmlHasAttribute(s_elem, "threads")){
+                sim_data.settings.writer_threads =
+                    std::stoi(xmlAttribute(s_elem, "threads"));
+            }
+            if(xmlHasAttribute(s_elem, "queue")){
+                sim_data.settings.writer_queue =
+                    std::stoi(xmlAttribute(s_elem, "queue"));
+            }
+            if(xmlHasAttribute(s_elem, "memory")){
+                sim_data.settings.writer_memory =
+                    std::stoi(xmlAttribute(s_elem, "memory"));
+            }
+            if(xmlHasAttribute(s_elem, "policy")){
+                sim_data.settings.writer_policy =
+                    toLowerCopy(xmlAttribute(s_elem, "policy"));
+                // Just to check that the policy is valid
+                WriterPool::toPolicy(sim_data.settings.writer_policy);
+            }
+        }
+        s_nodes = elem->getElementsByTagName(xmlS("Checkpoint"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            sim_data.settings.checkpoint_path = xmlAttribute(s_elem, "file");
+            if(xmlHasAttribute(s_elem, "interval")){
+                sim_data.settings.checkpoint_interval =
+                    std::stof(xmlAttribute(s_elem, "interval"));
+            }
+            if(!(sim_data.settings.checkpoint_interval > 0.f)){
+                std::ostringstream msg;
+                msg << "Invalid checkpoints interval "
+                    << sim_data.settings.checkpoint_interval
+                    << " s, it shall be positive" << std::endl;
+                LOG(L_ERROR, msg.str());
+                throw std::runtime_error("Invalid checkpoints interval");
+            }
+        }
     }
 }
 
@@ -827,13 +921,16 @@ void State::parseTools(DOMElement *root,
                     tool->set("n", xmlAttribute(s_elem, "n"));
                 }
             }
-            else if(!xmlAttribute(s_elem, "type").compare("copy")){
+            else if(!xmlAttribute(s_elem, "type").compare("copy") ||
+                    !xmlAttribute(s_elem, "type").compare("swap")){
                 const char *atts[2] = {"in", "out"};
                 for(unsigned int k = 0; k < 2; k++){
                     if(!xmlHasAttribute(s_elem, atts[k])){
                         std::ostringstream msg;
                         msg << "Tool \"" << tool->get("name")
-                            << "\" is of type \"copy\", but \"" << atts[k]
+                            << "\" is of type \""
+                            << xmlAttribute(s_elem, "type")
+                            << "\", but \"" << atts[k]
                             << "\" is not defined." << std::endl;
                         LOG(L_ERROR, msg.str());
                         throw std::runtime_error("Missing attributes");
@@ -902,12 +999,72 @@ void State::parseTools(DOMElement *root,
                 }
                 tool->set("operation", xmlS(s_elem->getTextContent()));
             }
+            else if(!xmlAttribute(s_elem, "type").compare("compact")){
+                const char *atts[4] = {"in", "out", "n", "condition"};
+                for(unsigned int k = 0; k < 4; k++){
+                    if(!xmlHasAttribute(s_elem, atts[k])){
+                        std::ostringstream msg;
+                        msg << "Tool \"" << tool->get("name")
+                            << "\" is of type \"compact\", but \"" << atts[k]
+                            << "\" is not defined." << std::endl;
+                        LOG(L_ERROR, msg.str());
+                        throw std::runtime_error("Missing attribute");
+                    }
+                    tool->set(atts[k], xmlAttribute(s_elem, atts[k]));
+                }
+            }
             else if(!xmlAttribute(s_elem, "type").compare("link-list")){
                 if(!xmlHasAttribute(s_elem, "in")){
                     tool->set("in", "r");
-                    continue;
                 }
-                tool->set("in", xmlAttribute(s_elem, "in"));
+                else{
+                    tool->set("in", xmlAttribute(s_elem, "in"));
+                }
+                if(xmlHasAttribute(s_elem, "incremental")){
+                    tool->set("incremental",
+                              xmlAttribute(s_elem, "incremental"));
+                }
+                else{
+                    tool->set("incremental", "false");
+                }
+                if(xmlHasAttribute(s_elem, "threshold")){
+                    tool->set("threshold", xmlAttribute(s_elem, "threshold"));
+                }
+                else{
+                    tool->set("threshold", "0.05");
+                }
+                if(xmlHasAttribute(s_elem, "ordering")){
+                    tool->set("ordering", xmlAttribute(s_elem, "ordering"));
+                }
+                else{
+                    tool->set("ordering", "linear");
+                }
+                if(xmlHasAttribute(s_elem, "sparse")){
+                    tool->set("sparse", xmlAttribute(s_elem, "sparse"));
+                }
+                else{
+                    tool->set("sparse", "false");
+                }
+            }
+            else if(!xmlAttribute(s_elem, "type").compare("neighbour-list")){
+                if(!xmlHasAttribute(s_elem, "in")){
+                    tool->set("in", "r");
+                }
+                else{
+                    tool->set("in", xmlAttribute(s_elem, "in"));
+                }
+                if(xmlHasAttribute(s_elem, "skin")){
+                    tool->set("skin", xmlAttribute(s_elem, "skin"));
+                }
+                else{
+                    tool->set("skin", "0.1");
+                }
+                if(xmlHasAttribute(s_elem, "max_neighs")){
+                    tool->set("max_neighs", xmlAttribute(s_elem, "max_neighs"));
+                }
+                else{
+                    tool->set("max_neighs", "64");
+                }
             }
             else if(!xmlAttribute(s_elem, "type").compare("radix-sort")){
                 const char *atts[3] = {"in", "perm", "inv_perm"};
@@ -1046,6 +1203,34 @@ void State::parseTools(DOMElement *root,
                 else{
                     tool->set("fps", xmlAttribute(s_elem, "fps"));
                 }
+                if(!xmlHasAttribute(s_elem, "ids")){
+                    tool->set("ids", "");
+                }
+                else{
+                    tool->set("ids", xmlAttribute(s_elem, "ids"));
+                }
+                if(!xmlHasAttribute(s_elem, "format")){
+                    tool->set("format", "text");
+                }
+                else{
+                    std::string format = xmlAttribute(s_elem, "format");
+                    if(format.compare("text") && format.compare("binary")){
+                        std::ostringstream msg;
+                        msg << "Report \"" << tool->get("name")
+                            << "\" has an invalid format \"" << format
+                            << "\"." << std::endl;
+                        LOG(L_ERROR, msg.str());
+                        LOG0(L_DEBUG, "\tValid formats are \"text\" and \"binary\"\n");
+                        throw std::runtime_error("Invalid report format");
+                    }
+                    tool->set("format", format);
+                }
+                if(!xmlHasAttribute(s_elem, "flush")){
+                    tool->set("flush", "1");
+                }
+                else{
+                    tool->set("flush", xmlAttribute(s_elem, "flush"));
+                }
             }
             else if(!xmlAttribute(s_elem, "type").compare("report_performance")){
                 if(xmlHasAttribute(s_elem, "bold")){
@@ -1075,11 +1260,14 @@ void State::parseTools(DOMElement *root,
                 LOG0(L_DEBUG, "\tThe valid types are:\n");
                 LOG0(L_DEBUG, "\t\tkernel\n");
                 LOG0(L_DEBUG, "\t\tcopy\n");
+                LOG0(L_DEBUG, "\t\tswap\n");
                 LOG0(L_DEBUG, "\t\tpython\n");
                 LOG0(L_DEBUG, "\t\tset\n");
                 LOG0(L_DEBUG, "\t\tset_scalar\n");
                 LOG0(L_DEBUG, "\t\treduction\n");
+                LOG0(L_DEBUG, "\t\tcompact\n");
                 LOG0(L_DEBUG, "\t\tlink-list\n");
+                LOG0(L_DEBUG, "\t\tneighbour-list\n");
                 LOG0(L_DEBUG, "\t\tradix-sort\n");
                 LOG0(L_DEBUG, "\t\tassert\n");
                 LOG0(L_DEBUG, "\t\tif\n");
@@ -1188,6 +1376,114 @@ void State::parseTiming(DOMElement *root,
     }
 }
 
+/** @brief Split a comma separated list of values
+ * @param values Comma separated values
+ * @return List of trimmed values
+ */
+static std::vector<std::string> splitValues(const std::string values)
+{
+    std::vector<std::string> split;
+    std::istringstream f(values);
+    std::string s;
+    while (getline(f, s, ',')) {
+        split.push_back(trimCopy(s));
+    }
+    return split;
+}
+
+/** @brief Translate an output filter into the OpenCL condition to be met by
+ * the particles.
+ * @param s_elem Filter XML element
+ * @param fields Fields required by the condition
+ * @return Condition
+ */
+static std::string filterCondition(DOMElement *s_elem,
+                                   std::vector<std::string> &fields)
+{
+    const char* components[4] = {"x", "y", "z", "w"};
+    std::ostringstream condition;
+    std::string type = toLowerCopy(xmlAttribute(s_elem, "type"));
+    fields.clear();
+    if(!type.compare("box")){
+        std::vector<std::string> min_values = splitValues(
+            xmlAttribute(s_elem, "min"));
+        std::vector<std::string> max_values = splitValues(
+            xmlAttribute(s_elem, "max"));
+        if(!min_values.size() || (min_values.size() > 4) ||
+           (min_values.size() != max_values.size())){
+            LOG(L_ERROR, "Invalid box filter bounds.\n");
+            throw std::runtime_error("Invalid filter");
+        }
+        for(unsigned int i = 0; i < min_values.size(); i++){
+            if(i)
+                condition << " && ";
+            condition << "(r." << components[i] << " >= (" << min_values.at(i)
+                      << ")) && (r." << components[i] << " <= ("
+                      << max_values.at(i) << "))";
+        }
+        fields.push_back("r");
+    }
+    else if(!type.compare("sphere")){
+        std::vector<std::string> center = splitValues(
+            xmlAttribute(s_elem, "center"));
+        std::string radius = xmlAttribute(s_elem, "radius");
+        if(!center.size() || (center.size() > 4) || !radius.size()){
+            LOG(L_ERROR, "Invalid sphere filter center or radius.\n");
+            throw std::runtime_error("Invalid filter");
+        }
+        condition << "(";
+        for(unsigned int i = 0; i < center.size(); i++){
+            if(i)
+                condition << " + ";
+            condition << "(r." << components[i] << " - (" << center.at(i)
+                      << ")) * (r." << components[i] << " - (" << center.at(i)
+                      << "))";
+        }
+        condition << ") <= (" << radius << ") * (" << radius << ")";
+        fields.push_back("r");
+    }
+    else if(!type.compare("imove")){
+        std::vector<std::string> values = splitValues(
+            xmlAttribute(s_elem, "value"));
+        if(!values.size()){
+            LOG(L_ERROR, "Invalid imove filter values.\n");
+            throw std::runtime_error("Invalid filter");
+        }
+        for(unsigned int i = 0; i < values.size(); i++){
+            if(i)
+                condition << " || ";
+            condition << "(imove == (" << values.at(i) << "))";
+        }
+        fields.push_back("imove");
+    }
+    else if(!type.compare("stride")){
+        std::string stride = xmlAttribute(s_elem, "value");
+        if(std::stoi(stride) < 1){
+            LOG(L_ERROR, "Invalid stride filter value.\n");
+            throw std::runtime_error("Invalid filter");
+        }
+        condition << "(k % " << std::stoi(stride) << ") == 0";
+    }
+    else if(!type.compare("condition")){
+        condition << xmlAttribute(s_elem, "value");
+        if(xmlHasAttribute(s_elem, "fields"))
+            fields = splitValues(xmlAttribute(s_elem, "fields"));
+    }
+    else{
+        std::ostringstream msg;
+        msg << "Unknow \"" << type << "\" output filter type" << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "\tThe valid options are:\n");
+        LOG0(L_DEBUG, "\t\tbox\n");
+        LOG0(L_DEBUG, "\t\tsphere\n");
+        LOG0(L_DEBUG, "\t\timove\n");
+        LOG0(L_DEBUG, "\t\tstride\n");
+        LOG0(L_DEBUG, "\t\tcondition\n");
+        throw std::runtime_error("Invalid filter type");
+    }
+    return condition.str();
+}
+
 void State::parseSets(DOMElement *root,
                       ProblemSetup &sim_data,
                       std::string prefix)
@@ -1240,6 +1536,35 @@ void State::parseSets(DOMElement *root,
             std::string format = xmlAttribute(s_elem, "format");
             std::string fields = xmlAttribute(s_elem, "fields");
             set->output(path, format, fields);
+            if(xmlHasAttribute(s_elem, "compression")){
+                unsigned int level = 0;
+                if(xmlHasAttribute(s_elem, "level"))
+                    level = std::stoi(xmlAttribute(s_elem, "level"));
+                set->outputCompression(
+                    toLowerCopy(xmlAttribute(s_elem, "compression")), level);
+            }
+        }
+
+        s_nodes = elem->getElementsByTagName(xmlS("Filter"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            std::vector<std::string> fields;
+            std::string condition = filterCondition(s_elem, fields);
+            set->addOutputFilter(condition, fields);
+        }
+
+        s_nodes = elem->getElementsByTagName(xmlS("Quantize"));
+        for(XMLSize_t j=0; j<s_nodes->getLength(); j++){
+            DOMNode* s_node = s_nodes->item(j);
+            if(s_node->getNodeType() != DOMNode::ELEMENT_NODE)
+                continue;
+            DOMElement* s_elem = dynamic_cast<xercesc::DOMElement*>(s_node);
+            std::string field = xmlAttribute(s_elem, "field");
+            float tolerance = std::stof(xmlAttribute(s_elem, "tolerance"));
+            set->addOutputQuantization(field, tolerance);
         }
         sim_data.sets.push_back(set);
     }
@@ -1352,6 +1677,34 @@ void State::parseReports(DOMElement *root,
                 else{
                     report->set("fps", xmlAttribute(s_elem, "fps"));
                 }
+                if(!xmlHasAttribute(s_elem, "ids")){
+                    report->set("ids", "");
+                }
+                else{
+                    report->set("ids", xmlAttribute(s_elem, "ids"));
+                }
+                if(!xmlHasAttribute(s_elem, "format")){
+                    report->set("format", "text");
+                }
+                else{
+                    std::string format = xmlAttribute(s_elem, "format");
+                    if(format.compare("text") && format.compare("binary")){
+                        std::ostringstream msg;
+                        msg << "Report \"" << report->get("name")
+                            << "\" has an invalid format \"" << format
+                            << "\"." << std::endl;
+                        LOG(L_ERROR, msg.str());
+                        LOG0(L_DEBUG, "\tValid formats are \"text\" and \"binary\"\n");
+                        throw std::runtime_error("Invalid report format");
+                    }
+                    report->set("format", format);
+                }
+                if(!xmlHasAttribute(s_elem, "flush")){
+                    report->set("flush", "1");
+                }
+                else{
+                    report->set("flush", xmlAttribute(s_elem, "flush"));
+                }
             }
             else if(!xmlAttribute(s_elem, "type").compare("performance")){
                 if(xmlHasAttribute(s_elem, "bold")){
@@ -1502,6 +1855,47 @@ void State::writeSettings(xercesc::DOMDocument* doc,
     }
     s_elem->setAttribute(xmlS("type"), xmlS(att.str()));
     elem->appendChild(s_elem);
+
+    s_elem = doc->createElement(xmlS("ProgramCache"));
+    s_elem->setAttribute(xmlS("path"), xmlS(sim_data.settings.program_cache));
+    elem->appendChild(s_elem);
+
+    s_elem = doc->createElement(xmlS("Replay"));
+    if(sim_data.settings.replay)
+        s_elem->setAttribute(xmlS("value"), xmlS("true"));
+    else
+        s_elem->setAttribute(xmlS("value"), xmlS("false"));
+    elem->appendChild(s_elem);
+
+    s_elem = doc->createElement(xmlS("Scheduler"));
+    if(sim_data.settings.queues){
+        s_elem->setAttribute(xmlS("mode"), xmlS("concurrent"));
+        att.str(""); att << sim_data.settings.queues;
+        s_elem->setAttribute(xmlS("queues"), xmlS(att.str()));
+    }
+    else{
+        s_elem->setAttribute(xmlS("mode"), xmlS("sequential"));
+    }
+    elem->appendChild(s_elem);
+
+    s_elem = doc->createElement(xmlS("Writers"));
+    att.str(""); att << sim_data.settings.writer_threads;
+    s_elem->setAttribute(xmlS("threads"), xmlS(att.str()));
+    att.str(""); att << sim_data.settings.writer_queue;
+    s_elem->setAttribute(xmlS("queue"), xmlS(att.str()));
+    att.str(""); att << sim_data.settings.writer_memory;
+    s_elem->setAttribute(xmlS("memory"), xmlS(att.str()));
+    s_elem->setAttribute(xmlS("policy"), xmlS(sim_data.settings.writer_policy));
+    elem->appendChild(s_elem);
+
+    if(sim_data.settings.checkpoint_path.size()){
+        s_elem = doc->createElement(xmlS("Checkpoint"));
+        s_elem->setAttribute(xmlS("file"),
+                             xmlS(sim_data.settings.checkpoint_path));
+        att.str(""); att << sim_data.settings.checkpoint_interval;
+        s_elem->setAttribute(xmlS("interval"), xmlS(att.str()));
+        elem->appendChild(s_elem);
+    }
 }
 
 void State::writeVariables(xercesc::DOMDocument* doc,
@@ -1720,17 +2114,68 @@ void State::writeSets(xercesc::DOMDocument* doc,
             if(j < sim_data.sets.at(i)->outputFields().size() - 1)
                 fields << ",";            
         }
+        // The frames spilled by the writers are binary files
+        std::string format = sim_data.sets.at(i)->outputFormat();
+        if(hasSuffix(savers.at(i)->file(), ".bin"))
+            format = "Binary";
         s_elem = doc->createElement(xmlS("Load"));
-        s_elem->setAttribute(xmlS("file"), xmlS(savers.at(i)->file()));
-        s_elem->setAttribute(xmlS("format"), xmlS(sim_data.sets.at(i)->outputFormat()));
-        s_elem->setAttribute(xmlS("fields"), xmlS(fields.str()));
+        if(sim_data.sets.at(i)->outputFilters().size()){
+            // The filtered files cannot be loaded back, so the original
+            // input is kept
+            std::ostringstream in_fields;
+            for(j = 0; j < sim_data.sets.at(i)->inputFields().size(); j++){
+                if(j)
+                    in_fields << ",";
+                in_fields << sim_data.sets.at(i)->inputFields().at(j);
+            }
+            s_elem->setAttribute(xmlS("file"),
+                                 xmlS(sim_data.sets.at(i)->inputPath()));
+            s_elem->setAttribute(xmlS("format"),
+                                 xmlS(sim_data.sets.at(i)->inputFormat()));
+            s_elem->setAttribute(xmlS("fields"), xmlS(in_fields.str()));
+        }
+        else{
+            s_elem->setAttribute(xmlS("file"), xmlS(savers.at(i)->file()));
+            s_elem->setAttribute(xmlS("format"), xmlS(format));
+            s_elem->setAttribute(xmlS("fields"), xmlS(fields.str()));
+        }
         elem->appendChild(s_elem);
 
         s_elem = doc->createElement(xmlS("Save"));
         s_elem->setAttribute(xmlS("file"), xmlS(sim_data.sets.at(i)->outputPath()));
         s_elem->setAttribute(xmlS("format"), xmlS(sim_data.sets.at(i)->outputFormat()));
         s_elem->setAttribute(xmlS("fields"), xmlS(fields.str()));
+        s_elem->setAttribute(xmlS("compression"),
+                             xmlS(sim_data.sets.at(i)->outputCompressor()));
+        if(sim_data.sets.at(i)->outputCompressionLevel()){
+            std::ostringstream level;
+            level << sim_data.sets.at(i)->outputCompressionLevel();
+            s_elem->setAttribute(xmlS("level"), xmlS(level.str()));
+        }
         elem->appendChild(s_elem);
+
+        for(auto condition : sim_data.sets.at(i)->outputFilters()){
+            std::ostringstream filter_fields;
+            for(j = 0; j < sim_data.sets.at(i)->outputFilterFields().size(); j++){
+                if(j)
+                    filter_fields << ",";
+                filter_fields << sim_data.sets.at(i)->outputFilterFields().at(j);
+            }
+            s_elem = doc->createElement(xmlS("Filter"));
+            s_elem->setAttribute(xmlS("type"), xmlS("condition"));
+            s_elem->setAttribute(xmlS("value"), xmlS(condition));
+            s_elem->setAttribute(xmlS("fields"), xmlS(filter_fields.str()));
+            elem->appendChild(s_elem);
+        }
+
+        for(auto quantization : sim_data.sets.at(i)->outputQuantizations()){
+            std::ostringstream tolerance;
+            tolerance << quantization.second;
+            s_elem = doc->createElement(xmlS("Quantize"));
+            s_elem->setAttribute(xmlS("field"), xmlS(quantization.first));
+            s_elem->setAttribute(xmlS("tolerance"), xmlS(tolerance.str()));
+            elem->appendChild(s_elem);
+        }
     }
 }
 
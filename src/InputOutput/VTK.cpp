@@ -26,10 +26,11 @@
 #ifdef HAVE_VTK
 
 #include <unistd.h>
-#include <signal.h>
 
 #include <InputOutput/VTK.h>
+#include <InputOutput/Binary.h>
 #include <InputOutput/Logger.h>
+#include <InputOutput/WriterPool.h>
 #include <ProblemSetup.h>
 #include <CalcServer.h>
 #include <AuxiliarMethods.h>
@@ -316,6 +317,44 @@ typedef struct{
     vtkXMLUnstructuredGridWriter *f;
 }data_pthread;
 
+/** @brief Build a VTK array from a downloaded column.
+ *
+ * If the column layout matches the VTK one, i.e. the type has not padding
+ * components, the array is just wrapping the column, which shall remain valid
+ * until the file is written. Otherwise the components are copied in a single
+ * pass.
+ * @param name Field name
+ * @param column Downloaded column
+ * @param n Number of particles
+ * @param n_components Number of components of the type
+ * @param typesize Size of the type, in bytes
+ * @return The VTK array
+ */
+template <typename T, typename TArray>
+static vtkSmartPointer<vtkDataArray> columnToArray(const std::string name,
+                                                   void *column,
+                                                   unsigned int n,
+                                                   unsigned int n_components,
+                                                   size_t typesize)
+{
+    vtkSmartPointer<TArray> vtk_array = vtkSmartPointer<TArray>::New();
+    vtk_array->SetNumberOfComponents(n_components);
+    vtk_array->SetName(name.c_str());
+    if(typesize == n_components * sizeof(T)){
+        // Zero-copy, the column is not released by VTK
+        vtk_array->SetArray((T*)column, (vtkIdType)n * n_components, 1);
+        return vtk_array;
+    }
+    vtk_array->SetNumberOfTuples(n);
+    T *dst = vtk_array->GetPointer(0);
+    for(unsigned int i = 0; i < n; i++){
+        memcpy(dst + i * n_components,
+               (char*)column + i * typesize,
+               n_components * sizeof(T));
+    }
+    return vtk_array;
+}
+
 /** @brief Parallel thread to write the data
  * @param data_void Input data of type data_pthread* (dynamically casted as
  * void*)
@@ -324,181 +363,106 @@ void* save_pthread(void *data_void)
 {
     unsigned int i, j;
     data_pthread *data = (data_pthread*)data_void;
+    unsigned int n = data->bounds.y - data->bounds.x;
 
-    // Create storage arrays
+    // Create the storage arrays from the whole columns
+    vtkSmartPointer<vtkPoints> vtk_points = vtkSmartPointer<vtkPoints>::New();
     std::vector< vtkSmartPointer<vtkDataArray> > vtk_arrays;
     Variables *vars = data->C->variables();
-    for(auto field : data->fields){
-        if(!vars->get(field)){
-            std::ostringstream msg;
-            msg << "Can't save undeclared variable \"" << field
-                << "\"." << std::endl;
-            data->S->addMessage(L_ERROR, msg.str());
-            for(auto d : data->data)
-                free(d);
-            data->data.clear();
-            data->f->Delete();
-            delete data; data=NULL;
-            return NULL;
-        }
-        if(vars->get(field)->type().find('*') == std::string::npos){
-            std::ostringstream msg;
-            msg << "Can't save scalar variable \"" << field
-                << "\"." << std::endl;
-            data->S->addMessage(L_ERROR, msg.str());
-            for(auto d : data->data)
-                free(d);
-            data->data.clear();
-            data->f->Delete();
-            delete data; data=NULL;
-            return NULL;
+    for(j = 0; j < data->fields.size(); j++){
+        const std::string field = data->fields.at(j);
+        if(!field.compare("r")){
+            // The points have always 3 components
+            vtkSmartPointer<vtkFloatArray> vtk_array =
+                vtkSmartPointer<vtkFloatArray>::New();
+            vtk_array->SetNumberOfComponents(3);
+            vtk_array->SetNumberOfTuples(n);
+            float *dst = vtk_array->GetPointer(0);
+            vec *ptr = (vec*)(data->data.at(j));
+            for(i = 0; i < n; i++){
+                dst[3 * i] = ptr[i].x;
+                dst[3 * i + 1] = ptr[i].y;
+                #ifdef HAVE_3D
+                    dst[3 * i + 2] = ptr[i].z;
+                #else
+                    dst[3 * i + 2] = 0.f;
+                #endif
+            }
+            vtk_points->SetData(vtk_array);
+            continue;
         }
+
         ArrayVariable *var = (ArrayVariable*)vars->get(field);
-        size_t typesize = vars->typeToBytes(var->type());
-        size_t len = var->size() / typesize;
-        if(len < data->bounds.y){
+        std::string type = var ? var->type() : "";
+        size_t typesize = vars->typeToBytes(type);
+        unsigned int n_components = vars->typeToN(type);
+        if(type.find("unsigned int") != std::string::npos ||
+           type.find("uivec") != std::string::npos) {
+            vtk_arrays.push_back(columnToArray<unsigned int,
+                                               vtkUnsignedIntArray>(
+                field, data->data.at(j), n, n_components, typesize));
+        }
+        else if(type.find("int") != std::string::npos ||
+                type.find("ivec") != std::string::npos) {
+            vtk_arrays.push_back(columnToArray<int, vtkIntArray>(
+                field, data->data.at(j), n, n_components, typesize));
+        }
+        else if(type.find("float") != std::string::npos ||
+                type.find("vec") != std::string::npos ||
+                type.find("matrix") != std::string::npos) {
+            vtk_arrays.push_back(columnToArray<float, vtkFloatArray>(
+                field, data->data.at(j), n, n_components, typesize));
+        }
+        else{
             std::ostringstream msg;
-            msg << "Variable \"" << field
-                << "\" is not long enough." << std::endl;
+            msg << "Can't save variable \"" << field << "\" of type \""
+                << type << "\"." << std::endl;
             data->S->addMessageF(L_ERROR, msg.str());
             for(auto d : data->data)
-                free(d);
+                data->C->staging()->release(d);
             data->data.clear();
             data->f->Delete();
             delete data; data=NULL;
             return NULL;
         }
-
-        unsigned int n_components = vars->typeToN(var->type());
-        if(var->type().find("unsigned int") != std::string::npos ||
-           var->type().find("uivec") != std::string::npos) {
-            vtkSmartPointer<vtkUnsignedIntArray> vtk_array =
-                vtkSmartPointer<vtkUnsignedIntArray>::New();
-            vtk_array->SetNumberOfComponents(n_components);
-            vtk_array->SetName(field.c_str());
-            vtk_arrays.push_back(vtk_array);
-        }
-        else if(var->type().find("int") != std::string::npos ||
-                var->type().find("ivec") != std::string::npos) {
-            vtkSmartPointer<vtkIntArray> vtk_array =
-                vtkSmartPointer<vtkIntArray>::New();
-            vtk_array->SetNumberOfComponents(n_components);
-            vtk_array->SetName(field.c_str());
-            vtk_arrays.push_back(vtk_array);
-        }
-        else if(var->type().find("float") != std::string::npos ||
-                var->type().find("vec") != std::string::npos ||
-                var->type().find("matrix") != std::string::npos) {
-            vtkSmartPointer<vtkFloatArray> vtk_array =
-                vtkSmartPointer<vtkFloatArray>::New();
-            vtk_array->SetNumberOfComponents(n_components);
-            vtk_array->SetName(field.c_str());
-            vtk_arrays.push_back(vtk_array);
-        }
     }
 
-    vtkSmartPointer<vtkVertex> vtk_vertex;
-    vtkSmartPointer<vtkPoints> vtk_points = vtkSmartPointer<vtkPoints>::New();
+    // Build all the vertexes at once
     vtkSmartPointer<vtkCellArray> vtk_cells = vtkSmartPointer<vtkCellArray>::New();
-
-    for(i = 0; i < data->bounds.y - data->bounds.x; i++){
-        for(j = 0; j < data->fields.size(); j++){
-            if(!data->fields.at(j).compare("r")){
-                vec *ptr = (vec*)(data->data.at(j));
-                #ifdef HAVE_3D
-                    vtk_points->InsertNextPoint(ptr[i].x, ptr[i].y, ptr[i].z);
-                #else
-                    vtk_points->InsertNextPoint(ptr[i].x, ptr[i].y, 0.f);
-                #endif
-                continue;
-            }
-            ArrayVariable *var = (ArrayVariable*)(
-                vars->get(data->fields.at(j)));
-            size_t typesize = vars->typeToBytes(var->type());
-            unsigned int n_components = vars->typeToN(var->type());
-            if(var->type().find("unsigned int") != std::string::npos ||
-               var->type().find("uivec") != std::string::npos) {
-                unsigned int vect[n_components];
-                size_t offset = typesize * i;
-                memcpy(vect,
-                       (char*)(data->data.at(j)) + offset,
-                       n_components * sizeof(unsigned int));
-                vtkSmartPointer<vtkUnsignedIntArray> vtk_array =
-                    (vtkUnsignedIntArray*)(vtk_arrays.at(j).GetPointer());
-                #if VTK_MAJOR_VERSION < 7
-                    vtk_array->InsertNextTupleValue(vect);
-                #else
-                    vtk_array->InsertNextTypedTuple(vect);
-                #endif // VTK_MAJOR_VERSION
-            }
-            else if(var->type().find("int") != std::string::npos ||
-                    var->type().find("ivec") != std::string::npos) {
-                int vect[n_components];
-                size_t offset = typesize * i;
-                memcpy(vect,
-                       (char*)(data->data.at(j)) + offset,
-                       n_components * sizeof(int));
-                vtkSmartPointer<vtkIntArray> vtk_array =
-                    (vtkIntArray*)(vtk_arrays.at(j).GetPointer());
-                #if VTK_MAJOR_VERSION < 7
-                    vtk_array->InsertNextTupleValue(vect);
-                #else
-                    vtk_array->InsertNextTypedTuple(vect);
-                #endif // VTK_MAJOR_VERSION
-            }
-            else if(var->type().find("float") != std::string::npos ||
-                    var->type().find("vec") != std::string::npos ||
-                    var->type().find("matrix") != std::string::npos) {
-                float vect[n_components];
-                size_t offset = typesize * i;
-                memcpy(vect,
-                       (char*)(data->data.at(j)) + offset,
-                       n_components * sizeof(float));
-                vtkSmartPointer<vtkFloatArray> vtk_array =
-                    (vtkFloatArray*)(vtk_arrays.at(j).GetPointer());
-                #if VTK_MAJOR_VERSION < 7
-                    vtk_array->InsertNextTupleValue(vect);
-                #else
-                    vtk_array->InsertNextTypedTuple(vect);
-                #endif // VTK_MAJOR_VERSION
-            }
+    #if VTK_MAJOR_VERSION < 9
+        vtkSmartPointer<vtkIdTypeArray> vtk_ids =
+            vtkSmartPointer<vtkIdTypeArray>::New();
+        vtk_ids->SetNumberOfTuples(2 * (vtkIdType)n);
+        vtkIdType *ids = vtk_ids->GetPointer(0);
+        for(i = 0; i < n; i++){
+            ids[2 * i] = 1;
+            ids[2 * i + 1] = i;
         }
-        vtk_vertex = vtkSmartPointer<vtkVertex>::New();
-        vtk_vertex->GetPointIds()->SetId(0, i);
-        vtk_cells->InsertNextCell(vtk_vertex);
-    }
+        vtk_cells->SetCells(n, vtk_ids);
+    #else
+        vtkSmartPointer<vtkIdTypeArray> vtk_offsets =
+            vtkSmartPointer<vtkIdTypeArray>::New();
+        vtkSmartPointer<vtkIdTypeArray> vtk_ids =
+            vtkSmartPointer<vtkIdTypeArray>::New();
+        vtk_offsets->SetNumberOfTuples((vtkIdType)n + 1);
+        vtk_ids->SetNumberOfTuples(n);
+        vtkIdType *offsets = vtk_offsets->GetPointer(0);
+        vtkIdType *ids = vtk_ids->GetPointer(0);
+        for(i = 0; i < n; i++){
+            offsets[i] = i;
+            ids[i] = i;
+        }
+        offsets[n] = n;
+        vtk_cells->SetData(vtk_offsets, vtk_ids);
+    #endif // VTK_MAJOR_VERSION
 
     // Setup the unstructured grid
     vtkSmartPointer<vtkUnstructuredGrid> grid =
         vtkSmartPointer<vtkUnstructuredGrid>::New();
     grid->SetPoints(vtk_points);
-    grid->SetCells(vtk_vertex->GetCellType(), vtk_cells);
-    for(i = 0; i < data->fields.size(); i++){
-        if(!data->fields.at(i).compare("r")){
-            continue;
-        }
-
-        ArrayVariable *var = (ArrayVariable*)(
-            vars->get(data->fields.at(i)));
-        if(var->type().find("unsigned int") != std::string::npos ||
-           var->type().find("uivec") != std::string::npos) {
-            vtkSmartPointer<vtkUnsignedIntArray> vtk_array =
-                (vtkUnsignedIntArray*)(vtk_arrays.at(i).GetPointer());
-            grid->GetPointData()->AddArray(vtk_array);
-        }
-        else if(var->type().find("int") != std::string::npos ||
-                var->type().find("ivec") != std::string::npos) {
-            vtkSmartPointer<vtkIntArray> vtk_array =
-                (vtkIntArray*)(vtk_arrays.at(i).GetPointer());
-            grid->GetPointData()->AddArray(vtk_array);
-        }
-        else if(var->type().find("float") != std::string::npos ||
-                var->type().find("vec") != std::string::npos ||
-                var->type().find("matrix") != std::string::npos) {
-            vtkSmartPointer<vtkFloatArray> vtk_array =
-                (vtkFloatArray*)(vtk_arrays.at(i).GetPointer());
-            grid->GetPointData()->AddArray(vtk_array);
-        }
+    grid->SetCells(VTK_VERTEX, vtk_cells);
+    for(auto vtk_array : vtk_arrays){
+        grid->GetPointData()->AddArray(vtk_array);
     }
 
     // Write file
@@ -512,9 +476,17 @@ void* save_pthread(void *data_void)
         data->S->addMessageF(L_ERROR, "Failure writing the VTK file.\n");
     }
 
-    // Clean up
+    // Clean up. The zero-copy arrays are wrapping the columns, so the grid
+    // shall be destroyed before releasing them
+    #if VTK_MAJOR_VERSION <= 5
+        data->f->SetInput(NULL);
+    #else // VTK_MAJOR_VERSION
+        data->f->SetInputData(NULL);
+    #endif // VTK_MAJOR_VERSION
+    grid = NULL;
+    vtk_arrays.clear();
     for(auto d : data->data)
-        free(d);
+        data->C->staging()->release(d);
     data->data.clear();
     data->f->Delete();
     delete data; data=NULL;
@@ -523,8 +495,6 @@ void* save_pthread(void *data_void)
 
 void VTK::save(float t)
 {
-    unsigned int i;
-
     // Check the fields to write
     std::vector<std::string> fields = simData().sets.at(setId())->outputFields();
     if(!fields.size()){
@@ -543,65 +513,74 @@ void VTK::save(float t)
         throw std::runtime_error("\"r\" field is mandatory");
     }
 
-    // Setup the data struct for the parallel thread
+    // Setup the data struct for the writing thread
     data_pthread *data = new data_pthread;
     data->fields = fields;
     data->bounds = bounds();
     data->C = CalcServer::CalcServer::singleton();
     data->S = Logger::singleton();
-    data->data = download(fields);
+    unsigned int n;
+    data->data = download(fields, n);
     if(!data->data.size()){
-        LOG(L_ERROR, "\"r\" field was not set to be saved into the file.\n");
+        delete data;
         throw std::runtime_error("Failure downloading data");
     }
+    data->bounds.y = data->bounds.x + n;
+    const std::string prev_file = file();
     data->f = create();
 
-    // Launch the thread
-    pthread_t tid;
-    int err;
-    err = pthread_create(&tid, NULL, &save_pthread, (void*)data);
-    if(err){
-        LOG(L_ERROR, "Failure launching the parallel thread.\n");
-        char err_str[strlen(strerror(err)) + 2];
-        strcpy(err_str, strerror(err));
-        strcat(err_str, "\n");
-        LOG0(L_DEBUG, err_str);
-        throw std::runtime_error("Failure launching VTK saving thread");
-    }
-    _tids.push_back(tid);
-
-    // Clear the already finished threads
-    if(_tids.size() > 0){
-        i = _tids.size() - 1;
-        while(true){
-            if(pthread_kill(_tids.at(i), 0)){
-                pthread_join(_tids.at(i), NULL);
-                _tids.erase(_tids.begin() + i);
-            }
-            if(i == 0) break;
-            i--;
+    // Submit it to the writers pool
+    WriterPool::task task;
+    task.bytes = 0;
+    Variables *vars = data->C->variables();
+    for(auto field : fields){
+        ArrayVariable *var = (ArrayVariable*)vars->get(field);
+        if(var)
+            task.bytes += vars->typeToBytes(var->type()) * n;
+    }
+    task.write = [data](){
+        save_pthread((void*)data);
+    };
+    task.spill = [this, data, t](){
+        // Write a binary file instead, which can be later converted
+        std::string path = file();
+        path = path.substr(0, path.size() - 4) + ".bin";
+        {
+            std::ostringstream msg;
+            msg << "Spilling \"" << path << "\" binary file..." << std::endl;
+            LOG(L_INFO, msg.str());
         }
-    }
-
-    // Check and limit the number of active writing processes
-    if(_tids.size() > 2){
-        LOG(L_WARNING, "More than 2 active writing tasks\n");
-        LOG(L_DEBUG, "This may result in heavy performance penalties, and hard disk failures\n");
-        LOG(L_DEBUG, "Please, consider a reduction of the output printing rate\n");
-        while(_tids.size() > 2){
-            pthread_join(_tids.at(0), NULL);
-            _tids.erase(_tids.begin());
+        try {
+            Binary::write(path, t, data->bounds, data->fields, data->data);
+        } catch(...) {
+            for(auto d : data->data)
+                data->C->staging()->release(d);
+            data->f->Delete();
+            delete data;
+            throw;
         }
-    }
-
-    updatePVD(t);
+        file(path);
+        for(auto d : data->data)
+            data->C->staging()->release(d);
+        data->f->Delete();
+        delete data;
+    };
+    task.discard = [this, data, prev_file](){
+        for(auto d : data->data)
+            data->C->staging()->release(d);
+        data->f->Delete();
+        delete data;
+        file(prev_file);
+        _next_file_index--;
+    };
+    if(WriterPool::singleton()->submit(task) == WriterPool::QUEUED)
+        updatePVD(t);
 }
 
 void VTK::waitForSavers(){
-    for(auto tid : _tids){
-        pthread_join(tid, NULL);
-    }
-    _tids.clear();
+    WriterPool *pool = WriterPool::singleton();
+    if(pool)
+        pool->wait();
 }
 
 vtkXMLUnstructuredGridWriter* VTK::create(){
@@ -621,6 +600,34 @@ vtkXMLUnstructuredGridWriter* VTK::create(){
     f->SetFileName(basename_str.c_str());
     _next_file_index++;
 
+    // Raw appended binary data, optionally compressed
+    f->SetDataModeToAppended();
+    f->EncodeAppendedDataOff();
+    const std::string compressor = simData().sets.at(setId())->outputCompressor();
+    const unsigned int level = simData().sets.at(setId())->outputCompressionLevel();
+    if(!compressor.compare("none")){
+        f->SetCompressor(NULL);
+    }
+    #if (VTK_MAJOR_VERSION > 8) || \
+        ((VTK_MAJOR_VERSION == 8) && (VTK_MINOR_VERSION >= 2))
+        else if(!compressor.compare("lz4")){
+            f->SetCompressorTypeToLZ4();
+        }
+        else if(!compressor.compare("lzma")){
+            f->SetCompressorTypeToLZMA();
+        }
+        else{
+            f->SetCompressorTypeToZLib();
+        }
+        if(level && f->GetCompressor()){
+            f->SetCompressionLevel(level);
+        }
+    #else
+        else if(compressor.compare("zlib") || level){
+            LOG(L_WARNING, "Just the default zlib compression is supported by the VTK version.\n");
+        }
+    #endif // VTK_VERSION
+
     return f;
 }
 
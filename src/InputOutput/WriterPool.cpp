@@ -0,0 +1,217 @@
+/*
+ *  This file is part of AQUAgpusph, a free CFD program based on SPH.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  AQUAgpusph is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  AQUAgpusph is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with AQUAgpusph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * @brief Pool of parallel threads to write the output files.
+ * (See Aqua::InputOutput::WriterPool for details)
+ */
+
+#include <sys/time.h>
+#include <string.h>
+#include <sstream>
+#include <stdexcept>
+
+#include <InputOutput/WriterPool.h>
+#include <InputOutput/Logger.h>
+
+namespace Aqua{ namespace InputOutput{
+
+WriterPool::WriterPool(unsigned int n_threads,
+                       unsigned int max_queue,
+                       size_t max_memory,
+                       policy pol)
+    : _max_queue(max_queue ? max_queue : 1)
+    , _max_memory(max_memory)
+    , _policy(pol)
+    , _active(0)
+    , _memory(0)
+    , _stop(false)
+    , _written(0)
+    , _busy(0.0)
+    , _skipped(0)
+    , _spilled(0)
+{
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond_task, NULL);
+    pthread_cond_init(&_cond_done, NULL);
+
+    if(!n_threads)
+        n_threads = 1;
+    for(unsigned int i = 0; i < n_threads; i++){
+        pthread_t tid;
+        int err = pthread_create(&tid, NULL, &WriterPool::worker, (void*)this);
+        if(err){
+            LOG(L_ERROR, "Failure launching the writing thread.\n");
+            std::ostringstream msg;
+            msg << "\t" << strerror(err) << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            if(!_tids.size())
+                throw std::runtime_error("Failure launching writing threads");
+            break;
+        }
+        _tids.push_back(tid);
+    }
+
+    std::ostringstream msg;
+    msg << _tids.size() << " writing threads launched" << std::endl;
+    LOG(L_INFO, msg.str());
+}
+
+WriterPool::~WriterPool()
+{
+    wait();
+    pthread_mutex_lock(&_mutex);
+    _stop = true;
+    pthread_cond_broadcast(&_cond_task);
+    pthread_mutex_unlock(&_mutex);
+    for(auto tid : _tids){
+        pthread_join(tid, NULL);
+    }
+    _tids.clear();
+
+    pthread_cond_destroy(&_cond_done);
+    pthread_cond_destroy(&_cond_task);
+    pthread_mutex_destroy(&_mutex);
+}
+
+WriterPool::outcome WriterPool::submit(task t)
+{
+    pthread_mutex_lock(&_mutex);
+    if(!room(t.bytes)){
+        if((_policy == SKIP) ||
+           ((_policy == SPILL) && t.spill)){
+            // Count it while the mutex is still locked
+            if(_policy == SKIP)
+                _skipped++;
+            else
+                _spilled++;
+            pthread_mutex_unlock(&_mutex);
+            if(_policy == SKIP){
+                LOG(L_WARNING,
+                    "The writers are falling behind, skipping the frame\n");
+                t.discard();
+                return SKIPPED;
+            }
+            LOG(L_WARNING,
+                "The writers are falling behind, spilling the frame\n");
+            t.spill();
+            return SPILLED;
+        }
+        while(!room(t.bytes)){
+            pthread_cond_wait(&_cond_done, &_mutex);
+        }
+    }
+    _memory += t.bytes;
+    _queue.push_back(t);
+    pthread_cond_signal(&_cond_task);
+    pthread_mutex_unlock(&_mutex);
+    return QUEUED;
+}
+
+void WriterPool::wait()
+{
+    pthread_mutex_lock(&_mutex);
+    while(_queue.size() || _active){
+        pthread_cond_wait(&_cond_done, &_mutex);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+unsigned int WriterPool::depth()
+{
+    pthread_mutex_lock(&_mutex);
+    unsigned int n = _queue.size() + _active;
+    pthread_mutex_unlock(&_mutex);
+    return n;
+}
+
+float WriterPool::throughput()
+{
+    pthread_mutex_lock(&_mutex);
+    float bps = (_busy > 0.0) ? (float)(_written / _busy) : 0.f;
+    pthread_mutex_unlock(&_mutex);
+    return bps;
+}
+
+WriterPool::policy WriterPool::toPolicy(const std::string name)
+{
+    if(!name.compare("block"))
+        return BLOCK;
+    else if(!name.compare("skip"))
+        return SKIP;
+    else if(!name.compare("spill"))
+        return SPILL;
+
+    std::ostringstream msg;
+    msg << "Unknow \"" << name << "\" writers policy" << std::endl;
+    LOG(L_ERROR, msg.str());
+    LOG0(L_DEBUG, "\tThe valid options are:\n");
+    LOG0(L_DEBUG, "\t\tblock\n");
+    LOG0(L_DEBUG, "\t\tskip\n");
+    LOG0(L_DEBUG, "\t\tspill\n");
+    throw std::runtime_error("Invalid writers policy");
+}
+
+bool WriterPool::room(size_t bytes) const
+{
+    unsigned int n = _queue.size() + _active;
+    if(!n){
+        // A single frame is always accepted, even if it exceeds the budget
+        return true;
+    }
+    if(n >= _max_queue)
+        return false;
+    if(_max_memory && (_memory + bytes > _max_memory))
+        return false;
+    return true;
+}
+
+void* WriterPool::worker(void *pool_void)
+{
+    WriterPool *pool = (WriterPool*)pool_void;
+
+    pthread_mutex_lock(&pool->_mutex);
+    while(true){
+        while(!pool->_stop && !pool->_queue.size()){
+            pthread_cond_wait(&pool->_cond_task, &pool->_mutex);
+        }
+        if(!pool->_queue.size())
+            break;
+        task t = pool->_queue.front();
+        pool->_queue.pop_front();
+        pool->_active++;
+        pthread_mutex_unlock(&pool->_mutex);
+
+        timeval tic, tac;
+        gettimeofday(&tic, NULL);
+        t.write();
+        gettimeofday(&tac, NULL);
+
+        pthread_mutex_lock(&pool->_mutex);
+        pool->_busy += (double)(tac.tv_sec - tic.tv_sec) +
+                       (double)(tac.tv_usec - tic.tv_usec) * 1E-6;
+        pool->_written += t.bytes;
+        pool->_memory -= t.bytes;
+        pool->_active--;
+        pthread_cond_broadcast(&pool->_cond_done);
+    }
+    pthread_mutex_unlock(&pool->_mutex);
+    return NULL;
+}
+
+}}  // namespace
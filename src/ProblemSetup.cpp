@@ -21,7 +21,9 @@
  * (See Aqua::InputOutput::ProblemSetup for details)
  */
 
+#include <stdlib.h>
 #include <limits>
+#include <algorithm>
 #include <sstream>
 
 #include <ProblemSetup.h>
@@ -85,6 +87,19 @@ ProblemSetup::sphSettings::sphSettings()
     device_id = 0;
     device_type = CL_DEVICE_TYPE_ALL;
     base_path = "";
+    program_cache = "";
+    queues = 0;
+    replay = false;
+    writer_threads = 2;
+    writer_queue = 4;
+    writer_memory = 0;
+    writer_policy = "block";
+    checkpoint_path = "";
+    checkpoint_interval = 600.f;
+    if(getenv("XDG_CACHE_HOME"))
+        program_cache = std::string(getenv("XDG_CACHE_HOME")) + "/aquagpusph";
+    else if(getenv("HOME"))
+        program_cache = std::string(getenv("HOME")) + "/.cache/aquagpusph";
 }
 
 void ProblemSetup::sphVariables::registerVariable(std::string name,
@@ -196,6 +211,8 @@ unsigned int ProblemSetup::toolInstances(ProblemSetup::sphTool *tool)
 
 ProblemSetup::sphParticlesSet::sphParticlesSet()
     : _n(0)
+    , _out_compressor("zlib")
+    , _out_level(0)
 {
 }
 
@@ -238,4 +255,79 @@ void ProblemSetup::sphParticlesSet::output(std::string path,
     }
 }
 
+void ProblemSetup::sphParticlesSet::outputCompression(std::string compressor,
+                                                      unsigned int level)
+{
+    if(compressor.compare("none") &&
+       compressor.compare("zlib") &&
+       compressor.compare("lz4") &&
+       compressor.compare("lzma")){
+        std::ostringstream msg;
+        msg << "Unknow \"" << compressor
+            << "\" output compressor" << std::endl;
+        LOG(L_ERROR, msg.str());
+        LOG0(L_DEBUG, "\tThe valid options are:\n");
+        LOG0(L_DEBUG, "\t\tnone\n");
+        LOG0(L_DEBUG, "\t\tzlib\n");
+        LOG0(L_DEBUG, "\t\tlz4\n");
+        LOG0(L_DEBUG, "\t\tlzma\n");
+        throw std::runtime_error("Invalid output compressor");
+    }
+    if(level > 9){
+        std::ostringstream msg;
+        msg << "Invalid compression level " << level
+            << ", it shall be in the range [0, 9]" << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid compression level");
+    }
+    _out_compressor = compressor;
+    _out_level = level;
+}
+
+void ProblemSetup::sphParticlesSet::addOutputFilter(
+    std::string condition,
+    std::vector<std::string> fields)
+{
+    _out_filters.push_back(condition);
+    for(auto field : fields){
+        if(std::find(_out_filter_fields.begin(),
+                     _out_filter_fields.end(),
+                     field) == _out_filter_fields.end())
+            _out_filter_fields.push_back(field);
+    }
+}
+
+void ProblemSetup::sphParticlesSet::addOutputQuantization(std::string field,
+                                                          float tolerance)
+{
+    if(!(tolerance > 0.f)){
+        std::ostringstream msg;
+        msg << "Invalid quantization tolerance " << tolerance
+            << " for the field \"" << field
+            << "\", it shall be positive" << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid quantization tolerance");
+    }
+    _out_tolerances[field] = tolerance;
+}
+
+float ProblemSetup::sphParticlesSet::outputTolerance(std::string field) const
+{
+    auto it = _out_tolerances.find(field);
+    if(it == _out_tolerances.end())
+        return 0.f;
+    return it->second;
+}
+
+const std::string ProblemSetup::sphParticlesSet::outputFilter() const
+{
+    std::ostringstream condition;
+    for(unsigned int i = 0; i < _out_filters.size(); i++){
+        if(i)
+            condition << " && ";
+        condition << "(" << _out_filters.at(i) << ")";
+    }
+    return condition.str();
+}
+
 }}  // namespace
@@ -40,6 +40,7 @@ TimeManager::TimeManager(ProblemSetup& sim_data)
     , _output_fps(-1.f)
     , _output_step(0)
     , _output_ipf(-1)
+    , _checkpoint_interval(-1.f)
 {
     unsigned int i;
     Variables *vars = CalcServer::CalcServer::singleton()->variables();
@@ -98,6 +99,10 @@ TimeManager::TimeManager(ProblemSetup& sim_data)
 
     _output_time = *_time;
     _output_step = *_step;
+
+    if(sim_data.settings.checkpoint_path.size())
+        _checkpoint_interval = sim_data.settings.checkpoint_interval;
+    gettimeofday(&_checkpoint_time, NULL);
 }
 
 TimeManager::~TimeManager()
@@ -154,4 +159,18 @@ bool TimeManager::mustPrintOutput()
     return false;
 }
 
+bool TimeManager::mustCheckpoint()
+{
+    if(_checkpoint_interval <= 0.f)
+        return false;
+    timeval now;
+    gettimeofday(&now, NULL);
+    float elapsed = (float)(now.tv_sec - _checkpoint_time.tv_sec) +
+                    (float)(now.tv_usec - _checkpoint_time.tv_usec) * 1E-6f;
+    if(elapsed < _checkpoint_interval)
+        return false;
+    _checkpoint_time = now;
+    return true;
+}
+
 }}  // namespace
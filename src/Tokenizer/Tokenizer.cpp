@@ -76,10 +76,7 @@ Tokenizer::Tokenizer()
         lc->thousands_sep = "";
     }
 
-    // Register a modulus operator
-    p.DefineOprtChars("%");
-    p.DefineOprt("%", mod_operator, mu::prINFIX);
-    p.DefineInfixOprt("!", not_operator, 0);
+    defineOperators(p);
 }
 
 Tokenizer::~Tokenizer()
@@ -172,6 +169,14 @@ float Tokenizer::solve(const std::string eq)
     return result;
 }
 
+void Tokenizer::defineOperators(mu::Parser &parser)
+{
+    // Register a modulus operator
+    parser.DefineOprtChars("%");
+    parser.DefineOprt("%", mod_operator, mu::prINFIX);
+    parser.DefineInfixOprt("!", not_operator, 0);
+}
+
 void Tokenizer::defaultVariables()
 {
     // Pi and e are registered variables out of the box
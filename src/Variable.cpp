@@ -22,6 +22,8 @@
  * (see Aqua::InpuOutput::Variable and Aqua::InpuOutput::Variables)
  */
 
+#include <algorithm>
+
 #include <Variable.h>
 #include <AuxiliarMethods.h>
 #include <InputOutput/Logger.h>
@@ -103,6 +105,141 @@ void Variable::setEvent(cl_event event)
     }
     _event = event;
     _synced = false;
+
+    // The readers are predecessors of the new event as well
+    for(auto reader_event : _reader_events){
+        err_code = clReleaseEvent(reader_event);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure releasing a reader event for \"" <<
+                   name() << "\" variable." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+    }
+    _reader_events.clear();
+}
+
+cl_event Variable::getEvent()
+{
+    if(!_reader_events.size())
+        return _event;
+
+    cl_int err_code;
+    cl_event event;
+    CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+    std::vector<cl_event> events = _reader_events;
+    events.push_back(_event);
+    err_code = clEnqueueMarkerWithWaitList(C->command_queue(),
+                                           events.size(),
+                                           events.data(),
+                                           &event);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure joining the reader events for \"" <<
+               name() << "\" variable." << std::endl;
+        LOG(L_ERROR, msg.str());
+        Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+    // setEvent() would mark the variable as not synced, but the marker is not
+    // modifying the variable at all
+    bool synced = _synced;
+    setEvent(event);
+    _synced = synced;
+    err_code = clReleaseEvent(event);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure releasing the joint event for \"" <<
+               name() << "\" variable." << std::endl;
+        LOG(L_ERROR, msg.str());
+        Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+    return _event;
+}
+
+void Variable::addReaderEvent(cl_event event)
+{
+    cl_int err_code;
+
+    // Forgive the readers which are already complete. Otherwise the list
+    // would grow forever for the variables which are never written
+    auto reader_event = _reader_events.begin();
+    while(reader_event != _reader_events.end()){
+        cl_int status;
+        err_code = clGetEventInfo(*reader_event,
+                                  CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                  sizeof(cl_int),
+                                  &status,
+                                  NULL);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure querying a reader event status for \"" <<
+                   name() << "\" variable." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        if(status != CL_COMPLETE){
+            reader_event++;
+            continue;
+        }
+        err_code = clReleaseEvent(*reader_event);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure releasing a reader event for \"" <<
+                   name() << "\" variable." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        reader_event = _reader_events.erase(reader_event);
+    }
+
+    // Join the pending readers in a marker if there are too many of them
+    if(_reader_events.size() >= __MAX_READER_EVENTS__){
+        cl_event marker;
+        CalcServer::CalcServer *C = CalcServer::CalcServer::singleton();
+        err_code = clEnqueueMarkerWithWaitList(C->command_queue(),
+                                               _reader_events.size(),
+                                               _reader_events.data(),
+                                               &marker);
+        if(err_code != CL_SUCCESS){
+            std::stringstream msg;
+            msg << "Failure joining the reader events for \"" <<
+                   name() << "\" variable." << std::endl;
+            LOG(L_ERROR, msg.str());
+            Logger::singleton()->printOpenCLError(err_code);
+            throw std::runtime_error("OpenCL execution error");
+        }
+        for(auto e : _reader_events){
+            err_code = clReleaseEvent(e);
+            if(err_code != CL_SUCCESS){
+                std::stringstream msg;
+                msg << "Failure releasing a reader event for \"" <<
+                       name() << "\" variable." << std::endl;
+                LOG(L_ERROR, msg.str());
+                Logger::singleton()->printOpenCLError(err_code);
+                throw std::runtime_error("OpenCL execution error");
+            }
+        }
+        // The marker is already retained
+        _reader_events.clear();
+        _reader_events.push_back(marker);
+    }
+
+    err_code = clRetainEvent(event);
+    if(err_code != CL_SUCCESS){
+        std::stringstream msg;
+        msg << "Failure reteaning the reader event for \"" <<
+               name() << "\" variable." << std::endl;
+        LOG(L_ERROR, msg.str());
+        Logger::singleton()->printOpenCLError(err_code);
+        throw std::runtime_error("OpenCL execution error");
+    }
+    _reader_events.push_back(event);
 }
 
 void Variable::sync()
@@ -1247,170 +1384,87 @@ void Variables::solve(const std::string type_name,
         throw std::runtime_error("Empty value string");
     }
 
+    unsigned int n = typeToN(type_name);
+    if(n > 4){
+        throw std::runtime_error("Invalid variable type");
+    }
+    // The tokenizer requires the updated values of the pending variables
+    std::vector<Variable*> deferred = _deferred;
+    _deferred.clear();
+    for(auto var : deferred){
+        populate(var);
+    }
+    float auxval[4];
+    readComponents(name, value, n, auxval);
+    castComponents(type_name, auxval, data);
+}
+
+void Variables::castComponents(const std::string type_name,
+                               const float *v,
+                               void *data)
+{
     // Ignore whether it is an array or a scalar
     std::string type = trimCopy(type_name);
     if(type.back() == '*')
         type.pop_back();
-
-    if(!type.compare("int")){
-        int val;
-        float auxval;
-        readComponents(name, value, 1, &auxval);
-        val = round(auxval);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("unsigned int")){
-        unsigned int val;
-        float auxval;
-        readComponents(name, value, 1, &auxval);
-        val = (unsigned int)round(auxval);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("float")){
-        float val;
-        readComponents(name, value, 1, &val);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("vec")){
-        vec val;
-        #ifdef HAVE_3D
-            float auxval[4];
-            readComponents(name, value, 4, auxval);
-            val.x = auxval[0];
-            val.y = auxval[1];
-            val.z = auxval[2];
-            val.w = auxval[3];
-            memcpy(data, &val, typesize);
-        #else
-            float auxval[2];
-            readComponents(name, value, 2, auxval);
-            val.x = auxval[0];
-            val.y = auxval[1];
-        #endif
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("vec2")){
-        vec2 val;
-        float auxval[2];
-        readComponents(name, value, 2, auxval);
-        val.x = auxval[0];
-        val.y = auxval[1];
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("vec3")){
-        vec3 val;
-        float auxval[3];
-        readComponents(name, value, 3, auxval);
-        val.x = auxval[0];
-        val.y = auxval[1];
-        val.z = auxval[2];
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("vec4")){
-        vec4 val;
-        float auxval[4];
-        readComponents(name, value, 4, auxval);
-        val.x = auxval[0];
-        val.y = auxval[1];
-        val.z = auxval[2];
-        val.w = auxval[3];
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("ivec")){
-        ivec val;
-        #ifdef HAVE_3D
-            float auxval[4];
-            readComponents(name, value, 4, auxval);
-            val.x = round(auxval[0]);
-            val.y = round(auxval[1]);
-            val.z = round(auxval[2]);
-            val.w = round(auxval[3]);
-            memcpy(data, &val, typesize);
-        #else
-            float auxval[2];
-            readComponents(name, value, 2, auxval);
-            val.x = round(auxval[0]);
-            val.y = round(auxval[1]);
-        #endif
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("ivec2")){
-        ivec2 val;
-        float auxval[2];
-        readComponents(name, value, 2, auxval);
-        val.x = round(auxval[0]);
-        val.y = round(auxval[1]);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("ivec3")){
-        ivec3 val;
-        float auxval[3];
-        readComponents(name, value, 3, auxval);
-        val.x = round(auxval[0]);
-        val.y = round(auxval[1]);
-        val.z = round(auxval[2]);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("ivec4")){
-        ivec4 val;
-        float auxval[4];
-        readComponents(name, value, 4, auxval);
-        val.x = round(auxval[0]);
-        val.y = round(auxval[1]);
-        val.z = round(auxval[2]);
-        val.w = round(auxval[3]);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("uivec")){
-        uivec val;
-        #ifdef HAVE_3D
-            float auxval[4];
-            readComponents(name, value, 4, auxval);
-            val.x = (unsigned int)round(auxval[0]);
-            val.y = (unsigned int)round(auxval[1]);
-            val.z = (unsigned int)round(auxval[2]);
-            val.w = (unsigned int)round(auxval[3]);
-            memcpy(data, &val, typesize);
-        #else
-            float auxval[2];
-            readComponents(name, value, 2, auxval);
-            val.x = (unsigned int)round(auxval[0]);
-            val.y = (unsigned int)round(auxval[1]);
-        #endif
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("uivec2")){
-        uivec2 val;
-        float auxval[2];
-        readComponents(name, value, 2, auxval);
-        val.x = (unsigned int)round(auxval[0]);
-        val.y = (unsigned int)round(auxval[1]);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("uivec3")){
-        uivec3 val;
-        float auxval[3];
-        readComponents(name, value, 3, auxval);
-        val.x = (unsigned int)round(auxval[0]);
-        val.y = (unsigned int)round(auxval[1]);
-        val.z = (unsigned int)round(auxval[2]);
-        memcpy(data, &val, typesize);
-    }
-    else if(!type.compare("uivec4")){
-        uivec4 val;
-        float auxval[4];
-        readComponents(name, value, 4, auxval);
-        val.x = (unsigned int)round(auxval[0]);
-        val.y = (unsigned int)round(auxval[1]);
-        val.z = (unsigned int)round(auxval[2]);
-        val.w = (unsigned int)round(auxval[3]);
-        memcpy(data, &val, typesize);
+    unsigned int i, n = typeToN(type);
+
+    if(!type.compare("unsigned int") ||
+       !type.compare("uivec") ||
+       !type.compare("uivec2") ||
+       !type.compare("uivec3") ||
+       !type.compare("uivec4")){
+        unsigned int *val = (unsigned int*)data;
+        for(i = 0; i < n; i++)
+            val[i] = (unsigned int)round(v[i]);
+    }
+    else if(!type.compare("int") ||
+            !type.compare("ivec") ||
+            !type.compare("ivec2") ||
+            !type.compare("ivec3") ||
+            !type.compare("ivec4")){
+        int *val = (int*)data;
+        for(i = 0; i < n; i++)
+            val[i] = round(v[i]);
+    }
+    else if(!type.compare("float") ||
+            !type.compare("vec") ||
+            !type.compare("vec2") ||
+            !type.compare("vec3") ||
+            !type.compare("vec4")){
+        memcpy(data, v, n * sizeof(float));
     }
     else{
         throw std::runtime_error("Invalid variable type");
     }
 }
 
+std::vector<std::string> Variables::splitComponents(const std::string value)
+{
+    // Replace all the commas outside functions by semicolons, to be taken into
+    // account as separators
+    std::string edited_val = value;
+    int parenthesis_counter = 0;
+    for (auto it = edited_val.begin(); it != edited_val.end(); ++it) {
+        // We does not care about unbalanced parenthesis, muparser will do it
+        if(*it == '(')
+            parenthesis_counter++;
+        else if(*it == ')')
+            parenthesis_counter--;
+        else if((*it == ',') && (parenthesis_counter == 0)){
+            *it = ';';
+        }        
+    }
+
+    std::vector<std::string> components;
+    std::istringstream f(edited_val);
+    std::string s;
+    while (getline(f, s, ';')) {
+        components.push_back(s);
+    }
+    return components;
+}
+
 void Variables::populate(const std::string name)
 {
     unsigned int i;
@@ -1430,6 +1484,13 @@ void Variables::populate(const std::string name)
     for(auto var : _vars){
         populate(var);
     }
+    _deferred.clear();
+}
+
+void Variables::populateDeferred(Variable* var)
+{
+    if(std::find(_deferred.begin(), _deferred.end(), var) == _deferred.end())
+        _deferred.push_back(var);
 }
 
 void Variables::populate(Variable* var)
@@ -1950,27 +2011,10 @@ void Variables::readComponents(const std::string name,
         throw std::runtime_error("5+ components variable registration");
     }
 
-    // Replace all the commas outside functions by semicolons, to be taken into
-    // account as separators
-    std::string edited_val = value;
-    int parenthesis_counter = 0;
-    for (auto it = edited_val.begin(); it != edited_val.end(); ++it) {
-        // We does not care about unbalanced parenthesis, muparser will do it
-        if(*it == '(')
-            parenthesis_counter++;
-        else if(*it == ')')
-            parenthesis_counter--;
-        else if((*it == ',') && (parenthesis_counter == 0)){
-            *it = ';';
-        }        
-    }
-
-    // Split the expression by semicolons, and parse each one
+    // Split the expression by commas, and parse each one
     const char* extensions[4] = {"_x", "_y", "_z", "_w"};
     i = 0;
-    std::istringstream f(edited_val);
-    std::string s;
-    while (getline(f, s, ';')) {
+    for (auto s : splitComponents(value)) {
         try {
             val = tok.solve(s);
         }
@@ -2007,4 +2051,168 @@ void Variables::readComponents(const std::string name,
     }
 }
 
+Expression::Expression(Variables *vars,
+                       const std::string type_name,
+                       const std::string value,
+                       const std::string name)
+    : _type(type_name)
+    , _value(value)
+    , _name(name)
+    , _n(Variables::typeToN(type_name))
+    , _vars(vars)
+{
+    if(!Variables::typeToBytes(_type) || (_n > 4)){
+        std::ostringstream msg;
+        msg << "Invalid type \"" << _type << "\" for the expression \""
+            << _value << "\"" << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable type");
+    }
+
+    std::vector<std::string> components = Variables::splitComponents(_value);
+    if(components.size() < _n){
+        std::ostringstream msg;
+        msg << "Failure parsing the expression \"" << _value << "\""
+            << std::endl;
+        LOG(L_ERROR, msg.str());
+        msg.str("");
+        msg << _n << " fields expected, "
+            << components.size() << " received" << std::endl;
+        LOG0(L_DEBUG, msg.str());
+        throw std::runtime_error("Invalid number of fields");
+    }
+
+    for(unsigned int i = 0; i < _n; i++){
+        mu::Parser *parser = new mu::Parser();
+        _parsers.push_back(parser);
+        Tokenizer::defineOperators(*parser);
+        try {
+            parser->SetExpr(components.at(i));
+            // Get the undefined symbols, without evaluating the expression
+            mu::varmap_type symbols = parser->GetUsedVar();
+            for(auto symbol : symbols){
+                parser->DefineVar(symbol.first, bind(symbol.first, i));
+            }
+        } catch(mu::Parser::exception_type &e) {
+            std::ostringstream msg;
+            msg << "Error parsing \"" << e.GetExpr() << "\"" << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            msg << "\t" << e.GetMsg() << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            msg.str("");
+            msg << "\tToken " << e.GetToken()
+                << " in position " << e.GetPos() << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Expression parsing error");
+        }
+        _results[i] = 0.0;
+    }
+}
+
+Expression::~Expression()
+{
+    for(auto parser : _parsers){
+        delete parser;
+    }
+    _parsers.clear();
+}
+
+std::vector<Variable*> Expression::variables() const
+{
+    std::vector<Variable*> vars;
+    for(auto &b : _bindings){
+        if(std::find(vars.begin(), vars.end(), b.var) == vars.end())
+            vars.push_back(b.var);
+    }
+    return vars;
+}
+
+void Expression::solve(void *data)
+{
+    float v[4];
+
+    // Update the bound values
+    for(auto &b : _bindings){
+        void *ptr = b.var->get();
+        switch(b.base_type){
+            case 0:
+                b.value = ((int*)ptr)[b.component];
+                break;
+            case 1:
+                b.value = ((unsigned int*)ptr)[b.component];
+                break;
+            default:
+                b.value = ((float*)ptr)[b.component];
+        }
+    }
+
+    for(unsigned int i = 0; i < _n; i++){
+        try {
+            _results[i] = _parsers.at(i)->Eval();
+        } catch(mu::Parser::exception_type &e) {
+            std::ostringstream msg;
+            msg << "Error evaluating \"" << e.GetExpr() << "\"" << std::endl;
+            LOG(L_ERROR, msg.str());
+            msg.str("");
+            msg << "\t" << e.GetMsg() << std::endl;
+            LOG0(L_DEBUG, msg.str());
+            throw std::runtime_error("Variable evaluation error");
+        }
+        v[i] = (float)_results[i];
+    }
+    Variables::castComponents(_type, v, data);
+}
+
+mu::value_type* Expression::bind(const std::string symbol,
+                                 unsigned int component)
+{
+    const char* extensions[4] = {"_x", "_y", "_z", "_w"};
+    unsigned int i;
+
+    // Previously computed components of the result
+    for(i = 0; i < component; i++){
+        if(!symbol.compare(_name + extensions[i]))
+            return &(_results[i]);
+    }
+
+    // Scalar variables, or components of the vectorial ones
+    Variable *var = _vars->get(symbol);
+    unsigned int var_component = 0;
+    if(!var && (symbol.size() > 2) && (symbol.at(symbol.size() - 2) == '_')){
+        for(i = 0; i < 4; i++){
+            if(symbol.at(symbol.size() - 1) == extensions[i][1])
+                break;
+        }
+        var = _vars->get(symbol.substr(0, symbol.size() - 2));
+        var_component = i;
+        if(var && (var_component >= Variables::typeToN(var->type())))
+            var = NULL;
+    }
+    if(!var || var->isArray()){
+        std::ostringstream msg;
+        msg << "The expression \"" << _value
+            << "\" is asking the undeclared scalar variable \""
+            << symbol << "\"" << std::endl;
+        LOG(L_ERROR, msg.str());
+        throw std::runtime_error("Invalid variable");
+    }
+
+    binding b;
+    b.var = var;
+    b.component = var_component;
+    const std::string type = var->type();
+    if((type.find("unsigned int") != std::string::npos) ||
+       (type.find("uivec") != std::string::npos))
+        b.base_type = 1;
+    else if((type.find("int") != std::string::npos) ||
+            (type.find("ivec") != std::string::npos))
+        b.base_type = 0;
+    else
+        b.base_type = 2;
+    b.value = 0.0;
+    _bindings.push_back(b);
+    return &(_bindings.back().value);
+}
+
 }}  // namespace
@@ -148,6 +148,15 @@ int main(int argc, char *argv[])
     }
 
     InputOutput::TimeManager t_manager(file_manager.problemSetup());
+    try {
+        file_manager.restart(t_manager);
+    } catch(...) {
+        delete logger; logger = NULL;
+        delete calc_server; calc_server = NULL;
+        if(Py_IsInitialized())
+            Py_Finalize();
+        return EXIT_FAILURE;
+    }
 
     LOG(L_INFO, "Start of simulation...\n");
     logger->printDate();
@@ -156,7 +165,10 @@ int main(int argc, char *argv[])
     while(!t_manager.mustStop())
     {
         try {
-            calc_server->update(t_manager);
+            if(!calc_server->update(t_manager)){
+                file_manager.checkpoint(t_manager);
+                continue;
+            }
             file_manager.save(t_manager.time());
         } catch (const Aqua::CalcServer::user_interruption& e) {
             // The user has interrupted the simulation, just exit normally
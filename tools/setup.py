@@ -50,7 +50,8 @@ setup(
               'aquagpusph_preprocessing.mesh_loader'],
     scripts=['aquagpusph_preprocessing/AQUAgpusph-loadAbaqus',
              'aquagpusph_preprocessing/AQUAgpusph-loadGiD',
-             'aquagpusph_postprocessing/pvd-locale'],
+             'aquagpusph_postprocessing/pvd-locale',
+             'aquagpusph_postprocessing/bin-decode'],
     url='http://canal.etsin.upm.es/aquagpusph',
     license='LICENSE',
     description='free SPH solver developed by the CEHINAV group.',